@@ -0,0 +1,135 @@
+#include "AttitudeFilter.h"
+
+static const float GRAVITY = 9.81f;
+static const float DEG_TO_RAD = 0.017453293f;
+// |acc|^2 band in which the accelerometer is taken for gravity
+static const float GATE_LOW_SQ = (1 - ATTITUDE_GATE) * (1 - ATTITUDE_GATE) * GRAVITY * GRAVITY;
+static const float GATE_HIGH_SQ = (1 + ATTITUDE_GATE) * (1 + ATTITUDE_GATE) * GRAVITY * GRAVITY;
+
+AttitudeFilter::AttitudeFilter(float kp):
+    mKp(kp)
+{
+    setSampleRate(52);
+    reset();
+}
+
+void AttitudeFilter::reset()
+{
+    mStarted = false;
+    mQ[0] = 1;
+    mQ[1] = mQ[2] = mQ[3] = 0;
+    updateLevel();
+}
+
+void AttitudeFilter::setSampleRate(uint32_t sampleRate)
+{
+    mHalfPeriod = 0.5f / (sampleRate ? sampleRate : 1);
+}
+
+// the shortest rotation that takes up to the acc direction
+void AttitudeFilter::start(const Vec3f &acc)
+{
+    float r = fastInvSqrt(dot(acc, acc));
+    float x = acc.x * r, y = acc.y * r, z = acc.z * r;
+    if (z < -0.999f) {
+        // upside down, any axis in the plane will do
+        mQ[0] = 0;
+        mQ[1] = 1;
+        mQ[2] = mQ[3] = 0;
+    } else {
+        r = fastInvSqrt(2 * (1 + z));
+        mQ[0] = (1 + z) * r;
+        mQ[1] = y * r;
+        mQ[2] = -x * r;
+        mQ[3] = 0;
+    }
+}
+
+void AttitudeFilter::update(const Vec3f &acc, const Vec3f &gyro)
+{
+    float accSq = dot(acc, acc);
+    bool gravity = accSq > GATE_LOW_SQ && accSq < GATE_HIGH_SQ;
+    if (!mStarted) {
+        mStarted = true;
+        if (gravity) {
+            start(acc);
+            updateLevel();
+            return;
+        }
+    }
+
+    float gx = gyro.x * DEG_TO_RAD, gy = gyro.y * DEG_TO_RAD, gz = gyro.z * DEG_TO_RAD;
+    if (gravity) {
+        // the error between measured and estimated up turns the gyro towards it
+        float r = fastInvSqrt(accSq);
+        float ax = acc.x * r, ay = acc.y * r, az = acc.z * r;
+        gx += mKp * (ay * mUp.z - az * mUp.y);
+        gy += mKp * (az * mUp.x - ax * mUp.z);
+        gz += mKp * (ax * mUp.y - ay * mUp.x);
+    }
+
+    // q += q * (0, g) * dt / 2
+    gx *= mHalfPeriod;
+    gy *= mHalfPeriod;
+    gz *= mHalfPeriod;
+    float q0 = mQ[0], q1 = mQ[1], q2 = mQ[2], q3 = mQ[3];
+    mQ[0] = q0 - q1 * gx - q2 * gy - q3 * gz;
+    mQ[1] = q1 + q0 * gx + q2 * gz - q3 * gy;
+    mQ[2] = q2 + q0 * gy - q1 * gz + q3 * gx;
+    mQ[3] = q3 + q0 * gz + q1 * gy - q2 * gx;
+    float r = fastInvSqrt(mQ[0] * mQ[0] + mQ[1] * mQ[1] + mQ[2] * mQ[2] + mQ[3] * mQ[3]);
+    for (size_t i=0; i<4; i++)
+        mQ[i] *= r;
+    updateLevel();
+}
+
+// up from the quaternion, then the tilt rotation that takes it to z
+void AttitudeFilter::updateLevel()
+{
+    const float *q = mQ;
+    mUp.x = 2 * (q[1] * q[3] - q[0] * q[2]);
+    mUp.y = 2 * (q[0] * q[1] + q[2] * q[3]);
+    mUp.z = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+    // turned over, rotate by 180 degrees about x first so the division stays away from 0
+    const bool flip = mUp.z < 0;
+    const float ux = mUp.x;
+    const float uy = flip ? -mUp.y : mUp.y;
+    const float uz = flip ? -mUp.z : mUp.z;
+    const float k = 1 / (1 + uz);
+    const float s = flip ? -1.0f : 1.0f;
+    mLevel[0].x = 1 - ux * ux * k;
+    mLevel[0].y = -ux * uy * k * s;
+    mLevel[0].z = -ux * s;
+    mLevel[1].x = -ux * uy * k;
+    mLevel[1].y = (1 - uy * uy * k) * s;
+    mLevel[1].z = -uy * s;
+    mLevel[2] = mUp;
+}
+
+Vec3f AttitudeFilter::level(const Vec3f &v) const
+{
+    Vec3f out;
+    out.x = dot(mLevel[0], v);
+    out.y = dot(mLevel[1], v);
+    out.z = dot(mLevel[2], v);
+    return out;
+}
+
+ImuBatch AttitudeFilter::levelBatch(const ImuBatch &batch, Vec3f acc[], Vec3f gyro[], size_t capacity)
+{
+    static const Vec3f NO_ROTATION = {0, 0, 0};
+    ImuBatch out = batch;
+    out.accCount = batch.accCount < capacity ? batch.accCount : capacity;
+    out.gyroCount = batch.gyroCount < out.accCount ? batch.gyroCount : out.accCount;
+    for (size_t i=0; i<out.accCount; i++) {
+        const Vec3f &g = i < out.gyroCount ? batch.gyro[i] : NO_ROTATION;
+        update(batch.acc[i], g);
+        acc[i] = level(batch.acc[i]);
+        if (i < out.gyroCount)
+            gyro[i] = level(g);
+    }
+    out.acc = acc;
+    out.gyro = gyro;
+    return out;
+}
@@ -0,0 +1,72 @@
+#pragma once
+// Attitude of the sensor from the IMU6 stream (Mahony complementary filter),
+// so the detectors can work in a gravity-aligned frame however the pod is
+// worn. The gyro integrates the orientation sample by sample; the
+// accelerometer pulls it towards gravity, only while |acc| is close to g so
+// zero-g periods and landings don't tilt it.
+//
+// Leveled samples keep the sensor's x/y axes, rotated by the tilt only (no
+// heading, which a 6-axis filter can't hold): z is up, acc z is the vertical
+// acceleration and gyro z the yaw rate, what SplitStepDetector expects of a
+// sensor worn upright.
+//
+// Per sample it is a few dozen multiply-adds, two fastInvSqrt() and one
+// division, no trig.
+#include <stddef.h>
+#include <stdint.h>
+#include "SplitStepDetector.h"
+
+const float ATTITUDE_KP = 1.0f; // 1/s, the pull towards gravity
+const float ATTITUDE_GATE = 0.25f; // |acc| within this fraction of g corrects the tilt
+const size_t LEVEL_MAX_SAMPLES = 32; // samples per batch levelBatch() takes
+
+// 1/sqrt(x) with the bit trick and two Newton steps, within 5e-6: one step
+// leaves 0.2%, enough to move |acc| of a leveled sample across a threshold
+inline float fastInvSqrt(float x)
+{
+    union { float f; uint32_t i; } v;
+    v.f = x;
+    v.i = 0x5F3759DF - (v.i >> 1);
+    float y = v.f * (1.5f - 0.5f * x * v.f * v.f);
+    return y * (1.5f - 0.5f * x * y * y);
+}
+
+class AttitudeFilter
+{
+public:
+    explicit AttitudeFilter(float kp = ATTITUDE_KP);
+
+    // the next sample starts from the tilt of its acc
+    void reset();
+
+    // rate (Hz) of the samples, for the integration step
+    void setSampleRate(uint32_t sampleRate);
+
+    // one sample, acc in m/s^2 and gyro in dps
+    void update(const Vec3f &acc, const Vec3f &gyro);
+
+    // unit vector pointing up, in sensor axes
+    const Vec3f &up() const { return mUp; }
+    float verticalAcc(const Vec3f &acc) const { return dot(acc, mUp); }
+    float yawRate(const Vec3f &gyro) const { return dot(gyro, mUp); }
+
+    // v of the current sample in the leveled frame
+    Vec3f level(const Vec3f &v) const;
+
+    // Runs the filter over the batch and writes its samples leveled to acc
+    // and gyro. Returns the leveled batch, at most capacity samples of each.
+    ImuBatch levelBatch(const ImuBatch &batch, Vec3f acc[], Vec3f gyro[], size_t capacity);
+
+private:
+    static float dot(const Vec3f &a, const Vec3f &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+    void start(const Vec3f &acc);
+    void updateLevel();
+
+    float mKp;
+    float mHalfPeriod; // s, half the sample period
+    bool mStarted;
+    float mQ[4]; // sensor to world quaternion, w x y z
+    Vec3f mUp;
+    // the tilt rotation of level(), rows
+    Vec3f mLevel[3];
+};
@@ -0,0 +1,152 @@
+#include "BleTransmitter.h"
+#include "Instrumentation.h"
+#include "common/core/debug.h"
+
+#include "comm_ble_gattsvc/resources.h"
+
+BleTransmitter::BleTransmitter():
+    ResourceClient(WBDEBUG_NAME(__FUNCTION__), WB_EXEC_CTX_APPLICATION),
+    mDataCharResource(wb::ID_INVALID_RESOURCE),
+    mEnabled(false),
+    mInFlight(false),
+    mPutRequest(0),
+    mHeld(0),
+    mRetries(0),
+    mRetryTimer(wb::ID_INVALID_TIMER),
+    mFailed(0),
+    mRefillCount(0)
+{
+}
+
+void BleTransmitter::setDataCharResource(wb::ResourceId resource)
+{
+    mDataCharResource = resource;
+}
+
+void BleTransmitter::setNotificationsEnabled(bool enabled)
+{
+    mEnabled = enabled;
+    if (!mEnabled)
+    {
+        mQueue.clear();
+        mHeld = 0;
+    }
+    else
+        sendNext();
+}
+
+void BleTransmitter::reset()
+{
+    // the link is gone, only the client's next subscription turns notifications on again
+    mEnabled = false;
+    mQueue.clear();
+    // the next link negotiates its MTU again
+    mQueue.setPayloadSize(TxQueue::DEFAULT_PAYLOAD);
+    // a put of the old link may still complete, mPutRequest tells it apart
+    mInFlight = false;
+    mHeld = 0;
+    if (mRetryTimer != wb::ID_INVALID_TIMER)
+    {
+        stopTimer(mRetryTimer);
+        mRetryTimer = wb::ID_INVALID_TIMER;
+    }
+}
+
+bool BleTransmitter::addRefillHandler(void (*handler)())
+{
+    for (size_t i = 0; i < mRefillCount; i++)
+        if (mRefill[i] == handler)
+            return true;
+    if (mRefillCount == MAX_REFILL_HANDLERS)
+        return false;
+    mRefill[mRefillCount++] = handler;
+    return true;
+}
+
+bool BleTransmitter::send(uint8_t type, uint8_t tag, const uint8_t data[], size_t len, TxPriority priority)
+{
+    PERF_SCOPE(PERF_SEND);
+    if (!mEnabled || mDataCharResource == wb::ID_INVALID_RESOURCE)
+    {
+        PERF_COUNT(PERF_TX_DROPS, 1);
+        return false;
+    }
+    if (!mQueue.push(type, tag, data, len, priority))
+    {
+        DEBUGLOG("BleTransmitter: message dropped, type %u len %u", type, len);
+        PERF_COUNT(PERF_TX_DROPS, 1);
+        return false;
+    }
+    PERF_RAISE(PERF_TX_HIGH_WATER, mQueue.size());
+    sendNext();
+    return true;
+}
+
+void BleTransmitter::sendNext()
+{
+    if (mInFlight || !mEnabled || mRetryTimer != wb::ID_INVALID_TIMER)
+        return;
+    if (mHeld == 0)
+    {
+        mHeld = mQueue.pop(mBuffer, sizeof(mBuffer));
+        mRetries = 0;
+    }
+    if (mHeld == 0)
+        return;
+    put();
+}
+
+void BleTransmitter::put()
+{
+    WB_RES::Characteristic dataCharValue;
+    dataCharValue.bytes = wb::MakeArray<uint8_t>(mBuffer, mHeld);
+    wb::Result res = asyncPut(mDataCharResource, AsyncRequestOptions(&mPutRequest, 0, true), dataCharValue);
+    if (res < 400)
+    {
+        mInFlight = true;
+        mHeld = 0;
+        return;
+    }
+    mFailed++;
+    if (++mRetries > MAX_RETRIES)
+    {
+        // the link doesn't take it, go on with the next one
+        DEBUGLOG("BleTransmitter: put refused %u times, dropped", (unsigned) mRetries);
+        mHeld = 0;
+        PERF_COUNT(PERF_TX_DROPS, 1);
+    }
+    // nothing completes to send the next one, a timer does
+    mRetryTimer = startTimer(RETRY_MS, false);
+}
+
+void BleTransmitter::onTimer(wb::TimerId timerId)
+{
+    if (timerId != mRetryTimer)
+        return;
+    mRetryTimer = wb::ID_INVALID_TIMER;
+    sendNext();
+}
+
+void BleTransmitter::onPutResult(wb::RequestId requestId,
+                                 wb::ResourceId resourceId,
+                                 wb::Result resultCode,
+                                 const wb::Value& rResultData)
+{
+    if (resourceId != mDataCharResource || !mInFlight || requestId != mPutRequest)
+        return;
+    if (resultCode >= 400)
+    {
+        DEBUGLOG("BleTransmitter::onPutResult: %d", resultCode);
+        mFailed++;
+    }
+    mInFlight = false;
+    for (size_t i = 0; i < mRefillCount; i++)
+        mRefill[i]();
+    sendNext();
+}
+
+BleTransmitter &bleTransmitter()
+{
+    static BleTransmitter transmitter;
+    return transmitter;
+}
@@ -0,0 +1,64 @@
+#pragma once
+// Sends the notifications of the data characteristic. Messages are queued in
+// a TxQueue and written one notification at a time: the next asyncPut is
+// only issued from onPutResult of the previous one, so a buffer is never
+// reused while its put is in flight and bursts are packed instead of
+// overwriting each other. A put the stack refuses is tried again a little
+// later with the same notification, up to MAX_RETRIES times.
+#include "movesense.h"
+#include "TxQueue.h"
+
+class BleTransmitter FINAL : private wb::ResourceClient
+{
+public:
+    BleTransmitter();
+
+    // the GATT data characteristic the notifications are written to
+    void setDataCharResource(wb::ResourceId resource);
+    // nothing is sent (and queued messages are discarded) while the client has notifications off
+    void setNotificationsEnabled(bool enabled);
+    // forget everything queued or in flight and the payload size, and stop sending until the
+    // client turns notifications on again, e.g. when the link dropped
+    void reset();
+
+    // Queues one [type, tag, data] message. Returns false if it was dropped.
+    bool send(uint8_t type, uint8_t tag, const uint8_t data[], size_t len, TxPriority priority = TX_PRIORITY_NORMAL);
+
+    // called whenever a notification went out, so bulk transfers can top up
+    // the queue at the pace of the link. In the order they were added, once each.
+    bool addRefillHandler(void (*handler)());
+
+    TxQueue &queue() { return mQueue; }
+    const TxStats &stats() const { return mQueue.stats(); }
+    uint32_t failedCount() const { return mFailed; }
+
+private:
+    static const size_t MAX_REFILL_HANDLERS = 2;
+    static const size_t MAX_RETRIES = 3;
+    static const size_t RETRY_MS = 20;
+
+    void sendNext();
+    void put();
+
+    virtual void onPutResult(wb::RequestId requestId,
+                             wb::ResourceId resourceId,
+                             wb::Result resultCode,
+                             const wb::Value& rResultData) OVERRIDE;
+    virtual void onTimer(wb::TimerId timerId) OVERRIDE;
+
+    TxQueue mQueue;
+    wb::ResourceId mDataCharResource;
+    bool mEnabled;
+    bool mInFlight; // a put is outstanding, mBuffer must not be touched
+    wb::RequestId mPutRequest; // of the outstanding put, results of older ones are stale
+    size_t mHeld; // length of a notification in mBuffer the stack refused, 0 for none
+    size_t mRetries; // of the held notification
+    wb::TimerId mRetryTimer;
+    uint32_t mFailed; // puts the link rejected
+    void (*mRefill[MAX_REFILL_HANDLERS])();
+    size_t mRefillCount;
+    uint8_t mBuffer[TxQueue::MAX_PAYLOAD];
+};
+
+// the transmitter of the app, created on first use
+BleTransmitter &bleTransmitter();
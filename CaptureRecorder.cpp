@@ -0,0 +1,112 @@
+#include "CaptureRecorder.h"
+#include "ImuCodec.h"
+
+CaptureRecorder::CaptureRecorder():
+    mCaptureId(0)
+{
+    reset();
+}
+
+void CaptureRecorder::reset()
+{
+    mRing.clear();
+    mCaptureCount = 0;
+    mUploaded = 0;
+    mState = IDLE;
+    mTriggerTime = 0;
+}
+
+void CaptureRecorder::record(const ImuBatch &batch, float samplePeriod)
+{
+    size_t count = batch.accCount < batch.gyroCount ? batch.accCount : batch.gyroCount;
+    for (size_t i=0; i<count; i++) {
+        CaptureSample s;
+        // only the offset in the batch is a float, the timestamp stays exact at any uptime
+        s.timestamp = batch.timestamp + (uint32_t) (i * samplePeriod + 0.5f);
+        s.acc[0] = quantizeRaw(batch.acc[i].x, RAW_ACC_SCALE);
+        s.acc[1] = quantizeRaw(batch.acc[i].y, RAW_ACC_SCALE);
+        s.acc[2] = quantizeRaw(batch.acc[i].z, RAW_ACC_SCALE);
+        s.gyro[0] = quantizeRaw(batch.gyro[i].x, RAW_GYRO_SCALE);
+        s.gyro[1] = quantizeRaw(batch.gyro[i].y, RAW_GYRO_SCALE);
+        s.gyro[2] = quantizeRaw(batch.gyro[i].z, RAW_GYRO_SCALE);
+        mRing.push(s);
+    }
+    // times are compared as differences, so the window holds across the uptime wrap
+    if (mState == COLLECTING && !mRing.empty()
+        && (int32_t) (mRing.back().timestamp - mTriggerTime) >= (int32_t) CAPTURE_POST_MS)
+        freeze();
+}
+
+bool CaptureRecorder::trigger(uint32_t time)
+{
+    if (mState != IDLE)
+        return false;
+    mTriggerTime = time;
+    mState = COLLECTING;
+    return true;
+}
+
+void CaptureRecorder::freeze()
+{
+    mCaptureCount = 0;
+    for (size_t i=0; i<mRing.size() && mCaptureCount<CAPTURE_SAMPLES; i++) {
+        const CaptureSample &s = mRing[i];
+        int32_t offset = (int32_t) (s.timestamp - mTriggerTime);
+        if (offset >= -(int32_t) CAPTURE_PRE_MS && offset <= (int32_t) CAPTURE_POST_MS)
+            mCapture[mCaptureCount++] = s;
+    }
+    mUploaded = 0;
+    mCaptureId++;
+    mState = mCaptureCount ? UPLOADING : IDLE;
+}
+
+size_t CaptureRecorder::samplesPerChunk(size_t size)
+{
+    return size > CAPTURE_HEADER_SIZE ? (size - CAPTURE_HEADER_SIZE) / CAPTURE_SAMPLE_SIZE : 0;
+}
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+size_t CaptureRecorder::chunk(uint8_t out[], size_t size) const
+{
+    if (mState != UPLOADING)
+        return 0;
+    size_t count = mCaptureCount - mUploaded;
+    size_t perChunk = samplesPerChunk(size);
+    if (count > perChunk)
+        count = perChunk;
+    if (count == 0)
+        return 0;
+
+    out[0] = mCaptureId;
+    put16(&out[1], (uint16_t) mUploaded);
+    put16(&out[3], (uint16_t) mCaptureCount);
+    size_t pos = CAPTURE_HEADER_SIZE;
+    for (size_t i=0; i<count; i++) {
+        const CaptureSample &s = mCapture[mUploaded + i];
+        out[pos++] = (uint8_t) s.timestamp;
+        out[pos++] = (uint8_t) (s.timestamp >> 8);
+        out[pos++] = (uint8_t) (s.timestamp >> 16);
+        out[pos++] = (uint8_t) (s.timestamp >> 24);
+        for (size_t k=0; k<3; k++, pos+=2)
+            put16(&out[pos], (uint16_t) s.acc[k]);
+        for (size_t k=0; k<3; k++, pos+=2)
+            put16(&out[pos], (uint16_t) s.gyro[k]);
+    }
+    return pos;
+}
+
+void CaptureRecorder::advance(size_t size)
+{
+    if (mState != UPLOADING)
+        return;
+    size_t count = mCaptureCount - mUploaded;
+    size_t perChunk = samplesPerChunk(size);
+    mUploaded += count < perChunk ? count : perChunk;
+    if (mUploaded >= mCaptureCount)
+        mState = IDLE;
+}
@@ -0,0 +1,77 @@
+#pragma once
+// Keeps the most recent acc/gyro samples in a ring so the samples around a
+// detection can be frozen and uploaded for auditing. A trigger at time T
+// captures [T - CAPTURE_PRE_MS, T + CAPTURE_POST_MS] once the post-trigger
+// samples have arrived. All memory is fixed at compile time (CAPTURE_MEMORY).
+//
+// The capture is uploaded in chunks, each a CAPTURE response payload of
+//   [captureId, firstSample (2), sampleCount (2), sample...]
+// where every sample is 16 bytes, little endian:
+//   timestamp ms (4), acc x/y/z (3 x int16, RAW_ACC_SCALE), gyro x/y/z (3 x int16, RAW_GYRO_SCALE)
+#include <stddef.h>
+#include <stdint.h>
+#include "RingBuffer.h"
+#include "SplitStepDetector.h"
+
+const uint32_t CAPTURE_PRE_MS = 400; // captured before the trigger
+const uint32_t CAPTURE_POST_MS = 200; // captured after the trigger
+const uint32_t CAPTURE_MAX_RATE = 104; // highest sample rate the window is sized for
+const size_t CAPTURE_SAMPLES = (CAPTURE_PRE_MS + CAPTURE_POST_MS) * CAPTURE_MAX_RATE / 1000 + 2;
+// the ring also has to hold the rest of the batch that completes the window
+const size_t CAPTURE_RING_SAMPLES = CAPTURE_SAMPLES + 16;
+const size_t CAPTURE_HEADER_SIZE = 5;
+const size_t CAPTURE_SAMPLE_SIZE = 16;
+
+struct CaptureSample
+{
+    uint32_t timestamp;
+    int16_t acc[3];
+    int16_t gyro[3];
+};
+
+class CaptureRecorder
+{
+public:
+    enum State
+    {
+        IDLE, // recording, nothing captured
+        COLLECTING, // triggered, waiting for the post-trigger samples
+        UPLOADING, // capture frozen, chunks pending
+    };
+
+    CaptureRecorder();
+
+    void reset();
+
+    // Appends the samples of a batch, spaced samplePeriod ms apart.
+    void record(const ImuBatch &batch, float samplePeriod);
+
+    // Starts a capture around time. Returns false if one is still running.
+    bool trigger(uint32_t time);
+
+    State state() const { return mState; }
+    // timestamp of the newest recorded sample, 0 before the first one
+    uint32_t latestTime() const { return mRing.empty() ? 0 : mRing.back().timestamp; }
+    uint8_t captureId() const { return mCaptureId; }
+
+    // Writes the next upload chunk (at most size bytes) without consuming it.
+    // Returns 0 when there is nothing to upload.
+    size_t chunk(uint8_t out[], size_t size) const;
+    // The chunk last returned by chunk(size) was sent.
+    void advance(size_t size);
+
+private:
+    void freeze();
+    static size_t samplesPerChunk(size_t size);
+
+    RingBuffer<CaptureSample, CAPTURE_RING_SAMPLES> mRing;
+    CaptureSample mCapture[CAPTURE_SAMPLES];
+    size_t mCaptureCount;
+    size_t mUploaded; // samples of mCapture already sent
+    State mState;
+    uint32_t mTriggerTime;
+    uint8_t mCaptureId;
+};
+
+// RAM the recorder takes
+const size_t CAPTURE_MEMORY = sizeof(CaptureRecorder);
@@ -0,0 +1,73 @@
+#include "CommandFrames.h"
+#include <string.h>
+
+FrameReader::FrameReader(const uint8_t write[], size_t len):
+    mWrite(write),
+    mLen(len),
+    mPos(1),
+    mMalformed(false)
+{
+}
+
+bool FrameReader::next(CommandFrame &frame)
+{
+    if (mMalformed || mPos >= mLen)
+        return false;
+    size_t len = mWrite[mPos];
+    // a frame holds at least its request ID and command
+    if (len < 2 || mPos + 1 + len > mLen) {
+        mMalformed = true;
+        return false;
+    }
+    frame.requestId = mWrite[mPos + 1];
+    frame.command = mWrite[mPos + 2];
+    frame.len = len - 2;
+    frame.data = frame.len ? &mWrite[mPos + FRAME_HEADER] : nullptr;
+    mPos += 1 + len;
+    return true;
+}
+
+FrameWriter::FrameWriter(uint8_t buffer[], size_t size):
+    mBuffer(buffer),
+    mSize(size)
+{
+    clear();
+}
+
+void FrameWriter::clear()
+{
+    mLen = 1;
+    mFrames = 0;
+    if (mSize > 0)
+        mBuffer[0] = PROTOCOL_V2;
+}
+
+bool FrameWriter::add(uint8_t requestId, uint8_t command, const uint8_t data[], size_t len)
+{
+    if (len > 0xFF - 2 || mLen + FRAME_HEADER + len > mSize)
+        return false;
+    mBuffer[mLen] = (uint8_t) (len + 2);
+    mBuffer[mLen + 1] = requestId;
+    mBuffer[mLen + 2] = command;
+    if (len)
+        memcpy(&mBuffer[mLen + FRAME_HEADER], data, len);
+    mLen += FRAME_HEADER + len;
+    mFrames++;
+    return true;
+}
+
+void encodeStatus(uint8_t command, uint16_t status, uint8_t out[])
+{
+    out[0] = command;
+    out[1] = (uint8_t) status;
+    out[2] = (uint8_t) (status >> 8);
+}
+
+bool decodeStatus(const uint8_t data[], size_t len, uint8_t &command, uint16_t &status)
+{
+    if (len != STATUS_SIZE)
+        return false;
+    command = data[0];
+    status = (uint16_t) (data[1] | (data[2] << 8));
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+// Protocol v2 of the command characteristic. A v1 write is one command:
+//   [command, data...]
+// A v2 write starts with PROTOCOL_V2, which no v1 command uses, and carries
+// as many commands as fit, each with a request ID of the client's choosing:
+//   [PROTOCOL_V2, (len, request ID, command, data[len - 2])...]
+// The frames are handled in order, each once the transmit queue has room for
+// its reply and status, so a long write doesn't overflow the queue. Every
+// command is answered with a STATUS response tagged with its request ID,
+// after whatever the command sends itself:
+//   [command, HTTP status (2)], little endian
+// The HTTP errors a v1 command replies with (replyError) go into the status
+// instead. A write with a frame that runs past its end is answered with
+// request ID 0, command PROTOCOL_V2 and 400, one that comes while two
+// writes' worth of frames still wait with 503; none of its frames run then.
+// Responses are sized to the link once the client sends SET_MTU.
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t PROTOCOL_V2 = 0xF2;
+const uint8_t STATUS_TYPE = 14; // response type of a v2 status
+const size_t FRAME_HEADER = 3; // len, request ID, command
+const size_t STATUS_SIZE = 3;
+const uint16_t STATUS_OK = 200;
+
+struct CommandFrame
+{
+    uint8_t requestId;
+    uint8_t command;
+    const uint8_t *data; // nullptr without data
+    size_t len;
+};
+
+inline bool isFramedWrite(const uint8_t write[], size_t len)
+{
+    return len >= 1 && write[0] == PROTOCOL_V2;
+}
+
+// Walks the frames of a v2 write.
+class FrameReader
+{
+public:
+    FrameReader(const uint8_t write[], size_t len);
+
+    // false at the end of the write or at a malformed frame
+    bool next(CommandFrame &frame);
+    bool malformed() const { return mMalformed; }
+    // bytes of the write read so far
+    size_t position() const { return mPos; }
+
+private:
+    const uint8_t *mWrite;
+    size_t mLen;
+    size_t mPos;
+    bool mMalformed;
+};
+
+// Builds a v2 write, the client side.
+class FrameWriter
+{
+public:
+    FrameWriter(uint8_t buffer[], size_t size);
+
+    // false when the frame doesn't fit any more
+    bool add(uint8_t requestId, uint8_t command, const uint8_t data[], size_t len);
+    size_t frames() const { return mFrames; }
+    // length of the write so far, 0 while empty
+    size_t length() const { return mFrames ? mLen : 0; }
+    const uint8_t *data() const { return mBuffer; }
+    void clear();
+
+private:
+    uint8_t *mBuffer;
+    size_t mSize;
+    size_t mLen;
+    size_t mFrames;
+};
+
+void encodeStatus(uint8_t command, uint16_t status, uint8_t out[]);
+bool decodeStatus(const uint8_t data[], size_t len, uint8_t &command, uint16_t &status);
+
+// Answers the command being handled with an HTTP error: a v1 COMMAND_RESULT
+// of [status (2, big endian)], or the status of its STATUS response in a v2
+// write. Defined with the framing in myApp.cpp.
+void replyError(uint16_t status, uint8_t tag);
+// The status of the v2 command being handled, for results that carry their
+// own status in v1 too. Does nothing outside a v2 write.
+void setFramedStatus(uint16_t status);
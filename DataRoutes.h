@@ -0,0 +1,21 @@
+#pragma once
+// The routing table of myApp's data subscriptions (myApp::mDataSubs), shared
+// by the subscription code in myApp.cpp and the stream handlers in
+// interface.cpp.
+#include "movesense.h"
+#include "RouteTable.h"
+
+// one slot per myApp::mDataSubs entry, checked in myApp.cpp
+const size_t DATA_ROUTE_SLOTS = 4;
+
+typedef RouteTable<DATA_ROUTE_SLOTS> DataRoutes;
+
+const uint8_t RAW_REF = 21; // raw streaming subscription, also the tag of its fragments
+
+DataRoutes &dataRoutes();
+
+// table key of a subscribed resource, path parameters (e.g. the sample rate) included
+inline uint32_t routeKey(const wb::ResourceId &resourceId)
+{
+    return (uint32_t) resourceId.localResourceId | ((uint32_t) resourceId.instanceId << 16);
+}
@@ -0,0 +1,144 @@
+#include "DetectionParams.h"
+
+// fields of the block, in order
+enum ParamsField
+{
+    BEGIN_ACC_FIELD,
+    END_ACC_FIELD,
+    SPLIT_STEP_GYRO_FIELD,
+    GOOD_STEP_FIELD,
+    FIXED_RATE_FIELD,
+    IDLE_RATE_FIELD,
+    ACTIVE_RATE_FIELD,
+    QUIET_PERIOD_FIELD,
+    ENTER_ACC_FIELD,
+    EXIT_ACC_FIELD,
+    ENTER_GYRO_FIELD,
+    EXIT_GYRO_FIELD,
+    CLASSIFIER_FIELD,
+    LEVEL_FIELD,
+    PARAMS_FIELD_COUNT,
+};
+static_assert(PARAMS_BLOCK_SIZE == 1 + 2 * PARAMS_FIELD_COUNT, "every field takes 2 bytes after the version");
+
+DetectionParams::DetectionParams():
+    fixedRate(0),
+    level(true)
+{
+}
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+static uint16_t get16(const uint8_t in[])
+{
+    return (uint16_t) (in[0] | (in[1] << 8));
+}
+
+// value * scale rounded and saturated to uint16
+static uint16_t quantize(float value, float scale)
+{
+    float v = value * scale + 0.5f;
+    if (v <= 0)
+        return 0;
+    return v >= 0xFFFF ? 0xFFFF : (uint16_t) v;
+}
+
+static uint16_t saturate(uint32_t value)
+{
+    return value > 0xFFFF ? 0xFFFF : (uint16_t) value;
+}
+
+size_t encodeDetectionParams(const DetectionParams &params, uint8_t out[], size_t size)
+{
+    if (size < PARAMS_BLOCK_SIZE)
+        return 0;
+    uint16_t fields[PARAMS_FIELD_COUNT];
+    fields[BEGIN_ACC_FIELD] = quantize(params.splitStep.beginThreshold, PARAMS_ACC_SCALE);
+    fields[END_ACC_FIELD] = quantize(params.splitStep.endThreshold, PARAMS_ACC_SCALE);
+    fields[SPLIT_STEP_GYRO_FIELD] = quantize(params.splitStep.splitStepThreshold, PARAMS_GYRO_SCALE);
+    fields[GOOD_STEP_FIELD] = saturate(params.splitStep.goodStepLength);
+    fields[FIXED_RATE_FIELD] = saturate(params.fixedRate);
+    fields[IDLE_RATE_FIELD] = saturate(params.rate.idleRate);
+    fields[ACTIVE_RATE_FIELD] = saturate(params.rate.activeRate);
+    fields[QUIET_PERIOD_FIELD] = saturate(params.rate.quietPeriod);
+    fields[ENTER_ACC_FIELD] = quantize(params.rate.enterAcc, PARAMS_ACC_SCALE);
+    fields[EXIT_ACC_FIELD] = quantize(params.rate.exitAcc, PARAMS_ACC_SCALE);
+    fields[ENTER_GYRO_FIELD] = quantize(params.rate.enterGyro, PARAMS_GYRO_SCALE);
+    fields[EXIT_GYRO_FIELD] = quantize(params.rate.exitGyro, PARAMS_GYRO_SCALE);
+    fields[CLASSIFIER_FIELD] = params.splitStep.classifier ? 1 : 0;
+    fields[LEVEL_FIELD] = params.level ? 1 : 0;
+
+    out[0] = PARAMS_VERSION;
+    for (size_t i=0; i<PARAMS_FIELD_COUNT; i++)
+        put16(&out[1 + 2 * i], fields[i]);
+    return PARAMS_BLOCK_SIZE;
+}
+
+bool decodeDetectionParams(const uint8_t in[], size_t len, DetectionParams &params)
+{
+    if (len < 1 || in[0] != PARAMS_VERSION || len % 2 == 0)
+        return false;
+    // later versions may append fields, the known ones are taken
+    size_t count = (len - 1) / 2;
+    if (count > PARAMS_FIELD_COUNT)
+        count = PARAMS_FIELD_COUNT;
+
+    DetectionParams p = params;
+    for (size_t i=0; i<count; i++) {
+        uint16_t v = get16(&in[1 + 2 * i]);
+        switch (i)
+        {
+            case BEGIN_ACC_FIELD: p.splitStep.beginThreshold = v / PARAMS_ACC_SCALE; break;
+            case END_ACC_FIELD: p.splitStep.endThreshold = v / PARAMS_ACC_SCALE; break;
+            case SPLIT_STEP_GYRO_FIELD: p.splitStep.splitStepThreshold = v / PARAMS_GYRO_SCALE; break;
+            case GOOD_STEP_FIELD: p.splitStep.goodStepLength = v; break;
+            case FIXED_RATE_FIELD: p.fixedRate = v; break;
+            case IDLE_RATE_FIELD: p.rate.idleRate = v; break;
+            case ACTIVE_RATE_FIELD: p.rate.activeRate = v; break;
+            case QUIET_PERIOD_FIELD: p.rate.quietPeriod = v; break;
+            case ENTER_ACC_FIELD: p.rate.enterAcc = v / PARAMS_ACC_SCALE; break;
+            case EXIT_ACC_FIELD: p.rate.exitAcc = v / PARAMS_ACC_SCALE; break;
+            case ENTER_GYRO_FIELD: p.rate.enterGyro = v / PARAMS_GYRO_SCALE; break;
+            case EXIT_GYRO_FIELD: p.rate.exitGyro = v / PARAMS_GYRO_SCALE; break;
+            case CLASSIFIER_FIELD: p.splitStep.classifier = v != 0; break;
+            case LEVEL_FIELD: p.level = v != 0; break;
+        }
+    }
+    params = p;
+    return true;
+}
+
+bool supportedSampleRate(uint32_t rate)
+{
+    static const uint32_t RATES[] = {13, 26, 52, 104, 208, 416, 833, 1666};
+    for (size_t i=0; i<sizeof(RATES)/sizeof(RATES[0]); i++) {
+        if (RATES[i] == rate)
+            return true;
+    }
+    return false;
+}
+
+static bool validRate(uint32_t rate, uint32_t maxRate)
+{
+    return rate <= maxRate && supportedSampleRate(rate);
+}
+
+bool validDetectionParams(const DetectionParams &p, uint32_t maxRate)
+{
+    const SplitStepConfig &s = p.splitStep;
+    // zero-g has to begin below the landing, or every sample toggles the state
+    if (s.beginThreshold <= 0 || s.endThreshold <= s.beginThreshold || s.splitStepThreshold <= 0)
+        return false;
+    if (p.fixedRate != 0 && !validRate(p.fixedRate, maxRate))
+        return false;
+    // equal rates would leave the scheduler nothing to switch, fixedRate is for that
+    const RateSchedulerConfig &r = p.rate;
+    if (!validRate(r.idleRate, maxRate) || !validRate(r.activeRate, maxRate) || r.idleRate >= r.activeRate)
+        return false;
+    // the exit bands sit inside the enter ones so the rate doesn't flap
+    return r.exitAcc <= r.enterAcc && r.exitGyro <= r.enterGyro;
+}
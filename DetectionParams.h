@@ -0,0 +1,47 @@
+#pragma once
+// Detection parameters that can be tuned at runtime instead of rebuilding:
+// the split step thresholds, the sample rate, the rate scheduler bands and
+// the frame the detectors work in.
+//
+// A parameter block is versioned and packed little endian:
+//   [version, begin acc (2), end acc (2), split step gyro (2), good step ms (2),
+//    fixed rate Hz (2, 0 adaptive), idle rate Hz (2), active rate Hz (2),
+//    quiet period ms (2), enter acc (2), exit acc (2), enter gyro (2), exit gyro (2),
+//    classifier (2, 0 for the split step gyro threshold), level (2, 0 for the sensor axes)]
+// acc in 0.01 m/s^2, gyro in 0.1 dps. A block may end after any field, the
+// fields left out keep their value, so a client with a small MTU can still
+// change the thresholds.
+#include <stddef.h>
+#include <stdint.h>
+#include "RateScheduler.h"
+#include "SplitStepDetector.h"
+
+const uint8_t PARAMS_VERSION = 1;
+const size_t PARAMS_BLOCK_SIZE = 29;
+const float PARAMS_ACC_SCALE = 100; // counts per m/s^2
+const float PARAMS_GYRO_SCALE = 10; // counts per dps
+
+struct DetectionParams
+{
+    SplitStepConfig splitStep;
+    uint32_t fixedRate; // sample rate (Hz) of the subscription, 0 follows rate
+    RateSchedulerConfig rate;
+    bool level; // detect in the gravity-aligned frame of AttitudeFilter, whatever the mounting
+
+    DetectionParams();
+
+    bool adaptive() const { return fixedRate == 0; }
+};
+
+// Writes the whole block, returns its size or 0 if size is too small.
+size_t encodeDetectionParams(const DetectionParams &params, uint8_t out[], size_t size);
+
+// Overwrites the fields present in the block. False, with params untouched,
+// for an unknown version or a block cut inside a field.
+bool decodeDetectionParams(const uint8_t in[], size_t len, DetectionParams &params);
+
+// whether the detectors can work with the parameters, rates up to maxRate
+bool validDetectionParams(const DetectionParams &params, uint32_t maxRate);
+
+// whether the IMU offers the sample rate
+bool supportedSampleRate(uint32_t rate);
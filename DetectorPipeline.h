@@ -0,0 +1,75 @@
+#pragma once
+// A compile-time list of detectors fed from one batch feature vector:
+//
+//   DetectorPipeline<SplitStepDetector, LateralShuffleDetector, LungeDetector> pipeline;
+//   computeBatchFeatures(...);   // once per batch
+//   n = pipeline.process(batch, features, events, max);
+//
+// Every detector is a plain member and is called directly, in list order, so
+// there is no virtual dispatch and the compiler can inline the whole chain.
+// Detectors need MAX_EVENTS_PER_BATCH, reset(), setSampleRate(rate) and
+// process(batch, features, events, maxEvents), see FootworkDetectors.h. The
+// features are the BasicBatchFeatures of the detectors' Math.
+#include <stddef.h>
+#include <stdint.h>
+#include "SplitStepDetector.h"
+
+template<typename... Detectors>
+class DetectorPipeline;
+
+template<>
+class DetectorPipeline<>
+{
+public:
+    static const size_t MAX_EVENTS_PER_BATCH = 0;
+
+    void reset() {}
+    void setSampleRate(uint32_t) {}
+    template<typename Features>
+    size_t process(const ImuBatch &, const Features &, SplitStepEvent[], size_t) { return 0; }
+};
+
+template<typename First, typename... Rest>
+class DetectorPipeline<First, Rest...>
+{
+public:
+    // room for the events of every detector, size the event buffer with it
+    static const size_t MAX_EVENTS_PER_BATCH =
+        First::MAX_EVENTS_PER_BATCH + DetectorPipeline<Rest...>::MAX_EVENTS_PER_BATCH;
+
+    void reset()
+    {
+        mFirst.reset();
+        mRest.reset();
+    }
+
+    void setSampleRate(uint32_t sampleRate)
+    {
+        mFirst.setSampleRate(sampleRate);
+        mRest.setSampleRate(sampleRate);
+    }
+
+    // Runs every detector on the batch. Events are written in list order,
+    // at most maxEvents; returns the number written.
+    template<typename Features>
+    size_t process(const ImuBatch &batch, const Features &features, SplitStepEvent events[], size_t maxEvents)
+    {
+        size_t count = mFirst.process(batch, features, events, maxEvents);
+        return count + mRest.process(batch, features, events + count, maxEvents - count);
+    }
+
+    // the detector of type T in the list
+    template<typename T>
+    T &get() { return select<T>(static_cast<T *>(nullptr)); }
+    template<typename T>
+    const T &get() const { return const_cast<DetectorPipeline *>(this)->get<T>(); }
+
+private:
+    template<typename T>
+    T &select(First *) { return mFirst; }
+    template<typename T>
+    T &select(...) { return mRest.template get<T>(); }
+
+    First mFirst;
+    DetectorPipeline<Rest...> mRest;
+};
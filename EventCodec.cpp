@@ -0,0 +1,79 @@
+#include "EventCodec.h"
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+static void put32(uint8_t out[], uint32_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+    out[2] = (uint8_t) (v >> 16);
+    out[3] = (uint8_t) (v >> 24);
+}
+
+static uint16_t get16(const uint8_t in[])
+{
+    return (uint16_t) (in[0] | (in[1] << 8));
+}
+
+static uint32_t get32(const uint8_t in[])
+{
+    return (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+void encodeEventRecord(const EventRecord &record, uint8_t out[])
+{
+    out[0] = record.kind;
+    put16(&out[1], record.sequence);
+    put32(&out[3], record.timestamp);
+    put16(&out[7], record.airtime);
+    put16(&out[9], record.maxGyro);
+}
+
+void decodeEventRecord(const uint8_t in[], EventRecord &record)
+{
+    record.kind = in[0];
+    record.sequence = get16(&in[1]);
+    record.timestamp = get32(&in[3]);
+    record.airtime = get16(&in[7]);
+    record.maxGyro = get16(&in[9]);
+}
+
+EventPacker::EventPacker(uint8_t buffer[], size_t size):
+    mBuffer(buffer),
+    mSize(size),
+    mCount(0)
+{
+}
+
+size_t EventPacker::capacity(size_t size)
+{
+    return size > EVENT_HEADER_SIZE ? (size - EVENT_HEADER_SIZE) / EVENT_RECORD_SIZE : 0;
+}
+
+bool EventPacker::add(const EventRecord &record)
+{
+    if (mCount >= capacity(mSize) || mCount >= 255)
+        return false;
+    encodeEventRecord(record, &mBuffer[EVENT_HEADER_SIZE + mCount * EVENT_RECORD_SIZE]);
+    mCount++;
+    mBuffer[0] = EVENT_PROTOCOL_VERSION;
+    mBuffer[1] = (uint8_t) mCount;
+    return true;
+}
+
+bool decodeEvents(const uint8_t data[], size_t len, EventRecord out[], size_t maxRecords, size_t &count)
+{
+    count = 0;
+    if (len < EVENT_HEADER_SIZE || data[0] != EVENT_PROTOCOL_VERSION)
+        return false;
+    size_t records = data[1];
+    if (len != EVENT_HEADER_SIZE + records * EVENT_RECORD_SIZE)
+        return false;
+    for (size_t i=0; i<records && count<maxRecords; i++)
+        decodeEventRecord(&data[EVENT_HEADER_SIZE + i * EVENT_RECORD_SIZE], out[count++]);
+    return count == records;
+}
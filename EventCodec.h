@@ -0,0 +1,53 @@
+#pragma once
+// Binary encoding of detection events, several per notification.
+//
+// An EVENTS response payload is
+//   [version, count, record * count]
+// and every record is EVENT_RECORD_SIZE bytes, little endian:
+//   kind (1), sequence (2), timestamp ms (4), airtime ms (2), max gyro dps (2)
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t EVENT_PROTOCOL_VERSION = 1;
+const size_t EVENT_HEADER_SIZE = 2; // version and count
+const size_t EVENT_RECORD_SIZE = 11;
+
+struct EventRecord
+{
+    uint8_t kind; // SplitStepEventKind
+    uint16_t sequence; // increments with every event, gaps mean lost events
+    uint32_t timestamp; // device time (ms) of the landing
+    uint16_t airtime; // ms between zero-g begin and landing
+    uint16_t maxGyro; // maximum |gyro z| (dps) during the airtime, saturated
+};
+
+// Packs records into one EVENTS payload.
+class EventPacker
+{
+public:
+    EventPacker(uint8_t buffer[], size_t size);
+
+    // false when the record doesn't fit any more
+    bool add(const EventRecord &record);
+    size_t count() const { return mCount; }
+    bool empty() const { return mCount == 0; }
+    // records that fit into a payload of the given size
+    static size_t capacity(size_t size);
+
+    // length of the payload so far, 0 while empty
+    size_t length() const { return mCount ? EVENT_HEADER_SIZE + mCount * EVENT_RECORD_SIZE : 0; }
+    const uint8_t *data() const { return mBuffer; }
+    void clear() { mCount = 0; }
+
+private:
+    uint8_t *mBuffer;
+    size_t mSize;
+    size_t mCount;
+};
+
+void encodeEventRecord(const EventRecord &record, uint8_t out[]);
+void decodeEventRecord(const uint8_t in[], EventRecord &record);
+
+// Decodes an EVENTS payload. Returns false if it is malformed or of an
+// unknown version; count is the number of records written to out.
+bool decodeEvents(const uint8_t data[], size_t len, EventRecord out[], size_t maxRecords, size_t &count);
@@ -0,0 +1,198 @@
+#pragma once
+// Sample arithmetic of the feature kernel and the detectors, chosen at
+// compile time by their Math template parameter:
+//
+//   FloatMath   float samples in m/s^2 and dps, as IMU6 delivers them
+//   FixedMath   Q15 integers: acc in 1/128 m/s^2 (full scale 256 m/s^2),
+//               gyro in 1/8 dps (full scale 4096 dps), |acc|^2 in uint32,
+//               sums in int64 and sample times in us
+//
+// A fixed-point sample is converted once from the float the sensor delivers,
+// with a power-of-two scale and an explicit rounding; from there on it is
+// integer adds, multiplies and compares, with isqrt() for the few magnitudes
+// that are reported. The same samples give the same events on any target, so
+// a host replay is bit-exact with the sensor, and no libm is needed.
+//
+// FIXED_POINT_DETECTION=1 makes DetectionMath, what the sensor analyses
+// with, the fixed-point one.
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "StreamingStats.h"
+
+#ifndef FIXED_POINT_DETECTION
+#define FIXED_POINT_DETECTION 0
+#endif
+
+constexpr float ACC_COUNTS = 128; // Q15 counts per m/s^2
+constexpr float GYRO_COUNTS = 8; // Q15 counts per dps
+
+// round to nearest (halves away from zero) and saturate to int16
+constexpr int32_t toQ15(float v, float counts)
+{
+    return v * counts >= 32767 ? 32767
+         : v * counts <= -32768 ? -32768
+         : (int32_t)(v * counts + (v < 0 ? -0.5f : 0.5f));
+}
+
+// floor(sqrt(v)), bit by bit
+inline uint32_t isqrt(uint32_t v)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Writes number in decimal, without a terminating zero. out needs room for
+// 11 characters. Returns the number of characters written.
+inline size_t formatDecimal(int32_t number, char out[])
+{
+    char digits[10];
+    size_t n = 0;
+    uint32_t v = number < 0 ? 0u - (uint32_t)number : (uint32_t)number;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    size_t len = 0;
+    if (number < 0)
+        out[len++] = '-';
+    while (n)
+        out[len++] = digits[--n];
+    return len;
+}
+
+// mean and max of non-negative Q15 values, what the detectors need of RunningStats
+class FixedRunningStats
+{
+public:
+    FixedRunningStats() { reset(); }
+
+    void reset()
+    {
+        mCount = 0;
+        mSum = 0;
+        mMax = 0;
+    }
+
+    void add(int32_t x)
+    {
+        mCount++;
+        mSum += x;
+        mMax = x > mMax ? x : mMax;
+    }
+
+    uint32_t count() const { return mCount; }
+    int32_t mean() const { return mCount ? (int32_t)(mSum / mCount) : 0; }
+    int32_t max() const { return mMax; }
+
+private:
+    uint32_t mCount;
+    int64_t mSum;
+    int32_t mMax;
+};
+
+struct FloatMath
+{
+    typedef float Value; // acc (m/s^2) or gyro (dps)
+    typedef float Square; // |acc|^2
+    typedef float Sum; // of values
+    typedef float SquareSum; // of squares
+    typedef float Time; // ms from the batch timestamp, small enough for a float at any uptime
+    typedef RunningStats Stats;
+
+    static Value acc(float v) { return v; }
+    static Value gyro(float v) { return v; }
+    static float accUnits(Value v) { return v; }
+    static float gyroUnits(Value v) { return v; }
+
+    static Value abs(Value v) { return fabsf(v); } // branch-free, see absf()
+    static Square square(Value v) { return v * v; }
+    static Square squareSum(Value x, Value y, Value z) { return x*x + y*y + z*z; }
+    static Value root(Square s) { return sqrtf(s); }
+    static Value mean(Sum sum, size_t count) { return sum * (count ? 1.0f / count : 0); }
+    static Square meanSquare(SquareSum sum, size_t count) { return sum * (count ? 1.0f / count : 0); }
+    static Value lowest() { return -FLT_MAX; }
+    static Value highest() { return FLT_MAX; }
+    static Square highestSquare() { return FLT_MAX; }
+
+    static Time samplePeriod(uint32_t sampleRate) { return 1000.0f / sampleRate; }
+    static Time sampleTime(size_t index, Time period) { return index * period; }
+    static Time fromMs(int32_t ms) { return (Time)ms; }
+    // rounded to the nearest ms, before the batch timestamp when negative
+    static int32_t toMs(Time t) { return (int32_t)floorf(t + 0.5f); }
+    // t0 + (t1 - t0) * num / den, the fraction clamped to [0, 1]
+    static Time interpolate(Time t0, Time t1, Value num, Value den)
+    {
+        float fraction = num / den;
+        if (fraction < 0)
+            fraction = 0;
+        else if (fraction > 1)
+            fraction = 1;
+        return t0 + fraction * (t1 - t0);
+    }
+};
+
+struct FixedMath
+{
+    typedef int32_t Value; // Q15 counts, int32 so products don't overflow
+    typedef uint32_t Square; // up to 3 * 2^30
+    typedef int64_t Sum;
+    typedef uint64_t SquareSum;
+    typedef int64_t Time; // us from the batch timestamp
+    typedef FixedRunningStats Stats;
+
+    static constexpr Value acc(float v) { return toQ15(v, ACC_COUNTS); }
+    static constexpr Value gyro(float v) { return toQ15(v, GYRO_COUNTS); }
+    static float accUnits(Value v) { return v * (1 / ACC_COUNTS); }
+    static float gyroUnits(Value v) { return v * (1 / GYRO_COUNTS); }
+
+    static Value abs(Value v) { return v < 0 ? -v : v; }
+    static Square square(Value v) { return (uint32_t)(v * v); }
+    static Square squareSum(Value x, Value y, Value z) { return (uint32_t)(x*x) + (uint32_t)(y*y) + (uint32_t)(z*z); }
+    static Value root(Square s) { return (Value)isqrt(s); }
+    static Value mean(Sum sum, size_t count) { return count ? (Value)(sum / (int64_t)count) : 0; }
+    static Square meanSquare(SquareSum sum, size_t count) { return count ? (Square)(sum / count) : 0; }
+    static Value lowest() { return INT32_MIN; }
+    static Value highest() { return INT32_MAX; }
+    static Square highestSquare() { return UINT32_MAX; }
+
+    static Time samplePeriod(uint32_t sampleRate) { return (1000000 + sampleRate / 2) / sampleRate; }
+    static Time sampleTime(size_t index, Time period) { return (Time)index * period; }
+    static Time fromMs(int32_t ms) { return (Time)ms * 1000; }
+    static int32_t toMs(Time t)
+    {
+        const Time n = t + 500;
+        return (int32_t)(n >= 0 ? n / 1000 : -((999 - n) / 1000));
+    }
+    static Time interpolate(Time t0, Time t1, Value num, Value den)
+    {
+        if (den < 0) {
+            num = -num;
+            den = -den;
+        }
+        if (num <= 0)
+            return t0;
+        if (num >= den)
+            return t1;
+        return t0 + (t1 - t0) * num / den;
+    }
+};
+
+#if FIXED_POINT_DETECTION
+typedef FixedMath DetectionMath;
+#else
+typedef FloatMath DetectionMath;
+#endif
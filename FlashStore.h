@@ -0,0 +1,66 @@
+#pragma once
+// The flash under the logbook (Logbook.h), in the terms of NOR flash: pages
+// of LOG_PAGE_SIZE bytes are programmed whole, programming can only clear
+// bits, and only a sector of several pages can be erased (back to 0xFF).
+// MemoryFlash keeps the pages in RAM with the same rules; host/fileFlash.h
+// keeps them in a file so a logbook survives the process.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+const size_t LOG_PAGE_SIZE = 256; // program unit of common SPI NOR parts
+
+class FlashStore
+{
+public:
+    virtual ~FlashStore() {}
+
+    virtual size_t pageCount() const = 0;
+    // pages erased together, pageCount() is a multiple of it
+    virtual size_t sectorPages() const = 0;
+
+    virtual bool read(size_t page, size_t offset, uint8_t out[], size_t len) = 0;
+    // data is LOG_PAGE_SIZE bytes, the page was erased before
+    virtual bool program(size_t page, const uint8_t data[]) = 0;
+    virtual bool erase(size_t sector) = 0;
+};
+
+template <size_t PAGES, size_t SECTOR_PAGES>
+class MemoryFlash : public FlashStore
+{
+public:
+    static_assert(PAGES % SECTOR_PAGES == 0, "the pages have to fill whole sectors");
+
+    MemoryFlash() { memset(mData, 0xFF, sizeof(mData)); }
+
+    virtual size_t pageCount() const { return PAGES; }
+    virtual size_t sectorPages() const { return SECTOR_PAGES; }
+
+    virtual bool read(size_t page, size_t offset, uint8_t out[], size_t len)
+    {
+        if (page >= PAGES || offset + len > LOG_PAGE_SIZE)
+            return false;
+        memcpy(out, mData[page] + offset, len);
+        return true;
+    }
+
+    virtual bool program(size_t page, const uint8_t data[])
+    {
+        if (page >= PAGES)
+            return false;
+        for (size_t i = 0; i < LOG_PAGE_SIZE; i++)
+            mData[page][i] &= data[i];
+        return true;
+    }
+
+    virtual bool erase(size_t sector)
+    {
+        if (sector >= PAGES / SECTOR_PAGES)
+            return false;
+        memset(mData[sector * SECTOR_PAGES], 0xFF, SECTOR_PAGES * LOG_PAGE_SIZE);
+        return true;
+    }
+
+private:
+    uint8_t mData[PAGES][LOG_PAGE_SIZE];
+};
@@ -0,0 +1,64 @@
+#include "FootworkClassifier.h"
+#include "FixedPoint.h"
+#include "FootworkModel.h"
+
+void quantizeLanding(const LandingFeatures &features, const FeatureQuantizer quantizers[], int8_t out[])
+{
+    for (size_t i=0; i<LANDING_FEATURE_COUNT; i++) {
+        float q = (features.values[i] - quantizers[i].offset) * quantizers[i].scale;
+        q += q < 0 ? -0.5f : 0.5f;
+        out[i] = q <= -128 ? -128 : q >= 127 ? 127 : (int8_t) q;
+    }
+}
+
+void quantizeLanding(const int32_t counts[], const FixedQuantizer quantizers[], int8_t out[])
+{
+    for (size_t i=0; i<LANDING_FEATURE_COUNT; i++) {
+        int64_t q = (int64_t) (counts[i] - quantizers[i].offset) * quantizers[i].scale;
+        q = (q + (q < 0 ? -32768 : 32768)) / 65536;
+        out[i] = q <= -128 ? -128 : q >= 127 ? 127 : (int8_t) q;
+    }
+}
+
+int32_t ensembleScore(const QuantizedEnsemble &model, const int8_t features[])
+{
+    int32_t score = model.bias;
+    for (size_t t=0; t<model.treeCount; t++) {
+        const QuantizedTree &tree = model.trees[t];
+        size_t node = 0;
+        for (size_t level=0; level<TREE_DEPTH; level++)
+            node = 2 * node + (features[tree.feature[node]] <= tree.threshold[node] ? 1 : 2);
+        score += tree.leaf[node - TREE_NODES];
+    }
+    return score;
+}
+
+const QuantizedEnsemble &footworkModel()
+{
+    static const QuantizedEnsemble model = {
+        FOOTWORK_QUANTIZERS,
+        FOOTWORK_TREES,
+        sizeof(FOOTWORK_TREES) / sizeof(FOOTWORK_TREES[0]),
+        FOOTWORK_BIAS,
+    };
+    return model;
+}
+
+const FixedQuantizer *footworkFixedQuantizers()
+{
+    // Q15 counts per unit of each feature, the airtime stays in ms
+    static const float COUNTS[LANDING_FEATURE_COUNT] = {GYRO_COUNTS, GYRO_COUNTS, GYRO_COUNTS, 1, ACC_COUNTS};
+    static FixedQuantizer quantizers[LANDING_FEATURE_COUNT];
+    static bool derived = false;
+    if (!derived) {
+        for (size_t i=0; i<LANDING_FEATURE_COUNT; i++) {
+            const FeatureQuantizer &q = FOOTWORK_QUANTIZERS[i];
+            float offset = q.offset * COUNTS[i];
+            float scale = q.scale / COUNTS[i] * 65536;
+            quantizers[i].offset = (int32_t) (offset + (offset < 0 ? -0.5f : 0.5f));
+            quantizers[i].scale = (int32_t) (scale + 0.5f);
+        }
+        derived = true;
+    }
+    return quantizers;
+}
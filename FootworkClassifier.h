@@ -0,0 +1,83 @@
+#pragma once
+// Split step vs other footwork, decided from the zero-g window of a landing
+// by a small ensemble of quantized decision trees instead of one gyro
+// threshold. The features are quantized to int8 once per landing; every tree
+// is a complete binary tree of TREE_DEPTH levels stored as arrays, so the
+// inference is TREE_COUNT * TREE_DEPTH byte compares and int8 adds, with
+// the tables in flash and nothing on the heap.
+//
+// The tables of the shipped model are generated by host/trainClassifier into
+// FootworkModel.h.
+#include <stddef.h>
+#include <stdint.h>
+
+// what the detector knows about a landing when it has to classify it
+enum LandingFeature
+{
+    MAX_Z_GYRO_FEATURE = 0, // largest |gyro z| (dps) of the zero-g window
+    MEAN_Z_GYRO_FEATURE = 1, // mean |gyro z| (dps) of the zero-g window
+    MAX_TILT_GYRO_FEATURE = 2, // largest |gyro x| or |gyro y| (dps) of the zero-g window
+    AIRTIME_FEATURE = 3, // ms from zero-g begin to landing
+    LANDING_ACC_FEATURE = 4, // |acc| (m/s^2) of the sample that ended the zero-g window
+    LANDING_FEATURE_COUNT = 5,
+};
+
+struct LandingFeatures
+{
+    float values[LANDING_FEATURE_COUNT];
+};
+
+const size_t TREE_DEPTH = 3;
+const size_t TREE_NODES = (1 << TREE_DEPTH) - 1;
+const size_t TREE_LEAVES = 1 << TREE_DEPTH;
+
+// q = round((value - offset) * scale), saturated to int8
+struct FeatureQuantizer
+{
+    float offset;
+    float scale;
+};
+
+// Node i tests feature[i] <= threshold[i] and goes on to node 2i+1 if it
+// holds, 2i+2 if not; the nodes below the last level are the leaves.
+struct QuantizedTree
+{
+    uint8_t feature[TREE_NODES];
+    int8_t threshold[TREE_NODES];
+    int8_t leaf[TREE_LEAVES];
+};
+
+struct QuantizedEnsemble
+{
+    const FeatureQuantizer *quantizers; // LANDING_FEATURE_COUNT of them
+    const QuantizedTree *trees;
+    size_t treeCount;
+    int16_t bias;
+};
+
+void quantizeLanding(const LandingFeatures &features, const FeatureQuantizer quantizers[], int8_t out[]);
+
+// The same for features in Q15 counts (FixedPoint.h), the airtime in ms:
+// q = round((counts - offset) * scale / 2^16), saturated to int8.
+struct FixedQuantizer
+{
+    int32_t offset; // counts
+    int32_t scale; // Q16
+};
+
+void quantizeLanding(const int32_t counts[], const FixedQuantizer quantizers[], int8_t out[]);
+
+// bias plus the leaf of every tree, >= 0 for a split step
+int32_t ensembleScore(const QuantizedEnsemble &model, const int8_t features[]);
+
+inline bool isSplitStep(const QuantizedEnsemble &model, const LandingFeatures &features)
+{
+    int8_t q[LANDING_FEATURE_COUNT];
+    quantizeLanding(features, model.quantizers, q);
+    return ensembleScore(model, q) >= 0;
+}
+
+// the model generated into FootworkModel.h
+const QuantizedEnsemble &footworkModel();
+// its quantizers for the features in counts, derived on the first call
+const FixedQuantizer *footworkFixedQuantizers();
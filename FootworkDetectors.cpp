@@ -0,0 +1,112 @@
+#include "FootworkDetectors.h"
+#include "ImuFeatures.h"
+
+template <typename Math>
+static void fillEvent(SplitStepEvent &e, SplitStepEventKind kind, uint32_t beginTime, uint32_t endTime,
+                      typename Math::Value maxZGyro, typename Math::Square maxAccSq)
+{
+    e.kind = kind;
+    e.beginTime = beginTime;
+    e.endTime = endTime;
+    e.maxZGyro = Math::gyroUnits(maxZGyro);
+    e.accMagnitude = Math::accUnits(Math::root(maxAccSq));
+}
+
+template <typename Math>
+void BasicLateralShuffleDetector<Math>::reset()
+{
+    mState.side = 0;
+    mState.pushes = 0;
+    mState.beginTime = 0;
+    mState.pushTime = 0;
+    mState.zGyro.reset();
+}
+
+template <typename Math>
+size_t BasicLateralShuffleDetector<Math>::process(const ImuBatch &batch, const BasicBatchFeatures<Math> &f,
+                                                  SplitStepEvent events[], size_t maxEvents)
+{
+    State &s = mState;
+    if (s.pushes > 0 && batch.timestamp - s.pushTime > SHUFFLE_GAP)
+        reset();
+
+    // a push goes one way only, a batch with both is just shaking
+    bool right = f.maxXAcc >= Math::acc(SHUFFLE_ACC);
+    bool left = f.minXAcc <= Math::acc(-SHUFFLE_ACC);
+    if (right == left)
+        return 0;
+
+    int8_t side = right ? 1 : -1;
+    s.zGyro.add(f.maxAbsZGyro);
+    s.pushTime = batch.timestamp;
+    // a push usually spans two batches, only a change of side counts
+    if (side == s.side)
+        return 0;
+    if (s.pushes == 0)
+        s.beginTime = batch.timestamp;
+    s.side = side;
+    s.pushes++;
+    // report once per shuffle, when it has enough pushes
+    if (s.pushes != SHUFFLE_STEPS || maxEvents == 0)
+        return 0;
+    fillEvent<Math>(events[0], LATERAL_SHUFFLE, s.beginTime, batch.timestamp, s.zGyro.max(), f.maxAccSq);
+    return 1;
+}
+
+template <typename Math>
+void BasicCrossoverDetector<Math>::reset()
+{
+    mState.detected = false;
+    mState.lastTime = 0;
+}
+
+template <typename Math>
+size_t BasicCrossoverDetector<Math>::process(const ImuBatch &batch, const BasicBatchFeatures<Math> &f,
+                                             SplitStepEvent events[], size_t maxEvents)
+{
+    // turning in the air is a hop, the split step detector reports those
+    if (f.minAccSq < Math::square(Math::acc(BEGIN_THRESHOLD)) || f.maxAbsZGyro < Math::gyro(CROSSOVER_GYRO))
+        return 0;
+    typename Math::Value lateral = f.maxXAcc > -f.minXAcc ? f.maxXAcc : -f.minXAcc;
+    if (Math::square(lateral) < Math::square(Math::acc(CROSSOVER_ACC)))
+        return 0;
+    if (mState.detected && batch.timestamp - mState.lastTime < CROSSOVER_REFRACTORY)
+        return 0;
+    mState.detected = true;
+    mState.lastTime = batch.timestamp;
+    if (maxEvents == 0)
+        return 0;
+    fillEvent<Math>(events[0], CROSSOVER, batch.timestamp, batch.timestamp, f.maxAbsZGyro, f.maxAccSq);
+    return 1;
+}
+
+template <typename Math>
+void BasicLungeDetector<Math>::reset()
+{
+    mState.detected = false;
+    mState.lastTime = 0;
+}
+
+template <typename Math>
+size_t BasicLungeDetector<Math>::process(const ImuBatch &batch, const BasicBatchFeatures<Math> &f,
+                                         SplitStepEvent events[], size_t maxEvents)
+{
+    // a landing is mostly vertical, a lunge plant brakes along y
+    if (f.maxAccSq < Math::square(Math::acc(LUNGE_IMPACT)) || f.maxAbsYAcc < Math::acc(LUNGE_ACC))
+        return 0;
+    if (mState.detected && batch.timestamp - mState.lastTime < LUNGE_REFRACTORY)
+        return 0;
+    mState.detected = true;
+    mState.lastTime = batch.timestamp;
+    if (maxEvents == 0)
+        return 0;
+    fillEvent<Math>(events[0], LUNGE, batch.timestamp, batch.timestamp, f.maxAbsZGyro, f.maxAccSq);
+    return 1;
+}
+
+template class BasicLateralShuffleDetector<FloatMath>;
+template class BasicLateralShuffleDetector<FixedMath>;
+template class BasicCrossoverDetector<FloatMath>;
+template class BasicCrossoverDetector<FixedMath>;
+template class BasicLungeDetector<FloatMath>;
+template class BasicLungeDetector<FixedMath>;
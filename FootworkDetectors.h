@@ -0,0 +1,97 @@
+#pragma once
+// Footwork detectors that run next to SplitStepDetector in a DetectorPipeline.
+// They only look at the batch features, so each one costs a few compares per
+// batch. Their state is a small struct; events use the SplitStepEvent layout
+// with beginTime/endTime spanning the movement.
+#include <stddef.h>
+#include <stdint.h>
+#include "SplitStepDetector.h"
+
+const float SHUFFLE_ACC = 6; // lateral acc (m/s^2) of a push off
+const uint8_t SHUFFLE_STEPS = 3; // alternating pushes that make a shuffle
+const uint32_t SHUFFLE_GAP = 600; // the maximum time (ms) between two pushes of a shuffle
+
+const float CROSSOVER_GYRO = 150; // z rotation (dps) of a crossover step
+const float CROSSOVER_ACC = 5; // lateral acc (m/s^2) of a crossover step
+const uint32_t CROSSOVER_REFRACTORY = 500; // the minimum time (ms) between two crossovers
+
+const float LUNGE_ACC = 15; // forward or backward acc (m/s^2) of a lunge plant
+const float LUNGE_IMPACT = 20; // acc magnitude (m/s^2) of a lunge plant
+const uint32_t LUNGE_REFRACTORY = 800; // the minimum time (ms) between two lunges
+
+// Every detector of the pipeline has the interface of SplitStepDetector:
+// MAX_EVENTS_PER_BATCH, reset(), setSampleRate() and process() with the
+// batch features, and the same Math parameter (FixedPoint.h).
+
+template <typename Math>
+class BasicLateralShuffleDetector
+{
+public:
+    static const size_t MAX_EVENTS_PER_BATCH = 1;
+
+    BasicLateralShuffleDetector() { reset(); }
+
+    void reset();
+    void setSampleRate(uint32_t) {}
+    size_t process(const ImuBatch &batch, const BasicBatchFeatures<Math> &features, SplitStepEvent events[],
+                   size_t maxEvents);
+
+private:
+    struct State
+    {
+        int8_t side; // direction of the last push, -1 left, 1 right, 0 none
+        uint8_t pushes; // alternating pushes so far
+        uint32_t beginTime; // timestamp of the first push
+        uint32_t pushTime; // timestamp of the last push
+        typename Math::Stats zGyro; // |gyro z| of the batches with a push
+    };
+    State mState;
+};
+
+template <typename Math>
+class BasicCrossoverDetector
+{
+public:
+    static const size_t MAX_EVENTS_PER_BATCH = 1;
+
+    BasicCrossoverDetector() { reset(); }
+
+    void reset();
+    void setSampleRate(uint32_t) {}
+    size_t process(const ImuBatch &batch, const BasicBatchFeatures<Math> &features, SplitStepEvent events[],
+                   size_t maxEvents);
+
+private:
+    struct State
+    {
+        bool detected; // whether lastTime holds a crossover
+        uint32_t lastTime;
+    };
+    State mState;
+};
+
+template <typename Math>
+class BasicLungeDetector
+{
+public:
+    static const size_t MAX_EVENTS_PER_BATCH = 1;
+
+    BasicLungeDetector() { reset(); }
+
+    void reset();
+    void setSampleRate(uint32_t) {}
+    size_t process(const ImuBatch &batch, const BasicBatchFeatures<Math> &features, SplitStepEvent events[],
+                   size_t maxEvents);
+
+private:
+    struct State
+    {
+        bool detected; // whether lastTime holds a lunge
+        uint32_t lastTime;
+    };
+    State mState;
+};
+
+typedef BasicLateralShuffleDetector<FloatMath> LateralShuffleDetector;
+typedef BasicCrossoverDetector<FloatMath> CrossoverDetector;
+typedef BasicLungeDetector<FloatMath> LungeDetector;
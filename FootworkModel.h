@@ -0,0 +1,25 @@
+#pragma once
+// Generated by host/trainClassifier from 1941 labeled landings, do not edit.
+// Training accuracy 100.0% (gyro threshold rule 65.8%).
+#include "FootworkClassifier.h"
+
+static const FeatureQuantizer FOOTWORK_QUANTIZERS[LANDING_FEATURE_COUNT] = {
+    {155.997f, 0.945503f}, // max z gyro
+    {119.521f, 1.2375f}, // mean z gyro
+    {123.154f, 1.0678f}, // max tilt gyro
+    {217.5f, 0.866894f}, // airtime
+    {24.5169f, 15.55f}, // landing acc
+};
+
+static const QuantizedTree FOOTWORK_TREES[] = {
+    {{0, 2, 0, 0, 0, 0, 0}, {22, -110, 127, 127, 127, 127, 127}, {42, 0, -125, 0, -127, 0, 0, 0}},
+    {{0, 2, 0, 0, 0, 0, 0}, {22, -110, 127, 127, 127, 127, 127}, {37, 0, -44, 0, -44, 0, 0, 0}},
+    {{0, 2, 0, 0, 0, 0, 0}, {22, -110, 127, 127, 127, 127, 127}, {34, 0, -37, 0, -37, 0, 0, 0}},
+    {{1, 2, 0, 0, 0, 0, 0}, {-98, -113, 22, 127, 127, -75, 127}, {33, 0, 9, 0, -33, 32, -34, 0}},
+    {{1, 2, 0, 0, 0, 0, 0}, {-98, -113, 22, 127, 127, -75, 127}, {32, 0, 6, 0, -31, 30, -32, 0}},
+    {{1, 2, 0, 0, 0, 0, 0}, {-98, -113, 22, 127, 127, -75, 127}, {31, 0, 4, 0, -29, 28, -30, 0}},
+    {{1, 0, 0, 0, 0, 0, 0}, {-103, 127, 22, 127, 127, -75, 127}, {29, 0, 0, 0, -28, 27, -28, 0}},
+    {{1, 0, 0, 0, 0, 2, 0}, {-108, 127, 22, 127, 127, -111, 127}, {28, 0, 0, 0, 26, -26, -26, 0}},
+};
+
+static const int16_t FOOTWORK_BIAS = 71;
@@ -0,0 +1,190 @@
+#include "ImuCodec.h"
+#include <string.h>
+
+int16_t quantizeRaw(float v, float scale)
+{
+    float q = v * scale;
+    q += q < 0 ? -0.5f : 0.5f;
+    if (q > 32767)
+        return 32767;
+    if (q < -32768)
+        return -32768;
+    return (int16_t) q;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static size_t putVarint(uint8_t out[], uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t) v;
+    return n;
+}
+
+static bool getVarint(const uint8_t in[], size_t len, size_t &pos, uint32_t &v)
+{
+    v = 0;
+    for (int shift=0; shift<=28; shift+=7) {
+        if (pos >= len)
+            return false;
+        uint8_t b = in[pos++];
+        v |= (uint32_t) (b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// component c (0..5) of sample i: acc x/y/z then gyro x/y/z
+static int16_t channelValue(const ImuBatch &batch, size_t c, size_t i)
+{
+    const Vec3f &v = c < 3 ? batch.acc[i] : batch.gyro[i];
+    float f = (c % 3) == 0 ? v.x : ((c % 3) == 1 ? v.y : v.z);
+    return quantizeRaw(f, c < 3 ? RAW_ACC_SCALE : RAW_GYRO_SCALE);
+}
+
+size_t encodeImuBatch(const ImuBatch &batch, uint8_t out[], size_t size)
+{
+    size_t count = batch.accCount < batch.gyroCount ? batch.accCount : batch.gyroCount;
+    if (count > RAW_MAX_SAMPLES || size < RAW_MAX_ENCODED)
+        return 0;
+
+    out[0] = (uint8_t) batch.timestamp;
+    out[1] = (uint8_t) (batch.timestamp >> 8);
+    out[2] = (uint8_t) (batch.timestamp >> 16);
+    out[3] = (uint8_t) (batch.timestamp >> 24);
+    out[4] = (uint8_t) count;
+    size_t pos = 5;
+    for (size_t c=0; c<RAW_CHANNELS; c++) {
+        int32_t previous = 0;
+        for (size_t i=0; i<count; i++) {
+            int32_t v = channelValue(batch, c, i);
+            pos += putVarint(&out[pos], zigzag(v - previous));
+            previous = v;
+        }
+    }
+    return pos;
+}
+
+bool decodeImuBatch(const uint8_t in[], size_t len, uint32_t &timestamp, Vec3f acc[], Vec3f gyro[],
+                    size_t maxSamples, size_t &count)
+{
+    count = 0;
+    if (len < 5)
+        return false;
+    timestamp = (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+    size_t samples = in[4];
+    if (samples > maxSamples)
+        return false;
+    size_t pos = 5;
+    for (size_t c=0; c<RAW_CHANNELS; c++) {
+        int32_t value = 0;
+        for (size_t i=0; i<samples; i++) {
+            uint32_t raw;
+            if (!getVarint(in, len, pos, raw))
+                return false;
+            value += unzigzag(raw);
+            Vec3f &v = c < 3 ? acc[i] : gyro[i];
+            float f = value / (c < 3 ? RAW_ACC_SCALE : RAW_GYRO_SCALE);
+            if (c % 3 == 0)
+                v.x = f;
+            else if (c % 3 == 1)
+                v.y = f;
+            else
+                v.z = f;
+        }
+    }
+    count = samples;
+    return pos == len;
+}
+
+size_t RawFragmenter::next(const uint8_t data[], size_t len, size_t &offset, uint8_t out[], size_t outSize)
+{
+    if (offset >= len || outSize <= RAW_FRAGMENT_HEADER)
+        return 0;
+    size_t chunk = len - offset;
+    if (chunk > outSize - RAW_FRAGMENT_HEADER)
+        chunk = outSize - RAW_FRAGMENT_HEADER;
+
+    uint8_t flags = 0;
+    if (offset == 0)
+        flags |= RAW_FIRST;
+    if (offset + chunk == len)
+        flags |= RAW_LAST;
+    out[0] = (uint8_t) mSequence;
+    out[1] = (uint8_t) (mSequence >> 8);
+    out[2] = flags;
+    memcpy(&out[RAW_FRAGMENT_HEADER], &data[offset], chunk);
+    mSequence++;
+    offset += chunk;
+    return RAW_FRAGMENT_HEADER + chunk;
+}
+
+RawReassembler::RawReassembler()
+{
+    reset();
+}
+
+void RawReassembler::reset()
+{
+    mLength = 0;
+    mInMessage = false;
+    mHaveSequence = false;
+    mExpected = 0;
+    mLostFragments = 0;
+    mDroppedMessages = 0;
+}
+
+bool RawReassembler::add(const uint8_t fragment[], size_t len)
+{
+    if (len < RAW_FRAGMENT_HEADER)
+        return false;
+    uint16_t sequence = (uint16_t) (fragment[0] | (fragment[1] << 8));
+    uint8_t flags = fragment[2];
+
+    if (mHaveSequence && sequence != mExpected) {
+        mLostFragments += (uint16_t) (sequence - mExpected);
+        if (mInMessage)
+            mDroppedMessages++;
+        mInMessage = false;
+    }
+    mHaveSequence = true;
+    mExpected = (uint16_t) (sequence + 1);
+
+    if (flags & RAW_FIRST) {
+        if (mInMessage)
+            mDroppedMessages++;
+        mInMessage = true;
+        mLength = 0;
+    } else if (!mInMessage) {
+        // rest of a message whose start was lost
+        return false;
+    }
+
+    size_t chunk = len - RAW_FRAGMENT_HEADER;
+    if (mLength + chunk > sizeof(mBuffer)) {
+        mDroppedMessages++;
+        mInMessage = false;
+        return false;
+    }
+    memcpy(&mBuffer[mLength], &fragment[RAW_FRAGMENT_HEADER], chunk);
+    mLength += chunk;
+
+    if (flags & RAW_LAST) {
+        mInMessage = false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+// Compact encoding of raw IMU6 batches for streaming, and the fragmentation
+// of encoded batches over GATT notifications.
+//
+// A batch is quantized (acc to 0.01 m/s^2, gyro to 0.1 dps) and written
+// channel by channel: the first sample of a channel as a zig-zag varint,
+// every following sample as the zig-zag varint of its delta. Batches don't
+// depend on each other, so a lost batch doesn't corrupt the next one.
+//   [timestamp (4, little endian), count (1), channels...]
+//
+// Every fragment starts with
+//   [sequence (2, little endian), flags (1)]
+// The sequence increments with every fragment so the receiver can tell
+// gaps; RAW_FIRST/RAW_LAST mark the fragments that start/end a message.
+#include <stddef.h>
+#include <stdint.h>
+#include "SplitStepDetector.h"
+
+const float RAW_ACC_SCALE = 100; // counts per m/s^2
+const float RAW_GYRO_SCALE = 10; // counts per dps
+const size_t RAW_MAX_SAMPLES = 32; // samples per batch the encoder accepts
+const size_t RAW_CHANNELS = 6;
+// header plus a worst case 3 byte varint for every value
+const size_t RAW_MAX_ENCODED = 5 + RAW_CHANNELS * RAW_MAX_SAMPLES * 3;
+
+const size_t RAW_FRAGMENT_HEADER = 3;
+const uint8_t RAW_FIRST = 1;
+const uint8_t RAW_LAST = 2;
+// largest message the reassembler takes (an SBEM serialized batch fits too)
+const size_t RAW_MAX_MESSAGE = 1024;
+
+// value * scale rounded and saturated to int16
+int16_t quantizeRaw(float value, float scale);
+
+// Returns the encoded length, 0 if the batch has more than RAW_MAX_SAMPLES
+// samples or doesn't fit size.
+size_t encodeImuBatch(const ImuBatch &batch, uint8_t out[], size_t size);
+
+// Decodes one batch. count is the number of samples written to acc/gyro.
+bool decodeImuBatch(const uint8_t in[], size_t len, uint32_t &timestamp, Vec3f acc[], Vec3f gyro[],
+                    size_t maxSamples, size_t &count);
+
+// Cuts messages into fragments of at most a given size.
+class RawFragmenter
+{
+public:
+    RawFragmenter() : mSequence(0) {}
+
+    void reset() { mSequence = 0; }
+
+    // Writes the fragment of data starting at offset and advances offset.
+    // Returns the fragment length, 0 when the message is done.
+    size_t next(const uint8_t data[], size_t len, size_t &offset, uint8_t out[], size_t outSize);
+
+private:
+    uint16_t mSequence;
+};
+
+// Joins fragments back into messages, dropping messages with a gap.
+class RawReassembler
+{
+public:
+    RawReassembler();
+
+    void reset();
+
+    // Returns true when the fragment completed a message, see data()/length().
+    bool add(const uint8_t fragment[], size_t len);
+
+    const uint8_t *data() const { return mBuffer; }
+    size_t length() const { return mLength; }
+
+    uint32_t lostFragments() const { return mLostFragments; }
+    uint32_t droppedMessages() const { return mDroppedMessages; }
+
+private:
+    uint8_t mBuffer[RAW_MAX_MESSAGE];
+    size_t mLength;
+    bool mInMessage;
+    bool mHaveSequence;
+    uint16_t mExpected;
+    uint32_t mLostFragments;
+    uint32_t mDroppedMessages;
+};
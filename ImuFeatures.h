@@ -0,0 +1,174 @@
+#pragma once
+// Per-batch feature kernel. One pass over the acc/gyro samples of an IMU6
+// notification produces every statistic the detectors need, without sqrt:
+// acc magnitudes stay squared and are compared with squared thresholds. The
+// kernel runs in float or Q15 (FixedPoint.h), see computeBatchFeatures().
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include "FixedPoint.h"
+#include "SplitStepDetector.h"
+
+// squared versions of the acc thresholds, compared against mean |acc|^2
+constexpr float BEGIN_THRESHOLD_SQ = float(BEGIN_THRESHOLD) * float(BEGIN_THRESHOLD);
+constexpr float END_THRESHOLD_SQ = float(END_THRESHOLD) * float(END_THRESHOLD);
+
+template <typename Math>
+struct BasicBatchFeatures
+{
+    typedef typename Math::Value Value;
+    typedef typename Math::Square Square;
+
+    Square meanAccSq; // mean of |acc|^2
+    Value meanZAcc; // mean z-axis acc
+    Value meanAbsZGyro; // mean of |gyro z|
+    Square minAccSq; // smallest |acc|^2 in the batch
+    Square maxAccSq; // largest |acc|^2 in the batch
+    Value maxAbsZGyro; // largest |gyro z| in the batch
+    Value minXAcc; // lateral acc extremes, the x axis of the sensor
+    Value maxXAcc;
+    Value maxAbsYAcc; // largest |forward acc| in the batch
+};
+
+typedef BasicBatchFeatures<FloatMath> BatchFeatures;
+typedef BasicBatchFeatures<FixedMath> FixedBatchFeatures;
+
+// fabsf clears the sign bit without a branch, a compare on the sign of
+// noisy samples mispredicts about every other time
+inline float absf(float v)
+{
+    return fabsf(v);
+}
+
+// Kernel for the interleaved x/y/z layout the sensor delivers. Samples are
+// read through references, never copied; with FixedMath each one is
+// converted to Q15 as it is read.
+template <typename Math>
+inline void computeBatchFeatures(const Vec3f *acc, size_t accCount, const Vec3f *gyro, size_t gyroCount,
+                                 BasicBatchFeatures<Math> &out)
+{
+    typedef typename Math::Value Value;
+    typedef typename Math::Square Square;
+    typename Math::SquareSum sumAccSq = 0;
+    typename Math::Sum sumZAcc = 0, sumAbsZGyro = 0;
+    Square minAccSq = Math::highestSquare(), maxAccSq = 0;
+    Value maxAbsZGyro = 0;
+    Value minXAcc = Math::highest(), maxXAcc = Math::lowest(), maxAbsYAcc = 0;
+
+    // IMU6 delivers the same number of acc and gyro samples, walk them together
+    size_t common = accCount < gyroCount ? accCount : gyroCount;
+    for (size_t i=0; i<common; i++) {
+        const Vec3f &a = acc[i];
+        Value x = Math::acc(a.x), y = Math::abs(Math::acc(a.y)), z = Math::acc(a.z);
+        Square accSq = Math::squareSum(x, y, z);
+        Value gz = Math::abs(Math::gyro(gyro[i].z));
+        sumAccSq += accSq;
+        sumZAcc += z;
+        sumAbsZGyro += gz;
+        minAccSq = accSq < minAccSq ? accSq : minAccSq;
+        maxAccSq = accSq > maxAccSq ? accSq : maxAccSq;
+        minXAcc = x < minXAcc ? x : minXAcc;
+        maxXAcc = x > maxXAcc ? x : maxXAcc;
+        maxAbsYAcc = y > maxAbsYAcc ? y : maxAbsYAcc;
+        maxAbsZGyro = gz > maxAbsZGyro ? gz : maxAbsZGyro;
+    }
+    for (size_t i=common; i<accCount; i++) {
+        const Vec3f &a = acc[i];
+        Value x = Math::acc(a.x), y = Math::abs(Math::acc(a.y)), z = Math::acc(a.z);
+        Square accSq = Math::squareSum(x, y, z);
+        sumAccSq += accSq;
+        sumZAcc += z;
+        minAccSq = accSq < minAccSq ? accSq : minAccSq;
+        maxAccSq = accSq > maxAccSq ? accSq : maxAccSq;
+        minXAcc = x < minXAcc ? x : minXAcc;
+        maxXAcc = x > maxXAcc ? x : maxXAcc;
+        maxAbsYAcc = y > maxAbsYAcc ? y : maxAbsYAcc;
+    }
+    for (size_t i=common; i<gyroCount; i++) {
+        Value gz = Math::abs(Math::gyro(gyro[i].z));
+        sumAbsZGyro += gz;
+        maxAbsZGyro = gz > maxAbsZGyro ? gz : maxAbsZGyro;
+    }
+
+    out.meanAccSq = Math::meanSquare(sumAccSq, accCount);
+    out.meanZAcc = Math::mean(sumZAcc, accCount);
+    out.meanAbsZGyro = Math::mean(sumAbsZGyro, gyroCount);
+    out.minAccSq = minAccSq;
+    out.maxAccSq = maxAccSq;
+    out.maxAbsZGyro = maxAbsZGyro;
+    out.minXAcc = accCount ? minXAcc : 0;
+    out.maxXAcc = accCount ? maxXAcc : 0;
+    out.maxAbsYAcc = maxAbsYAcc;
+}
+
+// Kernel for channel-per-array (SoA) data, e.g. host traces or buffered
+// samples, in float. Four independent accumulator lanes keep the loop free of
+// cross-iteration dependencies, so the lanes pipeline on the nRF52 FPU and
+// the sums vectorize on targets with float SIMD. The extremes compile to
+// branch-free scalar min/max; compilers only turn them into SIMD min/max
+// with -ffinite-math-only, which the sensor build doesn't use.
+inline void computeBatchFeaturesSoA(const float *accX, const float *accY, const float *accZ, const float *gyroZ,
+                                    size_t count, BatchFeatures &out)
+{
+    const size_t LANES = 4;
+    float sumAccSq[LANES] = {0}, sumZAcc[LANES] = {0}, sumAbsZGyro[LANES] = {0};
+    float minAccSq[LANES] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+    float maxAccSq[LANES] = {0}, maxAbsZGyro[LANES] = {0};
+    float minXAcc[LANES] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+    float maxXAcc[LANES] = {-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+    float maxAbsYAcc[LANES] = {0};
+
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        for (size_t l=0; l<LANES; l++) {
+            float x = accX[i+l], y = accY[i+l], z = accZ[i+l];
+            float accSq = x*x + y*y + z*z;
+            float gz = absf(gyroZ[i+l]);
+            sumAccSq[l] += accSq;
+            sumZAcc[l] += z;
+            sumAbsZGyro[l] += gz;
+            minAccSq[l] = accSq < minAccSq[l] ? accSq : minAccSq[l];
+            maxAccSq[l] = accSq > maxAccSq[l] ? accSq : maxAccSq[l];
+            maxAbsZGyro[l] = gz > maxAbsZGyro[l] ? gz : maxAbsZGyro[l];
+            minXAcc[l] = x < minXAcc[l] ? x : minXAcc[l];
+            maxXAcc[l] = x > maxXAcc[l] ? x : maxXAcc[l];
+            maxAbsYAcc[l] = absf(y) > maxAbsYAcc[l] ? absf(y) : maxAbsYAcc[l];
+        }
+    }
+    // at most three samples left, fold them into lane 0 one by one
+    for (; i<count; i++) {
+        float x = accX[i], y = accY[i], z = accZ[i];
+        float accSq = x*x + y*y + z*z;
+        float gz = absf(gyroZ[i]);
+        sumAccSq[0] += accSq;
+        sumZAcc[0] += z;
+        sumAbsZGyro[0] += gz;
+        minAccSq[0] = accSq < minAccSq[0] ? accSq : minAccSq[0];
+        maxAccSq[0] = accSq > maxAccSq[0] ? accSq : maxAccSq[0];
+        maxAbsZGyro[0] = gz > maxAbsZGyro[0] ? gz : maxAbsZGyro[0];
+        minXAcc[0] = x < minXAcc[0] ? x : minXAcc[0];
+        maxXAcc[0] = x > maxXAcc[0] ? x : maxXAcc[0];
+        maxAbsYAcc[0] = absf(y) > maxAbsYAcc[0] ? absf(y) : maxAbsYAcc[0];
+    }
+
+    float scale = count ? 1.0f / count : 0;
+    out.meanAccSq = (sumAccSq[0] + sumAccSq[1] + sumAccSq[2] + sumAccSq[3]) * scale;
+    out.meanZAcc = (sumZAcc[0] + sumZAcc[1] + sumZAcc[2] + sumZAcc[3]) * scale;
+    out.meanAbsZGyro = (sumAbsZGyro[0] + sumAbsZGyro[1] + sumAbsZGyro[2] + sumAbsZGyro[3]) * scale;
+    out.minAccSq = minAccSq[0];
+    out.maxAccSq = maxAccSq[0];
+    out.maxAbsZGyro = maxAbsZGyro[0];
+    out.minXAcc = minXAcc[0];
+    out.maxXAcc = maxXAcc[0];
+    out.maxAbsYAcc = maxAbsYAcc[0];
+    for (size_t l=1; l<LANES; l++) {
+        out.minAccSq = minAccSq[l] < out.minAccSq ? minAccSq[l] : out.minAccSq;
+        out.maxAccSq = maxAccSq[l] > out.maxAccSq ? maxAccSq[l] : out.maxAccSq;
+        out.maxAbsZGyro = maxAbsZGyro[l] > out.maxAbsZGyro ? maxAbsZGyro[l] : out.maxAbsZGyro;
+        out.minXAcc = minXAcc[l] < out.minXAcc ? minXAcc[l] : out.minXAcc;
+        out.maxXAcc = maxXAcc[l] > out.maxXAcc ? maxXAcc[l] : out.maxXAcc;
+        out.maxAbsYAcc = maxAbsYAcc[l] > out.maxAbsYAcc ? maxAbsYAcc[l] : out.maxAbsYAcc;
+    }
+    if (count == 0)
+        out.minXAcc = out.maxXAcc = 0;
+}
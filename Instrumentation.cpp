@@ -0,0 +1,108 @@
+#include "Instrumentation.h"
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+static void put32(uint8_t out[], uint32_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+    out[2] = (uint8_t) (v >> 16);
+    out[3] = (uint8_t) (v >> 24);
+}
+
+void perfClockInit()
+{
+#if defined(__arm__)
+    *(volatile uint32_t *) 0xE000EDFC |= 1u << 24; // DEMCR.TRCENA, powers the DWT
+    *(volatile uint32_t *) 0xE0001004 = 0; // DWT_CYCCNT
+    *(volatile uint32_t *) 0xE0001000 |= 1u; // DWT_CTRL.CYCCNTENA
+#endif
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i=0; i<PERF_BUCKETS; i++)
+        mBuckets[i] = 0;
+    mCount = 0;
+    mMax = 0;
+    mTotal = 0;
+}
+
+uint32_t LatencyHistogram::quantile(float q) const
+{
+    uint32_t rank = (uint32_t) (q * mCount);
+    uint32_t seen = 0;
+    for (size_t i=0; i<PERF_BUCKETS; i++) {
+        seen += mBuckets[i];
+        if (seen > rank)
+            return i >= 32 ? 0xFFFFFFFF : (1u << i) - 1;
+    }
+    return mMax;
+}
+
+size_t encodePerfCounters(const uint32_t counters[], size_t count, uint8_t out[], size_t size)
+{
+    size_t len = 7 + 4 * count;
+    if (size < len || count > 255)
+        return 0;
+    out[0] = PERF_COUNTERS_RECORD;
+    out[1] = PERF_VERSION;
+    put32(&out[2], PERF_TICK_HZ);
+    out[6] = (uint8_t) count;
+    for (size_t i=0; i<count; i++)
+        put32(&out[7 + 4 * i], counters[i]);
+    return len;
+}
+
+size_t encodePerfHistogram(uint8_t path, const LatencyHistogram &histogram, uint8_t out[], size_t size)
+{
+    if (size < PERF_HISTOGRAM_HEADER)
+        return 0;
+    // only the span of non-empty buckets is sent, cut to what fits
+    size_t first = 0;
+    while (first < PERF_BUCKETS && histogram.bucket(first) == 0)
+        first++;
+    size_t last = PERF_BUCKETS;
+    while (last > first && histogram.bucket(last - 1) == 0)
+        last--;
+    size_t n = last - first;
+    if (n > (size - PERF_HISTOGRAM_HEADER) / 2)
+        n = (size - PERF_HISTOGRAM_HEADER) / 2;
+    if (n == 0)
+        first = 0;
+
+    out[0] = PERF_HISTOGRAM_RECORD;
+    out[1] = path;
+    put32(&out[2], histogram.count());
+    put32(&out[6], histogram.max());
+    put32(&out[10], histogram.mean());
+    out[14] = (uint8_t) first;
+    out[15] = (uint8_t) n;
+    for (size_t i=0; i<n; i++) {
+        uint32_t v = histogram.bucket(first + i);
+        put16(&out[PERF_HISTOGRAM_HEADER + 2 * i], v > 0xFFFF ? 0xFFFF : (uint16_t) v);
+    }
+    return PERF_HISTOGRAM_HEADER + 2 * n;
+}
+
+#if PERF_STATS
+
+void PerfStats::reset()
+{
+    for (size_t i=0; i<PERF_PATH_COUNT; i++)
+        paths[i].reset();
+    for (size_t i=0; i<PERF_COUNTER_COUNT; i++)
+        counters[i] = 0;
+}
+
+PerfStats &perfStats()
+{
+    static PerfStats stats;
+    return stats;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#pragma once
+// Low-overhead instrumentation of the hot paths: a log2 latency histogram per
+// code path and a few event counters. Times are read from the DWT cycle
+// counter on the sensor and from std::chrono on the host.
+//
+// The code is instrumented with the PERF_ macros. Building with PERF_STATS=0
+// turns them into nothing and drops the storage, so the instrumented code
+// compiles to what it was without them.
+//
+// STATS replies with one counters record and a histogram record per path:
+//   [PERF_COUNTERS_RECORD, version, tick rate Hz (4), count, counter (4) * count]
+//   [PERF_HISTOGRAM_RECORD, path, count (4), max ticks (4), mean ticks (4),
+//    first bucket, bucket count n, bucket (2, saturated) * n]
+// little endian. Bucket i holds the durations of [2^(i-1), 2^i) ticks, bucket
+// 0 the ones below a tick; the record carries the span of non-empty buckets.
+#include <stddef.h>
+#include <stdint.h>
+#if !defined(__arm__)
+#include <chrono>
+#endif
+
+#ifndef PERF_STATS
+#define PERF_STATS 1
+#endif
+
+const uint8_t PERF_VERSION = 1;
+const uint8_t PERF_COUNTERS_RECORD = 0;
+const uint8_t PERF_HISTOGRAM_RECORD = 1;
+const size_t PERF_BUCKETS = 33; // below a tick, then one per bit of the duration
+const size_t PERF_HISTOGRAM_HEADER = 16;
+
+#if defined(__arm__)
+#ifndef PERF_CPU_HZ
+#define PERF_CPU_HZ 64000000 // nRF52 core clock
+#endif
+const uint32_t PERF_TICK_HZ = PERF_CPU_HZ;
+#else
+const uint32_t PERF_TICK_HZ = 1000000000; // ns
+#endif
+
+// timed code paths
+enum PerfPath
+{
+    PERF_PROCESS_DATA = 0, // one IMU notification, all its sessions
+    PERF_HANDLE_COMMAND = 1, // one command from the client
+    PERF_SEND = 2, // queueing one message, sendPacket and the binary responses alike
+    PERF_FEEDBACK = 3, // landing sample to the LED switched on: the wait for the batch, then processData
+    PERF_PATH_COUNT = 4,
+};
+
+enum PerfCounter
+{
+    PERF_BATCHES = 0, // IMU notifications processed
+    PERF_SAMPLES = 1, // acc samples in them
+    PERF_EVENTS = 2, // detections reported (zero-g begins not counted)
+    PERF_TX_DROPS = 3, // messages the transmitter did not take
+    PERF_TX_HIGH_WATER = 4, // most messages queued at once, the pool has TxQueue::POOL_SIZE
+    PERF_SUBSCRIBES = 5, // Whiteboard subscriptions, a fanned out reference doesn't make one
+    PERF_UNSUBSCRIBES = 6,
+    PERF_COUNTER_COUNT = 7,
+};
+
+// free-running, wraps; differences are fine across a wrap
+inline uint32_t perfTicks()
+{
+#if defined(__arm__)
+    return *(volatile uint32_t *) 0xE0001004; // DWT_CYCCNT
+#else
+    return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// starts the cycle counter, the host clock always runs
+void perfClockInit();
+
+// sample times are in ms, saturated so a stale timestamp can't wrap
+inline uint32_t perfMsToTicks(float ms)
+{
+    const float ticks = ms * (PERF_TICK_HZ / 1000);
+    return ticks <= 0 ? 0 : ticks >= 4294967295.0f ? 0xFFFFFFFF : (uint32_t) ticks;
+}
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset();
+    void add(uint32_t ticks)
+    {
+        mBuckets[ticks ? 32 - __builtin_clz(ticks) : 0]++;
+        mCount++;
+        mTotal += ticks;
+        mMax = ticks > mMax ? ticks : mMax;
+    }
+
+    uint32_t count() const { return mCount; }
+    uint32_t max() const { return mMax; }
+    uint32_t mean() const { return mCount ? (uint32_t) (mTotal / mCount) : 0; }
+    uint32_t bucket(size_t i) const { return mBuckets[i]; }
+    // upper bound (ticks) of the bucket holding the q quantile
+    uint32_t quantile(float q) const;
+
+private:
+    uint32_t mBuckets[PERF_BUCKETS];
+    uint32_t mCount;
+    uint32_t mMax;
+    uint64_t mTotal;
+};
+
+// times the enclosing scope into a histogram
+class PerfScope
+{
+public:
+    explicit PerfScope(LatencyHistogram &histogram) : mHistogram(histogram), mStart(perfTicks()) {}
+    ~PerfScope() { mHistogram.add(perfTicks() - mStart); }
+
+    uint32_t elapsed() const { return perfTicks() - mStart; }
+
+private:
+    LatencyHistogram &mHistogram;
+    uint32_t mStart;
+};
+
+// Writes the records of a STATS reply, returns their length or 0 if size is too small.
+size_t encodePerfCounters(const uint32_t counters[], size_t count, uint8_t out[], size_t size);
+size_t encodePerfHistogram(uint8_t path, const LatencyHistogram &histogram, uint8_t out[], size_t size);
+
+#if PERF_STATS
+
+struct PerfStats
+{
+    LatencyHistogram paths[PERF_PATH_COUNT];
+    uint32_t counters[PERF_COUNTER_COUNT];
+
+    PerfStats() { reset(); }
+    void reset();
+    void raise(PerfCounter counter, uint32_t value)
+    {
+        counters[counter] = value > counters[counter] ? value : counters[counter];
+    }
+};
+
+// the statistics of the app, created on first use
+PerfStats &perfStats();
+
+#define PERF_INIT() perfClockInit()
+#define PERF_SCOPE(path) PerfScope perfScope(perfStats().paths[path])
+#define PERF_COUNT(counter, n) (perfStats().counters[counter] += (uint32_t) (n))
+#define PERF_RAISE(counter, value) perfStats().raise(counter, (uint32_t) (value))
+// adds a duration measured otherwise, PERF_ELAPSED is the time in the enclosing PERF_SCOPE so far
+#define PERF_ADD(path, ticks) perfStats().paths[path].add((uint32_t) (ticks))
+#define PERF_ELAPSED() perfScope.elapsed()
+
+#else
+
+#define PERF_INIT() ((void) 0)
+#define PERF_SCOPE(path)
+#define PERF_COUNT(counter, n) ((void) 0)
+#define PERF_RAISE(counter, value) ((void) 0)
+#define PERF_ADD(path, ticks) ((void) 0)
+#define PERF_ELAPSED() 0
+
+#endif
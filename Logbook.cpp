@@ -0,0 +1,216 @@
+#include "Logbook.h"
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+static void put32(uint8_t out[], uint32_t v)
+{
+    for (size_t i = 0; i < 4; i++)
+        out[i] = (uint8_t) (v >> (8 * i));
+}
+
+static uint16_t get16(const uint8_t in[])
+{
+    return (uint16_t) (in[0] | (in[1] << 8));
+}
+
+static uint32_t get32(const uint8_t in[])
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+uint16_t logCrc16(const uint8_t data[], size_t len, uint16_t crc)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t) (data[i] << 8);
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+    }
+    return crc;
+}
+
+Logbook::Logbook(FlashStore &flash):
+    mFlash(flash),
+    mEnd(0),
+    mOldest(0),
+    mErasedUpTo(0),
+    mFirstRecord(LOG_NO_RECORD),
+    mPrograms(0),
+    mErases(0)
+{
+    memset(mPage, 0xFF, sizeof(mPage));
+}
+
+void Logbook::mount()
+{
+    const size_t pages = mFlash.pageCount();
+    uint8_t page[LOG_PAGE_SIZE];
+    bool found = false;
+    uint32_t newest = 0;
+    for (size_t i = 0; i < pages; i++) {
+        if (!mFlash.read(i, 0, page, sizeof(page)))
+            continue;
+        uint32_t sequence = get32(page);
+        if (sequence == 0xFFFFFFFF || sequence % pages != i)
+            continue;
+        uint16_t crc = logCrc16(page + LOG_PAGE_HEADER, LOG_PAGE_PAYLOAD, logCrc16(page, 6));
+        if (crc != get16(page + 6))
+            continue;
+        if (!found || sequence > newest)
+            newest = sequence;
+        found = true;
+    }
+    mPrograms = 0;
+    mErases = 0;
+    mFirstRecord = LOG_NO_RECORD;
+    memset(mPage, 0xFF, sizeof(mPage));
+    if (!found) {
+        // blank or unreadable, start over
+        mEnd = 0;
+        clear();
+        return;
+    }
+
+    // the page in RAM of the earlier run is skipped, the rest of the newest sector was erased with it
+    const size_t sectorPages = mFlash.sectorPages();
+    mEnd = (newest + 2) * LOG_PAGE_PAYLOAD;
+    mErasedUpTo = newest - newest % sectorPages + sectorPages;
+    // back from the newest page as far as the ring goes unbroken
+    mOldest = newest + 1 > pages ? newest + 1 - pages : 0;
+    uint32_t oldest = newest;
+    uint16_t firstRecord;
+    while (oldest > mOldest && pageHeader(oldest - 1, firstRecord))
+        oldest--;
+    mOldest = oldest;
+}
+
+void Logbook::clear()
+{
+    const size_t sectors = mFlash.pageCount() / mFlash.sectorPages();
+    for (size_t i = 0; i < sectors; i++)
+        mFlash.erase(i);
+    mErases += sectors;
+    // a started page is dropped, the next one begins a record
+    uint32_t sequence = (mEnd + LOG_PAGE_PAYLOAD - 1) / LOG_PAGE_PAYLOAD;
+    mEnd = sequence * LOG_PAGE_PAYLOAD;
+    mOldest = sequence;
+    mErasedUpTo = sequence - sequence % mFlash.sectorPages() + mFlash.pageCount();
+    mFirstRecord = LOG_NO_RECORD;
+    memset(mPage, 0xFF, sizeof(mPage));
+}
+
+bool Logbook::append(uint8_t type, const uint8_t data[], size_t len)
+{
+    if (len > 0xFFFF)
+        return false;
+    if (mFirstRecord == LOG_NO_RECORD)
+        mFirstRecord = (uint16_t) (mEnd % LOG_PAGE_PAYLOAD);
+    uint8_t header[LOG_RECORD_HEADER] = {type, (uint8_t) len, (uint8_t) (len >> 8)};
+    bool ok = write(header, sizeof(header));
+    return write(data, len) && ok;
+}
+
+bool Logbook::write(const uint8_t data[], size_t len)
+{
+    bool ok = true;
+    while (len > 0) {
+        size_t pos = mEnd % LOG_PAGE_PAYLOAD;
+        size_t n = LOG_PAGE_PAYLOAD - pos < len ? LOG_PAGE_PAYLOAD - pos : len;
+        memcpy(mPage + LOG_PAGE_HEADER + pos, data, n);
+        data += n;
+        len -= n;
+        mEnd += n;
+        if (mEnd % LOG_PAGE_PAYLOAD == 0)
+            ok = flushPage() && ok;
+    }
+    return ok;
+}
+
+// the RAM page is full: erase ahead if the ring got to a new sector, program it
+bool Logbook::flushPage()
+{
+    const size_t pages = mFlash.pageCount();
+    const size_t sectorPages = mFlash.sectorPages();
+    const uint32_t sequence = mEnd / LOG_PAGE_PAYLOAD - 1;
+    const size_t index = sequence % pages;
+    if (sequence >= mErasedUpTo) {
+        mFlash.erase(index / sectorPages);
+        mErases++;
+        mErasedUpTo = sequence - sequence % sectorPages + sectorPages;
+        // the pages of the last lap in that sector are gone
+        if (mErasedUpTo > mOldest + pages)
+            mOldest = mErasedUpTo - pages;
+    }
+    put32(mPage, sequence);
+    put16(mPage + 4, mFirstRecord);
+    put16(mPage + 6, logCrc16(mPage + LOG_PAGE_HEADER, LOG_PAGE_PAYLOAD, logCrc16(mPage, 6)));
+    bool ok = mFlash.program(index, mPage);
+    mPrograms++;
+    mFirstRecord = LOG_NO_RECORD;
+    memset(mPage, 0xFF, sizeof(mPage));
+    return ok;
+}
+
+bool Logbook::pageHeader(uint32_t sequence, uint16_t &firstRecord)
+{
+    const uint32_t current = mEnd / LOG_PAGE_PAYLOAD;
+    if (sequence == current) {
+        firstRecord = mFirstRecord;
+        return true;
+    }
+    if (sequence < mOldest || sequence > current)
+        return false;
+    uint8_t header[LOG_PAGE_HEADER];
+    if (!mFlash.read(sequence % mFlash.pageCount(), 0, header, sizeof(header)) || get32(header) != sequence)
+        return false;
+    firstRecord = get16(header + 4);
+    return true;
+}
+
+size_t Logbook::read(uint32_t offset, uint8_t out[], size_t size)
+{
+    if (offset >= mEnd)
+        return 0;
+    const uint32_t sequence = offset / LOG_PAGE_PAYLOAD;
+    const size_t pos = offset % LOG_PAGE_PAYLOAD;
+    size_t n = LOG_PAGE_PAYLOAD - pos;
+    if (n > mEnd - offset)
+        n = mEnd - offset;
+    if (n > size)
+        n = size;
+    if (sequence == mEnd / LOG_PAGE_PAYLOAD) {
+        memcpy(out, mPage + LOG_PAGE_HEADER + pos, n);
+        return n;
+    }
+    uint16_t firstRecord;
+    if (!pageHeader(sequence, firstRecord))
+        return 0;
+    return mFlash.read(sequence % mFlash.pageCount(), LOG_PAGE_HEADER + pos, out, n) ? n : 0;
+}
+
+uint32_t Logbook::seek(uint32_t offset)
+{
+    if (offset >= mEnd)
+        return mEnd;
+    const uint32_t current = mEnd / LOG_PAGE_PAYLOAD;
+    uint32_t sequence = offset / LOG_PAGE_PAYLOAD;
+    uint16_t firstRecord;
+    if (sequence >= mOldest && pageHeader(sequence, firstRecord))
+        return offset;
+    // the oldest page can start in the middle of a record
+    if (sequence < mOldest) {
+        sequence = mOldest;
+        offset = sequence * LOG_PAGE_PAYLOAD;
+    }
+    for (; sequence <= current; sequence++) {
+        if (!pageHeader(sequence, firstRecord) || firstRecord == LOG_NO_RECORD)
+            continue;
+        uint32_t record = sequence * LOG_PAGE_PAYLOAD + firstRecord;
+        if (record >= offset && record < mEnd)
+            return record;
+    }
+    return mEnd;
+}
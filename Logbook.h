@@ -0,0 +1,87 @@
+#pragma once
+// Keeps a practice session on the sensor while nobody listens. Records are
+// appended to one byte stream that fills flash pages (FlashStore.h) in a
+// ring: the newest page is built in RAM (write-behind) and programmed once it
+// is full, so every page is programmed exactly once and never padded, and a
+// sector is erased when the ring gets to it, dropping the oldest pages.
+//
+// Every page is a header and LOG_PAGE_PAYLOAD bytes of the stream,
+// little endian:
+//   sequence (4), offset of the first record starting in it (2, 0xFFFF if none), crc16 (2)
+// Page sequence s holds stream offsets [s * LOG_PAGE_PAYLOAD, (s + 1) * LOG_PAGE_PAYLOAD),
+// so an offset names the same byte for as long as the byte is kept, and a
+// download can resume at any offset. Records are
+//   type (1), length (2), data
+// and may run over into the next page. mount() finds the pages left by an
+// earlier run; the page that was still in RAM is lost with the power, and
+// its sequence is skipped so no record continues into a different one.
+// Bytes that are gone read as nothing, seek() finds the next record.
+#include <stddef.h>
+#include <stdint.h>
+#include "FlashStore.h"
+
+const size_t LOG_PAGE_HEADER = 8;
+const size_t LOG_PAGE_PAYLOAD = LOG_PAGE_SIZE - LOG_PAGE_HEADER;
+const size_t LOG_RECORD_HEADER = 3;
+const uint16_t LOG_NO_RECORD = 0xFFFF;
+
+enum LogRecordType
+{
+    LOG_SESSION = 1, // [device time ms (4)] an analysis started
+    LOG_EVENT = 2, // one EventRecord, see EventCodec.h
+    LOG_RAW = 3, // one compressed IMU6 batch, see ImuCodec.h
+};
+
+class Logbook
+{
+public:
+    explicit Logbook(FlashStore &flash);
+
+    // Picks up the pages of an earlier run, or starts empty.
+    void mount();
+    // Erases every sector; offsets go on from where they were.
+    void clear();
+
+    // Returns false if the flash refused a page, the record is lost then.
+    bool append(uint8_t type, const uint8_t data[], size_t len);
+
+    // offset of the oldest record still kept
+    uint32_t begin() { return seek(0); }
+    // offset the next record goes to
+    uint32_t end() const { return mEnd; }
+
+    // Copies stream bytes from offset, out of flash or the page in RAM, up to
+    // the end of its page. Returns how many, 0 at the end or if offset is gone.
+    size_t read(uint32_t offset, uint8_t out[], size_t size);
+    // offset if its byte is kept, else the first record after it (or end())
+    uint32_t seek(uint32_t offset);
+
+    // pages programmed and sectors erased since mount
+    uint32_t programs() const { return mPrograms; }
+    uint32_t erases() const { return mErases; }
+
+private:
+    bool write(const uint8_t data[], size_t len);
+    bool flushPage();
+    // whether the page of sequence is kept, and where its first record starts
+    bool pageHeader(uint32_t sequence, uint16_t &firstRecord);
+
+    FlashStore &mFlash;
+    uint8_t mPage[LOG_PAGE_SIZE]; // the page being filled, mEnd is in it
+    uint32_t mEnd;
+    uint32_t mOldest; // sequence of the oldest page in flash, == the RAM page's if none
+    uint32_t mErasedUpTo; // pages of lower sequence than this are erased ahead of the ring
+    uint16_t mFirstRecord; // of the RAM page
+    uint32_t mPrograms;
+    uint32_t mErases;
+};
+
+// crc16-CCITT, of the page header up to the crc and the payload
+uint16_t logCrc16(const uint8_t data[], size_t len, uint16_t crc = 0xFFFF);
+
+// the logbook of the app (interface.cpp), mounted on first use
+Logbook &logbook();
+// whether the default analysis is logged, its streams outlive a disconnect then
+bool logbookLogging();
+// ends a LOG_READ in progress, e.g. when the link dropped
+void stopLogDownload();
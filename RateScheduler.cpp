@@ -0,0 +1,78 @@
+#include "RateScheduler.h"
+
+static const float GRAVITY = 9.81f;
+
+RateSchedulerConfig::RateSchedulerConfig():
+    idleRate(IDLE_SAMPLE_RATE),
+    activeRate(ACTIVE_SAMPLE_RATE),
+    enterAcc(MOTION_ENTER_ACC),
+    exitAcc(MOTION_EXIT_ACC),
+    enterGyro(MOTION_ENTER_GYRO),
+    exitGyro(MOTION_EXIT_GYRO),
+    quietPeriod(QUIET_PERIOD)
+{
+}
+
+template <typename Math>
+static typename Math::Square squared(float v)
+{
+    return Math::square(Math::acc(v));
+}
+
+template <typename Math>
+BasicRateScheduler<Math>::BasicRateScheduler(const RateSchedulerConfig &config):
+    mConfig(config),
+    mRate(config.idleRate)
+{
+    setConfig(config);
+    reset();
+}
+
+template <typename Math>
+void BasicRateScheduler<Math>::setConfig(const RateSchedulerConfig &config)
+{
+    bool wasActive = mRate == mConfig.activeRate;
+    mConfig = config;
+    mEnterLowSq = config.enterAcc < GRAVITY ? squared<Math>(GRAVITY - config.enterAcc) : 0;
+    mEnterHighSq = squared<Math>(GRAVITY + config.enterAcc);
+    mExitLowSq = config.exitAcc < GRAVITY ? squared<Math>(GRAVITY - config.exitAcc) : 0;
+    mExitHighSq = squared<Math>(GRAVITY + config.exitAcc);
+    mEnterGyro = Math::gyro(config.enterGyro);
+    mExitGyro = Math::gyro(config.exitGyro);
+    mRate = wasActive ? config.activeRate : config.idleRate;
+}
+
+template <typename Math>
+void BasicRateScheduler<Math>::reset()
+{
+    mRate = mConfig.idleRate;
+    mLastMotion = 0;
+}
+
+template <typename Math>
+bool BasicRateScheduler<Math>::update(const BasicBatchFeatures<Math> &f, uint32_t timestamp)
+{
+    if (!active()) {
+        bool motion = f.minAccSq < mEnterLowSq || f.maxAccSq > mEnterHighSq || f.maxAbsZGyro > mEnterGyro;
+        if (!motion)
+            return false;
+        mRate = mConfig.activeRate;
+        mLastMotion = timestamp;
+        return true;
+    }
+
+    bool motion = f.minAccSq < mExitLowSq || f.maxAccSq > mExitHighSq || f.maxAbsZGyro > mExitGyro;
+    if (motion) {
+        mLastMotion = timestamp;
+        return false;
+    }
+    if (timestamp - mLastMotion < mConfig.quietPeriod)
+        return false;
+    // with equal rates there is nothing to step down to
+    const uint32_t previous = mRate;
+    mRate = mConfig.idleRate;
+    return mRate != previous;
+}
+
+template class BasicRateScheduler<FloatMath>;
+template class BasicRateScheduler<FixedMath>;
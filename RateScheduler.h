@@ -0,0 +1,67 @@
+#pragma once
+// Chooses the IMU sample rate from the motion in the incoming batches: a low
+// rate while the player stands between points, a high one as soon as they
+// move. Stepping up is immediate, stepping down waits for a quiet period, and
+// the enter/exit thresholds are apart so the rate does not flap.
+#include <stdint.h>
+#include "ImuFeatures.h"
+
+const uint32_t IDLE_SAMPLE_RATE=26; // rate (Hz) between points
+const uint32_t ACTIVE_SAMPLE_RATE=104; // rate (Hz) during play
+const float MOTION_ENTER_ACC=3.0f; // |acc| deviation (m/s^2) from 1 g that counts as motion
+const float MOTION_EXIT_ACC=1.5f; // |acc| deviation (m/s^2) from 1 g that still keeps the rate up
+const float MOTION_ENTER_GYRO=60; // |gyro z| (dps) that counts as motion
+const float MOTION_EXIT_GYRO=30; // |gyro z| (dps) that still keeps the rate up
+const uint32_t QUIET_PERIOD=5000; // time (ms) without motion before stepping down
+
+struct RateSchedulerConfig
+{
+    uint32_t idleRate;
+    uint32_t activeRate;
+    float enterAcc;
+    float exitAcc;
+    float enterGyro;
+    float exitGyro;
+    uint32_t quietPeriod;
+
+    RateSchedulerConfig();
+};
+
+// Math is the arithmetic of the batch features it is fed, see FixedPoint.h.
+template <typename Math>
+class BasicRateScheduler
+{
+public:
+    explicit BasicRateScheduler(const RateSchedulerConfig &config = RateSchedulerConfig());
+
+    // back to the idle rate
+    void reset();
+
+    // Takes new thresholds and rates. Keeps whether the player is active,
+    // at the rate of the new config.
+    void setConfig(const RateSchedulerConfig &config);
+    const RateSchedulerConfig &config() const { return mConfig; }
+
+    uint32_t rate() const { return mRate; }
+    bool active() const { return mRate == mConfig.activeRate; }
+
+    // Feeds the features of one batch. Returns true when rate() changed and
+    // the subscription has to follow.
+    bool update(const BasicBatchFeatures<Math> &features, uint32_t timestamp);
+
+private:
+    RateSchedulerConfig mConfig;
+    // |acc|^2 bands and gyro thresholds in Math units, derived once from the
+    // config so update() stays sqrt-free
+    typename Math::Square mEnterLowSq;
+    typename Math::Square mEnterHighSq;
+    typename Math::Square mExitLowSq;
+    typename Math::Square mExitHighSq;
+    typename Math::Value mEnterGyro;
+    typename Math::Value mExitGyro;
+
+    uint32_t mRate;
+    uint32_t mLastMotion; // timestamp of the last batch above the exit thresholds
+};
+
+typedef BasicRateScheduler<FloatMath> RateScheduler;
@@ -0,0 +1,58 @@
+#pragma once
+// Fixed-capacity ring buffer that overwrites its oldest element when full.
+// Storage is part of the object, nothing is allocated.
+#include <stddef.h>
+
+template <typename T, size_t CAPACITY>
+class RingBuffer
+{
+public:
+    RingBuffer() : mHead(0), mCount(0) {}
+
+    void clear()
+    {
+        mHead = 0;
+        mCount = 0;
+    }
+
+    void push(const T &value)
+    {
+        mData[(mHead + mCount) % CAPACITY] = value;
+        if (mCount < CAPACITY)
+            mCount++;
+        else
+            mHead = (mHead + 1) % CAPACITY;
+    }
+
+    // drops the oldest element
+    void popFront()
+    {
+        if (mCount == 0)
+            return;
+        mHead = (mHead + 1) % CAPACITY;
+        mCount--;
+    }
+
+    // drops the newest element
+    void popBack()
+    {
+        if (mCount > 0)
+            mCount--;
+    }
+
+    size_t size() const { return mCount; }
+    bool empty() const { return mCount == 0; }
+    bool full() const { return mCount == CAPACITY; }
+    static size_t capacity() { return CAPACITY; }
+
+    // index 0 is the oldest element
+    const T &operator[](size_t index) const { return mData[(mHead + index) % CAPACITY]; }
+    T &operator[](size_t index) { return mData[(mHead + index) % CAPACITY]; }
+    const T &front() const { return (*this)[0]; }
+    const T &back() const { return (*this)[mCount - 1]; }
+
+private:
+    T mData[CAPACITY];
+    size_t mHead;
+    size_t mCount;
+};
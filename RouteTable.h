@@ -0,0 +1,208 @@
+#pragma once
+// Routing table of the data subscriptions. A notification finds its slot by
+// resource in O(1) (open addressing on a small power-of-two table), commands
+// find it by client reference in O(1) (direct index), and free slots are kept
+// on a stack. Every slot also carries the handler the stream is bound to and
+// a binding (e.g. the detector instance it feeds), so dispatching a
+// notification needs no comparisons against known references.
+//
+// Several slots can route the same resource: the first one is found by
+// findResource() and the others follow through next(), in the order they were
+// bound. One notification is then decoded once and fanned out to all of them.
+//
+// Slots are indices the owner uses for its own per-subscription data, e.g.
+// myApp::mDataSubs. No allocation and no Whiteboard dependency, so the host
+// benchmark runs the same code.
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t ROUTE_NO_HANDLER = 0;
+
+// smallest power of two that is at least n
+constexpr size_t pow2AtLeast(size_t n, size_t p = 1)
+{
+    return p >= n ? p : pow2AtLeast(n, p * 2);
+}
+
+constexpr unsigned log2Of(size_t pow2)
+{
+    return pow2 <= 1 ? 0 : 1 + log2Of(pow2 / 2);
+}
+
+template <size_t SLOTS>
+class RouteTable
+{
+public:
+    static const int NONE = -1;
+
+    RouteTable() { clear(); }
+
+    void clear()
+    {
+        for (size_t i=0; i<SLOTS; i++) {
+            mFree[i] = (uint8_t) (SLOTS - 1 - i);
+            mResource[i] = 0;
+            mBound[i] = false;
+            mReference[i] = 0;
+            mHandler[i] = ROUTE_NO_HANDLER;
+            mBinding[i] = 0;
+            mNext[i] = 0;
+        }
+        mFreeCount = SLOTS;
+        for (size_t i=0; i<BUCKETS; i++)
+            mBuckets[i] = 0;
+        for (size_t i=0; i<256; i++)
+            mByReference[i] = 0;
+    }
+
+    // Takes a free slot for the client reference. Fails (NONE) when the table
+    // is full, the reference is 0 or it already has a slot.
+    int add(uint8_t reference, uint8_t handler = ROUTE_NO_HANDLER)
+    {
+        if (reference == 0 || mByReference[reference] != 0 || mFreeCount == 0)
+            return NONE;
+        int slot = mFree[--mFreeCount];
+        mReference[slot] = reference;
+        mHandler[slot] = handler;
+        mBound[slot] = false;
+        mByReference[reference] = (uint8_t) (slot + 1);
+        return slot;
+    }
+
+    // Routes notifications of resource to the slot, after the slots that
+    // already route it.
+    void bind(int slot, uint32_t resource)
+    {
+        if (mBound[slot])
+            unbind(slot);
+        mResource[slot] = resource;
+        mBound[slot] = true;
+        mNext[slot] = 0;
+        size_t b = bucket(resource);
+        while (mBuckets[b] != 0) {
+            int head = mBuckets[b] - 1;
+            if (mResource[head] == resource) {
+                int last = head;
+                while (mNext[last] != 0)
+                    last = mNext[last] - 1;
+                mNext[last] = (uint8_t) (slot + 1);
+                return;
+            }
+            b = (b + 1) & (BUCKETS - 1);
+        }
+        mBuckets[b] = (uint8_t) (slot + 1);
+    }
+
+    void remove(int slot)
+    {
+        if (mBound[slot])
+            unbind(slot);
+        mByReference[mReference[slot]] = 0;
+        mReference[slot] = 0;
+        mHandler[slot] = ROUTE_NO_HANDLER;
+        mBinding[slot] = 0;
+        mFree[mFreeCount++] = (uint8_t) slot;
+    }
+
+    int findResource(uint32_t resource) const
+    {
+        size_t b = bucket(resource);
+        while (mBuckets[b] != 0) {
+            int slot = mBuckets[b] - 1;
+            if (mResource[slot] == resource)
+                return slot;
+            b = (b + 1) & (BUCKETS - 1);
+        }
+        return NONE;
+    }
+
+    // the next slot routing the same resource
+    int next(int slot) const { return mNext[slot] - 1; }
+
+    // whether other slots route the resource of this one
+    bool shared(int slot) const
+    {
+        return mBound[slot] && (mNext[slot] != 0 || findResource(mResource[slot]) != slot);
+    }
+
+    int findReference(uint8_t reference) const
+    {
+        return reference ? mByReference[reference] - 1 : NONE;
+    }
+
+    uint8_t reference(int slot) const { return mReference[slot]; }
+    uint8_t handler(int slot) const { return mHandler[slot]; }
+    uint8_t binding(int slot) const { return mBinding[slot]; }
+    void setHandler(int slot, uint8_t handler, uint8_t binding = 0)
+    {
+        mHandler[slot] = handler;
+        mBinding[slot] = binding;
+    }
+    bool bound(int slot) const { return mBound[slot]; }
+    uint32_t resource(int slot) const { return mResource[slot]; }
+
+    size_t size() const { return SLOTS - mFreeCount; }
+    bool full() const { return mFreeCount == 0; }
+    static size_t capacity() { return SLOTS; }
+
+private:
+    static_assert(SLOTS > 0 && SLOTS < 255, "slots are stored as uint8_t + 1");
+
+    // at most half full, so probe sequences stay short
+    static const size_t BUCKETS = pow2AtLeast(2 * SLOTS);
+    static const unsigned BUCKET_BITS = log2Of(BUCKETS);
+
+    static size_t bucket(uint32_t resource)
+    {
+        // Fibonacci hashing, resource ids are small consecutive numbers: the
+        // top bits of the product mix all of them
+        return (size_t) ((uint32_t) (resource * 2654435769u) >> (32 - BUCKET_BITS));
+    }
+
+    // Takes the slot out of the routing of its resource. The last slot of a
+    // resource empties its bucket, and the rest of the probe sequence shifts
+    // back so lookups never need tombstones.
+    void unbind(int slot)
+    {
+        mBound[slot] = false;
+        size_t b = bucket(mResource[slot]);
+        while (mResource[mBuckets[b] - 1] != mResource[slot])
+            b = (b + 1) & (BUCKETS - 1);
+        int head = mBuckets[b] - 1;
+        if (head != slot) {
+            int prev = head;
+            while (mNext[prev] - 1 != slot)
+                prev = mNext[prev] - 1;
+            mNext[prev] = mNext[slot];
+            mNext[slot] = 0;
+            return;
+        }
+        if (mNext[slot] != 0) {
+            mBuckets[b] = mNext[slot];
+            mNext[slot] = 0;
+            return;
+        }
+        size_t hole = b;
+        for (size_t next = (hole + 1) & (BUCKETS - 1); mBuckets[next] != 0; next = (next + 1) & (BUCKETS - 1)) {
+            size_t home = bucket(mResource[mBuckets[next] - 1]);
+            // an entry can move back to the hole unless its home lies between the hole and it
+            bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+            if (!stays) {
+                mBuckets[hole] = mBuckets[next];
+                hole = next;
+            }
+        }
+        mBuckets[hole] = 0;
+    }
+
+    uint8_t mBuckets[BUCKETS]; // slot + 1, 0 is empty
+    uint8_t mByReference[256]; // slot + 1 per client reference, 0 is none
+    uint32_t mResource[SLOTS];
+    bool mBound[SLOTS];
+    uint8_t mReference[SLOTS];
+    uint8_t mHandler[SLOTS];
+    uint8_t mBinding[SLOTS];
+    uint8_t mNext[SLOTS]; // slot + 1 of the next slot on the same resource, 0 is none
+    uint8_t mFree[SLOTS]; // stack of free slots
+    size_t mFreeCount;
+};
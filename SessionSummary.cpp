@@ -0,0 +1,196 @@
+#include "SessionSummary.h"
+
+static void put16(uint8_t out[], uint16_t v)
+{
+    out[0] = (uint8_t) v;
+    out[1] = (uint8_t) (v >> 8);
+}
+
+static uint16_t get16(const uint8_t in[])
+{
+    return (uint16_t) (in[0] | (in[1] << 8));
+}
+
+static uint16_t saturate16(uint32_t v)
+{
+    return v > 0xFFFF ? 0xFFFF : (uint16_t) v;
+}
+
+static uint8_t saturate8(uint32_t v)
+{
+    return v > 0xFF ? 0xFF : (uint8_t) v;
+}
+
+// the bin of value, the last one takes everything beyond
+static size_t binOf(uint32_t value, uint32_t width, size_t bins)
+{
+    size_t bin = value / width;
+    return bin < bins ? bin : bins - 1;
+}
+
+SessionAggregator::SessionAggregator():
+    mInterval(0),
+    mLastSummary(0)
+{
+    reset();
+}
+
+void SessionAggregator::reset()
+{
+    mStarted = false;
+    mSince = 0;
+    mLatest = 0;
+    for (size_t i=0; i<SUMMARY_KINDS; i++)
+        mCounts[i] = 0;
+    for (size_t i=0; i<SUMMARY_AIRTIME_BINS; i++)
+        mAirtime[i] = 0;
+    for (size_t i=0; i<SUMMARY_INTERVAL_BINS; i++)
+        mIntervals[i] = 0;
+    mRollingAirtime.reset();
+    mRollingGood.reset();
+    mRallyIntervals.reset();
+    mHaveStep = false;
+    mLastStep = 0;
+    mStreak = 0;
+    mBestStreak = 0;
+    mHighStreak = 0;
+    mWorstStreak = 0;
+}
+
+bool SessionAggregator::update(uint32_t timestamp)
+{
+    if (!mStarted) {
+        mStarted = true;
+        mSince = timestamp;
+        mLastSummary = timestamp;
+    }
+    mLatest = timestamp;
+    if (mInterval == 0 || timestamp - mLastSummary < (uint32_t) mInterval * 1000)
+        return false;
+    mLastSummary = timestamp;
+    return true;
+}
+
+void SessionAggregator::add(const SplitStepEvent &event)
+{
+    if (event.kind < GOOD_STEP || event.kind >= EVENT_KIND_COUNT)
+        return;
+    mCounts[event.kind - GOOD_STEP]++;
+    if (event.kind != GOOD_STEP && event.kind != HIGH_STEP)
+        return;
+
+    uint32_t airtime = event.endTime - event.beginTime;
+    mAirtime[binOf(airtime, SUMMARY_AIRTIME_BIN_MS, SUMMARY_AIRTIME_BINS)]++;
+    mRollingAirtime.add((float) airtime);
+    mRollingGood.add(event.kind == GOOD_STEP ? 1.0f : 0.0f);
+
+    if (mHaveStep && event.endTime - mLastStep <= RALLY_GAP) {
+        uint32_t interval = event.endTime - mLastStep;
+        mIntervals[binOf(interval, SUMMARY_INTERVAL_BIN_MS, SUMMARY_INTERVAL_BINS)]++;
+        mRallyIntervals.add((float) interval);
+    }
+    mHaveStep = true;
+    mLastStep = event.endTime;
+
+    if (event.kind == GOOD_STEP) {
+        mStreak++;
+        mHighStreak = 0;
+        mBestStreak = mStreak > mBestStreak ? mStreak : mBestStreak;
+    } else {
+        mHighStreak++;
+        mStreak = 0;
+        mWorstStreak = mHighStreak > mWorstStreak ? mHighStreak : mWorstStreak;
+    }
+}
+
+void SessionAggregator::setInterval(uint16_t seconds)
+{
+    // the next periodic summary is a full interval away
+    mInterval = seconds;
+    mLastSummary = mLatest;
+}
+
+void SessionAggregator::summarize(SummaryReason reason, SessionSummary &out) const
+{
+    out.reason = (uint8_t) reason;
+    out.elapsed = saturate16(mStarted ? (mLatest - mSince) / 1000 : 0);
+    for (size_t i=0; i<SUMMARY_KINDS; i++)
+        out.counts[i] = saturate16(mCounts[i]);
+    out.rollingAirtime = saturate16((uint32_t) (mRollingAirtime.mean() + 0.5f));
+    out.rollingGood = (uint8_t) (mRollingGood.mean() * 100 + 0.5f);
+    out.streak = saturate8(mStreak);
+    out.bestStreak = saturate8(mBestStreak);
+    out.worstStreak = saturate8(mWorstStreak);
+    out.meanInterval = saturate16((uint32_t) (mRallyIntervals.mean() + 0.5f));
+    for (size_t i=0; i<SUMMARY_AIRTIME_BINS; i++)
+        out.airtime[i] = saturate16(mAirtime[i]);
+    for (size_t i=0; i<SUMMARY_INTERVAL_BINS; i++)
+        out.intervals[i] = saturate16(mIntervals[i]);
+    out.heartRate = 0;
+    out.workload = 0;
+    out.load = 0;
+}
+
+size_t encodeSessionSummary(const SessionSummary &summary, uint8_t out[], size_t size)
+{
+    if (size < SUMMARY_SIZE)
+        return 0;
+    size_t pos = 0;
+    out[pos++] = SUMMARY_VERSION;
+    out[pos++] = summary.reason;
+    put16(&out[pos], summary.elapsed);
+    pos += 2;
+    for (size_t i=0; i<SUMMARY_KINDS; i++, pos += 2)
+        put16(&out[pos], summary.counts[i]);
+    put16(&out[pos], summary.rollingAirtime);
+    pos += 2;
+    out[pos++] = summary.rollingGood;
+    out[pos++] = summary.streak;
+    out[pos++] = summary.bestStreak;
+    out[pos++] = summary.worstStreak;
+    put16(&out[pos], summary.meanInterval);
+    pos += 2;
+    for (size_t i=0; i<SUMMARY_AIRTIME_BINS; i++, pos += 2)
+        put16(&out[pos], summary.airtime[i]);
+    for (size_t i=0; i<SUMMARY_INTERVAL_BINS; i++, pos += 2)
+        put16(&out[pos], summary.intervals[i]);
+    out[pos++] = summary.heartRate;
+    out[pos++] = summary.workload;
+    put16(&out[pos], summary.load);
+    pos += 2;
+    return pos;
+}
+
+bool decodeSessionSummary(const uint8_t in[], size_t len, SessionSummary &summary)
+{
+    if (len != SUMMARY_SIZE || in[0] != SUMMARY_VERSION)
+        return false;
+    size_t pos = 1;
+    summary.reason = in[pos++];
+    summary.elapsed = get16(&in[pos]);
+    pos += 2;
+    for (size_t i=0; i<SUMMARY_KINDS; i++, pos += 2)
+        summary.counts[i] = get16(&in[pos]);
+    summary.rollingAirtime = get16(&in[pos]);
+    pos += 2;
+    summary.rollingGood = in[pos++];
+    summary.streak = in[pos++];
+    summary.bestStreak = in[pos++];
+    summary.worstStreak = in[pos++];
+    summary.meanInterval = get16(&in[pos]);
+    pos += 2;
+    for (size_t i=0; i<SUMMARY_AIRTIME_BINS; i++, pos += 2)
+        summary.airtime[i] = get16(&in[pos]);
+    for (size_t i=0; i<SUMMARY_INTERVAL_BINS; i++, pos += 2)
+        summary.intervals[i] = get16(&in[pos]);
+    summary.heartRate = in[pos++];
+    summary.workload = in[pos++];
+    summary.load = get16(&in[pos]);
+    return true;
+}
+
+SessionAggregator &sessionAggregator()
+{
+    static SessionAggregator aggregator;
+    return aggregator;
+}
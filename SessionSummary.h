@@ -0,0 +1,105 @@
+#pragma once
+// Statistics of a practice session, aggregated on the sensor from the events
+// of the default analysis. A client gets them in one SUMMARY_DATA message,
+// on demand or every few seconds, instead of following every event, and
+// finds them complete when it comes back after a disconnect. Fixed-size
+// bins, no allocation.
+//
+// A SUMMARY_DATA payload is SUMMARY_SIZE bytes, little endian:
+//   version, reason (0 requested, 1 periodic), elapsed s (2),
+//   count per kind GOOD_STEP..LUNGE (6 x 2),
+//   rolling airtime ms (2), rolling good % (1),
+//   current, best and worst streak (3 x 1), mean time between split steps ms (2),
+//   airtime histogram (SUMMARY_AIRTIME_BINS x 2), interval histogram (SUMMARY_INTERVAL_BINS x 2),
+//   heart rate bpm (1, 0 without), workload score (1), session load (2), see WorkloadFusion.h;
+//   without WORKLOAD (no heart rate) score and load come from the footwork alone
+// Counts saturate at 0xFFFF and streaks at 255.
+#include <stddef.h>
+#include <stdint.h>
+#include "SplitStepDetector.h"
+#include "StreamingStats.h"
+
+const uint8_t SUMMARY_VERSION = 2;
+const size_t SUMMARY_KINDS = EVENT_KIND_COUNT - GOOD_STEP; // ZERO_G_BEGIN isn't counted
+const size_t SUMMARY_AIRTIME_BINS = 12;
+const uint32_t SUMMARY_AIRTIME_BIN_MS = 25; // the last bin takes everything longer
+const size_t SUMMARY_INTERVAL_BINS = 6;
+const uint32_t SUMMARY_INTERVAL_BIN_MS = 1000;
+const uint32_t RALLY_GAP = 10000; // split steps further apart (ms) are in different rallies
+const size_t ROLLING_STEPS = 10; // split steps the rolling values cover
+const size_t SUMMARY_SIZE = 16 + 2 * (SUMMARY_KINDS + SUMMARY_AIRTIME_BINS + SUMMARY_INTERVAL_BINS);
+
+enum SummaryReason
+{
+    SUMMARY_REQUESTED = 0,
+    SUMMARY_PERIODIC = 1,
+};
+
+// what a SUMMARY_DATA payload carries
+struct SessionSummary
+{
+    uint8_t reason; // SummaryReason
+    uint16_t elapsed; // s since the aggregator was reset
+    uint16_t counts[SUMMARY_KINDS]; // events per kind, from GOOD_STEP on
+    uint16_t rollingAirtime; // mean airtime (ms) of the last ROLLING_STEPS split steps
+    uint8_t rollingGood; // % of them that were good
+    uint8_t streak; // good split steps in a row up to now
+    uint8_t bestStreak; // longest run of good split steps
+    uint8_t worstStreak; // longest run of split steps that were too high
+    uint16_t meanInterval; // mean time (ms) between two split steps of a rally
+    uint16_t airtime[SUMMARY_AIRTIME_BINS]; // split steps per SUMMARY_AIRTIME_BIN_MS of airtime
+    uint16_t intervals[SUMMARY_INTERVAL_BINS]; // rally intervals per SUMMARY_INTERVAL_BIN_MS
+    uint8_t heartRate; // mean bpm of the workload window, 0 without heart rate
+    uint8_t workload; // rolling workload score 0-100
+    uint16_t load; // workload of the session, score-minutes
+};
+
+class SessionAggregator
+{
+public:
+    SessionAggregator();
+
+    // starts a new session, the time starts with the next batch
+    void reset();
+
+    // Takes the device time of a batch of the default analysis. Returns true
+    // when a periodic summary is due, and counts it as sent.
+    bool update(uint32_t timestamp);
+    void add(const SplitStepEvent &event);
+
+    // periodic summaries every seconds, 0 for none
+    void setInterval(uint16_t seconds);
+    uint16_t interval() const { return mInterval; }
+
+    // the workload fields are left 0, WorkloadFusion has them
+    void summarize(SummaryReason reason, SessionSummary &out) const;
+
+private:
+    bool mStarted; // whether mSince holds the first batch of the session
+    uint32_t mSince;
+    uint32_t mLatest; // timestamp of the last batch
+    uint32_t mCounts[SUMMARY_KINDS];
+    uint32_t mAirtime[SUMMARY_AIRTIME_BINS];
+    uint32_t mIntervals[SUMMARY_INTERVAL_BINS];
+    WindowStats<ROLLING_STEPS> mRollingAirtime;
+    WindowStats<ROLLING_STEPS> mRollingGood; // 1 for a good split step, 0 for a high one
+    RunningStats mRallyIntervals;
+    bool mHaveStep; // whether mLastStep holds a split step
+    uint32_t mLastStep; // landing of the last split step
+    uint32_t mStreak;
+    uint32_t mBestStreak;
+    uint32_t mHighStreak;
+    uint32_t mWorstStreak;
+
+    uint16_t mInterval;
+    uint32_t mLastSummary; // timestamp the last periodic summary was due
+};
+
+// Writes the summary as a SUMMARY_DATA payload. Returns its length, 0 if
+// size is too small.
+size_t encodeSessionSummary(const SessionSummary &summary, uint8_t out[], size_t size);
+// false if the payload is malformed or of an unknown version
+bool decodeSessionSummary(const uint8_t in[], size_t len, SessionSummary &summary);
+
+// the aggregator of the default analysis, shared with the disconnect handling in myApp.cpp
+SessionAggregator &sessionAggregator();
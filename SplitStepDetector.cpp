@@ -0,0 +1,234 @@
+#include "SplitStepDetector.h"
+#include "ImuFeatures.h"
+
+SplitStepConfig::SplitStepConfig():
+    beginThreshold(BEGIN_THRESHOLD),
+    endThreshold(END_THRESHOLD),
+    splitStepThreshold(SPLIT_STEP_THRESHOLD),
+    goodStepLength(GOOD_STEP_LENGTH),
+    classifier(true)
+{
+}
+
+template <typename Math>
+BasicSplitStepDetector<Math>::BasicSplitStepDetector(const SplitStepConfig &config):
+    mInterpolate(true)
+{
+    setConfig(config);
+    setSampleRate(52);
+    reset();
+}
+
+template <typename Math>
+void BasicSplitStepDetector<Math>::setConfig(const SplitStepConfig &config)
+{
+    mConfig = config;
+    mBeginThreshold = Math::acc(config.beginThreshold);
+    mEndThreshold = Math::acc(config.endThreshold);
+    mBeginSq = Math::square(mBeginThreshold);
+    mEndSq = Math::square(mEndThreshold);
+    mSplitStepGyro = Math::gyro(config.splitStepThreshold);
+}
+
+template <typename Math>
+void BasicSplitStepDetector<Math>::reset()
+{
+    mHavePrevious = false;
+    mPrevAccSq = 0;
+    mPrevTime = 0;
+    mBase = 0;
+    mBegin = false;
+    mBeginTime = 0;
+    mZeroGGyro.reset();
+    mZeroGTilt.reset();
+    for (size_t i=0; i<LANDING_FEATURE_COUNT; i++)
+        mLanding[i] = 0;
+    mBeginZAcc = 0;
+    mEndZAcc = 0;
+}
+
+template <typename Math>
+static typename Math::Value tilt(const Vec3f &gyro)
+{
+    typename Math::Value x = Math::abs(Math::gyro(gyro.x));
+    typename Math::Value y = Math::abs(Math::gyro(gyro.y));
+    return x > y ? x : y;
+}
+
+template <typename Math>
+void BasicSplitStepDetector<Math>::setSampleRate(uint32_t sampleRate)
+{
+    mSampleRate = sampleRate ? sampleRate : 1;
+    mSamplePeriod = Math::samplePeriod(mSampleRate);
+}
+
+template <typename Math>
+LandingFeatures BasicSplitStepDetector<Math>::lastLanding() const
+{
+    LandingFeatures f;
+    f.values[MAX_Z_GYRO_FEATURE] = Math::gyroUnits(mLanding[MAX_Z_GYRO_FEATURE]);
+    f.values[MEAN_Z_GYRO_FEATURE] = Math::gyroUnits(mLanding[MEAN_Z_GYRO_FEATURE]);
+    f.values[MAX_TILT_GYRO_FEATURE] = Math::gyroUnits(mLanding[MAX_TILT_GYRO_FEATURE]);
+    f.values[AIRTIME_FEATURE] = (float) mLanding[AIRTIME_FEATURE];
+    f.values[LANDING_ACC_FEATURE] = Math::accUnits(mLanding[LANDING_ACC_FEATURE]);
+    return f;
+}
+
+// the model in the units of the detector
+static bool modelSaysSplitStep(const float values[])
+{
+    LandingFeatures f;
+    for (size_t i=0; i<LANDING_FEATURE_COUNT; i++)
+        f.values[i] = values[i];
+    return isSplitStep(footworkModel(), f);
+}
+
+static bool modelSaysSplitStep(const int32_t values[])
+{
+    int8_t q[LANDING_FEATURE_COUNT];
+    quantizeLanding(values, footworkFixedQuantizers(), q);
+    return ensembleScore(footworkModel(), q) >= 0;
+}
+
+// if the zero-g window looks like a split step, by the model or the gyroscope threshold
+template <typename Math>
+bool BasicSplitStepDetector<Math>::classify() const
+{
+    if (mConfig.classifier)
+        return modelSaysSplitStep(mLanding);
+    return mLanding[MAX_Z_GYRO_FEATURE] < mSplitStepGyro;
+}
+
+// time at which |acc| crossed threshold between the previous sample and this one
+template <typename Math>
+typename Math::Time BasicSplitStepDetector<Math>::crossingTime(Square accSq, Value threshold, Time time) const
+{
+    if (!mInterpolate || !mHavePrevious)
+        return time;
+    // only two square roots per transition, the hot path stays squared
+    Value prev = Math::root(mPrevAccSq);
+    Value cur = Math::root(accSq);
+    if (prev == cur)
+        return time;
+    return Math::interpolate(mPrevTime, time, prev - threshold, prev - cur);
+}
+
+template <typename Math>
+void BasicSplitStepDetector<Math>::remember(const Vec3f &acc, Time time)
+{
+    mHavePrevious = true;
+    mPrevAccSq = Math::squareSum(Math::acc(acc.x), Math::acc(acc.y), Math::acc(acc.z));
+    mPrevTime = time;
+}
+
+template <typename Math>
+size_t BasicSplitStepDetector<Math>::process(const ImuBatch &batch, SplitStepEvent events[], size_t maxEvents)
+{
+    BasicBatchFeatures<Math> f;
+    computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, f);
+    return process(batch, f, events, maxEvents);
+}
+
+template <typename Math>
+size_t BasicSplitStepDetector<Math>::process(const ImuBatch &batch, const BasicBatchFeatures<Math> &f,
+                                             SplitStepEvent events[], size_t maxEvents)
+{
+    if (batch.accCount == 0)
+        return 0;
+
+    // the previous sample moves to the time base of this batch, the difference
+    // wraps with the uint32 timestamps
+    if (mHavePrevious)
+        mPrevTime -= Math::fromMs((int32_t) (batch.timestamp - mBase));
+    mBase = batch.timestamp;
+
+    const size_t last = batch.accCount - 1;
+    const Time lastTime = Math::sampleTime(last, mSamplePeriod);
+
+    // most batches can't change the state, the batch statistics settle them
+    // without walking the samples
+    if (!mBegin && f.minAccSq >= mBeginSq) {
+        remember(batch.acc[last], lastTime);
+        return 0;
+    }
+    if (mBegin && f.maxAccSq < mBeginSq) {
+        // zero-g batches are rare, only the gyro of their samples is needed
+        for (size_t i=0; i<batch.accCount && i<batch.gyroCount; i++) {
+            mZeroGGyro.add(Math::abs(Math::gyro(batch.gyro[i].z)));
+            mZeroGTilt.add(tilt<Math>(batch.gyro[i]));
+        }
+        mEndZAcc = Math::acc(batch.acc[last].z);
+        remember(batch.acc[last], lastTime);
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t i=0; i<batch.accCount; i++) {
+        const Vec3f &a = batch.acc[i];
+        const Value z = Math::acc(a.z);
+        const Square accSq = Math::squareSum(Math::acc(a.x), Math::acc(a.y), z);
+        const Time time = Math::sampleTime(i, mSamplePeriod);
+
+        // this marks the beginning of the zero-acceleration period
+        if (accSq < mBeginSq) {
+            if (!mBegin) {
+                // reset all the value. Record the initial timestamp to calculate the height of jump
+                mBegin = true;
+                mZeroGGyro.reset();
+                mZeroGTilt.reset();
+                mBeginZAcc = z;
+                mBeginTime = batch.timestamp + (uint32_t) Math::toMs(crossingTime(accSq, mBeginThreshold, time));
+
+                if (count < maxEvents) {
+                    SplitStepEvent &e = events[count++];
+                    e.kind = ZERO_G_BEGIN;
+                    e.beginTime = mBeginTime;
+                    e.endTime = mBeginTime;
+                    e.maxZGyro = 0;
+                    e.accMagnitude = Math::accUnits(Math::root(accSq));
+                }
+            } else {
+                mEndZAcc = z;
+            }
+            // calculate the maximum of gyroscope data during the zero-acceleration period
+            if (i < batch.gyroCount) {
+                mZeroGGyro.add(Math::abs(Math::gyro(batch.gyro[i].z)));
+                mZeroGTilt.add(tilt<Math>(batch.gyro[i]));
+            }
+        }
+        // this markes the end of the zero-acceleration period
+        else if (mBegin && accSq > mEndSq) {
+            mBegin = false;
+            uint32_t endTime = batch.timestamp + (uint32_t) Math::toMs(crossingTime(accSq, mEndThreshold, time));
+            mLanding[MAX_Z_GYRO_FEATURE] = mZeroGGyro.max();
+            mLanding[MEAN_Z_GYRO_FEATURE] = mZeroGGyro.mean();
+            mLanding[MAX_TILT_GYRO_FEATURE] = mZeroGTilt.max();
+            mLanding[AIRTIME_FEATURE] = (Value) (endTime - mBeginTime);
+            mLanding[LANDING_ACC_FEATURE] = Math::root(accSq);
+
+            if (count < maxEvents) {
+                SplitStepEvent &e = events[count++];
+                e.beginTime = mBeginTime;
+                e.endTime = endTime;
+                e.maxZGyro = Math::gyroUnits(mLanding[MAX_Z_GYRO_FEATURE]);
+                e.accMagnitude = Math::accUnits(mLanding[LANDING_ACC_FEATURE]);
+
+                if (classify()) {
+                    // calculate the total duration to get the height of jump
+                    uint32_t duration = e.endTime - e.beginTime;
+                    // bad split step only consider the case where the user jump too high due to the limitation of the sensor
+                    e.kind = duration <= mConfig.goodStepLength ? GOOD_STEP : HIGH_STEP;
+                } else {
+                    e.kind = OTHER_FOOTWORK;
+                }
+            }
+        }
+        mHavePrevious = true;
+        mPrevAccSq = accSq;
+        mPrevTime = time;
+    }
+    return count;
+}
+
+template class BasicSplitStepDetector<FloatMath>;
+template class BasicSplitStepDetector<FixedMath>;
@@ -0,0 +1,145 @@
+#pragma once
+// Split step detection engine. It has no Whiteboard dependency so the same
+// code runs on the sensor (fed from IMU6Data in interface.cpp) and on the
+// host replay tools under host/.
+#include <stddef.h>
+#include <stdint.h>
+#include "FixedPoint.h"
+#include "FootworkClassifier.h"
+
+const int8_t BEGIN_THRESHOLD=6; // acceleration threshold for split step beginning
+const int8_t END_THRESHOLD=10; // acceleration threshold for split step ending
+const int8_t SPLIT_STEP_THRESHOLD=80; // the threshold to differentiate between split steps and other footworks
+const uint32_t GOOD_STEP_LENGTH=200; // the maximum time (ms) for performing a good split step
+
+// one acc or gyro sample, same layout as wb::FloatVector3D
+struct Vec3f
+{
+    float x;
+    float y;
+    float z;
+};
+
+// the samples of one IMU6 notification
+struct ImuBatch
+{
+    uint32_t timestamp; // timestamp (ms) of the batch
+    const Vec3f *acc;
+    size_t accCount;
+    const Vec3f *gyro;
+    size_t gyroCount;
+};
+
+template <typename Math>
+struct BasicBatchFeatures;
+
+// thresholds of one detector instance, so several profiles can run side by side
+struct SplitStepConfig
+{
+    float beginThreshold; // acc (m/s^2) below which zero-g begins
+    float endThreshold; // acc (m/s^2) above which the landing is detected
+    float splitStepThreshold; // max |gyro z| (dps) of a split step, more is other footwork
+    uint32_t goodStepLength; // the maximum airtime (ms) of a good split step
+    bool classifier; // footworkModel() tells split steps from other footwork, else the splitStepThreshold rule
+
+    SplitStepConfig();
+};
+
+enum SplitStepEventKind
+{
+    ZERO_G_BEGIN = 0, // the zero-acceleration period has begun
+    GOOD_STEP = 1, // split step with a short enough airtime
+    HIGH_STEP = 2, // split step, but the user jumped too high
+    OTHER_FOOTWORK = 3, // landing that isn't a split step: too much rotation, a hop
+    // kinds reported by the other detectors of the pipeline, see FootworkDetectors.h
+    LATERAL_SHUFFLE = 4, // side steps pushing off alternately left and right
+    CROSSOVER = 5, // turning step with the feet on the ground
+    LUNGE = 6, // long step braking hard forward or backward
+    EVENT_KIND_COUNT = 7,
+};
+
+struct SplitStepEvent
+{
+    SplitStepEventKind kind;
+    uint32_t beginTime; // timestamp of the zero-g begin
+    uint32_t endTime; // timestamp of the landing, equals beginTime for ZERO_G_BEGIN
+    float maxZGyro; // the maximum gyroscope magnitude detected during split step
+    float accMagnitude; // acc magnitude of the sample that triggered the event
+};
+
+// Math is FloatMath or FixedMath (FixedPoint.h): the thresholds are
+// converted once by setConfig(), the samples as they are read, and the event
+// fields back to m/s^2 and dps.
+template <typename Math>
+class BasicSplitStepDetector
+{
+public:
+    typedef typename Math::Value Value;
+    typedef typename Math::Square Square;
+    typedef typename Math::Time Time;
+
+    // events beyond this many in one batch are dropped (a landing and a new
+    // zero-g period can't both happen twice within one notification)
+    static const size_t MAX_EVENTS_PER_BATCH = 4;
+
+    explicit BasicSplitStepDetector(const SplitStepConfig &config = SplitStepConfig());
+
+    void reset();
+
+    // takes effect with the next sample, the current state is kept
+    void setConfig(const SplitStepConfig &config);
+    const SplitStepConfig &config() const { return mConfig; }
+
+    // rate (Hz) the samples were taken at, used to timestamp every sample of a batch
+    void setSampleRate(uint32_t sampleRate);
+    uint32_t sampleRate() const { return mSampleRate; }
+
+    // whether zero-g begin and landing are interpolated between the two
+    // samples around the threshold crossing instead of taking the later one
+    void setInterpolation(bool enabled) { mInterpolate = enabled; }
+
+    // Feeds one batch to the detector. Every sample is checked against the
+    // thresholds with its own timestamp (batch timestamp plus its offset at
+    // the sample rate). Writes at most maxEvents events and returns the
+    // number written.
+    size_t process(const ImuBatch &batch, SplitStepEvent events[], size_t maxEvents);
+    // same, with the batch features already computed by the caller
+    size_t process(const ImuBatch &batch, const BasicBatchFeatures<Math> &features, SplitStepEvent events[],
+                   size_t maxEvents);
+
+    bool inZeroG() const { return mBegin; }
+    // the zero-g window of the last landing, what it was classified by
+    LandingFeatures lastLanding() const;
+
+private:
+    Time crossingTime(Square accSq, Value threshold, Time time) const;
+    void remember(const Vec3f &acc, Time time);
+    bool classify() const;
+
+    SplitStepConfig mConfig;
+    // the thresholds in Math units, acc squared, derived once from the config
+    Square mBeginSq;
+    Square mEndSq;
+    Value mBeginThreshold;
+    Value mEndThreshold;
+    Value mSplitStepGyro;
+
+    uint32_t mSampleRate;
+    Time mSamplePeriod; // between two samples
+    bool mInterpolate;
+    bool mHavePrevious; // whether mPrevAccSq/mPrevTime hold the last sample seen
+    Square mPrevAccSq; // |acc|^2 of the last sample seen
+    Time mPrevTime; // time of the last sample seen, from mBase
+    uint32_t mBase; // timestamp (ms) of the batch being processed, sample times are relative to it
+
+    bool mBegin; // whether the split step process has begun
+    uint32_t mBeginTime; // the starting timestamp of split step
+    typename Math::Stats mZeroGGyro; // |gyro z| of the samples during split step
+    typename Math::Stats mZeroGTilt; // larger of |gyro x| and |gyro y| of the samples during split step
+    Value mLanding[LANDING_FEATURE_COUNT]; // LandingFeatures in Math units, airtime in ms
+    Value mBeginZAcc; // beginning z-axis acc
+    Value mEndZAcc; // ending z-axis acc
+};
+
+typedef BasicSplitStepDetector<FloatMath> SplitStepDetector;
+typedef BasicSplitStepDetector<FixedMath> FixedSplitStepDetector;
@@ -0,0 +1,197 @@
+#pragma once
+// Incremental statistics over a stream of samples. Every update is O(1)
+// (amortized for the rolling extremes) and all storage is part of the object,
+// so they can be kept per subscription or per detector without allocation.
+//
+//   RunningStats        mean/variance (Welford), min and max since reset()
+//   WindowStats<N>      mean/variance of the last N samples (sliding Welford)
+//   RollingMax<N>       largest of the last N samples (monotonic deque)
+//   RollingMin<N>       smallest of the last N samples
+//   Ema                 exponential moving average
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "RingBuffer.h"
+
+class RunningStats
+{
+public:
+    RunningStats() { reset(); }
+
+    void reset()
+    {
+        mCount = 0;
+        mMean = 0;
+        mM2 = 0;
+        mMin = FLT_MAX;
+        mMax = -FLT_MAX;
+    }
+
+    void add(float x)
+    {
+        mCount++;
+        float delta = x - mMean;
+        mMean += delta / mCount;
+        mM2 += delta * (x - mMean);
+        mMin = x < mMin ? x : mMin;
+        mMax = x > mMax ? x : mMax;
+    }
+
+    uint32_t count() const { return mCount; }
+    float mean() const { return mMean; }
+    // population variance
+    float variance() const { return mCount ? mM2 / mCount : 0; }
+    // 0 before the first sample
+    float min() const { return mCount ? mMin : 0; }
+    float max() const { return mCount ? mMax : 0; }
+
+private:
+    uint32_t mCount;
+    float mMean;
+    float mM2; // sum of squared differences from the mean
+    float mMin;
+    float mMax;
+};
+
+template <size_t N>
+class WindowStats
+{
+public:
+    WindowStats() { reset(); }
+
+    void reset()
+    {
+        mWindow.clear();
+        mMean = 0;
+        mM2 = 0;
+        mFreshMean = 0;
+        mFreshM2 = 0;
+        mFreshCount = 0;
+    }
+
+    void add(float x)
+    {
+        if (!mWindow.full()) {
+            mWindow.push(x);
+            float delta = x - mMean;
+            mMean += delta / mWindow.size();
+            mM2 += delta * (x - mMean);
+        } else {
+            // replace the oldest sample: Welford's update for a fixed-size window
+            float old = mWindow.front();
+            mWindow.push(x);
+            float oldMean = mMean;
+            mMean += (x - old) / N;
+            mM2 += (x - old) * (x - mMean + old - oldMean);
+        }
+
+        // float rounding of the sliding update drifts over a long stream: a
+        // plain Welford sum starts every N samples and takes over once it
+        // holds the whole window, so every update stays O(1)
+        mFreshCount++;
+        float delta = x - mFreshMean;
+        mFreshMean += delta / mFreshCount;
+        mFreshM2 += delta * (x - mFreshMean);
+        if (mFreshCount == N) {
+            mMean = mFreshMean;
+            mM2 = mFreshM2;
+            mFreshMean = 0;
+            mFreshM2 = 0;
+            mFreshCount = 0;
+        }
+    }
+
+    size_t count() const { return mWindow.size(); }
+    bool full() const { return mWindow.full(); }
+    float mean() const { return mMean; }
+    float variance() const { return mWindow.empty() || mM2 < 0 ? 0 : mM2 / mWindow.size(); }
+    // the sample that leaves the window next, e.g. for rolling sums of differences
+    float oldest() const { return mWindow.empty() ? 0 : mWindow.front(); }
+
+private:
+    RingBuffer<float, N> mWindow;
+    float mMean;
+    float mM2; // sum of squared differences from the mean
+    float mFreshMean; // of the samples since the fresh sum started
+    float mFreshM2;
+    size_t mFreshCount;
+};
+
+// Keeps the samples that can still become the extreme of the window, best
+// first. Each sample is pushed and popped at most once.
+template <size_t N, bool MAX>
+class RollingExtreme
+{
+public:
+    RollingExtreme() { reset(); }
+
+    void reset()
+    {
+        mCandidates.clear();
+        mNext = 0;
+    }
+
+    void add(float x)
+    {
+        // the front leaves the window
+        if (!mCandidates.empty() && mNext - mCandidates.front().index >= N)
+            mCandidates.popFront();
+        // candidates no better than x can't be the extreme anymore
+        while (!mCandidates.empty() && !better(mCandidates.back().value, x))
+            mCandidates.popBack();
+        Entry e = {x, mNext++};
+        mCandidates.push(e);
+    }
+
+    // 0 before the first sample
+    float value() const { return mCandidates.empty() ? 0 : mCandidates.front().value; }
+
+private:
+    struct Entry
+    {
+        float value;
+        uint32_t index; // sample number, wraps safely since only differences are used
+    };
+
+    static bool better(float a, float b) { return MAX ? a > b : a < b; }
+
+    RingBuffer<Entry, N> mCandidates;
+    uint32_t mNext;
+};
+
+template <size_t N>
+using RollingMax = RollingExtreme<N, true>;
+template <size_t N>
+using RollingMin = RollingExtreme<N, false>;
+
+class Ema
+{
+public:
+    // alpha is the weight of a new sample, 0 < alpha <= 1
+    explicit Ema(float alpha = 0.1f) : mAlpha(alpha) { reset(); }
+
+    // weight for a time constant of tau ms at one sample every period ms
+    static float alphaFor(float period, float tau) { return tau > 0 ? period / (tau + period) : 1; }
+
+    void setAlpha(float alpha) { mAlpha = alpha; }
+
+    void reset()
+    {
+        mValue = 0;
+        mPrimed = false;
+    }
+
+    void add(float x)
+    {
+        // the first sample starts the average instead of decaying from 0
+        mValue = mPrimed ? mValue + mAlpha * (x - mValue) : x;
+        mPrimed = true;
+    }
+
+    float value() const { return mValue; }
+
+private:
+    float mAlpha;
+    float mValue;
+    bool mPrimed;
+};
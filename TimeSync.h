@@ -0,0 +1,18 @@
+#pragma once
+// Clock alignment with the client. TIME_SYNC (interface.cpp) takes the
+// client's clock and reads the sensor's with a GET of /Time/Detailed, whose
+// result myApp.cpp hands to sendTimeSync(). The TIME_DATA reply pairs them:
+//   [client time (4), device time ms (4)], little endian
+// The device time is the clock of the IMU6 timestamps, the time base of every
+// timestamp the sensor reports (EVENTS, LANDING, RAW, CAPTURE_DATA), so a
+// client that estimates offset and drift from the replies can put them on its
+// own clock, see host/clockSync.h.
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t TIME_DATA_SIZE = 8;
+
+// answers the TIME_SYNC waiting for the clock, valid is false if it couldn't be read
+void sendTimeSync(bool valid, uint32_t deviceTime);
+// forgets the TIME_SYNC waiting for the clock, e.g. when the link dropped
+void cancelTimeSync();
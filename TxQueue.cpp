@@ -0,0 +1,166 @@
+#include "TxQueue.h"
+#include <string.h>
+
+TxQueue::TxQueue():
+    mPayloadSize(DEFAULT_PAYLOAD)
+{
+    clear();
+    resetStats();
+}
+
+void TxQueue::clear()
+{
+    for (size_t i=0; i<POOL_SIZE; i++)
+        mFree[i] = (uint8_t) (POOL_SIZE - 1 - i);
+    mFreeCount = POOL_SIZE;
+    for (size_t p=0; p<TX_PRIORITY_COUNT; p++) {
+        mRings[p].head = 0;
+        mRings[p].count = 0;
+    }
+    mCount = 0;
+}
+
+void TxQueue::resetStats()
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+void TxQueue::setPayloadSize(size_t size)
+{
+    // a notification has to hold at least the type, the tag and one byte
+    mPayloadSize = size < 3 ? 3 : (size > MAX_PAYLOAD ? MAX_PAYLOAD : size);
+}
+
+bool TxQueue::push(uint8_t type, uint8_t tag, const uint8_t data[], size_t len, TxPriority priority)
+{
+    if (len + 2 > mPayloadSize) {
+        mStats.oversize++;
+        return false;
+    }
+    // low priority traffic is throttled before the pool runs dry
+    if (priority == TX_PRIORITY_LOW && mFreeCount <= LOW_PRIORITY_RESERVE) {
+        mStats.dropped++;
+        return false;
+    }
+
+    int slot;
+    if (mFreeCount > 0) {
+        slot = mFree[--mFreeCount];
+    } else {
+        // full: push out the newest message of the lowest priority below this one
+        slot = -1;
+        for (size_t p=0; p<(size_t) priority && slot < 0; p++)
+            slot = dropNewest(p);
+        if (slot < 0) {
+            mStats.dropped++;
+            return false;
+        }
+        mStats.dropped++;
+    }
+
+    Slot &s = mSlots[slot];
+    s.type = type;
+    s.tag = tag;
+    s.len = (uint8_t) len;
+    if (len)
+        memcpy(s.data, data, len);
+
+    Ring &ring = mRings[priority];
+    ring.index[(ring.head + ring.count) % POOL_SIZE] = (uint8_t) slot;
+    ring.count++;
+    mCount++;
+    mStats.queued++;
+    return true;
+}
+
+size_t TxQueue::pop(uint8_t out[], size_t size)
+{
+    if (mCount == 0)
+        return 0;
+    size_t limit = size < mPayloadSize ? size : mPayloadSize;
+
+    // collect the messages that fit one notification, in the order they'd be sent
+    size_t total = TX_PACKED_HEADER;
+    size_t take[TX_PRIORITY_COUNT] = {0};
+    size_t taken = 0;
+    bool full = false;
+    for (int p=TX_PRIORITY_COUNT-1; p>=0 && !full; p--) {
+        const Ring &ring = mRings[p];
+        for (size_t k=0; k<ring.count; k++) {
+            const Slot &s = mSlots[ring.index[(ring.head + k) % POOL_SIZE]];
+            if (total + TX_PACKED_ENTRY_HEADER + s.len > limit) {
+                full = true;
+                break;
+            }
+            total += TX_PACKED_ENTRY_HEADER + s.len;
+            take[p]++;
+            taken++;
+        }
+    }
+
+    if (taken <= 1) {
+        // a single message keeps the plain [type, tag, data] layout
+        int p = TX_PRIORITY_COUNT - 1;
+        while (mRings[p].count == 0)
+            p--;
+        int slot = popSlot(p);
+        const Slot &s = mSlots[slot];
+        size_t len = 2 + s.len;
+        if (len > limit) {
+            // the payload size shrank after it was queued
+            release(slot);
+            mStats.oversize++;
+            return pop(out, size);
+        }
+        out[0] = s.type;
+        out[1] = s.tag;
+        memcpy(&out[2], s.data, s.len);
+        release(slot);
+        mStats.sent++;
+        return len;
+    }
+
+    size_t pos = TX_PACKED_HEADER;
+    out[0] = TX_PACKED_TYPE;
+    out[1] = (uint8_t) taken;
+    for (int p=TX_PRIORITY_COUNT-1; p>=0; p--) {
+        for (size_t k=0; k<take[p]; k++) {
+            int slot = popSlot(p);
+            const Slot &s = mSlots[slot];
+            out[pos++] = s.len;
+            out[pos++] = s.type;
+            out[pos++] = s.tag;
+            memcpy(&out[pos], s.data, s.len);
+            pos += s.len;
+            release(slot);
+        }
+    }
+    mStats.sent++;
+    mStats.packed += taken;
+    return pos;
+}
+
+int TxQueue::popSlot(size_t priority)
+{
+    Ring &ring = mRings[priority];
+    int slot = ring.index[ring.head];
+    ring.head = (uint8_t) ((ring.head + 1) % POOL_SIZE);
+    ring.count--;
+    mCount--;
+    return slot;
+}
+
+int TxQueue::dropNewest(size_t priority)
+{
+    Ring &ring = mRings[priority];
+    if (ring.count == 0)
+        return -1;
+    ring.count--;
+    mCount--;
+    return ring.index[(ring.head + ring.count) % POOL_SIZE];
+}
+
+void TxQueue::release(int slot)
+{
+    mFree[mFreeCount++] = (uint8_t) slot;
+}
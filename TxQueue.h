@@ -0,0 +1,93 @@
+#pragma once
+// Fixed-size pool of outgoing messages with one ring per priority. Messages
+// are copied in when queued and turned into notifications one at a time by
+// pop(), which packs several small messages into one notification when they
+// fit in the payload size of the link. No allocation.
+//
+// A notification holding one message keeps the original layout:
+//   [type, tag, data...]
+// A notification holding several messages is
+//   [TX_PACKED_TYPE, count, (len, type, tag, data[len])...]
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t TX_PACKED_TYPE = 4; // response type of a packed notification
+const size_t TX_PACKED_HEADER = 2; // type and count
+const size_t TX_PACKED_ENTRY_HEADER = 3; // len, type and tag of every packed message
+
+enum TxPriority
+{
+    TX_PRIORITY_LOW = 0, // bulk data, only queued while there is room to spare
+    TX_PRIORITY_NORMAL = 1, // command results and events
+    TX_PRIORITY_HIGH = 2, // may push out queued lower priority messages
+    TX_PRIORITY_COUNT = 3,
+};
+
+struct TxStats
+{
+    uint32_t queued; // messages accepted by push()
+    uint32_t sent; // notifications handed out by pop()
+    uint32_t packed; // messages that shared a notification with others
+    uint32_t dropped; // messages rejected or pushed out because the pool was full
+    uint32_t oversize; // messages rejected because they don't fit a notification
+};
+
+class TxQueue
+{
+public:
+    static const size_t POOL_SIZE = 8;
+    // largest notification payload: ATT MTU 247 on nRF52 minus the 3 byte ATT header
+    static const size_t MAX_PAYLOAD = 244;
+    // payload size used until the link tells otherwise, what sendPacket always sent
+    static const size_t DEFAULT_PAYLOAD = 66;
+    // free slots a low priority message has to leave for the others
+    static const size_t LOW_PRIORITY_RESERVE = 2;
+
+    TxQueue();
+
+    void clear();
+
+    void setPayloadSize(size_t size);
+    size_t payloadSize() const { return mPayloadSize; }
+
+    // Copies the message into a pooled slot. Returns false if it was dropped.
+    bool push(uint8_t type, uint8_t tag, const uint8_t data[], size_t len, TxPriority priority);
+
+    // Writes the next notification to out, highest priority first, and frees
+    // the slots it used. Returns its length, 0 if the queue is empty.
+    size_t pop(uint8_t out[], size_t size);
+
+    bool empty() const { return mCount == 0; }
+    size_t size() const { return mCount; }
+
+    const TxStats &stats() const { return mStats; }
+    void resetStats();
+
+private:
+    struct Slot
+    {
+        uint8_t type;
+        uint8_t tag;
+        uint8_t len;
+        uint8_t data[MAX_PAYLOAD];
+    };
+    // indices into mSlots, oldest first
+    struct Ring
+    {
+        uint8_t index[POOL_SIZE];
+        uint8_t head;
+        uint8_t count;
+    };
+
+    int popSlot(size_t priority);
+    int dropNewest(size_t priority);
+    void release(int slot);
+
+    Slot mSlots[POOL_SIZE];
+    uint8_t mFree[POOL_SIZE]; // stack of free slot indices
+    size_t mFreeCount;
+    Ring mRings[TX_PRIORITY_COUNT];
+    size_t mCount;
+    size_t mPayloadSize;
+    TxStats mStats;
+};
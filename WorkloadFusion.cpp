@@ -0,0 +1,206 @@
+#include "WorkloadFusion.h"
+
+static float clamp01(float v)
+{
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+WorkloadFusion::WorkloadFusion()
+{
+    reset();
+}
+
+void WorkloadFusion::reset()
+{
+    mHr.clear();
+    mEvents.clear();
+    mHaveBatch = false;
+    mBatchTime = 0;
+    mHaveHr = false;
+    mHrTime = 0;
+    for (size_t i=0; i<WORKLOAD_WINDOW_S; i++)
+        clearBin(mBins[i]);
+    clearBin(mTotal);
+    mStarted = false;
+    mSecond = 0;
+    mScore = 0;
+    mLoad = 0;
+    mForced = 0;
+    mLate = 0;
+    mHighWater = 0;
+}
+
+void WorkloadFusion::clearBin(Bin &bin)
+{
+    bin.hrSum = 0;
+    bin.hrCount = 0;
+    bin.events = 0;
+    bin.airtimeSum = 0;
+    bin.steps = 0;
+}
+
+uint8_t WorkloadFusion::heartRate() const
+{
+    return mTotal.hrCount ? (uint8_t) ((mTotal.hrSum / mTotal.hrCount + 5) / 10) : 0;
+}
+
+void WorkloadFusion::addEvent(const SplitStepEvent &event)
+{
+    if (event.kind < GOOD_STEP || event.kind >= EVENT_KIND_COUNT)
+        return;
+    Item item;
+    item.time = event.endTime;
+    item.kind = (uint8_t) event.kind;
+    const bool step = event.kind == GOOD_STEP || event.kind == HIGH_STEP;
+    item.value = step ? (uint16_t) (event.endTime - event.beginTime) : 0;
+    push(mEvents, item);
+}
+
+void WorkloadFusion::addBatch(uint32_t endTime)
+{
+    mHaveBatch = true;
+    mBatchTime = endTime;
+    drain();
+}
+
+void WorkloadFusion::addHeartRate(float average, const uint16_t rr[], size_t rrCount)
+{
+    if (!mHaveBatch) {
+        mLate++;
+        return;
+    }
+    // a stream is taken in order, the stamp can't go back
+    uint32_t time = mHaveHr && mHrTime > mBatchTime ? mHrTime : mBatchTime;
+    Item item;
+    item.kind = 0;
+    if (rrCount > 0) {
+        // one beat per interval, the last one now; only the newest MAX_RR
+        const uint16_t *newest = rrCount > MAX_RR ? rr + rrCount - MAX_RR : rr;
+        const size_t n = rrCount > MAX_RR ? MAX_RR : rrCount;
+        uint32_t span = 0;
+        for (size_t i=1; i<n; i++)
+            span += newest[i];
+        for (size_t i=0; i<n; i++) {
+            if (i > 0)
+                span -= newest[i];
+            // 30 to 240 bpm, the rest is a missed or an extra beat
+            if (newest[i] < 250 || newest[i] > 2000)
+                continue;
+            item.time = span < time - mHrTime ? time - span : mHrTime;
+            item.value = (uint16_t) (600000 / newest[i]);
+            push(mHr, item);
+        }
+    } else if (average > 0) {
+        item.time = time;
+        item.value = (uint16_t) (average * 10 + 0.5f);
+        push(mHr, item);
+    }
+    mHaveHr = true;
+    mHrTime = time;
+    drain();
+}
+
+void WorkloadFusion::push(RingBuffer<Item, QUEUE_SIZE> &queue, const Item &item)
+{
+    // the other stream is behind: the oldest items go as they are
+    while (queue.full()) {
+        const bool hr = mEvents.empty() || (!mHr.empty() && mHr.front().time <= mEvents.front().time);
+        RingBuffer<Item, QUEUE_SIZE> &oldest = hr ? mHr : mEvents;
+        take(oldest.front(), hr);
+        oldest.popFront();
+        mForced++;
+    }
+    queue.push(item);
+    const size_t buffered = mHr.size() + mEvents.size();
+    if (buffered > mHighWater)
+        mHighWater = buffered;
+}
+
+// takes everything both streams have got to, oldest first
+void WorkloadFusion::drain()
+{
+    if (!mHaveBatch)
+        return;
+    uint32_t limit = mBatchTime;
+    if (mHaveHr && mHrTime + HR_STALE_MS >= mBatchTime && mHrTime < limit)
+        limit = mHrTime;
+    while (true) {
+        const bool hr = !mHr.empty() && mHr.front().time <= limit &&
+                        (mEvents.empty() || mHr.front().time <= mEvents.front().time);
+        const bool event = !hr && !mEvents.empty() && mEvents.front().time <= limit;
+        if (!hr && !event)
+            break;
+        RingBuffer<Item, QUEUE_SIZE> &queue = hr ? mHr : mEvents;
+        take(queue.front(), hr);
+        queue.popFront();
+    }
+    if (mStarted)
+        advanceTo(limit / 1000);
+}
+
+void WorkloadFusion::take(const Item &item, bool heartRate)
+{
+    const uint32_t second = item.time / 1000;
+    if (!mStarted) {
+        mStarted = true;
+        mSecond = second;
+    }
+    advanceTo(second);
+    if (second + WORKLOAD_WINDOW_S <= mSecond) {
+        mLate++;
+        return;
+    }
+    Bin &bin = mBins[second % WORKLOAD_WINDOW_S];
+    if (heartRate) {
+        bin.hrSum += item.value;
+        bin.hrCount++;
+        mTotal.hrSum += item.value;
+        mTotal.hrCount++;
+        return;
+    }
+    bin.events++;
+    mTotal.events++;
+    if (item.kind == GOOD_STEP || item.kind == HIGH_STEP) {
+        bin.airtimeSum += item.value;
+        bin.steps++;
+        mTotal.airtimeSum += item.value;
+        mTotal.steps++;
+    }
+}
+
+void WorkloadFusion::advanceTo(uint32_t second)
+{
+    // past a whole window of seconds the bins are empty, nothing changes any more
+    for (uint32_t i=0; mSecond < second; i++) {
+        if (i > WORKLOAD_WINDOW_S) {
+            mSecond = second;
+            break;
+        }
+        scoreSecond();
+        mSecond++;
+        Bin &bin = mBins[mSecond % WORKLOAD_WINDOW_S];
+        mTotal.hrSum -= bin.hrSum;
+        mTotal.hrCount -= bin.hrCount;
+        mTotal.events -= bin.events;
+        mTotal.airtimeSum -= bin.airtimeSum;
+        mTotal.steps -= bin.steps;
+        clearBin(bin);
+    }
+}
+
+void WorkloadFusion::scoreSecond()
+{
+    const float rate = clamp01(mTotal.events * 60.0f / WORKLOAD_WINDOW_S / WORKLOAD_FULL_RATE);
+    const float airtime = mTotal.steps ? clamp01(mTotal.airtimeSum / (float) mTotal.steps / WORKLOAD_FULL_AIRTIME) : 0;
+    float score;
+    if (mTotal.hrCount && mConfig.maxHr > mConfig.restHr) {
+        const float hr = mTotal.hrSum / (10.0f * mTotal.hrCount);
+        const float reserve = clamp01((hr - mConfig.restHr) / (mConfig.maxHr - mConfig.restHr));
+        score = WORKLOAD_HR_WEIGHT * reserve + WORKLOAD_RATE_WEIGHT * rate + WORKLOAD_AIRTIME_WEIGHT * airtime;
+    } else {
+        score = (WORKLOAD_RATE_WEIGHT * rate + WORKLOAD_AIRTIME_WEIGHT * airtime) /
+                (WORKLOAD_RATE_WEIGHT + WORKLOAD_AIRTIME_WEIGHT);
+    }
+    mScore = (uint8_t) (score * 100 + 0.5f);
+    mLoad += mScore;
+}
@@ -0,0 +1,113 @@
+#pragma once
+// A rolling workload score of the default analysis from two streams: heart
+// rate (average and RR intervals of /Meas/HR) and the footwork events of the
+// IMU. Both arrive on the application thread at their own pace, so every
+// stream has a bounded queue and items are taken in time order up to the
+// point both streams have reached; a heart rate that stopped coming doesn't
+// hold the events back for longer than HR_STALE_MS, and a full queue is
+// taken from without waiting. The fused items go into one-second bins of a
+// WORKLOAD_WINDOW_S window, and every completed second scores
+//   heart rate reserve, footwork events per minute and split step airtime
+// as 0-100 and adds it to the load of the session (score-minutes). Without
+// heart rate in the window the score is made of the footwork alone.
+//
+// HR notifications carry no timestamp, they are timed with the end of the
+// latest IMU batch (the device clock of the IMU6 timestamps), so heart rate
+// only counts while the default analysis runs. Fixed-size queues and bins,
+// no allocation, and a bounded amount of work per notification.
+#include <stddef.h>
+#include <stdint.h>
+#include "RingBuffer.h"
+#include "SplitStepDetector.h"
+
+const uint32_t WORKLOAD_WINDOW_S = 30;
+const uint32_t HR_STALE_MS = 5000;
+const float WORKLOAD_FULL_RATE = 30; // events per minute that score full marks
+const float WORKLOAD_FULL_AIRTIME = 300; // ms
+// weights of the score with heart rate, and of the footwork alone
+const float WORKLOAD_HR_WEIGHT = 0.5f;
+const float WORKLOAD_RATE_WEIGHT = 0.3f;
+const float WORKLOAD_AIRTIME_WEIGHT = 0.2f;
+
+struct WorkloadConfig
+{
+    uint8_t restHr; // bpm
+    uint8_t maxHr;
+
+    WorkloadConfig() : restHr(60), maxHr(190) {}
+};
+
+class WorkloadFusion
+{
+public:
+    static const size_t QUEUE_SIZE = 16; // items per stream
+    static const size_t MAX_RR = 8; // RR intervals taken from one notification
+
+    WorkloadFusion();
+
+    // starts a new session, the settings stay
+    void reset();
+    void setConfig(const WorkloadConfig &config) { mConfig = config; }
+    const WorkloadConfig &config() const { return mConfig; }
+
+    // the events of an IMU batch, then the end time of the batch
+    void addEvent(const SplitStepEvent &event);
+    void addBatch(uint32_t endTime);
+    // one HR notification: an average and the RR intervals (ms) since the last one
+    void addHeartRate(float average, const uint16_t rr[], size_t rrCount);
+
+    uint8_t score() const { return mScore; }
+    // mean heart rate (bpm) of the window, 0 without
+    uint8_t heartRate() const;
+    // sum of the scores of every second, in score-minutes
+    uint16_t load() const { return (uint16_t) (mLoad / 60 > 0xFFFF ? 0xFFFF : mLoad / 60); }
+
+    // items taken before the other stream got there, because a queue was full
+    uint32_t forced() const { return mForced; }
+    // items older than the window, or heart rate before the first batch
+    uint32_t late() const { return mLate; }
+    size_t highWater() const { return mHighWater; }
+
+private:
+    struct Item
+    {
+        uint32_t time; // ms
+        uint16_t value; // heart rate: bpm x 10, event: airtime ms of a split step
+        uint8_t kind; // event: SplitStepEventKind
+    };
+
+    struct Bin
+    {
+        uint32_t hrSum; // bpm x 10
+        uint16_t hrCount;
+        uint16_t events;
+        uint32_t airtimeSum;
+        uint16_t steps;
+    };
+
+    void push(RingBuffer<Item, QUEUE_SIZE> &queue, const Item &item);
+    void drain();
+    void take(const Item &item, bool heartRate);
+    // completes the seconds before second
+    void advanceTo(uint32_t second);
+    void clearBin(Bin &bin);
+    void scoreSecond();
+
+    WorkloadConfig mConfig;
+    RingBuffer<Item, QUEUE_SIZE> mHr;
+    RingBuffer<Item, QUEUE_SIZE> mEvents;
+    bool mHaveBatch;
+    uint32_t mBatchTime; // end of the latest IMU batch
+    bool mHaveHr;
+    uint32_t mHrTime; // of the latest HR notification
+
+    Bin mBins[WORKLOAD_WINDOW_S];
+    Bin mTotal; // of the bins
+    bool mStarted; // whether mSecond holds a second yet
+    uint32_t mSecond; // the second being filled
+    uint8_t mScore;
+    uint32_t mLoad; // sum of the per-second scores
+    uint32_t mForced;
+    uint32_t mLate;
+    size_t mHighWater;
+};
@@ -0,0 +1,528 @@
+// Runs the whole app (myApp.cpp, interface.cpp, BleTransmitter.cpp) against
+// the stand-in Whiteboard runtime in host/sim. A script plays the central:
+// it connects, enables notifications and writes commands at given times while
+// the runtime feeds the IMU6 subscriptions from a trace. Time is simulated, so
+// the results only depend on the trace and the script, and a session replays
+// far faster than real time.
+//
+// Script lines are "<ms> <action>", the time relative to the start of the
+// trace or to its end ("end", "end-500"); '#' starts a comment:
+//   connect | disconnect | notify on | notify off | cmd <hex bytes...> | sync
+// "sync" sends TIME_SYNC with the script time; the replies feed a ClockSync,
+// whose estimate of the sensor clock is printed.
+// Without --script the default session connects, switches to binary events,
+// turns on LED feedback, runs BEGIN_SUB for the whole trace and asks for
+// a SUMMARY and STATS at the end. The last SUMMARY_DATA received is printed,
+// and the records of the last logbook download (LOG_READ) are counted.
+// /Meas/HR plays the heart rate trace of --hr, or one synthesized from the
+// labels of the IMU trace, once a script turns on WORKLOAD ("cmd 14 01").
+//
+// usage: appSim [--script FILE] [--synth SECONDS] [--rate HZ] [--seed N]
+//               [--hr FILE] [--link-us N] [--notifications] [trace.csv ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "EventCodec.h"
+#include "Instrumentation.h"
+#include "Logbook.h"
+#include "TimeSync.h"
+#include "SessionSummary.h"
+#include "TxQueue.h"
+#include "clockSync.h"
+#include "hrTrace.h"
+#include "imuTrace.h"
+#include "myApp.h"
+#include "simRuntime.h"
+
+namespace
+{
+const uint8_t EVENTS_TYPE = 5; // Responses::EVENTS of interface.cpp
+const uint8_t LANDING_TYPE = 9; // Responses::LANDING
+const uint8_t SUMMARY_TYPE = 10; // Responses::SUMMARY_DATA
+const uint8_t TIME_TYPE = 11; // Responses::TIME_DATA
+const uint8_t LOG_DATA_TYPE = 12; // Responses::LOG_DATA
+const uint8_t LOG_INFO_TYPE = 13; // Responses::LOG_INFO
+const uint8_t TIME_SYNC_COMMAND = 15; // Commands::TIME_SYNC
+const uint32_t DRAIN_MS = 2000; // after the last action, for the replies to go out
+const char *DEFAULT_SCRIPT[] = {
+    "10 connect",
+    "20 notify on",
+    "30 cmd 04 01", // SET_FORMAT binary, no batching window
+    "35 cmd 0c 01", // FEEDBACK on
+    "40 cmd 01", // BEGIN_SUB, default analysis
+    "end cmd 0d", // SUMMARY
+    "end cmd 0a", // STATS
+    "end+200 cmd 02", // END_SUB
+};
+
+struct ScriptAction
+{
+    uint32_t time; // ms
+    std::string verb;
+    std::vector<uint8_t> bytes; // of cmd
+    bool on; // of notify
+    int line;
+};
+
+bool parseTime(const char *text, uint32_t traceMs, uint32_t &time)
+{
+    char *rest;
+    if (strncmp(text, "end", 3) == 0)
+    {
+        long offset = text[3] ? strtol(text + 3, &rest, 10) : 0;
+        if (text[3] && *rest)
+            return false;
+        if (offset < 0 && (uint32_t)-offset > traceMs)
+            return false;
+        time = (uint32_t)((long)traceMs + offset);
+        return true;
+    }
+    unsigned long value = strtoul(text, &rest, 10);
+    if (rest == text || *rest)
+        return false;
+    time = (uint32_t)value;
+    return true;
+}
+
+bool parseAction(const std::string &text, int line, uint32_t traceMs, ScriptAction &action)
+{
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t begin = text.find_first_not_of(" \t\r", pos);
+        if (begin == std::string::npos || text[begin] == '#')
+            break;
+        size_t end = text.find_first_of(" \t\r#", begin);
+        words.push_back(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        pos = end == std::string::npos ? text.size() : end;
+    }
+    if (words.empty())
+        return false;
+    action.line = line;
+    action.on = false;
+    action.bytes.clear();
+    if (words.size() < 2 || !parseTime(words[0].c_str(), traceMs, action.time))
+    {
+        fprintf(stderr, "script line %d: expected <ms> <action>\n", line);
+        exit(2);
+    }
+    action.verb = words[1];
+    bool valid = false;
+    if (action.verb == "connect" || action.verb == "disconnect")
+        valid = words.size() == 2;
+    else if (action.verb == "sync" && words.size() == 2)
+    {
+        valid = true;
+        action.bytes.push_back(TIME_SYNC_COMMAND);
+        for (size_t i = 0; i < 4; i++)
+            action.bytes.push_back((uint8_t)(action.time >> (8 * i)));
+    }
+    else if (action.verb == "notify" && words.size() == 3)
+    {
+        action.on = words[2] == "on";
+        valid = action.on || words[2] == "off";
+    }
+    else if (action.verb == "cmd" && words.size() >= 3)
+    {
+        valid = true;
+        for (size_t i = 2; i < words.size() && valid; i++)
+        {
+            char *rest;
+            unsigned long byte = strtoul(words[i].c_str(), &rest, 16);
+            valid = *rest == 0 && byte <= 0xFF;
+            action.bytes.push_back((uint8_t)byte);
+        }
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "script line %d: bad action '%s'\n", line, text.c_str());
+        exit(2);
+    }
+    return true;
+}
+
+bool loadScript(const char *path, uint32_t traceMs, std::vector<ScriptAction> &script)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char text[512];
+    int line = 0;
+    while (fgets(text, sizeof(text), file))
+    {
+        ScriptAction action;
+        std::string s(text);
+        if (!s.empty() && s[s.size() - 1] == '\n')
+            s.erase(s.size() - 1);
+        if (parseAction(s, ++line, traceMs, action))
+            script.push_back(action);
+    }
+    fclose(file);
+    return true;
+}
+
+void runAction(const ScriptAction &action)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    bool done;
+    if (action.verb == "connect")
+        done = (sim.connect(), true);
+    else if (action.verb == "disconnect")
+        done = (sim.disconnect(), true);
+    else if (action.verb == "notify")
+        done = sim.setNotifications(action.on);
+    else
+        done = sim.writeCommand(action.bytes.data(), action.bytes.size());
+    if (!done)
+        fprintf(stderr, "%u ms: '%s' ignored, not connected or no GATT service yet\n", action.time,
+                action.verb.c_str());
+}
+
+// message of a notification, packed ones hold several
+struct Message
+{
+    uint8_t type;
+    uint8_t tag;
+    const uint8_t *data;
+    size_t len;
+};
+
+void unpack(const SimRuntime::Notification &n, std::vector<Message> &messages)
+{
+    messages.clear();
+    const std::vector<uint8_t> &b = n.bytes;
+    if (b.size() < 2)
+        return;
+    if (b[0] != TX_PACKED_TYPE)
+    {
+        Message m = {b[0], b[1], b.data() + 2, b.size() - 2};
+        messages.push_back(m);
+        return;
+    }
+    size_t pos = TX_PACKED_HEADER;
+    for (size_t i = 0; i < b[1] && pos + TX_PACKED_ENTRY_HEADER <= b.size(); i++)
+    {
+        size_t len = b[pos];
+        if (pos + TX_PACKED_ENTRY_HEADER + len > b.size())
+            break;
+        Message m = {b[pos + 1], b[pos + 2], b.data() + pos + TX_PACKED_ENTRY_HEADER, len};
+        messages.push_back(m);
+        pos += TX_PACKED_ENTRY_HEADER + len;
+    }
+}
+
+void printScore(const ImuTrace &trace, const DetectionScore &score)
+{
+    size_t expected[EVENT_KIND_COUNT] = {0};
+    for (size_t i = 0; i < trace.labels.size(); i++)
+        expected[trace.labels[i].kind]++;
+    printf("  events: good %zu, high %zu, other %zu", score.kinds[GOOD_STEP], score.kinds[HIGH_STEP],
+           score.kinds[OTHER_FOOTWORK]);
+    if (!trace.labels.empty())
+        printf(" (labeled: good %zu, high %zu, other %zu)", expected[GOOD_STEP], expected[HIGH_STEP],
+               expected[OTHER_FOOTWORK]);
+    printf("\n");
+    if (score.matched)
+        printf("  airtime error: %.1f ms mean over %zu matched landings\n", score.meanAirtimeError(), score.matched);
+}
+
+#if PERF_STATS
+void printPath(const char *name, const LatencyHistogram &h)
+{
+    if (!h.count())
+        return;
+    printf("  %-14s %7u calls, p50 < %u ns, p99 < %u ns, max %u ns\n", name, h.count(), h.quantile(0.5f) + 1,
+           h.quantile(0.99f) + 1, h.max());
+}
+#endif
+
+void printSummary(const SessionSummary &s)
+{
+    printf("  summary after %u s: good %u, high %u, other %u, shuffle %u, crossover %u, lunge %u\n", s.elapsed,
+           s.counts[0], s.counts[1], s.counts[2], s.counts[3], s.counts[4], s.counts[5]);
+    printf("    last %zu split steps: %u ms airtime, %u%% good; streak %u, best %u, worst %u; %u ms between steps\n",
+           ROLLING_STEPS, s.rollingAirtime, s.rollingGood, s.streak, s.bestStreak, s.worstStreak, s.meanInterval);
+    printf("    airtime per %u ms:", SUMMARY_AIRTIME_BIN_MS);
+    for (size_t i = 0; i < SUMMARY_AIRTIME_BINS; i++)
+        printf(" %u", s.airtime[i]);
+    printf("\n    intervals per %u ms:", SUMMARY_INTERVAL_BIN_MS);
+    for (size_t i = 0; i < SUMMARY_INTERVAL_BINS; i++)
+        printf(" %u", s.intervals[i]);
+    printf("\n    workload %u, heart rate %u bpm, load %u score-min\n", s.workload, s.heartRate, s.load);
+}
+
+uint32_t get32(const uint8_t in[])
+{
+    return in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// the records of a logbook download, from the first one received
+void printLogbook(uint32_t first, const std::vector<uint8_t> &bytes, uint32_t begin, uint32_t end)
+{
+    size_t records = 0, events = 0, sessions = 0, pos = 0;
+    while (pos + LOG_RECORD_HEADER <= bytes.size())
+    {
+        size_t len = bytes[pos + 1] | bytes[pos + 2] << 8;
+        if (pos + LOG_RECORD_HEADER + len > bytes.size())
+            break;
+        records++;
+        events += bytes[pos] == LOG_EVENT;
+        sessions += bytes[pos] == LOG_SESSION;
+        pos += LOG_RECORD_HEADER + len;
+    }
+    printf("  logbook: kept %u to %u, downloaded %zu bytes from %u: %zu records, %zu events, %zu sessions\n", begin,
+           end, bytes.size(), first, records, events, sessions);
+}
+
+void printLatency(const char *name, const LatencyHistogram &h, double ticksPerMs)
+{
+    if (!h.count())
+        return;
+    // the bucket bounds are powers of two, no use going past the maximum
+    uint32_t p50 = std::min(h.quantile(0.5f) + 1, h.max());
+    uint32_t p99 = std::min(h.quantile(0.99f) + 1, h.max());
+    printf("  %s: p50 <= %.1f ms, p99 <= %.1f ms, max %.1f ms (%u)\n", name, p50 / ticksPerMs, p99 / ticksPerMs,
+           h.max() / ticksPerMs, h.count());
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: appSim [--script FILE] [--synth SECONDS] [--rate HZ] [--seed N]\n"
+                    "              [--hr FILE] [--link-us N] [--notifications] [trace.csv ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t synthSeconds = 600;
+    uint32_t rate = 208;
+    uint32_t seed = 1;
+    uint32_t linkLatency = 7500;
+    const char *scriptPath = nullptr;
+    const char *hrPath = nullptr;
+    bool printNotifications = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--script" && hasValue)
+            scriptPath = argv[++i];
+        else if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--hr" && hasValue)
+            hrPath = argv[++i];
+        else if (arg == "--link-us" && hasValue)
+            linkLatency = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--notifications")
+            printNotifications = true;
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+    if (paths.size() > 1 || (paths.empty() && synthSeconds == 0))
+        usage();
+
+    std::vector<ImuTrace> corpus(1);
+    if (!paths.empty())
+    {
+        if (!loadCorpus(paths, corpus))
+            return 1;
+    }
+    else
+        synthesizeTrace(corpus[0], rate, synthSeconds, seed);
+    const ImuTrace &trace = corpus[0];
+    if (trace.sampleCount() == 0)
+    {
+        fprintf(stderr, "%s: no samples\n", trace.name.c_str());
+        return 1;
+    }
+    const uint32_t traceStart = trace.timestamps[0];
+    const uint32_t traceMs = trace.timestamps.back() - traceStart;
+
+    std::vector<ScriptAction> script;
+    if (scriptPath)
+    {
+        if (!loadScript(scriptPath, traceMs, script))
+            return 1;
+    }
+    else
+    {
+        for (size_t i = 0; i < sizeof(DEFAULT_SCRIPT) / sizeof(DEFAULT_SCRIPT[0]); i++)
+        {
+            ScriptAction action;
+            parseAction(DEFAULT_SCRIPT[i], (int)i + 1, traceMs, action);
+            script.push_back(action);
+        }
+    }
+
+    HrTrace hr;
+    if (hrPath)
+    {
+        if (!loadHrTrace(hrPath, hr))
+            return 1;
+    }
+    else
+        synthesizeHrTrace(trace, seed, hr);
+
+    SimRuntime &sim = SimRuntime::instance();
+    sim.setLinkLatency(linkLatency);
+    sim.setImuSource(traceView(trace));
+    sim.setHrSource(&hr);
+
+    static myApp app;
+    wb::LaunchableModule &module = app;
+    if (!sim.launch(module))
+    {
+        fprintf(stderr, "%s did not start\n", module.name());
+        return 1;
+    }
+    uint32_t endMs = traceMs;
+    for (size_t i = 0; i < script.size(); i++)
+    {
+        const ScriptAction &action = script[i];
+        sim.at((uint64_t)action.time * 1000, [action]() { runAction(action); });
+        endMs = std::max(endMs, action.time);
+    }
+    endMs += DRAIN_MS;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    sim.runUntil((uint64_t)endMs * 1000);
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s: %zu samples at %u Hz, %zu labels\n", trace.name.c_str(), trace.sampleCount(), trace.sampleRate,
+           trace.labels.size());
+    printf("  simulated %.1f s in %.1f ms (%.0fx real time), %zu IMU batches, %.0f batches/s\n", endMs / 1000.0,
+           wallMs, endMs / wallMs, sim.imuBatches(), sim.imuBatches() / (wallMs / 1000.0));
+    if (sim.hrNotifications())
+        printf("  %zu HR notifications from %s\n", sim.hrNotifications(), hr.name.c_str());
+
+    // what the central received
+    const std::vector<SimRuntime::Notification> &notifications = sim.notifications();
+    size_t bytes = 0;
+    size_t messageCount[256] = {0};
+    DetectionScore score;
+    LatencyHistogram eventLatency; // landing to notification, us
+    LatencyHistogram landingLatency; // landing to LANDING notification, us
+    std::vector<Message> messages;
+    SessionSummary summary;
+    bool haveSummary = false;
+    ClockSync clockSync;
+    bool haveLog = false;
+    uint32_t logBegin = 0, logEnd = 0, logFirst = 0;
+    std::vector<uint8_t> logBytes; // the download, contiguous from logFirst
+    size_t syncReplies = 0;
+    for (size_t i = 0; i < notifications.size(); i++)
+    {
+        const SimRuntime::Notification &n = notifications[i];
+        bytes += n.bytes.size();
+        unpack(n, messages);
+        if (printNotifications)
+        {
+            printf("  %8.1f ms:", n.time / 1000.0);
+            for (size_t j = 0; j < n.bytes.size(); j++)
+                printf(" %02x", n.bytes[j]);
+            printf("\n");
+        }
+        for (size_t m = 0; m < messages.size(); m++)
+        {
+            messageCount[messages[m].type]++;
+            if (messages[m].type == LANDING_TYPE && messages[m].len >= 5)
+            {
+                const uint8_t *d = messages[m].data;
+                uint64_t landing = (uint64_t)(d[1] | d[2] << 8 | d[3] << 16 | (uint32_t)d[4] << 24) * 1000;
+                landingLatency.add((uint32_t)(n.time > landing ? n.time - landing : 0));
+            }
+            if (messages[m].type == SUMMARY_TYPE && decodeSessionSummary(messages[m].data, messages[m].len, summary))
+                haveSummary = true;
+            if (messages[m].type == LOG_INFO_TYPE && messages[m].len >= 8)
+            {
+                haveLog = true;
+                logBegin = get32(messages[m].data);
+                logEnd = get32(messages[m].data + 4);
+            }
+            if (messages[m].type == LOG_DATA_TYPE && messages[m].len >= 4)
+            {
+                uint32_t offset = get32(messages[m].data);
+                // a new download, or a gap seek() skipped
+                if (logBytes.empty() || offset != logFirst + logBytes.size())
+                {
+                    logBytes.clear();
+                    logFirst = offset;
+                }
+                logBytes.insert(logBytes.end(), messages[m].data + 4, messages[m].data + messages[m].len);
+            }
+            if (messages[m].type == TIME_TYPE && messages[m].len == TIME_DATA_SIZE)
+            {
+                const uint8_t *d = messages[m].data;
+                clockSync.add(get32(d), get32(d + 4), n.time / 1000.0);
+                syncReplies++;
+            }
+            if (messages[m].type != EVENTS_TYPE)
+                continue;
+            EventRecord records[32];
+            size_t count;
+            if (!decodeEvents(messages[m].data, messages[m].len, records, 32, count))
+                continue;
+            for (size_t r = 0; r < count; r++)
+            {
+                SplitStepEvent e;
+                e.kind = (SplitStepEventKind)records[r].kind;
+                e.endTime = traceStart + records[r].timestamp;
+                e.beginTime = e.endTime - records[r].airtime;
+                e.maxZGyro = records[r].maxGyro;
+                e.accMagnitude = 0;
+                score.add(trace, e);
+                uint64_t landing = (uint64_t)records[r].timestamp * 1000;
+                eventLatency.add((uint32_t)(n.time > landing ? n.time - landing : 0));
+            }
+        }
+    }
+    printf("  %zu notifications, %zu bytes (%.0f B/s)\n", notifications.size(), bytes, bytes / (endMs / 1000.0));
+    printf("  messages by type:");
+    for (size_t t = 0; t < 256; t++)
+        if (messageCount[t])
+            printf(" %zu: %zu", t, messageCount[t]);
+    printf("\n");
+    printScore(trace, score);
+    if (haveSummary)
+        printSummary(summary);
+    if (haveLog)
+        printLogbook(logFirst, logBytes, logBegin, logEnd);
+    if (clockSync.valid())
+        printf("  clock sync: %zu replies, device %+.1f ms from the client, drift %+.1f ppm, +-%.1f ms\n",
+               syncReplies, -clockSync.offset(), clockSync.driftPpm(), clockSync.uncertainty());
+    printLatency("landing to EVENTS", eventLatency, 1000);
+    printLatency("landing to LANDING", landingLatency, 1000);
+#if PERF_STATS
+    // the wait for the batch in simulated time, then processData up to the LED on the host
+    printLatency("landing to LED", perfStats().paths[PERF_FEEDBACK], PERF_TICK_HZ / 1000.0);
+#endif
+    printf("  led changes: %zu\n", sim.ledChanges().size());
+
+#if PERF_STATS
+    // host time spent in the app, per path
+    const PerfStats &stats = perfStats();
+    printf("  app cpu time:\n");
+    printPath("processData", stats.paths[PERF_PROCESS_DATA]);
+    printPath("handleCommand", stats.paths[PERF_HANDLE_COMMAND]);
+    printPath("send", stats.paths[PERF_SEND]);
+    printf("  tx drops %u, tx high water %u, subscribes %u, unsubscribes %u\n", stats.counters[PERF_TX_DROPS],
+           stats.counters[PERF_TX_HIGH_WATER], stats.counters[PERF_SUBSCRIBES], stats.counters[PERF_UNSUBSCRIBES]);
+#endif
+    return 0;
+}
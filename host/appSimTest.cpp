@@ -0,0 +1,122 @@
+// Checks the whole app in the stand-in Whiteboard runtime (host/sim, as
+// appSim) on the link going away under a running session. With periodic
+// summaries the analyses outlive a disconnect: while there is no link the
+// app must not put notifications the stack can only refuse, and a client
+// that connects and turns notifications on again gets the summaries. Run
+// by ctest.
+//
+// usage: appSimTest
+#include <stdio.h>
+#include <vector>
+#include "TxQueue.h"
+#include "imuTrace.h"
+#include "myApp.h"
+#include "simRuntime.h"
+
+namespace
+{
+const uint64_t SETTLE_US = 10000;
+const uint8_t SUMMARY_TYPE = 10; // Responses::SUMMARY_DATA of interface.cpp
+
+size_t gFailures = 0;
+
+void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        gFailures++;
+        fprintf(stderr, "failed: %s\n", what);
+    }
+}
+
+void write(const std::vector<uint8_t> &command)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    if (!sim.writeCommand(command.data(), command.size()))
+        fprintf(stderr, "write of %zu bytes ignored\n", command.size());
+    sim.runUntil(sim.now() + SETTLE_US);
+}
+
+void connect()
+{
+    SimRuntime &sim = SimRuntime::instance();
+    sim.connect();
+    sim.runUntil(sim.now() + SETTLE_US);
+    sim.setNotifications(true);
+    sim.runUntil(sim.now() + SETTLE_US);
+}
+
+// whether a notification from first on carries a SUMMARY_DATA, on its own or packed
+bool summarySince(size_t first)
+{
+    const std::vector<SimRuntime::Notification> &notifications = SimRuntime::instance().notifications();
+    for (size_t i = first; i < notifications.size(); i++)
+    {
+        const std::vector<uint8_t> &bytes = notifications[i].bytes;
+        if (bytes.size() < TX_PACKED_HEADER)
+            continue;
+        if (bytes[0] == SUMMARY_TYPE)
+            return true;
+        if (bytes[0] != TX_PACKED_TYPE)
+            continue;
+        for (size_t pos = TX_PACKED_HEADER; pos + TX_PACKED_ENTRY_HEADER <= bytes.size();
+             pos += TX_PACKED_ENTRY_HEADER + bytes[pos])
+            if (bytes[pos + 1] == SUMMARY_TYPE)
+                return true;
+    }
+    return false;
+}
+
+void testDisconnected()
+{
+    SimRuntime &sim = SimRuntime::instance();
+    connect();
+    write({0x0d, 0x01, 0x00}); // SUMMARY every second
+    write({0x01}); // BEGIN_SUB, default analysis
+    sim.runUntil(sim.now() + 3000000);
+    check(summarySince(0), "summaries while connected");
+    check(sim.refusedNotifications() == 0, "no refused notifications while connected");
+
+    sim.disconnect();
+    const size_t batches = sim.imuBatches();
+    sim.runUntil(sim.now() + 20000000);
+    check(sim.imuBatches() > batches, "the analysis runs on without the link");
+    if (sim.refusedNotifications())
+        fprintf(stderr, "%zu notifications put on a dead link\n", sim.refusedNotifications());
+    check(sim.refusedNotifications() == 0, "nothing is put while disconnected");
+
+    // notifications are off on a new link until the client turns them on
+    sim.connect();
+    sim.runUntil(sim.now() + 3000000);
+    check(sim.refusedNotifications() == 0, "nothing is put before notifications are on");
+    const size_t first = sim.notifications().size();
+    sim.setNotifications(true);
+    sim.runUntil(sim.now() + 3000000);
+    check(summarySince(first), "summaries again once notifications are on");
+}
+}
+
+int main()
+{
+    ImuTrace trace;
+    synthesizeTrace(trace, 104, 60, 1);
+    SimRuntime &sim = SimRuntime::instance();
+    sim.setImuSource(traceView(trace));
+    static myApp app;
+    wb::LaunchableModule &module = app;
+    if (!sim.launch(module))
+    {
+        fprintf(stderr, "%s did not start\n", module.name());
+        return 1;
+    }
+
+    testDisconnected();
+
+    if (gFailures)
+    {
+        fprintf(stderr, "%zu checks failed\n", gFailures);
+        return 1;
+    }
+    printf("app checks passed\n");
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Measures the attitude filter (AttitudeFilter.h): its cost per sample next
+// to the sample period at 104 Hz, and what leveling the samples does to
+// detection when the pod is worn at an angle. Every trace is replayed as
+// recorded and turned by a few mountings, with the detector on the sensor
+// axes and on the leveled ones.
+//
+// usage: attitudeBench [--synth SECONDS] [--iterations N] [trace ...]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "AttitudeFilter.h"
+#include "imuTrace.h"
+
+namespace
+{
+const uint32_t BUDGET_RATE = 104; // Hz the budget is given at
+
+struct Mounting
+{
+    const char *name;
+    float roll; // degrees about x, then
+    float pitch; // about y
+};
+
+const Mounting MOUNTINGS[] = {
+    {"upright", 0, 0},
+    {"pitch 20", 0, 20},
+    {"roll 35", 35, 0},
+    {"roll 30 pitch 30", 30, 30},
+    {"on its side", 90, 0},
+    {"upside down", 180, 0},
+};
+
+Vec3f rotate(const float m[3][3], const Vec3f &v)
+{
+    Vec3f out;
+    out.x = m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z;
+    out.y = m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z;
+    out.z = m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z;
+    return out;
+}
+
+// the trace as a sensor worn at that angle would have recorded it
+void mountTrace(const ImuTrace &trace, const Mounting &mounting, ImuTrace &out)
+{
+    const float deg = 3.14159265f / 180;
+    float cr = cosf(mounting.roll * deg), sr = sinf(mounting.roll * deg);
+    float cp = cosf(mounting.pitch * deg), sp = sinf(mounting.pitch * deg);
+    // sensor axes from body axes, (Ry * Rx) transposed
+    const float m[3][3] = {
+        {cp, 0, -sp},
+        {sr * sp, cr, sr * cp},
+        {cr * sp, -sr, cr * cp},
+    };
+    out = trace;
+    out.name = trace.name + " " + mounting.name;
+    for (size_t i = 0; i < out.sampleCount(); i++)
+    {
+        out.acc[i] = rotate(m, trace.acc[i]);
+        out.gyro[i] = rotate(m, trace.gyro[i]);
+    }
+}
+
+struct Result
+{
+    DetectionScore score;
+    size_t correct; // landings matched to a label of the same kind
+    size_t labels;
+
+    Result() : correct(0), labels(0) {}
+};
+
+Result replay(const ImuTrace &trace, bool level)
+{
+    Result result;
+    result.labels = trace.labels.size();
+    SplitStepDetector detector;
+    detector.setSampleRate(trace.sampleRate);
+    AttitudeFilter attitude;
+    attitude.setSampleRate(trace.sampleRate);
+    Vec3f acc[LEVEL_MAX_SAMPLES], gyro[LEVEL_MAX_SAMPLES];
+    SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        ImuBatch batch = trace.batch(b);
+        if (level)
+            batch = attitude.levelBatch(batch, acc, gyro, LEVEL_MAX_SAMPLES);
+        size_t n = detector.process(batch, events, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+        for (size_t i = 0; i < n; i++)
+        {
+            result.score.add(trace, events[i]);
+            const TraceLabel *label = events[i].kind != ZERO_G_BEGIN ? matchLabel(trace, events[i]) : nullptr;
+            if (label && label->kind == events[i].kind)
+                result.correct++;
+        }
+    }
+    return result;
+}
+
+void printResult(const char *name, const Result &r)
+{
+    printf("    %-8s good %3zu, high %3zu, other %3zu, %5.1f%% right, airtime error %.1f ms\n", name,
+           r.score.kinds[GOOD_STEP], r.score.kinds[HIGH_STEP], r.score.kinds[OTHER_FOOTWORK],
+           r.labels ? 100.0 * r.correct / r.labels : 0, r.score.meanAirtimeError());
+}
+
+volatile float gSink;
+
+// ns per sample of update() and level() of acc and gyro
+double timeFilter(const ImuTrace &trace, size_t iterations)
+{
+    AttitudeFilter attitude;
+    attitude.setSampleRate(trace.sampleRate);
+    float sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < iterations; it++)
+        for (size_t i = 0; i < trace.sampleCount(); i++)
+        {
+            attitude.update(trace.acc[i], trace.gyro[i]);
+            sink += attitude.level(trace.acc[i]).z + attitude.level(trace.gyro[i]).z;
+        }
+    gSink = sink;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (iterations * trace.sampleCount());
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t synthSeconds = 600;
+    size_t iterations = 20;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            iterations = (size_t)atol(argv[++i]);
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "usage: attitudeBench [--synth SECONDS] [--iterations N] [trace ...]\n");
+            return 2;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    std::vector<ImuTrace> corpus;
+    if (paths.empty())
+    {
+        const uint32_t rates[] = {52, 104, 208};
+        corpus.resize(3);
+        for (size_t r = 0; r < 3; r++)
+            synthesizeTrace(corpus[r], rates[r], synthSeconds, 1 + (uint32_t)r);
+    }
+    else if (!loadCorpus(paths, corpus))
+        return 1;
+
+    double ns = timeFilter(corpus[0], iterations);
+    printf("filter and leveling: %.1f ns per sample (%.4f%% of the sample period at %u Hz)\n", ns,
+           100 * ns * BUDGET_RATE / 1e9, BUDGET_RATE);
+
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        printf("%s: %zu labels\n", corpus[t].name.c_str(), corpus[t].labels.size());
+        for (size_t m = 0; m < sizeof(MOUNTINGS) / sizeof(MOUNTINGS[0]); m++)
+        {
+            ImuTrace mounted;
+            mountTrace(corpus[t], MOUNTINGS[m], mounted);
+            printf("  %s\n", MOUNTINGS[m].name);
+            printResult("sensor", replay(mounted, false));
+            printResult("leveled", replay(mounted, true));
+        }
+    }
+    return 0;
+}
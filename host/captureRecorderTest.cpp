@@ -0,0 +1,100 @@
+// Checks the window the capture recorder (CaptureRecorder.h) freezes around
+// a trigger: it is frozen once the post-trigger samples have arrived and
+// holds exactly the samples in [T - CAPTURE_PRE_MS, T + CAPTURE_POST_MS],
+// early in the uptime, with the trigger just below the wrap of the uint32
+// timestamps and with the wrap inside the window. Run by ctest.
+//
+// usage: captureRecorderTest
+#include <stdio.h>
+#include <string.h>
+#include "CaptureRecorder.h"
+
+namespace
+{
+const size_t BATCH_SAMPLES = 8;
+const uint32_t RATE = 104;
+
+size_t gFailures = 0;
+
+void check(bool ok, const char *what, uint32_t triggerTime)
+{
+    if (!ok && gFailures++ < 20)
+        fprintf(stderr, "failed: %s, trigger at %u\n", what, triggerTime);
+}
+
+// records batches from start on until the capture freezes, then reads it back
+void testWindow(uint32_t start, uint32_t triggerTime)
+{
+    const float samplePeriod = 1000.0f / RATE;
+    Vec3f acc[BATCH_SAMPLES], gyro[BATCH_SAMPLES];
+    memset(acc, 0, sizeof(acc));
+    memset(gyro, 0, sizeof(gyro));
+    ImuBatch batch;
+    batch.acc = acc;
+    batch.accCount = BATCH_SAMPLES;
+    batch.gyro = gyro;
+    batch.gyroCount = BATCH_SAMPLES;
+
+    CaptureRecorder recorder;
+    bool triggered = false;
+    // a second of batches is more than enough to complete the window
+    for (uint32_t n = 0; n < RATE / BATCH_SAMPLES && recorder.state() != CaptureRecorder::UPLOADING; n++)
+    {
+        batch.timestamp = start + (uint32_t)(n * BATCH_SAMPLES * samplePeriod + 0.5f);
+        recorder.record(batch, samplePeriod);
+        // the app triggers on the batch a landing is detected in
+        if (!triggered && (int32_t)(recorder.latestTime() - triggerTime) >= 0)
+        {
+            check(recorder.trigger(triggerTime), "the trigger is taken", triggerTime);
+            triggered = true;
+        }
+        const int32_t past = (int32_t)(recorder.latestTime() - triggerTime);
+        if (triggered && past < (int32_t)CAPTURE_POST_MS)
+            check(recorder.state() == CaptureRecorder::COLLECTING, "collecting until the window is complete",
+                  triggerTime);
+    }
+    check(recorder.state() == CaptureRecorder::UPLOADING, "the capture is frozen", triggerTime);
+
+    // the whole capture fits in one large chunk
+    uint8_t out[CAPTURE_HEADER_SIZE + CAPTURE_SAMPLES * CAPTURE_SAMPLE_SIZE];
+    const size_t size = recorder.chunk(out, sizeof(out));
+    const size_t count = out[3] | out[4] << 8;
+    check(size == CAPTURE_HEADER_SIZE + count * CAPTURE_SAMPLE_SIZE, "one chunk holds the capture", triggerTime);
+    // the window at 104 Hz, give or take the sample on either edge, less
+    // before the trigger if the recording started later than CAPTURE_PRE_MS before it
+    const uint32_t recorded = triggerTime - start;
+    const uint32_t pre = recorded < CAPTURE_PRE_MS ? recorded : CAPTURE_PRE_MS;
+    const size_t expected = (pre + CAPTURE_POST_MS) * RATE / 1000;
+    check(count + 1 >= expected && count <= expected + 1, "the capture covers the window", triggerTime);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *s = &out[CAPTURE_HEADER_SIZE + i * CAPTURE_SAMPLE_SIZE];
+        const uint32_t timestamp = s[0] | s[1] << 8 | s[2] << 16 | (uint32_t)s[3] << 24;
+        const int32_t offset = (int32_t)(timestamp - triggerTime);
+        check(offset >= -(int32_t)CAPTURE_PRE_MS && offset <= (int32_t)CAPTURE_POST_MS,
+              "every sample is in the window", triggerTime);
+        check(i == 0 || (int32_t)(timestamp - previous) > 0, "the samples are in order", triggerTime);
+        previous = timestamp;
+    }
+}
+}
+
+int main()
+{
+    testWindow(1000, 1500);
+    // the post-trigger end of the window is past the wrap
+    testWindow(0xffffffffu - 800, 0xffffffffu - 100);
+    // the wrap is in the pre-trigger part
+    testWindow(0xffffffffu - 500, 150);
+    // a trigger less than CAPTURE_PRE_MS into the uptime keeps what there is
+    testWindow(0, 100);
+
+    if (gFailures)
+    {
+        fprintf(stderr, "%zu checks failed\n", gFailures);
+        return 1;
+    }
+    printf("capture recorder checks passed\n");
+    return 0;
+}
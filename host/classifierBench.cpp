@@ -0,0 +1,169 @@
+// Compares the shipped footwork classifier (FootworkModel.h) with the gyro
+// threshold rule it replaces, on sessions it wasn't trained on: how many
+// landings each gets right, and what one classification costs next to the
+// time budget of a batch at 104 Hz.
+//
+// usage: classifierBench [--synth SECONDS] [--iterations N] [trace ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "FootworkClassifier.h"
+#include "imuTrace.h"
+
+namespace
+{
+const uint32_t BUDGET_RATE = 104; // Hz the budget is given at
+const uint32_t FIRST_SEED = 101; // the trainer uses seeds from 1
+
+struct Confusion
+{
+    size_t splitAsSplit;
+    size_t splitAsOther;
+    size_t otherAsSplit;
+    size_t otherAsOther;
+
+    Confusion() : splitAsSplit(0), splitAsOther(0), otherAsSplit(0), otherAsOther(0) {}
+    void add(bool splitStep, bool predicted)
+    {
+        if (splitStep)
+            (predicted ? splitAsSplit : splitAsOther)++;
+        else
+            (predicted ? otherAsSplit : otherAsOther)++;
+    }
+    double accuracy() const
+    {
+        size_t n = splitAsSplit + splitAsOther + otherAsSplit + otherAsOther;
+        return n ? 100.0 * (splitAsSplit + otherAsOther) / n : 0;
+    }
+};
+
+void printConfusion(const char *name, const Confusion &c)
+{
+    printf("  %-16s %5.1f%%   split steps %zu ok / %zu missed, other footwork %zu ok / %zu taken for split steps\n",
+           name, c.accuracy(), c.splitAsSplit, c.splitAsOther, c.otherAsOther, c.otherAsSplit);
+}
+
+volatile int32_t gSink;
+
+template <typename F>
+double timeLandings(const std::vector<LabeledLanding> &landings, size_t iterations, F fn)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t it = 0; it < iterations; it++)
+        for (size_t i = 0; i < landings.size(); i++)
+            gSink = fn(landings[i].features);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (iterations * landings.size());
+}
+
+// the split step kinds of a replay with the classifier on or off
+DetectionScore replay(const std::vector<ImuTrace> &corpus, bool classifier)
+{
+    DetectionScore score;
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        SplitStepConfig config;
+        config.classifier = classifier;
+        SplitStepDetector detector(config);
+        detector.setSampleRate(corpus[t].sampleRate);
+        SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+        for (size_t b = 0; b < corpus[t].batchCount(); b++)
+        {
+            size_t n = detector.process(corpus[t].batch(b), events, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+            for (size_t i = 0; i < n; i++)
+                score.add(corpus[t], events[i]);
+        }
+    }
+    return score;
+}
+
+void printReplay(const char *name, const DetectionScore &score)
+{
+    printf("  %-16s good %zu, high %zu, other %zu\n", name, score.kinds[GOOD_STEP], score.kinds[HIGH_STEP],
+           score.kinds[OTHER_FOOTWORK]);
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t synthSeconds = 1200;
+    size_t iterations = 2000;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            iterations = (size_t)atol(argv[++i]);
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "usage: classifierBench [--synth SECONDS] [--iterations N] [trace ...]\n");
+            return 2;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    // held-out sessions: plain ones and ones with confusers, at every rate
+    std::vector<ImuTrace> corpus;
+    if (paths.empty())
+    {
+        const uint32_t rates[] = {52, 104, 208};
+        for (size_t r = 0; r < 3; r++)
+            for (int confusers = 0; confusers < 2; confusers++)
+            {
+                corpus.push_back(ImuTrace());
+                synthesizeTrace(corpus.back(), rates[r], synthSeconds, FIRST_SEED + (uint32_t)r, confusers != 0);
+            }
+    }
+    else if (!loadCorpus(paths, corpus))
+        return 1;
+
+    const QuantizedEnsemble &model = footworkModel();
+    printf("model: %zu trees of depth %zu, %zu bytes of tables\n", model.treeCount, TREE_DEPTH,
+           model.treeCount * sizeof(QuantizedTree) + LANDING_FEATURE_COUNT * sizeof(FeatureQuantizer));
+
+    std::vector<LabeledLanding> all;
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        std::vector<LabeledLanding> landings;
+        collectLandings(corpus[t], landings);
+        Confusion threshold, trees;
+        for (size_t i = 0; i < landings.size(); i++)
+        {
+            threshold.add(landings[i].splitStep, landings[i].thresholdKind != OTHER_FOOTWORK);
+            trees.add(landings[i].splitStep, isSplitStep(model, landings[i].features));
+        }
+        printf("%s: %zu landings\n", corpus[t].name.c_str(), landings.size());
+        printConfusion("threshold rule", threshold);
+        printConfusion("classifier", trees);
+        all.insert(all.end(), landings.begin(), landings.end());
+    }
+    if (all.empty())
+    {
+        fprintf(stderr, "no labeled landings\n");
+        return 1;
+    }
+
+    const float splitStepThreshold = SplitStepConfig().splitStepThreshold;
+    double thresholdNs = timeLandings(all, iterations, [&](const LandingFeatures &f) {
+        return (int32_t)(f.values[MAX_Z_GYRO_FEATURE] < splitStepThreshold);
+    });
+    double treesNs = timeLandings(all, iterations, [&](const LandingFeatures &f) {
+        return (int32_t)isSplitStep(model, f);
+    });
+    // one landing per batch at most, so one classification is the worst case per batch
+    const double budgetNs = 1e9 / 13;
+    printf("per landing: threshold rule %.1f ns, classifier %.1f ns (%.5f%% of the %.0f ms batch budget at %u Hz)\n",
+           thresholdNs, treesNs, 100 * treesNs / budgetNs, budgetNs / 1e6, BUDGET_RATE);
+
+    printf("replay of all sessions:\n");
+    printReplay("threshold rule", replay(corpus, false));
+    printReplay("classifier", replay(corpus, true));
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "clockSync.h"
+#include <algorithm>
+
+namespace
+{
+const double SLOW_TRIP_FACTOR = 1.5; // round trips slower than the fastest recent one by more are dropped
+const double SLOW_TRIP_MARGIN = 2; // ms, so jitter of a fast link doesn't drop everything
+const double MIN_DRIFT_SPAN = 20000; // ms of kept replies before the drift is fitted, the line is noise before
+}
+
+ClockSync::ClockSync(size_t window) : mWindow(window < 2 ? 2 : window)
+{
+    reset();
+}
+
+void ClockSync::reset()
+{
+    mPoints.clear();
+    mRecentTrips.clear();
+    mLastDevice = 0;
+    mBase = 0;
+    mRate = 1;
+}
+
+// device times are read close to the last sync, a signed difference unwraps them
+int64_t ClockSync::unwrap(uint32_t deviceTime) const
+{
+    if (mPoints.empty())
+        return deviceTime;
+    return mLastDevice + (int32_t)(deviceTime - (uint32_t)mLastDevice);
+}
+
+bool ClockSync::add(double clientSend, uint32_t deviceTime, double clientReceive)
+{
+    double roundTrip = clientReceive - clientSend;
+    if (roundTrip < 0)
+        return false;
+    mRecentTrips.push_back(roundTrip);
+    if (mRecentTrips.size() > mWindow)
+        mRecentTrips.erase(mRecentTrips.begin());
+    double fastest = *std::min_element(mRecentTrips.begin(), mRecentTrips.end());
+    double slow = fastest * SLOW_TRIP_FACTOR + SLOW_TRIP_MARGIN;
+    if (roundTrip > slow)
+        return false;
+    // kept before a faster link showed up, they'd pull the line
+    for (size_t i = mPoints.size(); i-- > 0;)
+        if (mPoints[i].roundTrip > slow)
+            mPoints.erase(mPoints.begin() + i);
+
+    Point p;
+    p.device = unwrap(deviceTime);
+    p.client = clientSend + roundTrip / 2;
+    p.roundTrip = roundTrip;
+    mPoints.push_back(p);
+    if (mPoints.size() > mWindow)
+        mPoints.erase(mPoints.begin());
+    fit();
+    return true;
+}
+
+void ClockSync::fit()
+{
+    const Point &last = mPoints.back();
+    mLastDevice = last.device;
+    // relative to the last point, the numbers stay small
+    double n = (double)mPoints.size();
+    double sx = 0, sy = 0;
+    for (size_t i = 0; i < mPoints.size(); i++)
+    {
+        sx += (double)(mPoints[i].device - last.device);
+        sy += mPoints[i].client - last.client;
+    }
+    double mx = sx / n, my = sy / n;
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < mPoints.size(); i++)
+    {
+        double dx = (double)(mPoints[i].device - last.device) - mx;
+        double dy = mPoints[i].client - last.client - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    // a line needs the points spread over time, until then the clocks run alike
+    double span = (double)(last.device - mPoints.front().device);
+    mRate = sxx > 0 && span >= MIN_DRIFT_SPAN ? sxy / sxx : 1;
+    mBase = last.client + my - mRate * mx;
+}
+
+double ClockSync::toClient(uint32_t deviceTime) const
+{
+    if (mPoints.empty())
+        return deviceTime;
+    return mBase + mRate * (double)(unwrap(deviceTime) - mLastDevice);
+}
+
+double ClockSync::offset() const
+{
+    return mPoints.empty() ? 0 : mBase - (double)mLastDevice;
+}
+
+double ClockSync::uncertainty() const
+{
+    double fastest = 0;
+    for (size_t i = 0; i < mPoints.size(); i++)
+        fastest = i == 0 || mPoints[i].roundTrip < fastest ? mPoints[i].roundTrip : fastest;
+    return fastest / 2;
+}
@@ -0,0 +1,56 @@
+#pragma once
+// Maps the clock of one sensor to the client's, from TIME_SYNC round trips
+// (TimeSync.h). A reply carries the device time of some instant between
+// sending the request and receiving the reply, so the midpoint of the two is
+// the estimate, off by at most half the round trip. Round trips much slower
+// than the fastest recent one were held up on the way and are dropped; a
+// least-squares line through the kept ones of the last window gives offset and
+// drift, so the mapping follows the drift as long as the client keeps syncing.
+// Until the kept replies span 20 s the clocks are taken to run alike, a line
+// through a few close points would extrapolate their noise.
+//
+// Client times are ms on any clock of the client; device times are the
+// sensor's uint32 ms and may wrap.
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class ClockSync
+{
+public:
+    // window: round trips the line is fitted through
+    explicit ClockSync(size_t window = 32);
+
+    void reset();
+
+    // One TIME_DATA reply. Returns whether it was used.
+    bool add(double clientSend, uint32_t deviceTime, double clientReceive);
+
+    // whether a reply was used yet, before that toClient() returns device time
+    bool valid() const { return !mPoints.empty(); }
+    double toClient(uint32_t deviceTime) const;
+    // client minus device time (ms) at the last sync
+    double offset() const;
+    // how much faster the device clock runs, ppm
+    double driftPpm() const { return (1 / mRate - 1) * 1e6; }
+    // half the fastest round trip of the window, the bound of a single estimate
+    double uncertainty() const;
+
+private:
+    struct Point
+    {
+        int64_t device; // unwrapped
+        double client; // midpoint of the round trip
+        double roundTrip;
+    };
+
+    int64_t unwrap(uint32_t deviceTime) const;
+    void fit();
+
+    size_t mWindow;
+    std::vector<Point> mPoints; // kept replies, oldest first
+    std::vector<double> mRecentTrips; // of the last replies, kept or not
+    int64_t mLastDevice; // unwrapped device time of the last kept reply
+    double mBase; // client time at mLastDevice
+    double mRate; // client ms per device ms
+};
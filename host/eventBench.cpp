@@ -0,0 +1,168 @@
+// Round-trip check and throughput of the binary event protocol
+// (EventCodec.h), and how many events per second fit the link compared with
+// the text results, for a few payload sizes and connection intervals.
+//
+// usage: eventBench [--events N] [--per-interval N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "EventCodec.h"
+#include "SplitStepDetector.h"
+#include "TxQueue.h"
+
+namespace
+{
+uint32_t gSeed = 12345;
+
+uint32_t nextRandom()
+{
+    gSeed ^= gSeed << 13;
+    gSeed ^= gSeed >> 17;
+    gSeed ^= gSeed << 5;
+    return gSeed;
+}
+
+EventRecord randomRecord(uint16_t sequence)
+{
+    EventRecord r;
+    r.kind = (uint8_t) (GOOD_STEP + nextRandom() % 3);
+    r.sequence = sequence;
+    r.timestamp = nextRandom();
+    r.airtime = (uint16_t) nextRandom();
+    r.maxGyro = (uint16_t) nextRandom();
+    return r;
+}
+
+bool sameRecord(const EventRecord &a, const EventRecord &b)
+{
+    return a.kind == b.kind && a.sequence == b.sequence && a.timestamp == b.timestamp && a.airtime == b.airtime &&
+           a.maxGyro == b.maxGyro;
+}
+
+// packs all records into payloads of the given size and decodes them again
+bool roundTrip(const std::vector<EventRecord> &records, size_t payloadSize)
+{
+    std::vector<uint8_t> payload(payloadSize);
+    EventRecord decoded[255];
+    size_t next = 0;
+    while (next < records.size())
+    {
+        EventPacker packer(&payload[0], payloadSize);
+        size_t first = next;
+        while (next < records.size() && packer.add(records[next]))
+            next++;
+        size_t count;
+        if (first == next || !decodeEvents(&payload[0], packer.length(), decoded, 255, count) ||
+            count != next - first)
+            return false;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!sameRecord(decoded[i], records[first + i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool rejectsMalformed()
+{
+    uint8_t payload[64];
+    EventPacker packer(payload, sizeof(payload));
+    packer.add(randomRecord(0));
+    packer.add(randomRecord(1));
+    EventRecord out[4];
+    size_t count;
+    if (!decodeEvents(payload, packer.length(), out, 4, count) || count != 2)
+        return false;
+    if (decodeEvents(payload, packer.length() - 1, out, 4, count))
+        return false;
+    payload[0] = EVENT_PROTOCOL_VERSION + 1;
+    return !decodeEvents(payload, packer.length(), out, 4, count);
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t eventCount = 1000000;
+    size_t perInterval = 4; // notifications the link sends per connection interval
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+            eventCount = (size_t) atol(argv[++i]);
+        else if (strcmp(argv[i], "--per-interval") == 0 && i + 1 < argc)
+            perInterval = (size_t) atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: eventBench [--events N] [--per-interval N]\n");
+            return 2;
+        }
+    }
+
+    std::vector<EventRecord> records(eventCount);
+    for (size_t i = 0; i < eventCount; i++)
+        records[i] = randomRecord((uint16_t) i);
+
+    const size_t payloadSizes[] = {20, TxQueue::DEFAULT_PAYLOAD, TxQueue::MAX_PAYLOAD};
+    for (size_t p = 0; p < 3; p++)
+    {
+        if (!roundTrip(records, payloadSizes[p] - 2))
+        {
+            fprintf(stderr, "round trip failed for %zu byte payloads\n", payloadSizes[p]);
+            return 1;
+        }
+    }
+    if (!rejectsMalformed())
+    {
+        fprintf(stderr, "malformed payload was accepted\n");
+        return 1;
+    }
+    printf("round trip ok for %zu events\n", eventCount);
+
+    // encode and decode cost
+    uint8_t payload[TxQueue::MAX_PAYLOAD];
+    size_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EventPacker packer(payload, sizeof(payload) - 2);
+    for (size_t i = 0; i < eventCount; i++)
+    {
+        if (!packer.add(records[i]))
+        {
+            sink += packer.length();
+            packer.clear();
+            packer.add(records[i]);
+        }
+    }
+    double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    EventRecord r;
+    for (size_t i = 0; i < eventCount; i++)
+    {
+        encodeEventRecord(records[i], payload);
+        decodeEventRecord(payload, r);
+        sink += r.airtime;
+    }
+    double roundNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("pack %.1f ns/event, encode+decode %.1f ns/event (%zu)\n", encodeNs / eventCount, roundNs / eventCount,
+           sink & 1);
+
+    // link capacity: text sends one result string per notification
+    const size_t textSize = 2 + sizeof("You jumped too high for your split step");
+    const double intervals[] = {7.5, 15, 30, 50};
+    printf("\nevents/s with %zu notifications per connection interval (text result is %zu bytes)\n", perInterval,
+           textSize);
+    printf("%-9s %-8s %10s %10s %8s\n", "payload", "interval", "text", "binary", "per ntf");
+    for (size_t p = 0; p < 3; p++)
+    {
+        size_t perNotification = EventPacker::capacity(payloadSizes[p] - 2);
+        for (size_t c = 0; c < 4; c++)
+        {
+            double notificationsPerSecond = perInterval * 1000.0 / intervals[c];
+            double text = textSize <= payloadSizes[p] ? notificationsPerSecond : 0;
+            printf("%-9zu %-8.1f %10.0f %10.0f %8zu\n", payloadSizes[p], intervals[c], text,
+                   notificationsPerSecond * perNotification, perNotification);
+        }
+    }
+    return 0;
+}
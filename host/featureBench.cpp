@@ -0,0 +1,159 @@
+// Micro-benchmark of the per-batch feature computation: the original
+// processData loops (sqrt per sample, samples copied by value) against the
+// AoS and SoA kernels in ImuFeatures.h, and the AoS kernel in fixed point
+// (FixedMath, FixedPoint.h), for a range of batch sizes.
+//
+// usage: featureBench [--batches N]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "ImuFeatures.h"
+#include "imuTrace.h"
+
+namespace
+{
+struct LegacyFeatures
+{
+    float averageAccMagnitude;
+    float averageZAcc;
+    float averageZGyro;
+};
+
+// the loops processData used before the feature kernel
+void legacyFeatures(const Vec3f *acc, size_t accCount, const Vec3f *gyro, size_t gyroCount, LegacyFeatures &out)
+{
+    float averageZGyro=0;
+    for (size_t i=0; i<gyroCount;i++) {
+        Vec3f a = gyro[i];
+        averageZGyro += sqrt(a.z*a.z);
+    }
+    averageZGyro /= gyroCount;
+
+    float averageAccMagnitude=0;
+    float averageZAcc=0;
+    for (size_t i=0; i<accCount;i++) {
+        Vec3f a = acc[i];
+        float acc = sqrt(a.x*a.x + a.y*a.y + a.z*a.z);
+        averageZAcc += a.z;
+        averageAccMagnitude += acc;
+    }
+    out.averageAccMagnitude = averageAccMagnitude / accCount;
+    out.averageZAcc = averageZAcc / accCount;
+    out.averageZGyro = averageZGyro;
+}
+
+volatile float gSink;
+
+// every feature is used, so no kernel gets away with computing only the means
+template <typename Features>
+float useFeatures(const Features &f)
+{
+    return (float)(f.meanAccSq < f.minAccSq + f.maxAccSq ? f.meanAbsZGyro + f.maxAbsZGyro : f.meanZAcc) +
+           (float)(f.minXAcc + f.maxXAcc + f.maxAbsYAcc);
+}
+
+template <typename F>
+double timeBatches(size_t batchCount, F fn)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < batchCount; b++)
+        fn(b);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / batchCount;
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t batches = 200000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--batches") == 0 && i + 1 < argc)
+            batches = (size_t)atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: featureBench [--batches N]\n");
+            return 2;
+        }
+    }
+
+    ImuTrace trace;
+    synthesizeTrace(trace, 208, 120, 7);
+    const size_t n = trace.sampleCount();
+    std::vector<float> ax(n), ay(n), az(n), gz(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        ax[i] = trace.acc[i].x;
+        ay[i] = trace.acc[i].y;
+        az[i] = trace.acc[i].z;
+        gz[i] = trace.gyro[i].z;
+    }
+
+    printf("%-8s %12s %12s %12s %12s\n", "samples", "legacy ns", "aos ns", "soa ns", "fixed ns");
+    const size_t sizes[] = {1, 2, 4, 8, 16, 32};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        const size_t size = sizes[s];
+        const size_t windows = n / size;
+
+        // the kernels must agree with the old loops (up to float rounding)
+        float worstZAcc = 0, worstZGyro = 0, worstFixed = 0;
+        bool extremesAgree = true;
+        for (size_t w = 0; w < windows; w++)
+        {
+            const size_t first = w * size;
+            LegacyFeatures legacy;
+            BatchFeatures aos, soa;
+            FixedBatchFeatures fixed;
+            legacyFeatures(&trace.acc[first], size, &trace.gyro[first], size, legacy);
+            computeBatchFeatures(&trace.acc[first], size, &trace.gyro[first], size, aos);
+            computeBatchFeaturesSoA(&ax[first], &ay[first], &az[first], &gz[first], size, soa);
+            computeBatchFeatures(&trace.acc[first], size, &trace.gyro[first], size, fixed);
+            worstZAcc = fmaxf(worstZAcc, fabsf(legacy.averageZAcc - aos.meanZAcc));
+            worstZAcc = fmaxf(worstZAcc, fabsf(aos.meanZAcc - soa.meanZAcc));
+            worstZGyro = fmaxf(worstZGyro, fabsf(legacy.averageZGyro - aos.meanAbsZGyro));
+            worstZGyro = fmaxf(worstZGyro, fabsf(aos.meanAbsZGyro - soa.meanAbsZGyro));
+            // extremes don't round, both kernels must find the same ones
+            extremesAgree = extremesAgree && aos.minXAcc == soa.minXAcc && aos.maxXAcc == soa.maxXAcc &&
+                            aos.maxAbsYAcc == soa.maxAbsYAcc && aos.maxAbsZGyro == soa.maxAbsZGyro;
+            // fixed point is off by its resolution at most, half a count per sample and the mean's truncation
+            worstFixed = fmaxf(worstFixed, fabsf(FixedMath::accUnits(fixed.meanZAcc) - aos.meanZAcc) * ACC_COUNTS);
+            worstFixed = fmaxf(worstFixed, fabsf(FixedMath::gyroUnits(fixed.maxAbsZGyro) - aos.maxAbsZGyro) * GYRO_COUNTS);
+        }
+        if (worstZAcc > 1e-3f || worstZGyro > 1e-2f || !extremesAgree || worstFixed > 1.5f)
+        {
+            fprintf(stderr, "kernel mismatch at %zu samples: zAcc %g, zGyro %g, fixed %g counts\n", size, worstZAcc,
+                    worstZGyro, worstFixed);
+            return 1;
+        }
+
+        double legacyNs = timeBatches(batches, [&](size_t b) {
+            const size_t first = (b % windows) * size;
+            LegacyFeatures f;
+            legacyFeatures(&trace.acc[first], size, &trace.gyro[first], size, f);
+            gSink = f.averageAccMagnitude < BEGIN_THRESHOLD ? f.averageZGyro : f.averageZAcc;
+        });
+        double aosNs = timeBatches(batches, [&](size_t b) {
+            const size_t first = (b % windows) * size;
+            BatchFeatures f;
+            computeBatchFeatures(&trace.acc[first], size, &trace.gyro[first], size, f);
+            gSink = useFeatures(f);
+        });
+        double soaNs = timeBatches(batches, [&](size_t b) {
+            const size_t first = (b % windows) * size;
+            BatchFeatures f;
+            computeBatchFeaturesSoA(&ax[first], &ay[first], &az[first], &gz[first], size, f);
+            gSink = useFeatures(f);
+        });
+        double fixedNs = timeBatches(batches, [&](size_t b) {
+            const size_t first = (b % windows) * size;
+            FixedBatchFeatures f;
+            computeBatchFeatures(&trace.acc[first], size, &trace.gyro[first], size, f);
+            gSink = useFeatures(f);
+        });
+        printf("%-8zu %12.1f %12.1f %12.1f %12.1f\n", size, legacyNs, aosNs, soaNs, fixedNs);
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "fileFlash.h"
+
+FileFlash::FileFlash(const char *path, size_t pages, size_t sectorPages)
+    : mFile(nullptr), mPages(pages), mSectorPages(sectorPages), mBytesProgrammed(0), mOverwrites(0),
+      mSectorErases(pages / sectorPages, 0)
+{
+    mFile = fopen(path, "r+b");
+    if (mFile)
+    {
+        fseek(mFile, 0, SEEK_END);
+        if ((size_t)ftell(mFile) == pages * LOG_PAGE_SIZE)
+            return;
+        // another geometry, start over
+        fclose(mFile);
+    }
+    mFile = fopen(path, "w+b");
+    if (!mFile)
+        return;
+    std::vector<uint8_t> blank(LOG_PAGE_SIZE, 0xFF);
+    for (size_t i = 0; i < pages; i++)
+        fwrite(blank.data(), 1, blank.size(), mFile);
+    fflush(mFile);
+}
+
+FileFlash::~FileFlash()
+{
+    if (mFile)
+        fclose(mFile);
+}
+
+bool FileFlash::read(size_t page, size_t offset, uint8_t out[], size_t len)
+{
+    if (!mFile || page >= mPages || offset + len > LOG_PAGE_SIZE)
+        return false;
+    return fseek(mFile, (long)(page * LOG_PAGE_SIZE + offset), SEEK_SET) == 0 && fread(out, 1, len, mFile) == len;
+}
+
+bool FileFlash::program(size_t page, const uint8_t data[])
+{
+    uint8_t current[LOG_PAGE_SIZE];
+    if (!read(page, 0, current, sizeof(current)))
+        return false;
+    bool erased = true;
+    for (size_t i = 0; i < LOG_PAGE_SIZE; i++)
+    {
+        erased = erased && current[i] == 0xFF;
+        current[i] &= data[i];
+    }
+    if (!erased)
+        mOverwrites++;
+    mBytesProgrammed += LOG_PAGE_SIZE;
+    return fseek(mFile, (long)(page * LOG_PAGE_SIZE), SEEK_SET) == 0 &&
+           fwrite(current, 1, sizeof(current), mFile) == sizeof(current) && fflush(mFile) == 0;
+}
+
+bool FileFlash::erase(size_t sector)
+{
+    if (!mFile || sector >= mSectorErases.size())
+        return false;
+    std::vector<uint8_t> blank(mSectorPages * LOG_PAGE_SIZE, 0xFF);
+    mSectorErases[sector]++;
+    return fseek(mFile, (long)(sector * blank.size()), SEEK_SET) == 0 &&
+           fwrite(blank.data(), 1, blank.size(), mFile) == blank.size() && fflush(mFile) == 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+// A FlashStore (FlashStore.h) in a file, for running the logbook on a
+// workstation: the pages keep the NOR rules (programming only clears bits,
+// erase sets a sector to 0xFF) and survive the process, so a logbook can be
+// mounted again as after a reset. Counts what was programmed and erased, per
+// sector for the wear.
+#include <stdio.h>
+#include <vector>
+#include "FlashStore.h"
+
+class FileFlash : public FlashStore
+{
+public:
+    // Opens path, or creates it erased. pages is a multiple of sectorPages.
+    FileFlash(const char *path, size_t pages, size_t sectorPages);
+    ~FileFlash();
+
+    bool ok() const { return mFile != nullptr; }
+
+    virtual size_t pageCount() const { return mPages; }
+    virtual size_t sectorPages() const { return mSectorPages; }
+    virtual bool read(size_t page, size_t offset, uint8_t out[], size_t len);
+    virtual bool program(size_t page, const uint8_t data[]);
+    virtual bool erase(size_t sector);
+
+    uint64_t bytesProgrammed() const { return mBytesProgrammed; }
+    // programs of a page that wasn't erased, a logbook bug
+    uint32_t overwrites() const { return mOverwrites; }
+    const std::vector<uint32_t> &sectorErases() const { return mSectorErases; }
+
+private:
+    FILE *mFile;
+    size_t mPages;
+    size_t mSectorPages;
+    uint64_t mBytesProgrammed;
+    uint32_t mOverwrites;
+    std::vector<uint32_t> mSectorErases;
+};
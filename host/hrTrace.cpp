@@ -0,0 +1,135 @@
+#include "hrTrace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+
+namespace
+{
+const float REST_BPM = 72;
+const float PEAK_BPM = 172;
+const float RISE_S = 15; // time constants of the heart rate following the effort
+const float RECOVERY_S = 40;
+const uint32_t EFFORT_WINDOW_MS = 10000; // movements in this much time make the effort
+const float FULL_EFFORT = 5; // movements in the window that drive the heart rate to its peak
+
+// xorshift, the same sequence on every host
+struct Rng
+{
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * (next() / 4294967296.0f); }
+};
+}
+
+bool loadHrTrace(const std::string &path, HrTrace &trace)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+    {
+        fprintf(stderr, "cannot open heart rate trace %s\n", path.c_str());
+        return false;
+    }
+    trace = HrTrace();
+    trace.name = path;
+
+    std::string line;
+    size_t lineNo = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        HrNotification n;
+        unsigned t;
+        int consumed = 0;
+        if (sscanf(line.c_str(), "%u,%f%n", &t, &n.average, &consumed) != 2)
+        {
+            fprintf(stderr, "%s:%zu: malformed notification\n", path.c_str(), lineNo);
+            return false;
+        }
+        n.time = t;
+        const char *p = line.c_str() + consumed;
+        unsigned rr;
+        int len;
+        while (sscanf(p, ",%u%n", &rr, &len) == 1)
+        {
+            n.rr.push_back((uint16_t)rr);
+            p += len;
+        }
+        if (!trace.notifications.empty() && n.time < trace.notifications.back().time)
+        {
+            fprintf(stderr, "%s:%zu: notifications out of order\n", path.c_str(), lineNo);
+            return false;
+        }
+        trace.notifications.push_back(n);
+    }
+    return true;
+}
+
+bool saveHrTrace(const std::string &path, const HrTrace &trace)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(f, "# time_ms,average_bpm,rr_ms...\n");
+    for (size_t i = 0; i < trace.notifications.size(); i++)
+    {
+        const HrNotification &n = trace.notifications[i];
+        fprintf(f, "%u,%.1f", n.time, n.average);
+        for (size_t j = 0; j < n.rr.size(); j++)
+            fprintf(f, ",%u", n.rr[j]);
+        fprintf(f, "\n");
+    }
+    return fclose(f) == 0;
+}
+
+void synthesizeHrTrace(const ImuTrace &imu, uint32_t seed, HrTrace &trace)
+{
+    Rng rng(seed);
+    trace = HrTrace();
+    trace.name = imu.name + "-hr";
+    if (imu.sampleCount() == 0)
+        return;
+    const uint32_t start = imu.timestamps[0];
+    const uint32_t duration = imu.timestamps.back() - start;
+
+    float bpm = REST_BPM;
+    size_t label = 0, oldest = 0;
+    double nextBeat = 60000.0 / bpm; // ms
+    for (uint32_t t = 1000; t <= duration; t += 1000)
+    {
+        // movements that ended in the effort window
+        while (label < imu.labels.size() && imu.labels[label].endTime - start <= t)
+            label++;
+        while (oldest < label && imu.labels[oldest].endTime - start + EFFORT_WINDOW_MS <= t)
+            oldest++;
+        float effort = (label - oldest) / FULL_EFFORT;
+        float target = REST_BPM + (PEAK_BPM - REST_BPM) * (effort < 1 ? effort : 1);
+        float tau = target > bpm ? RISE_S : RECOVERY_S;
+        bpm += (target - bpm) * (1 - expf(-1 / tau));
+
+        HrNotification n;
+        n.time = t;
+        float sum = 0;
+        while (nextBeat <= t)
+        {
+            float interval = 60000 / bpm * rng.uniform(0.96f, 1.04f);
+            n.rr.push_back((uint16_t)(interval + 0.5f));
+            sum += 60000 / interval;
+            nextBeat += interval;
+        }
+        n.average = n.rr.empty() ? bpm : sum / n.rr.size();
+        trace.notifications.push_back(n);
+    }
+}
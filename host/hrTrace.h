@@ -0,0 +1,34 @@
+#pragma once
+// Heart rate traces for the host tools, played as /Meas/HR notifications
+// next to an IMU6 trace (imuTrace.h).
+//
+// Trace files are plain text, one notification per line:
+//   time_ms,average_bpm[,rr_ms...]
+// with the time in ms from the first sample of the IMU trace and the RR
+// intervals of the beats since the previous notification. Lines starting
+// with '#' are comments.
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "imuTrace.h"
+
+struct HrNotification
+{
+    uint32_t time;
+    float average;
+    std::vector<uint16_t> rr;
+};
+
+struct HrTrace
+{
+    std::string name;
+    std::vector<HrNotification> notifications;
+};
+
+bool loadHrTrace(const std::string &path, HrTrace &trace);
+bool saveHrTrace(const std::string &path, const HrTrace &trace);
+
+// A heart rate that follows the labeled movements of an IMU trace: it climbs
+// towards a rally's intensity and recovers in the breaks, slower than it
+// rises, with beat-to-beat variation. One notification per second.
+void synthesizeHrTrace(const ImuTrace &imu, uint32_t seed, HrTrace &trace);
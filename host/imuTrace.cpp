@@ -0,0 +1,492 @@
+#include "imuTrace.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+
+size_t ImuTrace::batchCount() const
+{
+    return traceView(*this).batchCount();
+}
+
+ImuBatch ImuTrace::batch(size_t index) const
+{
+    return traceView(*this).batch(index);
+}
+
+size_t TraceView::batchCount() const
+{
+    size_t perBatch = samplesPerBatch();
+    return (sampleCount + perBatch - 1) / perBatch;
+}
+
+ImuBatch TraceView::batch(size_t index) const
+{
+    size_t perBatch = samplesPerBatch();
+    size_t first = index * perBatch;
+    size_t count = sampleCount - first < perBatch ? sampleCount - first : perBatch;
+    ImuBatch b;
+    b.timestamp = timestamps[first];
+    b.acc = &acc[first];
+    b.accCount = count;
+    b.gyro = &gyro[first];
+    b.gyroCount = count;
+    return b;
+}
+
+TraceView traceView(const ImuTrace &trace)
+{
+    TraceView v;
+    v.name = trace.name.c_str();
+    v.sampleRate = trace.sampleRate;
+    v.sampleCount = trace.sampleCount();
+    v.timestamps = trace.timestamps.empty() ? nullptr : &trace.timestamps[0];
+    v.acc = trace.acc.empty() ? nullptr : &trace.acc[0];
+    v.gyro = trace.gyro.empty() ? nullptr : &trace.gyro[0];
+    v.labels = trace.labels.empty() ? nullptr : &trace.labels[0];
+    v.labelCount = trace.labels.size();
+    return v;
+}
+
+DetectionScore::DetectionScore() :
+    matched(0),
+    airtimeError(0)
+{
+    memset(kinds, 0, sizeof(kinds));
+}
+
+void DetectionScore::add(const ImuTrace &trace, const SplitStepEvent &event)
+{
+    kinds[event.kind]++;
+    // labels are split step landings only
+    if (event.kind == ZERO_G_BEGIN || event.kind > OTHER_FOOTWORK)
+        return;
+    const TraceLabel *l = matchLabel(trace, event);
+    if (l)
+    {
+        double airtime = (double)event.endTime - event.beginTime;
+        double labeled = (double)l->endTime - l->beginTime;
+        matched++;
+        airtimeError += airtime > labeled ? airtime - labeled : labeled - airtime;
+    }
+}
+
+const TraceLabel *matchLabel(const ImuTrace &trace, const SplitStepEvent &event)
+{
+    for (size_t i = 0; i < trace.labels.size(); i++)
+    {
+        const TraceLabel &l = trace.labels[i];
+        if (event.beginTime <= l.endTime && l.beginTime <= event.endTime)
+            return &l;
+    }
+    return nullptr;
+}
+
+void collectLandings(const ImuTrace &trace, std::vector<LabeledLanding> &landings)
+{
+    SplitStepConfig config;
+    config.classifier = false;
+    SplitStepDetector detector(config);
+    detector.setSampleRate(trace.sampleRate);
+    SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        size_t n = detector.process(trace.batch(b), events, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceLabel *l = events[i].kind != ZERO_G_BEGIN ? matchLabel(trace, events[i]) : nullptr;
+            if (!l)
+                continue;
+            // a batch holds one landing at most, lastLanding() is this one
+            LabeledLanding landing;
+            landing.features = detector.lastLanding();
+            landing.splitStep = l->kind != OTHER_FOOTWORK;
+            landing.thresholdKind = events[i].kind;
+            landings.push_back(landing);
+        }
+    }
+}
+
+static bool parseKind(const char *name, SplitStepEventKind &kind)
+{
+    if (strcmp(name, "good") == 0)
+        kind = GOOD_STEP;
+    else if (strcmp(name, "high") == 0)
+        kind = HIGH_STEP;
+    else if (strcmp(name, "other") == 0)
+        kind = OTHER_FOOTWORK;
+    else
+        return false;
+    return true;
+}
+
+bool loadTrace(const std::string &path, ImuTrace &trace)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+    {
+        fprintf(stderr, "cannot open trace %s\n", path.c_str());
+        return false;
+    }
+    trace = ImuTrace();
+    trace.name = path;
+
+    std::string line;
+    size_t lineNo = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        if (line.empty())
+            continue;
+        if (line[0] == '#')
+        {
+            unsigned rate;
+            char kindName[16];
+            unsigned begin, end;
+            if (sscanf(line.c_str(), "# rate=%u", &rate) == 1)
+                trace.sampleRate = rate;
+            else if (sscanf(line.c_str(), "# label=%15[a-z],%u,%u", kindName, &begin, &end) == 3)
+            {
+                TraceLabel label;
+                if (!parseKind(kindName, label.kind))
+                {
+                    fprintf(stderr, "%s:%zu: unknown label kind %s\n", path.c_str(), lineNo, kindName);
+                    return false;
+                }
+                label.beginTime = begin;
+                label.endTime = end;
+                trace.labels.push_back(label);
+            }
+            continue;
+        }
+        unsigned t;
+        Vec3f a, g;
+        if (sscanf(line.c_str(), "%u,%f,%f,%f,%f,%f,%f", &t, &a.x, &a.y, &a.z, &g.x, &g.y, &g.z) != 7)
+        {
+            fprintf(stderr, "%s:%zu: malformed sample\n", path.c_str(), lineNo);
+            return false;
+        }
+        trace.timestamps.push_back(t);
+        trace.acc.push_back(a);
+        trace.gyro.push_back(g);
+    }
+    return true;
+}
+
+static const char *labelKindName(SplitStepEventKind kind)
+{
+    return kind == GOOD_STEP ? "good" : (kind == HIGH_STEP ? "high" : "other");
+}
+
+bool saveTrace(const std::string &path, const ImuTrace &trace)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "cannot write trace %s\n", path.c_str());
+        return false;
+    }
+    fprintf(f, "# rate=%u\n", trace.sampleRate);
+    for (size_t i = 0; i < trace.labels.size(); i++)
+    {
+        const TraceLabel &l = trace.labels[i];
+        fprintf(f, "# label=%s,%u,%u\n", labelKindName(l.kind), l.beginTime, l.endTime);
+    }
+    for (size_t i = 0; i < trace.sampleCount(); i++)
+    {
+        const Vec3f &a = trace.acc[i];
+        const Vec3f &g = trace.gyro[i];
+        fprintf(f, "%u,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f\n", trace.timestamps[i], a.x, a.y, a.z, g.x, g.y, g.z);
+    }
+    return fclose(f) == 0;
+}
+
+namespace
+{
+const char BINARY_MAGIC[4] = {'I', 'M', 'U', 'T'};
+const uint32_t BINARY_VERSION = 1;
+
+struct BinaryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t sampleCount;
+    uint32_t labelCount;
+    uint32_t reserved[3];
+};
+static_assert(sizeof(BinaryHeader) == 32, "binary trace header layout");
+static_assert(sizeof(TraceLabel) == 3 * sizeof(uint32_t), "labels are mapped in place");
+static_assert(sizeof(Vec3f) == 3 * sizeof(float), "samples are mapped in place");
+
+size_t binarySize(const BinaryHeader &h)
+{
+    return sizeof(BinaryHeader) + (size_t)h.sampleCount * (sizeof(uint32_t) + 2 * sizeof(Vec3f)) +
+           (size_t)h.labelCount * sizeof(TraceLabel);
+}
+}
+
+bool isBinaryTrace(const std::string &path)
+{
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".imut") == 0;
+}
+
+bool saveBinaryTrace(const std::string &path, const ImuTrace &trace)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f)
+    {
+        fprintf(stderr, "cannot write trace %s\n", path.c_str());
+        return false;
+    }
+    BinaryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BINARY_MAGIC, sizeof(h.magic));
+    h.version = BINARY_VERSION;
+    h.sampleRate = trace.sampleRate;
+    h.sampleCount = (uint32_t)trace.sampleCount();
+    h.labelCount = (uint32_t)trace.labels.size();
+    fwrite(&h, sizeof(h), 1, f);
+    size_t n = trace.sampleCount();
+    if (n)
+    {
+        fwrite(&trace.timestamps[0], sizeof(uint32_t), n, f);
+        fwrite(&trace.acc[0], sizeof(Vec3f), n, f);
+        fwrite(&trace.gyro[0], sizeof(Vec3f), n, f);
+    }
+    if (!trace.labels.empty())
+        fwrite(&trace.labels[0], sizeof(TraceLabel), trace.labels.size(), f);
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+MappedTrace::MappedTrace() :
+    mData(nullptr),
+    mSize(0)
+{
+    memset(&mView, 0, sizeof(mView));
+}
+
+MappedTrace::~MappedTrace()
+{
+    if (mData)
+        munmap(mData, mSize);
+}
+
+bool MappedTrace::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot open trace %s\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader))
+    {
+        fprintf(stderr, "%s: not a binary trace\n", path.c_str());
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "cannot map trace %s\n", path.c_str());
+        return false;
+    }
+    const BinaryHeader *h = (const BinaryHeader *)data;
+    if (memcmp(h->magic, BINARY_MAGIC, sizeof(h->magic)) != 0 || h->version != BINARY_VERSION ||
+        binarySize(*h) != (size_t)st.st_size)
+    {
+        fprintf(stderr, "%s: not a binary trace of version %u\n", path.c_str(), BINARY_VERSION);
+        munmap(data, st.st_size);
+        return false;
+    }
+    if (mData)
+        munmap(mData, mSize);
+    mData = data;
+    mSize = st.st_size;
+    mName = path;
+
+    const char *p = (const char *)data + sizeof(BinaryHeader);
+    mView.name = mName.c_str();
+    mView.sampleRate = h->sampleRate;
+    mView.sampleCount = h->sampleCount;
+    mView.timestamps = (const uint32_t *)p;
+    p += h->sampleCount * sizeof(uint32_t);
+    mView.acc = (const Vec3f *)p;
+    p += h->sampleCount * sizeof(Vec3f);
+    mView.gyro = (const Vec3f *)p;
+    p += h->sampleCount * sizeof(Vec3f);
+    mView.labels = (const TraceLabel *)p;
+    mView.labelCount = h->labelCount;
+    // the OS reads ahead, the workers walk every trace front to back
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+namespace
+{
+// small deterministic generator so synthesized sessions are reproducible
+struct Rng
+{
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * (next() / 4294967296.0f); }
+    // roughly normal, sum of four uniforms
+    float noise(float sigma)
+    {
+        float s = 0;
+        for (int i = 0; i < 4; i++)
+            s += uniform(-1.0f, 1.0f);
+        return s * sigma * 0.866f;
+    }
+};
+
+const float GRAVITY = 9.81f;
+const uint32_t LOAD_MS = 100; // knee bend before take-off
+const uint32_t LANDING_MS = 80; // impact after touch-down
+}
+
+void synthesizeTrace(ImuTrace &trace, uint32_t sampleRate, uint32_t seconds, uint32_t seed, bool confusers)
+{
+    Rng rng(seed);
+    trace = ImuTrace();
+    char name[64];
+    snprintf(name, sizeof(name), "synth-%uHz-%us-%u%s", sampleRate, seconds, seed, confusers ? "-confusers" : "");
+    trace.name = name;
+    trace.sampleRate = sampleRate;
+
+    const uint32_t start = 1000;
+    const uint32_t end = start + seconds * 1000;
+
+    // lay out the movements first, then render the samples
+    std::vector<bool> confusing; // per label
+    uint32_t t = start + 1000;
+    uint32_t rallyLeft = 3 + rng.next() % 8;
+    while (true)
+    {
+        TraceLabel label;
+        uint32_t r = rng.next() % 4;
+        label.kind = r < 2 ? GOOD_STEP : (r == 2 ? HIGH_STEP : OTHER_FOOTWORK);
+        uint32_t airtime;
+        if (label.kind == GOOD_STEP)
+            airtime = (uint32_t)rng.uniform(80, 180);
+        else if (label.kind == HIGH_STEP)
+            airtime = (uint32_t)rng.uniform(240, 360);
+        else
+            airtime = (uint32_t)rng.uniform(120, 220);
+        label.beginTime = t + LOAD_MS;
+        label.endTime = label.beginTime + airtime;
+        if (label.endTime + LANDING_MS + 500 > end)
+            break;
+        trace.labels.push_back(label);
+        confusing.push_back(confusers && rng.next() % 3 == 0);
+        t = label.endTime + LANDING_MS + (uint32_t)rng.uniform(1200, 3500);
+        if (--rallyLeft == 0)
+        {
+            // break between points
+            t += (uint32_t)rng.uniform(10000, 25000);
+            rallyLeft = 3 + rng.next() % 8;
+        }
+    }
+
+    const double period = 1000.0 / sampleRate;
+    size_t next = 0;
+    for (size_t i = 0;; i++)
+    {
+        uint32_t ts = start + (uint32_t)(i * period + 0.5);
+        if (ts >= end)
+            break;
+        while (next < trace.labels.size() && trace.labels[next].endTime + LANDING_MS <= ts)
+            next++;
+
+        float accMag = GRAVITY + rng.noise(0.3f);
+        float gyroZ = rng.noise(4.0f);
+        float tilt = 0;
+        if (next < trace.labels.size())
+        {
+            const TraceLabel &l = trace.labels[next];
+            if (ts + LOAD_MS >= l.beginTime && ts < l.beginTime)
+                accMag = 13.0f + rng.noise(0.8f);
+            else if (ts >= l.beginTime && ts < l.endTime)
+            {
+                accMag = 1.5f + rng.noise(0.5f);
+                gyroZ = l.kind == OTHER_FOOTWORK ? 200.0f + rng.noise(30.0f) : 25.0f + rng.noise(8.0f);
+                if (confusing[next] && l.kind == OTHER_FOOTWORK)
+                {
+                    // a hop: little turn, the body tilts
+                    gyroZ = 45.0f + rng.noise(10.0f);
+                    tilt = 160.0f + rng.noise(25.0f);
+                }
+                else if (confusing[next] && ts + 40 >= l.endTime)
+                    gyroZ = 130.0f + rng.noise(15.0f); // turning into the landing
+            }
+            else if (ts >= l.endTime)
+                accMag = (confusing[next] && l.kind == OTHER_FOOTWORK ? 28.0f : 22.0f) + rng.noise(2.0f);
+        }
+        if (accMag < 0)
+            accMag = -accMag;
+
+        // mostly vertical, with a little sway on x/y
+        Vec3f a;
+        a.x = rng.noise(0.15f) * accMag / GRAVITY;
+        a.y = rng.noise(0.15f) * accMag / GRAVITY;
+        a.z = sqrtf(accMag * accMag - a.x * a.x - a.y * a.y);
+        Vec3f g;
+        g.x = tilt + rng.noise(6.0f);
+        g.y = rng.noise(6.0f);
+        g.z = gyroZ;
+
+        trace.timestamps.push_back(ts);
+        trace.acc.push_back(a);
+        trace.gyro.push_back(g);
+    }
+}
+
+bool loadCorpus(const std::vector<std::string> &paths, std::vector<ImuTrace> &corpus)
+{
+    corpus.clear();
+    if (paths.empty())
+    {
+        corpus.resize(1);
+        synthesizeTrace(corpus[0], 52, 600, 1);
+        return true;
+    }
+    corpus.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!loadTrace(paths[i], corpus[i]))
+            return false;
+    }
+    return true;
+}
+
+const char *eventKindName(SplitStepEventKind kind)
+{
+    switch (kind)
+    {
+        case ZERO_G_BEGIN: return "zero-g";
+        case GOOD_STEP: return "good";
+        case HIGH_STEP: return "high";
+        case OTHER_FOOTWORK: return "other";
+        case LATERAL_SHUFFLE: return "shuffle";
+        case CROSSOVER: return "crossover";
+        case LUNGE: return "lunge";
+        case EVENT_KIND_COUNT: break;
+    }
+    return "?";
+}
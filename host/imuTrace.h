@@ -0,0 +1,131 @@
+#pragma once
+// Recorded (or synthesized) IMU6 traces for the host tools.
+//
+// Trace files are plain text, one sample per line:
+//   timestamp_ms,accX,accY,accZ,gyroX,gyroY,gyroZ
+// Lines starting with '#' are comments, except for two directives:
+//   # rate=<Hz>                          sample rate the trace was recorded at
+//   # label=<kind>,<beginMs>,<endMs>     ground truth (kind: good|high|other)
+//
+// Binary trace files (*.imut) hold the same data laid out to be memory-mapped
+// and used in place, so many workers can share one copy read-only:
+//   header (32): magic "IMUT", version, rate, samples, labels (uint32 each), reserved
+//   timestamps (uint32 * samples), acc (Vec3f * samples), gyro (Vec3f * samples),
+//   labels (kind, begin, end as uint32 * labels)
+// in the byte order of the host that wrote them.
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "SplitStepDetector.h"
+
+struct TraceLabel
+{
+    SplitStepEventKind kind;
+    uint32_t beginTime;
+    uint32_t endTime;
+};
+
+struct ImuTrace
+{
+    std::string name;
+    uint32_t sampleRate;
+    std::vector<uint32_t> timestamps;
+    std::vector<Vec3f> acc;
+    std::vector<Vec3f> gyro;
+    std::vector<TraceLabel> labels;
+
+    ImuTrace() : sampleRate(52) {}
+
+    size_t sampleCount() const { return acc.size(); }
+    // samples per IMU6 notification at this rate (the sensor sends ~13 per second)
+    size_t samplesPerBatch() const { return sampleRate >= 26 ? sampleRate / 13 : 1; }
+    size_t batchCount() const;
+    ImuBatch batch(size_t index) const;
+};
+
+// Read-only samples and labels of a trace, held by an ImuTrace or a MappedTrace.
+struct TraceView
+{
+    const char *name;
+    uint32_t sampleRate;
+    size_t sampleCount;
+    const uint32_t *timestamps;
+    const Vec3f *acc;
+    const Vec3f *gyro;
+    const TraceLabel *labels;
+    size_t labelCount;
+
+    size_t samplesPerBatch() const { return sampleRate >= 26 ? sampleRate / 13 : 1; }
+    size_t batchCount() const;
+    ImuBatch batch(size_t index) const;
+};
+
+TraceView traceView(const ImuTrace &trace);
+
+// A binary trace file mapped read-only.
+class MappedTrace
+{
+public:
+    MappedTrace();
+    ~MappedTrace();
+
+    bool open(const std::string &path);
+    const TraceView &view() const { return mView; }
+
+private:
+    MappedTrace(const MappedTrace &);
+    MappedTrace &operator=(const MappedTrace &);
+
+    std::string mName;
+    void *mData;
+    size_t mSize;
+    TraceView mView;
+};
+
+// Detected events of a replay, scored against the labels of the trace.
+struct DetectionScore
+{
+    size_t kinds[EVENT_KIND_COUNT]; // events per SplitStepEventKind
+    size_t matched; // landings that overlap a labeled movement
+    double airtimeError; // summed |airtime - labeled airtime| (ms) of the matched ones
+
+    DetectionScore();
+    void add(const ImuTrace &trace, const SplitStepEvent &event);
+    double meanAirtimeError() const { return matched ? airtimeError / matched : 0; }
+};
+
+// the label a landing overlaps, null if none
+const TraceLabel *matchLabel(const ImuTrace &trace, const SplitStepEvent &event);
+
+// A landing the detector found in a labeled trace: its zero-g window and
+// whether the label it overlaps is a split step.
+struct LabeledLanding
+{
+    LandingFeatures features;
+    bool splitStep;
+    SplitStepEventKind thresholdKind; // what the gyro threshold rule made of it
+};
+
+// Runs the detector with the threshold rule over the trace and appends the
+// matched landings.
+void collectLandings(const ImuTrace &trace, std::vector<LabeledLanding> &landings);
+
+bool loadTrace(const std::string &path, ImuTrace &trace);
+bool saveTrace(const std::string &path, const ImuTrace &trace);
+bool saveBinaryTrace(const std::string &path, const ImuTrace &trace);
+// whether the path names a binary trace (*.imut)
+bool isBinaryTrace(const std::string &path);
+
+// Generates a session of rallies (split steps, high jumps and turning hops a
+// few seconds apart) separated by breaks of standing still. The generated
+// labels are the ground truth. With confusers a third of the movements are
+// the ones a gyro threshold gets wrong: split steps that turn into the
+// landing (a burst of z rotation at the end of the airtime) and hops that
+// tilt instead of turning.
+void synthesizeTrace(ImuTrace &trace, uint32_t sampleRate, uint32_t seconds, uint32_t seed, bool confusers = false);
+
+// Loads every path, or one synthesized session when paths is empty.
+bool loadCorpus(const std::vector<std::string> &paths, std::vector<ImuTrace> &corpus);
+
+const char *eventKindName(SplitStepEventKind kind);
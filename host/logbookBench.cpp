@@ -0,0 +1,252 @@
+// Runs the logbook (Logbook.h) on a file-backed flash (fileFlash.h) the way
+// the sensor fills it: a synthesized session goes through the split step
+// detector and its events, and optionally every compressed IMU6 batch, are
+// appended. Reports the append cost, the write amplification and sector
+// wear, then downloads the log in notification-sized chunks (all of it and
+// resumed from the middle) and checks every byte against what was appended.
+// Last it drops the logbook without a flush, as a reset would, mounts the
+// file again and checks that only the page in RAM was lost.
+//
+// usage: logbookBench [--file PATH] [--pages N] [--sector-pages N] [--synth SECONDS]
+//                     [--rate HZ] [--seed N] [--raw]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "EventCodec.h"
+#include "ImuCodec.h"
+#include "Logbook.h"
+#include "SplitStepDetector.h"
+#include "TxQueue.h"
+#include "fileFlash.h"
+#include "imuTrace.h"
+
+namespace
+{
+const size_t LOG_DATA_HEADER = 2 + 4; // type, tag and offset of a LOG_DATA notification
+
+// what a client ends up with after downloading from offset
+struct Download
+{
+    size_t notifications;
+    size_t bytes;
+    size_t mismatches; // bytes that differ from what was appended
+    size_t records; // parsed from the first record on
+    size_t events;
+    uint32_t first; // offset of the first byte received
+};
+
+// Appends to the logbook and keeps a copy of the whole stream to check against.
+struct Writer
+{
+    Logbook &book;
+    std::vector<uint8_t> stream; // byte i is at offset i
+    std::vector<uint32_t> starts; // offsets of the records
+    size_t records;
+    size_t recordBytes;
+
+    explicit Writer(Logbook &b) : book(b), records(0), recordBytes(0) {}
+
+    void append(uint8_t type, const uint8_t data[], size_t len)
+    {
+        if (stream.size() < book.end())
+            stream.resize(book.end(), 0); // a gap left by a mount
+        starts.push_back(book.end());
+        book.append(type, data, len);
+        stream.push_back(type);
+        stream.push_back((uint8_t)len);
+        stream.push_back((uint8_t)(len >> 8));
+        stream.insert(stream.end(), data, data + len);
+        records++;
+        recordBytes += LOG_RECORD_HEADER + len;
+    }
+};
+
+void logSession(Writer &writer, const ImuTrace &trace, bool raw)
+{
+    SplitStepDetector detector((SplitStepConfig()));
+    detector.setSampleRate(trace.sampleRate);
+    SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    uint8_t encoded[RAW_MAX_ENCODED];
+    uint16_t sequence = 0;
+    uint8_t start[4];
+    for (size_t i = 0; i < 4; i++)
+        start[i] = (uint8_t)(trace.timestamps[0] >> (8 * i));
+    writer.append(LOG_SESSION, start, sizeof(start));
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        ImuBatch batch = trace.batch(b);
+        if (raw)
+        {
+            size_t len = encodeImuBatch(batch, encoded, sizeof(encoded));
+            if (len > 0)
+                writer.append(LOG_RAW, encoded, len);
+        }
+        size_t n = detector.process(batch, events, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (events[i].kind == ZERO_G_BEGIN)
+                continue;
+            EventRecord r;
+            r.kind = (uint8_t)events[i].kind;
+            r.sequence = sequence++;
+            r.timestamp = events[i].endTime;
+            r.airtime = (uint16_t)(events[i].endTime - events[i].beginTime);
+            r.maxGyro = (uint16_t)(events[i].maxZGyro + 0.5f);
+            uint8_t record[EVENT_RECORD_SIZE];
+            encodeEventRecord(r, record);
+            writer.append(LOG_EVENT, record, sizeof(record));
+        }
+    }
+}
+
+// the same loop as pumpLogDownload in interface.cpp, one chunk per notification
+Download download(Logbook &book, const std::vector<uint8_t> &stream, uint32_t from, size_t payload)
+{
+    Download d = {0, 0, 0, 0, 0, 0};
+    std::vector<uint8_t> chunk(payload);
+    const size_t chunkSize = payload - LOG_DATA_HEADER;
+    uint32_t offset = from;
+    std::vector<uint8_t> received;
+    bool first = true;
+    while (true)
+    {
+        offset = book.seek(offset);
+        if (offset >= book.end())
+            break;
+        size_t len = 0, n;
+        while (len < chunkSize && (n = book.read(offset + len, chunk.data() + len, chunkSize - len)) > 0)
+            len += n;
+        if (first)
+            d.first = offset;
+        else if (offset != d.first + received.size())
+            received.clear(); // a gap, parsing starts over at the record seek() found
+        if (received.empty())
+            d.first = offset;
+        first = false;
+        for (size_t i = 0; i < len; i++)
+            d.mismatches += offset + i >= stream.size() || stream[offset + i] != chunk[i];
+        received.insert(received.end(), chunk.data(), chunk.data() + len);
+        d.notifications++;
+        d.bytes += len;
+        offset += len;
+    }
+    // the client's side: records from the first one
+    size_t pos = 0;
+    while (pos + LOG_RECORD_HEADER <= received.size())
+    {
+        size_t len = received[pos + 1] | received[pos + 2] << 8;
+        if (pos + LOG_RECORD_HEADER + len > received.size())
+            break;
+        d.records++;
+        d.events += received[pos] == LOG_EVENT;
+        pos += LOG_RECORD_HEADER + len;
+    }
+    return d;
+}
+
+void printDownload(const char *name, const Download &d, size_t payload)
+{
+    printf("  %s from %u: %zu bytes in %zu notifications of %zu bytes, %zu records (%zu events), %zu bytes wrong\n",
+           name, d.first, d.bytes, d.notifications, payload, d.records, d.events, d.mismatches);
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = "logbook.flash";
+    size_t pages = 32;
+    size_t sectorPages = 4;
+    uint32_t seconds = 600;
+    uint32_t rate = 104;
+    uint32_t seed = 1;
+    bool raw = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--file" && hasValue)
+            path = argv[++i];
+        else if (arg == "--pages" && hasValue)
+            pages = (size_t)atoi(argv[++i]);
+        else if (arg == "--sector-pages" && hasValue)
+            sectorPages = (size_t)atoi(argv[++i]);
+        else if (arg == "--synth" && hasValue)
+            seconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--raw")
+            raw = true;
+        else
+        {
+            fprintf(stderr, "usage: logbookBench [--file PATH] [--pages N] [--sector-pages N] [--synth SECONDS]\n"
+                            "                    [--rate HZ] [--seed N] [--raw]\n");
+            return 2;
+        }
+    }
+    if (sectorPages == 0 || pages < 2 * sectorPages || pages % sectorPages || seconds == 0)
+    {
+        fprintf(stderr, "need at least two sectors of pages and a session\n");
+        return 2;
+    }
+
+    ImuTrace trace;
+    synthesizeTrace(trace, rate, seconds, seed);
+    remove(path.c_str());
+    FileFlash flash(path.c_str(), pages, sectorPages);
+    if (!flash.ok())
+    {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 1;
+    }
+    Logbook book(flash);
+    book.mount();
+    Writer writer(book);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    logSession(writer, trace, raw);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s: %u s at %u Hz, %zu pages of %zu bytes, %zu per sector (%zu kB)%s\n", path.c_str(), seconds, rate,
+           pages, LOG_PAGE_SIZE, sectorPages, pages * LOG_PAGE_SIZE / 1024, raw ? ", raw batches" : "");
+    printf("  appended %zu records, %zu bytes (%.0f B/s of session), %.0f ns per record with the file writes\n",
+           writer.records, writer.recordBytes, writer.recordBytes / (double)seconds, ns / writer.records);
+    printf("  programmed %u pages, %.3f flash bytes per record byte, %u sector erases",
+           book.programs(), (double)flash.bytesProgrammed() / writer.recordBytes, book.erases());
+    const std::vector<uint32_t> &wear = flash.sectorErases();
+    printf(" (%u to %u per sector), %u pages programmed twice\n", *std::min_element(wear.begin(), wear.end()),
+           *std::max_element(wear.begin(), wear.end()), flash.overwrites());
+    printf("  kept %u to %u, %u bytes of %zu\n", book.begin(), book.end(), book.end() - book.begin(),
+           writer.stream.size());
+
+    const size_t payloads[] = {TxQueue::DEFAULT_PAYLOAD, TxQueue::MAX_PAYLOAD};
+    for (size_t i = 0; i < 2; i++)
+        printDownload("download", download(book, writer.stream, 0, payloads[i]), payloads[i]);
+    // a client that got the first half resumes at the record it didn't finish
+    uint32_t middle = *std::lower_bound(writer.starts.begin(), writer.starts.end(),
+                                        book.begin() + (book.end() - book.begin()) / 2);
+    Download resumed = download(book, writer.stream, middle, TxQueue::DEFAULT_PAYLOAD);
+    printDownload("resumed", resumed, TxQueue::DEFAULT_PAYLOAD);
+
+    // a reset: the page in RAM goes, the rest is mounted again
+    uint32_t end = book.end();
+    uint32_t programmed = end - end % LOG_PAGE_PAYLOAD;
+    Logbook again(flash);
+    again.mount();
+    Writer after(again);
+    after.stream = writer.stream;
+    after.stream.resize(programmed);
+    printf("  after a reset: kept %u to %u, %u bytes of the RAM page lost\n", again.begin(), again.end(),
+           end - programmed);
+    printDownload("download", download(again, after.stream, 0, TxQueue::DEFAULT_PAYLOAD), TxQueue::DEFAULT_PAYLOAD);
+    // the next session goes on after the skipped page, a client resuming at the old end finds its first record
+    logSession(after, trace, false);
+    Download next = download(again, after.stream, end, TxQueue::DEFAULT_PAYLOAD);
+    printDownload("next session", next, TxQueue::DEFAULT_PAYLOAD);
+    return 0;
+}
@@ -0,0 +1,307 @@
+// Simulates several sensors with drifting clocks talking to one client, to
+// check the clock sync (clockSync.h) and the stream merge (streamMerge.h)
+// together: every sensor's clock has its own offset and drift, the link
+// delays its notifications and sync replies by a random amount with
+// occasional stalls, and the client maps the event timestamps to its own
+// clock and merges the sensors into one stream. Reports the sync error
+// against the true times, whether the merged stream is in order, and the
+// merge throughput for 2 to 64 streams.
+//
+// usage: mergeBench [--sensors N] [--seconds S] [--sync-ms MS] [--seed N] [--items N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "clockSync.h"
+#include "streamMerge.h"
+
+namespace
+{
+const double BATCH_MS = 1000.0 / 13; // the sensor sends ~13 notifications per second
+const double EVENTS_PER_S = 3; // footwork events per sensor
+const size_t MERGE_CAPACITY = 64; // buffered items per stream
+const size_t THROUGHPUT_CAPACITY = 1024; // 64 streams take turns, a stream may not come up for a while
+const double ORDER_TOLERANCE = 5; // ms, consecutive merged events closer than this may swap
+
+// xorshift, the same sequence on every host
+struct Rng
+{
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    double uniform(double lo, double hi) { return lo + (hi - lo) * (next() / 4294967296.0); }
+};
+
+struct SensorClock
+{
+    double offset; // device ms at client time 0
+    double drift; // ppm, how much faster than the client
+
+    uint32_t read(double t) const { return (uint32_t)(int64_t)(offset + t * (1 + drift * 1e-6)); }
+};
+
+// one way over the link, ms: a connection interval or a few, sometimes a stall
+double linkDelay(Rng &rng)
+{
+    double d = rng.uniform(7.5, 45);
+    if (rng.next() % 10 == 0)
+        d += rng.uniform(100, 300);
+    return d;
+}
+
+// what reaches the client, in arrival order
+struct Arrival
+{
+    double time; // client ms
+    size_t sensor;
+    bool sync;
+    double sent; // sync: client time of the request
+    double left; // client time it left the sensor
+    uint32_t device; // sync: device time of the reply; batch: time of its last sample
+    std::vector<uint32_t> events; // batch: device times of its events
+    std::vector<double> trueTimes; // of the events
+    bool operator<(const Arrival &other) const { return time < other.time; }
+};
+
+struct Item
+{
+    double trueTime;
+};
+
+double percentile(std::vector<double> v, double q)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+void simulate(size_t sensors, double seconds, double syncMs, uint32_t seed)
+{
+    Rng rng(seed);
+    std::vector<SensorClock> clocks(sensors);
+    for (size_t k = 0; k < sensors; k++)
+    {
+        clocks[k].offset = rng.uniform(0, 4294967296.0);
+        clocks[k].drift = rng.uniform(-100, 100);
+    }
+    // one clock about to wrap around
+    clocks[0].offset = 4294967296.0 - seconds * 500;
+
+    std::vector<Arrival> arrivals;
+    const double end = seconds * 1000;
+    for (size_t k = 0; k < sensors; k++)
+    {
+        // the client syncs every sensor from the start, staggered
+        for (double t = k * syncMs / sensors; t < end; t += syncMs)
+        {
+            Arrival a;
+            a.sensor = k;
+            a.sync = true;
+            a.sent = t;
+            double read = t + linkDelay(rng) + rng.uniform(0, 3); // the GET of the clock
+            a.device = clocks[k].read(read);
+            a.left = read;
+            a.time = read + linkDelay(rng);
+            arrivals.push_back(a);
+        }
+        // events from the third second, each reported with the batch it falls in
+        double next = 2000 + rng.uniform(0, 1000 / EVENTS_PER_S);
+        for (double b = rng.uniform(0, BATCH_MS); b < end; b += BATCH_MS)
+        {
+            Arrival a;
+            a.sensor = k;
+            a.sync = false;
+            a.device = clocks[k].read(b);
+            for (; next <= b; next += rng.uniform(0.2, 1.8) * 1000 / EVENTS_PER_S)
+            {
+                a.events.push_back(clocks[k].read(next));
+                a.trueTimes.push_back(next);
+            }
+            a.left = b;
+            a.time = b + linkDelay(rng);
+            arrivals.push_back(a);
+        }
+    }
+    // notifications of one sensor can't overtake each other on the link
+    std::vector<double> lastArrival(sensors, 0);
+    std::sort(arrivals.begin(), arrivals.end(), [](const Arrival &x, const Arrival &y) {
+        return x.sensor != y.sensor ? x.sensor < y.sensor : x.left < y.left;
+    });
+    for (size_t i = 0; i < arrivals.size(); i++)
+    {
+        Arrival &a = arrivals[i];
+        a.time = std::max(a.time, lastArrival[a.sensor]);
+        lastArrival[a.sensor] = a.time;
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end());
+
+    std::vector<ClockSync> syncs(sensors);
+    StreamMerger<Item> merger(sensors, MERGE_CAPACITY);
+    std::vector<double> errors;
+    size_t unsynced = 0, full = 0, merged = 0, backwards = 0, swapped = 0, maxBuffered = 0;
+    int64_t lastTime = INT64_MIN;
+    double lastTrue = 0;
+    size_t lastSensor = sensors;
+
+    // everything that can leave, checked for order
+    auto drain = [&]() {
+        int64_t time;
+        Item item;
+        size_t sensor;
+        while (merger.pop(time, item, sensor))
+        {
+            if (time < lastTime)
+                backwards++;
+            if (merged && sensor != lastSensor && item.trueTime + ORDER_TOLERANCE < lastTrue)
+                swapped++;
+            lastTime = time;
+            lastTrue = item.trueTime;
+            lastSensor = sensor;
+            merged++;
+        }
+    };
+
+    for (size_t i = 0; i < arrivals.size(); i++)
+    {
+        const Arrival &a = arrivals[i];
+        ClockSync &sync = syncs[a.sensor];
+        if (a.sync)
+        {
+            sync.add(a.sent, a.device, a.time);
+            continue;
+        }
+        if (!sync.valid())
+        {
+            unsynced += a.events.size();
+            continue;
+        }
+        for (size_t e = 0; e < a.events.size(); e++)
+        {
+            double mapped = sync.toClient(a.events[e]);
+            errors.push_back(mapped - a.trueTimes[e] < 0 ? a.trueTimes[e] - mapped : mapped - a.trueTimes[e]);
+            Item item = {a.trueTimes[e]};
+            if (!merger.push(a.sensor, (int64_t)(mapped * 1000), item))
+                full++;
+        }
+        // nothing more before the end of the batch from this sensor
+        merger.advance(a.sensor, (int64_t)(sync.toClient(a.device) * 1000));
+        maxBuffered = std::max(maxBuffered, merger.buffered());
+        drain();
+    }
+    for (size_t k = 0; k < sensors; k++)
+        merger.close(k);
+    drain();
+
+    printf("%zu sensors, %.0f s, sync every %.0f ms\n", sensors, seconds, syncMs);
+    for (size_t k = 0; k < sensors; k++)
+        printf("  sensor %zu: drift %+6.1f ppm, estimated %+6.1f ppm, +-%.1f ms\n", k, clocks[k].drift,
+               syncs[k].driftPpm(), syncs[k].uncertainty());
+    printf("  event time error: p50 %.2f ms, p99 %.2f ms, max %.2f ms over %zu events (%zu before the first sync)\n",
+           percentile(errors, 0.5), percentile(errors, 0.99), percentile(errors, 1), errors.size(), unsynced);
+    printf("  merged %zu events, %zu out of order, %zu swapped by more than %.0f ms, %zu late\n", merged, backwards,
+           swapped, ORDER_TOLERANCE, merger.late());
+    printf("  at most %zu buffered (%zu per stream), %zu dropped on a full buffer\n", maxBuffered, MERGE_CAPACITY,
+           full);
+}
+
+// items/s through the merger with n streams, against sorting them all at once
+void throughput(size_t n, size_t items, uint32_t seed)
+{
+    Rng rng(seed);
+    std::vector<size_t> order(items);
+    std::vector<int64_t> times(items);
+    // the sensors share the client clock, each item comes from any of them
+    int64_t clock = 0;
+    for (size_t i = 0; i < items; i++)
+    {
+        order[i] = rng.next() % n;
+        clock += rng.next() % 1000;
+        times[i] = clock;
+    }
+
+    StreamMerger<uint32_t> merger(n, THROUGHPUT_CAPACITY);
+    size_t out = 0, full = 0;
+    int64_t time;
+    uint32_t item;
+    size_t stream;
+    uint64_t sum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < items; i++)
+    {
+        if (!merger.push(order[i], times[i], (uint32_t)i))
+            full++;
+        while (merger.pop(time, item, stream))
+        {
+            sum += item;
+            out++;
+        }
+    }
+    for (size_t k = 0; k < n; k++)
+        merger.close(k);
+    while (merger.pop(time, item, stream))
+    {
+        sum += item;
+        out++;
+    }
+    double mergeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::pair<int64_t, uint32_t> > all(items);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < items; i++)
+        all[i] = std::make_pair(times[i], (uint32_t)i);
+    std::sort(all.begin(), all.end());
+    double sortNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    printf("  %2zu streams: %6.1f M items/s merged (%zu out, %zu dropped), %6.1f M items/s sorting all at once%s\n",
+           n, items / mergeNs * 1e3, out, full, items / sortNs * 1e3, sum ? "" : " ");
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t sensors = 4;
+    double seconds = 600;
+    double syncMs = 2000;
+    uint32_t seed = 1;
+    size_t items = 4000000;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sensors" && hasValue)
+            sensors = (size_t)atoi(argv[++i]);
+        else if (arg == "--seconds" && hasValue)
+            seconds = atof(argv[++i]);
+        else if (arg == "--sync-ms" && hasValue)
+            syncMs = atof(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--items" && hasValue)
+            items = (size_t)atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: mergeBench [--sensors N] [--seconds S] [--sync-ms MS] [--seed N] [--items N]\n");
+            return 2;
+        }
+    }
+    if (sensors < 1 || seconds <= 0 || syncMs <= 0)
+        return 2;
+
+    simulate(sensors, seconds, syncMs, seed);
+
+    printf("merge throughput, %zu items:\n", items);
+    const size_t counts[] = {2, 4, 8, 16, 64};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+        throughput(counts[i], items, seed);
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Cost of the detector pipeline per IMU6 batch as detectors are added. The
+// features are computed once per batch and shared; the "separate" column is
+// what the same detectors would cost if each one walked the samples itself.
+// Shuffles, crossovers and lunges are drawn into the quiet stretches of the
+// trace so every detector has something to find.
+//
+// usage: pipelineBench [--iterations N] [--rate HZ] [trace.csv ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "DetectorPipeline.h"
+#include "FootworkDetectors.h"
+#include "ImuFeatures.h"
+#include "imuTrace.h"
+
+namespace
+{
+typedef DetectorPipeline<SplitStepDetector> Pipeline1;
+typedef DetectorPipeline<SplitStepDetector, LateralShuffleDetector> Pipeline2;
+typedef DetectorPipeline<SplitStepDetector, LateralShuffleDetector, CrossoverDetector> Pipeline3;
+typedef DetectorPipeline<SplitStepDetector, LateralShuffleDetector, CrossoverDetector, LungeDetector> Pipeline4;
+
+// whether [begin, end] is clear of labeled movements, with a margin
+bool quiet(const ImuTrace &trace, uint32_t begin, uint32_t end)
+{
+    for (size_t i = 0; i < trace.labels.size(); i++)
+        if (begin <= trace.labels[i].endTime + 1500 && trace.labels[i].beginTime <= end + 1500)
+            return false;
+    return true;
+}
+
+// overwrites the samples in [begin, end) with the given acc (z keeps gravity) and z rotation
+void draw(ImuTrace &trace, uint32_t begin, uint32_t end, float x, float y, float gyroZ)
+{
+    for (size_t i = 0; i < trace.sampleCount(); i++)
+    {
+        if (trace.timestamps[i] < begin || trace.timestamps[i] >= end)
+            continue;
+        trace.acc[i].x = x;
+        trace.acc[i].y = y;
+        trace.acc[i].z = 9.81f;
+        trace.gyro[i].z = gyroZ;
+    }
+}
+
+size_t addFootwork(ImuTrace &trace)
+{
+    if (trace.timestamps.empty())
+        return 0;
+    size_t added = 0;
+    for (uint32_t t = trace.timestamps[0] + 2000; t + 2000 < trace.timestamps.back(); t += 7000)
+    {
+        if (!quiet(trace, t, t + 1500))
+            continue;
+        switch (added++ % 3)
+        {
+            case 0: // three pushes, alternating sides
+                for (int p = 0; p < 3; p++)
+                    draw(trace, t + p * 400, t + p * 400 + 150, p % 2 ? -8.0f : 8.0f, 0, 10.0f);
+                break;
+            case 1:
+                draw(trace, t, t + 200, 7.0f, 0, 220.0f);
+                break;
+            case 2:
+                draw(trace, t, t + 100, 0, -18.0f, 10.0f);
+                break;
+        }
+    }
+    return added;
+}
+
+template <typename P>
+size_t runShared(const ImuTrace &trace, size_t kinds[])
+{
+    P pipeline;
+    pipeline.setSampleRate(trace.sampleRate);
+    SplitStepEvent events[P::MAX_EVENTS_PER_BATCH];
+    size_t total = 0;
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        ImuBatch batch = trace.batch(b);
+        BatchFeatures f;
+        computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, f);
+        size_t n = pipeline.process(batch, f, events, P::MAX_EVENTS_PER_BATCH);
+        for (size_t i = 0; kinds && i < n; i++)
+            kinds[events[i].kind]++;
+        total += n;
+    }
+    return total;
+}
+
+// every detector pays for its own pass over the samples
+template <typename P>
+size_t runSeparate(const ImuTrace &trace, size_t detectors)
+{
+    P pipeline;
+    pipeline.setSampleRate(trace.sampleRate);
+    SplitStepEvent events[P::MAX_EVENTS_PER_BATCH];
+    size_t total = 0;
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        ImuBatch batch = trace.batch(b);
+        BatchFeatures f;
+        for (size_t d = 0; d < detectors; d++)
+            computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, f);
+        total += pipeline.process(batch, f, events, P::MAX_EVENTS_PER_BATCH);
+    }
+    return total;
+}
+
+volatile size_t gSink;
+
+// best of a few rounds, the differences between the rows are small
+template <typename F>
+double nsPerBatch(const ImuTrace &trace, int iterations, F fn)
+{
+    double best = 0;
+    for (int round = 0; round < 5; round++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++)
+            gSink = fn();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    return best / ((double)trace.batchCount() * iterations);
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: pipelineBench [--iterations N] [--rate HZ] [trace.csv ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20;
+    uint32_t rate = 104;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+            iterations = atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+    if (iterations < 1)
+        usage();
+
+    std::vector<ImuTrace> corpus;
+    if (paths.empty())
+    {
+        corpus.resize(1);
+        synthesizeTrace(corpus[0], rate, 600, 1);
+    }
+    else if (!loadCorpus(paths, corpus))
+        return 1;
+
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        ImuTrace &trace = corpus[t];
+        size_t drawn = addFootwork(trace);
+        printf("%s: %zu batches of %zu samples, %zu footwork moves drawn in\n", trace.name.c_str(),
+               trace.batchCount(), trace.samplesPerBatch(), drawn);
+
+        size_t kinds[EVENT_KIND_COUNT] = {0};
+        runShared<Pipeline4>(trace, kinds);
+        printf("  events:");
+        for (size_t k = 0; k < EVENT_KIND_COUNT; k++)
+            printf(" %s %zu", eventKindName((SplitStepEventKind)k), kinds[k]);
+        printf("\n");
+
+        double shared[4], separate[4];
+        shared[0] = nsPerBatch(trace, iterations, [&]() { return runShared<Pipeline1>(trace, nullptr); });
+        shared[1] = nsPerBatch(trace, iterations, [&]() { return runShared<Pipeline2>(trace, nullptr); });
+        shared[2] = nsPerBatch(trace, iterations, [&]() { return runShared<Pipeline3>(trace, nullptr); });
+        shared[3] = nsPerBatch(trace, iterations, [&]() { return runShared<Pipeline4>(trace, nullptr); });
+        separate[0] = nsPerBatch(trace, iterations, [&]() { return runSeparate<Pipeline1>(trace, 1); });
+        separate[1] = nsPerBatch(trace, iterations, [&]() { return runSeparate<Pipeline2>(trace, 2); });
+        separate[2] = nsPerBatch(trace, iterations, [&]() { return runSeparate<Pipeline3>(trace, 3); });
+        separate[3] = nsPerBatch(trace, iterations, [&]() { return runSeparate<Pipeline4>(trace, 4); });
+
+        printf("  %-10s %14s %14s %14s\n", "detectors", "shared ns", "added ns", "separate ns");
+        for (size_t d = 0; d < 4; d++)
+            printf("  %-10zu %14.1f %14.1f %14.1f\n", d + 1, shared[d], d ? shared[d] - shared[d - 1] : shared[d],
+                   separate[d]);
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+// Compares the two command protocols on the setup of a session, against the
+// whole app in the stand-in Whiteboard runtime (host/sim, as appSim). A v1
+// client writes one command and waits for its reply before the next; a v2
+// client sends SET_MTU and the rest of the setup as frames of as few writes
+// as fit the MTU (CommandFrames.h) and checks the STATUS of every request.
+// Reports the writes, round trips, notifications and ATT bytes of each, the
+// bytes on the air with and without data length extension, and the setup
+// time those take at the connection interval.
+//
+// On-air model: every ATT PDU gets the L2CAP header and is cut into link
+// layer packets of the LL payload, each with its own preamble, access
+// address, header and CRC. A round trip is the connection event of the write
+// and the events the replies need, at packetsPerEvent packets each; empty
+// packets and the write response are left out.
+//
+// usage: protoBench [--mtu N] [--ci-ms MS] [--packets-per-event N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "CommandFrames.h"
+#include "DetectionParams.h"
+#include "TxQueue.h"
+#include "myApp.h"
+#include "simRuntime.h"
+
+namespace
+{
+const uint8_t SET_MTU_COMMAND = 19; // Commands::SET_MTU
+const uint8_t TIME_SYNC_COMMAND = 15; // Commands::TIME_SYNC
+const uint64_t SETTLE_US = 500000; // after a write, for its replies to go out
+const size_t ATT_HEADER = 3;
+const size_t L2CAP_HEADER = 4;
+const size_t LL_OVERHEAD = 10; // preamble, access address, header, CRC
+const size_t LL_PAYLOAD = 27; // without data length extension
+const size_t LL_PAYLOAD_DLE = 251;
+
+struct Command
+{
+    const char *name;
+    std::vector<uint8_t> bytes; // command and data
+};
+
+// what went over the link for one write
+struct Exchange
+{
+    size_t writeLen; // ATT value
+    std::vector<size_t> notifications; // ATT values
+    size_t messages;
+    uint64_t lastReply; // us after the write
+};
+
+struct Totals
+{
+    size_t writes;
+    size_t notifications;
+    size_t messages;
+    size_t upBytes; // ATT values, client to sensor
+    size_t downBytes;
+    size_t statuses;
+    size_t failed; // statuses other than 200
+    uint64_t simUs; // write to last reply, summed over the round trips
+    size_t onAir[2]; // without and with DLE
+    double setupMs[2];
+};
+
+std::vector<Command> sessionSetup()
+{
+    std::vector<Command> setup;
+    uint8_t block[1 + PARAMS_BLOCK_SIZE] = {0};
+    size_t len = encodeDetectionParams(DetectionParams(), block + 1, PARAMS_BLOCK_SIZE);
+    Command c;
+    c.name = "HELLO";
+    c.bytes = {0x00};
+    setup.push_back(c);
+    c.name = "SET_FORMAT binary";
+    c.bytes = {0x04, 0x01};
+    setup.push_back(c);
+    c.name = "SET_PARAMS";
+    c.bytes.assign(1, 0x08);
+    c.bytes.insert(c.bytes.end(), block, block + 1 + len);
+    setup.push_back(c);
+    c.name = "GET_PARAMS";
+    c.bytes = {0x09, 0x00};
+    setup.push_back(c);
+    c.name = "FEEDBACK on";
+    c.bytes = {0x0c, 0x01};
+    setup.push_back(c);
+    c.name = "SUMMARY every 10 s";
+    c.bytes = {0x0d, 0x0a, 0x00, 0x01};
+    setup.push_back(c);
+    c.name = "LOG events";
+    c.bytes = {0x10, 0x01};
+    setup.push_back(c);
+    c.name = "TIME_SYNC";
+    c.bytes = {TIME_SYNC_COMMAND, 0, 0, 0, 0}; // the client time goes in when it is sent
+    setup.push_back(c);
+    c.name = "BEGIN_SUB";
+    c.bytes = {0x01};
+    setup.push_back(c);
+    return setup;
+}
+
+void putClientTime(std::vector<uint8_t> &bytes, uint32_t now)
+{
+    if (bytes[0] != TIME_SYNC_COMMAND)
+        return;
+    for (size_t i = 0; i < 4; i++)
+        bytes[1 + i] = (uint8_t)(now >> (8 * i));
+}
+
+// messages of a notification, packed ones hold several
+void unpack(const std::vector<uint8_t> &b, std::vector<std::vector<uint8_t> > &messages)
+{
+    messages.clear();
+    if (b.size() < 2)
+        return;
+    if (b[0] != TX_PACKED_TYPE)
+    {
+        messages.push_back(b);
+        return;
+    }
+    size_t pos = TX_PACKED_HEADER;
+    for (size_t i = 0; i < b[1] && pos + TX_PACKED_ENTRY_HEADER <= b.size(); i++)
+    {
+        size_t len = b[pos];
+        if (pos + TX_PACKED_ENTRY_HEADER + len > b.size())
+            break;
+        std::vector<uint8_t> m(b.begin() + pos + 1, b.begin() + pos + TX_PACKED_ENTRY_HEADER + len);
+        messages.push_back(m);
+        pos += TX_PACKED_ENTRY_HEADER + len;
+    }
+}
+
+// writes and lets the app answer, returns what came back
+Exchange exchange(const std::vector<uint8_t> &write, Totals &totals)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    const size_t first = sim.notifications().size();
+    const uint64_t start = sim.now();
+    Exchange e = {write.size(), std::vector<size_t>(), 0, 0};
+    if (!sim.writeCommand(write.data(), write.size()))
+        fprintf(stderr, "write of %zu bytes ignored\n", write.size());
+    sim.runUntil(start + SETTLE_US);
+
+    std::vector<std::vector<uint8_t> > messages;
+    const std::vector<SimRuntime::Notification> &notifications = sim.notifications();
+    for (size_t i = first; i < notifications.size(); i++)
+    {
+        e.notifications.push_back(notifications[i].bytes.size());
+        e.lastReply = notifications[i].time - start;
+        unpack(notifications[i].bytes, messages);
+        e.messages += messages.size();
+        for (size_t m = 0; m < messages.size(); m++)
+        {
+            uint8_t command;
+            uint16_t status;
+            if (messages[m][0] != STATUS_TYPE || !decodeStatus(&messages[m][2], messages[m].size() - 2, command, status))
+                continue;
+            totals.statuses++;
+            if (status != STATUS_OK)
+            {
+                totals.failed++;
+                printf("  request %u (command %u): status %u\n", messages[m][1], command, status);
+            }
+        }
+    }
+    return e;
+}
+
+size_t llPackets(size_t attValue, size_t llPayload)
+{
+    size_t pdu = attValue + ATT_HEADER + L2CAP_HEADER;
+    return (pdu + llPayload - 1) / llPayload;
+}
+
+void account(const std::vector<Exchange> &exchanges, double ciMs, size_t packetsPerEvent, Totals &totals)
+{
+    const size_t llPayloads[2] = {LL_PAYLOAD, LL_PAYLOAD_DLE};
+    for (size_t i = 0; i < exchanges.size(); i++)
+    {
+        const Exchange &e = exchanges[i];
+        totals.writes++;
+        totals.upBytes += e.writeLen;
+        totals.notifications += e.notifications.size();
+        totals.messages += e.messages;
+        totals.simUs += e.lastReply;
+        for (size_t d = 0; d < 2; d++)
+        {
+            size_t up = llPackets(e.writeLen, llPayloads[d]);
+            size_t down = 0;
+            totals.onAir[d] += e.writeLen + ATT_HEADER + L2CAP_HEADER + up * LL_OVERHEAD;
+            for (size_t n = 0; n < e.notifications.size(); n++)
+            {
+                if (d == 0)
+                    totals.downBytes += e.notifications[n];
+                size_t packets = llPackets(e.notifications[n], llPayloads[d]);
+                totals.onAir[d] += e.notifications[n] + ATT_HEADER + L2CAP_HEADER + packets * LL_OVERHEAD;
+                down += packets;
+            }
+            // the write's event, then the replies from the next one on
+            size_t events = (up + packetsPerEvent - 1) / packetsPerEvent + (down + packetsPerEvent - 1) / packetsPerEvent;
+            totals.setupMs[d] += events * ciMs;
+        }
+    }
+}
+
+// one write per command, each waiting for its reply
+Totals runV1(const std::vector<Command> &setup, double ciMs, size_t packetsPerEvent)
+{
+    Totals totals = {};
+    std::vector<Exchange> exchanges;
+    for (size_t i = 0; i < setup.size(); i++)
+    {
+        std::vector<uint8_t> write = setup[i].bytes;
+        putClientTime(write, SimRuntime::instance().nowMs());
+        exchanges.push_back(exchange(write, totals));
+    }
+    account(exchanges, ciMs, packetsPerEvent, totals);
+    return totals;
+}
+
+// SET_MTU and the setup framed into as few writes as the MTU allows
+Totals runV2(const std::vector<Command> &setup, size_t mtu, double ciMs, size_t packetsPerEvent)
+{
+    Totals totals = {};
+    std::vector<Command> commands;
+    Command setMtu;
+    setMtu.name = "SET_MTU";
+    setMtu.bytes = {SET_MTU_COMMAND, (uint8_t)mtu, (uint8_t)(mtu >> 8)};
+    commands.push_back(setMtu);
+    commands.insert(commands.end(), setup.begin(), setup.end());
+
+    std::vector<uint8_t> buffer(mtu - ATT_HEADER);
+    FrameWriter writer(buffer.data(), buffer.size());
+    std::vector<Exchange> exchanges;
+    uint8_t requestId = 1;
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        std::vector<uint8_t> bytes = commands[i].bytes;
+        putClientTime(bytes, SimRuntime::instance().nowMs());
+        if (writer.add(requestId, bytes[0], bytes.data() + 1, bytes.size() - 1))
+        {
+            requestId++;
+            continue;
+        }
+        if (writer.frames() == 0)
+        {
+            fprintf(stderr, "%s does not fit a write of %zu bytes\n", commands[i].name, buffer.size());
+            continue;
+        }
+        exchanges.push_back(exchange(std::vector<uint8_t>(writer.data(), writer.data() + writer.length()), totals));
+        writer.clear();
+        i--;
+    }
+    if (writer.frames())
+        exchanges.push_back(exchange(std::vector<uint8_t>(writer.data(), writer.data() + writer.length()), totals));
+    account(exchanges, ciMs, packetsPerEvent, totals);
+    return totals;
+}
+
+void connect()
+{
+    SimRuntime &sim = SimRuntime::instance();
+    sim.connect();
+    sim.runUntil(sim.now() + 10000);
+    sim.setNotifications(true);
+    sim.runUntil(sim.now() + 10000);
+}
+
+void print(const char *name, const Totals &t, size_t commands)
+{
+    printf("  %s: %zu commands in %zu writes, %zu round trips, %zu notifications (%zu messages, %zu statuses)\n", name,
+           commands, t.writes, t.writes, t.notifications, t.messages, t.statuses);
+    printf("    ATT values: %zu bytes up, %zu down; on the air %zu bytes (%zu with DLE)\n", t.upBytes, t.downBytes,
+           t.onAir[0], t.onAir[1]);
+    printf("    setup time: %.0f ms (%.0f ms with DLE), %.1f ms write to last reply in the sim\n", t.setupMs[0],
+           t.setupMs[1], t.simUs / 1000.0);
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t mtu = 247;
+    double ciMs = 30;
+    size_t packetsPerEvent = 4;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--mtu" && hasValue)
+            mtu = (size_t)atoi(argv[++i]);
+        else if (arg == "--ci-ms" && hasValue)
+            ciMs = atof(argv[++i]);
+        else if (arg == "--packets-per-event" && hasValue)
+            packetsPerEvent = (size_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: protoBench [--mtu N] [--ci-ms MS] [--packets-per-event N]\n");
+            return 2;
+        }
+    }
+    if (mtu < 23 || mtu > TxQueue::MAX_PAYLOAD + ATT_HEADER || ciMs <= 0 || packetsPerEvent == 0)
+    {
+        fprintf(stderr, "need an ATT MTU of 23 to %zu, a connection interval and packets per event\n",
+                TxQueue::MAX_PAYLOAD + ATT_HEADER);
+        return 2;
+    }
+
+    // no IMU source: the subscriptions stay quiet, only the replies go out
+    SimRuntime &sim = SimRuntime::instance();
+    static myApp app;
+    wb::LaunchableModule &module = app;
+    if (!sim.launch(module))
+    {
+        fprintf(stderr, "%s did not start\n", module.name());
+        return 1;
+    }
+
+    const std::vector<Command> setup = sessionSetup();
+    printf("session setup, %zu commands, ATT MTU %zu, connection interval %.1f ms, %zu packets per event\n",
+           setup.size(), mtu, ciMs, packetsPerEvent);
+    connect();
+    Totals v1 = runV1(setup, ciMs, packetsPerEvent);
+    print("v1", v1, setup.size());
+    // a new link, the payload size starts over at the default
+    sim.disconnect();
+    sim.runUntil(sim.now() + 10000);
+    connect();
+    Totals v2 = runV2(setup, mtu, ciMs, packetsPerEvent);
+    print("v2", v2, setup.size() + 1);
+    if (v2.statuses != setup.size() + 1 || v2.failed)
+    {
+        printf("  v2: %zu of %zu statuses, %zu failed\n", v2.statuses, setup.size() + 1, v2.failed);
+        return 1;
+    }
+    printf("  v2/v1: %.2fx round trips, %.2fx bytes on the air (%.2fx with DLE), %.2fx setup time\n",
+           (double)v2.writes / v1.writes, (double)v2.onAir[0] / v1.onAir[0], (double)v2.onAir[1] / v1.onAir[1],
+           v2.setupMs[0] / v1.setupMs[0]);
+    return 0;
+}
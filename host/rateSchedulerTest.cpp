@@ -0,0 +1,90 @@
+// Checks the adaptive sample-rate scheduler (RateScheduler.h) and the rules
+// SET_PARAMS and BEGIN_SUB apply to its rates (DetectionParams.h): a burst of
+// motion steps the rate up once and a quiet period steps it down once, equal
+// idle and active rates are refused, and a scheduler that still gets them
+// never asks the subscription to follow a rate that didn't change. Run by
+// ctest.
+//
+// usage: rateSchedulerTest
+#include <stdio.h>
+#include "DetectionParams.h"
+#include "ImuFeatures.h"
+#include "RateScheduler.h"
+
+namespace
+{
+const uint32_t BATCH_MS = 80;
+
+size_t gFailures = 0;
+
+void check(bool ok, const char *what)
+{
+    if (!ok && gFailures++ < 20)
+        fprintf(stderr, "failed: %s\n", what);
+}
+
+// the features of a batch at rest, or of one with a turn in it
+BatchFeatures batchFeatures(bool motion)
+{
+    Vec3f acc[8], gyro[8];
+    for (size_t i = 0; i < 8; i++)
+    {
+        acc[i].x = acc[i].y = 0;
+        acc[i].z = 9.81f;
+        gyro[i].x = gyro[i].y = 0;
+        gyro[i].z = motion ? 200.0f : 0.0f;
+    }
+    BatchFeatures f;
+    computeBatchFeatures(acc, 8, gyro, 8, f);
+    return f;
+}
+
+// feeds the batches of a session, motion in [motionFrom, motionTo) ms,
+// and counts the switches the subscription would have to follow
+size_t countSwitches(RateScheduler &scheduler, uint32_t sessionMs, uint32_t motionFrom, uint32_t motionTo)
+{
+    const BatchFeatures quiet = batchFeatures(false);
+    const BatchFeatures motion = batchFeatures(true);
+    size_t switches = 0;
+    for (uint32_t t = 0; t < sessionMs; t += BATCH_MS)
+    {
+        const uint32_t rate = scheduler.rate();
+        const bool moving = t >= motionFrom && t < motionTo;
+        if (scheduler.update(moving ? motion : quiet, t))
+        {
+            switches++;
+            check(scheduler.rate() != rate, "a switch changes the rate");
+        }
+    }
+    return switches;
+}
+}
+
+int main()
+{
+    DetectionParams params;
+    check(validDetectionParams(params, ACTIVE_SAMPLE_RATE), "the default params are valid");
+    params.rate.idleRate = params.rate.activeRate;
+    check(!validDetectionParams(params, ACTIVE_SAMPLE_RATE), "equal idle and active rates are refused");
+    params.rate.idleRate = params.rate.activeRate * 2;
+    check(!validDetectionParams(params, 2 * ACTIVE_SAMPLE_RATE), "an idle rate above the active one is refused");
+
+    RateScheduler scheduler;
+    check(countSwitches(scheduler, 20000, 2000, 4000) == 2, "one burst of motion switches up and down once");
+    check(scheduler.rate() == IDLE_SAMPLE_RATE, "the rate is back to idle after the quiet period");
+
+    // a config that got past validation, or set directly: nothing to switch
+    RateSchedulerConfig equal;
+    equal.idleRate = equal.activeRate;
+    RateScheduler fixed(equal);
+    check(countSwitches(fixed, 20000, 2000, 4000) == 0, "equal rates never switch");
+    check(fixed.rate() == equal.activeRate, "equal rates keep their rate");
+
+    if (gFailures)
+    {
+        fprintf(stderr, "%zu checks failed\n", gFailures);
+        return 1;
+    }
+    printf("rate scheduler checks passed\n");
+    return 0;
+}
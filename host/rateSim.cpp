@@ -0,0 +1,166 @@
+// Simulates the adaptive IMU rate scheduler on recorded sessions. The trace
+// is recorded at the highest rate and decimated to whatever rate the
+// scheduler picks, batch by batch, the way the sensor would deliver it.
+// Reports the time spent at each rate, the number of resubscriptions and how
+// detection compares with fixed-rate subscriptions.
+//
+// usage: rateSim [--synth SECONDS] [--seed N] [--quiet MS] [--gap MS] [trace.csv ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ImuFeatures.h"
+#include "RateScheduler.h"
+#include "SplitStepDetector.h"
+#include "imuTrace.h"
+
+namespace
+{
+struct SimResult
+{
+    std::map<uint32_t, double> msAtRate;
+    size_t switches;
+    size_t samples; // samples the sensor delivered and the detector processed
+    DetectionScore score;
+    SimResult() : switches(0), samples(0) {}
+};
+
+// fixedRate == 0 runs the scheduler
+bool simulate(const ImuTrace &trace, uint32_t fixedRate, const RateSchedulerConfig &config, uint32_t gapMs,
+              SimResult &result)
+{
+    RateScheduler scheduler(config);
+    SplitStepDetector detector;
+    uint32_t rate = fixedRate ? fixedRate : scheduler.rate();
+    detector.setSampleRate(rate);
+
+    std::vector<Vec3f> acc, gyro;
+    SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    size_t i = 0;
+    while (i < trace.sampleCount())
+    {
+        if (trace.sampleRate % rate)
+        {
+            fprintf(stderr, "%s: %u Hz trace can't be decimated to %u Hz\n", trace.name.c_str(), trace.sampleRate,
+                    rate);
+            return false;
+        }
+        const size_t step = trace.sampleRate / rate;
+        const size_t perBatch = rate >= 26 ? rate / 13 : 1;
+
+        acc.clear();
+        gyro.clear();
+        const uint32_t timestamp = trace.timestamps[i];
+        for (size_t k = 0; k < perBatch && i < trace.sampleCount(); k++, i += step)
+        {
+            acc.push_back(trace.acc[i]);
+            gyro.push_back(trace.gyro[i]);
+        }
+        ImuBatch batch;
+        batch.timestamp = timestamp;
+        batch.acc = &acc[0];
+        batch.accCount = acc.size();
+        batch.gyro = &gyro[0];
+        batch.gyroCount = gyro.size();
+
+        BatchFeatures features;
+        computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, features);
+        size_t n = detector.process(batch, features, events, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+        for (size_t e = 0; e < n; e++)
+            result.score.add(trace, events[e]);
+        result.samples += acc.size();
+        result.msAtRate[rate] += acc.size() * 1000.0 / rate;
+
+        if (!fixedRate && scheduler.update(features, timestamp))
+        {
+            result.switches++;
+            rate = scheduler.rate();
+            detector.setSampleRate(rate);
+            // no data while the old subscription is torn down and the new one starts
+            while (i < trace.sampleCount() && trace.timestamps[i] < timestamp + gapMs)
+                i++;
+        }
+    }
+    return true;
+}
+
+void report(const char *name, const SimResult &r)
+{
+    double total = 0;
+    for (std::map<uint32_t, double>::const_iterator it = r.msAtRate.begin(); it != r.msAtRate.end(); ++it)
+        total += it->second;
+    printf("  %-9s %8.0f samples/s  %4zu switches  good %3zu high %3zu other %3zu  airtime err %5.1f ms ", name,
+           r.samples / (total / 1000.0), r.switches, r.score.kinds[GOOD_STEP], r.score.kinds[HIGH_STEP],
+           r.score.kinds[OTHER_FOOTWORK], r.score.meanAirtimeError());
+    for (std::map<uint32_t, double>::const_iterator it = r.msAtRate.begin(); it != r.msAtRate.end(); ++it)
+        printf(" %uHz %.1f%%", it->first, 100.0 * it->second / total);
+    printf("\n");
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: rateSim [--synth SECONDS] [--seed N] [--quiet MS] [--gap MS] [trace.csv ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t synthSeconds = 1800;
+    uint32_t seed = 1;
+    uint32_t gapMs = 20;
+    RateSchedulerConfig config;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--quiet" && hasValue)
+            config.quietPeriod = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--gap" && hasValue)
+            gapMs = (uint32_t)atoi(argv[++i]);
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+
+    std::vector<ImuTrace> corpus;
+    if (paths.empty())
+    {
+        corpus.resize(1);
+        synthesizeTrace(corpus[0], 208, synthSeconds, seed);
+    }
+    else if (!loadCorpus(paths, corpus))
+        return 1;
+
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        const ImuTrace &trace = corpus[t];
+        printf("%s: %.0f s at %u Hz, %zu labeled movements\n", trace.name.c_str(),
+               trace.sampleCount() / (double)trace.sampleRate, trace.sampleRate, trace.labels.size());
+
+        const uint32_t fixedRates[] = {52, config.activeRate};
+        for (size_t r = 0; r < 2; r++)
+        {
+            SimResult fixed;
+            char name[16];
+            snprintf(name, sizeof(name), "fixed %u", fixedRates[r]);
+            if (!simulate(trace, fixedRates[r], config, gapMs, fixed))
+                return 1;
+            report(name, fixed);
+        }
+        SimResult adaptive;
+        if (!simulate(trace, 0, config, gapMs, adaptive))
+            return 1;
+        report("adaptive", adaptive);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Compression ratio and encode/decode cost of the raw IMU streaming codec
+// (ImuCodec.h) on a recorded session, plus fragmentation over notifications
+// with simulated fragment loss.
+//
+// usage: rawBench [--rate HZ] [--payload BYTES] [--loss PERCENT] [trace.csv]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ImuCodec.h"
+#include "TxQueue.h"
+#include "imuTrace.h"
+
+int main(int argc, char **argv)
+{
+    uint32_t rate = 104;
+    size_t payload = TxQueue::DEFAULT_PAYLOAD;
+    double lossPercent = 1.0;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rate" && hasValue)
+            rate = (uint32_t) atoi(argv[++i]);
+        else if (arg == "--payload" && hasValue)
+            payload = (size_t) atoi(argv[++i]);
+        else if (arg == "--loss" && hasValue)
+            lossPercent = atof(argv[++i]);
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "usage: rawBench [--rate HZ] [--payload BYTES] [--loss PERCENT] [trace.csv]\n");
+            return 2;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    ImuTrace trace;
+    if (paths.empty())
+        synthesizeTrace(trace, rate, 600, 3);
+    else if (!loadTrace(paths[0], trace))
+        return 1;
+
+    // encode every batch, check the quantization error on the way back
+    std::vector<uint8_t> encoded(trace.batchCount() * RAW_MAX_ENCODED);
+    std::vector<size_t> offsets, lengths;
+    size_t total = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        size_t len = encodeImuBatch(trace.batch(b), &encoded[total], RAW_MAX_ENCODED);
+        if (len == 0)
+        {
+            fprintf(stderr, "batch %zu could not be encoded\n", b);
+            return 1;
+        }
+        offsets.push_back(total);
+        lengths.push_back(len);
+        total += len;
+    }
+    double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    Vec3f acc[RAW_MAX_SAMPLES], gyro[RAW_MAX_SAMPLES];
+    float worstAcc = 0, worstGyro = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        uint32_t timestamp;
+        size_t count;
+        ImuBatch batch = trace.batch(b);
+        if (!decodeImuBatch(&encoded[offsets[b]], lengths[b], timestamp, acc, gyro, RAW_MAX_SAMPLES, count) ||
+            count != batch.accCount || timestamp != batch.timestamp)
+        {
+            fprintf(stderr, "batch %zu did not decode\n", b);
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            worstAcc = fmaxf(worstAcc, fabsf(acc[i].z - batch.acc[i].z));
+            worstAcc = fmaxf(worstAcc, fabsf(acc[i].x - batch.acc[i].x));
+            worstGyro = fmaxf(worstGyro, fabsf(gyro[i].z - batch.gyro[i].z));
+        }
+    }
+    double decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    const double seconds = trace.sampleCount() / (double) trace.sampleRate;
+    const size_t floatBytes = trace.batchCount() * 4 + trace.sampleCount() * 6 * sizeof(float);
+    printf("%s: %zu batches of %zu samples\n", trace.name.c_str(), trace.batchCount(), trace.samplesPerBatch());
+    printf("  float triples  %8.0f bytes/s\n", floatBytes / seconds);
+    printf("  compressed     %8.0f bytes/s  ratio %.2f, %.1f bytes/sample\n", total / seconds,
+           (double) floatBytes / total, (double) total / trace.sampleCount());
+    printf("  encode %.0f ns/batch, decode %.0f ns/batch, max error acc %.4f m/s^2 gyro %.3f dps\n",
+           encodeNs / trace.batchCount(), decodeNs / trace.batchCount(), worstAcc, worstGyro);
+
+    // fragment over notifications of the given payload (type and tag come first) and lose some
+    RawFragmenter fragmenter;
+    RawReassembler reassembler;
+    std::vector<uint8_t> fragment(payload);
+    size_t fragments = 0, complete = 0, intact = 0;
+    uint32_t rng = 99;
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        size_t offset = 0, len;
+        while ((len = fragmenter.next(&encoded[offsets[b]], lengths[b], offset, &fragment[0], payload - 2)) > 0)
+        {
+            fragments++;
+            rng = rng * 1664525u + 1013904223u;
+            if ((rng >> 8) % 100000 < lossPercent * 1000)
+                continue;
+            if (reassembler.add(&fragment[0], len))
+            {
+                complete++;
+                if (reassembler.length() == lengths[b] &&
+                    memcmp(reassembler.data(), &encoded[offsets[b]], lengths[b]) == 0)
+                    intact++;
+            }
+        }
+    }
+    printf("  %zu byte payload: %.1f notifications/s, %.1f%% loss -> %zu/%zu batches rebuilt (%zu intact), "
+           "%u fragments detected lost\n",
+           payload, fragments / seconds, lossPercent, complete, trace.batchCount(), intact,
+           reassembler.lostFragments());
+    return intact == complete ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+// Streams recorded IMU6 traces through SplitStepDetector batch by batch, the
+// same way processData does on the sensor, and reports throughput and the
+// detected events. --export writes the first trace, as a binary trace when the
+// file name ends in .imut. --fixed also replays with the fixed-point detector
+// (FixedPoint.h), the way a FIXED_POINT_DETECTION build of the sensor runs,
+// and lists where its events differ from the float ones. Every trace is also
+// replayed as if recorded at a later uptime, up to across the uint32 wrap of
+// the timestamps, and must give the same events shifted by as much.
+//
+// usage: replay [--iterations N] [--synth SECONDS] [--rate HZ] [--seed N]
+//               [--export FILE] [--events] [--no-interp] [--fixed] [trace.csv ...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Instrumentation.h"
+#include "SplitStepDetector.h"
+#include "imuTrace.h"
+
+namespace
+{
+bool gInterpolate = true;
+bool gPrintEvents = false;
+LatencyHistogram gBatchLatency; // per batch, from the reporting passes
+
+// one pass over the trace; the reporting pass also matches events to labels
+// and keeps them in detected when given
+template <typename Detector>
+size_t replayTrace(const ImuTrace &trace, DetectionScore &score, bool report,
+                   const SplitStepConfig &config = SplitStepConfig(), std::vector<SplitStepEvent> *detected = nullptr)
+{
+    Detector detector(config);
+    detector.setSampleRate(trace.sampleRate);
+    detector.setInterpolation(gInterpolate);
+    SplitStepEvent events[Detector::MAX_EVENTS_PER_BATCH];
+    size_t total = 0;
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        size_t n;
+        if (report)
+        {
+            PerfScope scope(gBatchLatency);
+            n = detector.process(trace.batch(b), events, Detector::MAX_EVENTS_PER_BATCH);
+        }
+        else
+            n = detector.process(trace.batch(b), events, Detector::MAX_EVENTS_PER_BATCH);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!report)
+                continue;
+            score.add(trace, events[i]);
+            if (detected)
+                detected->push_back(events[i]);
+            if (gPrintEvents && events[i].kind != ZERO_G_BEGIN)
+                printf("  %-6s begin=%u end=%u airtime=%u maxZGyro=%.1f\n", eventKindName(events[i].kind),
+                       events[i].beginTime, events[i].endTime, events[i].endTime - events[i].beginTime,
+                       events[i].maxZGyro);
+        }
+        total += n;
+    }
+    return total;
+}
+
+void printScore(const ImuTrace &trace, const DetectionScore &score)
+{
+    size_t expected[EVENT_KIND_COUNT] = {0};
+    for (size_t i = 0; i < trace.labels.size(); i++)
+        expected[trace.labels[i].kind]++;
+    printf("  events: zero-g %zu, good %zu, high %zu, other %zu", score.kinds[ZERO_G_BEGIN], score.kinds[GOOD_STEP],
+           score.kinds[HIGH_STEP], score.kinds[OTHER_FOOTWORK]);
+    if (!trace.labels.empty())
+        printf(" (labeled: good %zu, high %zu, other %zu)", expected[GOOD_STEP], expected[HIGH_STEP],
+               expected[OTHER_FOOTWORK]);
+    printf("\n");
+    if (score.matched)
+        printf("  airtime error: %.1f ms mean over %zu matched landings\n", score.meanAirtimeError(), score.matched);
+}
+
+template <typename Detector>
+double timeTrace(const ImuTrace &trace, int iterations, size_t &events)
+{
+    size_t sink = 0;
+    DetectionScore scratch;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++)
+        sink += replayTrace<Detector>(trace, scratch, false);
+    events = sink / iterations;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool sameEvent(const SplitStepEvent &a, const SplitStepEvent &b)
+{
+    return a.kind == b.kind && a.beginTime == b.beginTime && a.endTime == b.endTime;
+}
+
+// the trace as if the sensor had been up for offset ms more when it was recorded
+ImuTrace shiftTrace(const ImuTrace &trace, uint32_t offset)
+{
+    ImuTrace shifted = trace;
+    for (size_t i = 0; i < shifted.timestamps.size(); i++)
+        shifted.timestamps[i] += offset;
+    for (size_t i = 0; i < shifted.labels.size(); i++)
+    {
+        shifted.labels[i].beginTime += offset;
+        shifted.labels[i].endTime += offset;
+    }
+    return shifted;
+}
+
+// Replays the trace at later uptimes, one of them across the uint32 wrap of
+// the timestamps, and counts the events that don't come out shifted by as
+// much: the sample times must not lose precision as the timestamps grow.
+template <typename Detector>
+void checkUptime(const ImuTrace &trace, const char *name, const std::vector<SplitStepEvent> &events)
+{
+    const uint32_t offsets[] = {200000000u, 1000000000u, 0u - trace.timestamps[trace.sampleCount() / 2]};
+    const size_t count = sizeof(offsets) / sizeof(offsets[0]);
+    printf("  %s at later uptimes:", name);
+    for (size_t o = 0; o < count; o++)
+    {
+        const ImuTrace shifted = shiftTrace(trace, offsets[o]);
+        Detector detector;
+        detector.setSampleRate(shifted.sampleRate);
+        detector.setInterpolation(gInterpolate);
+        SplitStepEvent found[Detector::MAX_EVENTS_PER_BATCH];
+        size_t seen = 0, differing = 0;
+        for (size_t b = 0; b < shifted.batchCount(); b++)
+        {
+            size_t n = detector.process(shifted.batch(b), found, Detector::MAX_EVENTS_PER_BATCH);
+            for (size_t i = 0; i < n; i++, seen++)
+            {
+                SplitStepEvent back = found[i];
+                back.beginTime -= offsets[o];
+                back.endTime -= offsets[o];
+                if (seen >= events.size() || !sameEvent(back, events[seen]))
+                    differing++;
+            }
+        }
+        differing += seen < events.size() ? events.size() - seen : 0;
+        printf("%s +%.1f h %zu differ%s", o ? "," : "", offsets[o] / 3600000.0, differing,
+               o == count - 1 ? " (across the wrap)" : "");
+    }
+    printf("\n");
+}
+
+// the fixed-point replay next to the float one
+void compareFixed(const ImuTrace &trace, int iterations, double floatNs, const std::vector<SplitStepEvent> &floatEvents)
+{
+    DetectionScore score;
+    std::vector<SplitStepEvent> fixedEvents;
+    replayTrace<FixedSplitStepDetector>(trace, score, true, SplitStepConfig(), &fixedEvents);
+    size_t eventCount;
+    double ns = timeTrace<FixedSplitStepDetector>(trace, iterations, eventCount);
+    printf("  fixed point: %.1f ns/batch (float %.1f)\n", ns / ((double)trace.batchCount() * iterations),
+           floatNs / ((double)trace.batchCount() * iterations));
+    printScore(trace, score);
+
+    // events in order of detection, list the first ones that don't match
+    size_t differing = 0;
+    size_t n = std::max(floatEvents.size(), fixedEvents.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        const SplitStepEvent *f = i < floatEvents.size() ? &floatEvents[i] : nullptr;
+        const SplitStepEvent *q = i < fixedEvents.size() ? &fixedEvents[i] : nullptr;
+        if (f && q && sameEvent(*f, *q))
+            continue;
+        if (differing++ < 5)
+            printf("    #%zu float %s %u-%u, fixed %s %u-%u\n", i, f ? eventKindName(f->kind) : "-",
+                   f ? f->beginTime : 0, f ? f->endTime : 0, q ? eventKindName(q->kind) : "-", q ? q->beginTime : 0,
+                   q ? q->endTime : 0);
+    }
+    printf("  %zu of %zu events differ from float\n", differing, n);
+    checkUptime<FixedSplitStepDetector>(trace, "fixed point", fixedEvents);
+}
+
+bool parseProfile(const char *text, SplitStepConfig &config)
+{
+    float begin, end, gyro;
+    unsigned good;
+    if (sscanf(text, "%f,%f,%f,%u", &begin, &end, &gyro, &good) != 4)
+        return false;
+    config.beginThreshold = begin;
+    config.endThreshold = end;
+    config.splitStepThreshold = gyro;
+    config.goodStepLength = good;
+    return true;
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: replay [--iterations N] [--synth SECONDS] [--rate HZ] [--seed N]\n"
+                    "              [--export FILE] [--events] [--no-interp] [--fixed]\n"
+                    "              [--profile BEGIN,END,GYRO,GOOD_MS] [trace.csv ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20;
+    uint32_t synthSeconds = 0;
+    uint32_t rate = 52;
+    uint32_t seed = 1;
+    const char *exportPath = nullptr;
+    bool compare = false;
+    bool fixed = false;
+    SplitStepConfig profile;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+            iterations = atoi(argv[++i]);
+        else if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--export" && hasValue)
+            exportPath = argv[++i];
+        else if (arg == "--events")
+            gPrintEvents = true;
+        else if (arg == "--no-interp")
+            gInterpolate = false;
+        else if (arg == "--fixed")
+            fixed = true;
+        else if (arg == "--profile" && hasValue)
+        {
+            if (!parseProfile(argv[++i], profile))
+                usage();
+            compare = true;
+        }
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+    if (iterations < 1)
+        usage();
+
+    std::vector<ImuTrace> corpus;
+    if (synthSeconds)
+    {
+        corpus.resize(1);
+        synthesizeTrace(corpus[0], rate, synthSeconds, seed);
+    }
+    else if (!loadCorpus(paths, corpus))
+        return 1;
+
+    if (exportPath)
+    {
+        bool saved = isBinaryTrace(exportPath) ? saveBinaryTrace(exportPath, corpus[0]) : saveTrace(exportPath, corpus[0]);
+        return saved ? 0 : 1;
+    }
+
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        const ImuTrace &trace = corpus[t];
+        printf("%s: %zu samples at %u Hz, %zu batches\n", trace.name.c_str(), trace.sampleCount(),
+               trace.sampleRate, trace.batchCount());
+
+        DetectionScore score;
+        std::vector<SplitStepEvent> events;
+        gBatchLatency.reset();
+        replayTrace<SplitStepDetector>(trace, score, true, SplitStepConfig(), &events);
+
+        // timed passes, events are already counted above
+        size_t eventCount;
+        double ns = timeTrace<SplitStepDetector>(trace, iterations, eventCount);
+
+        double samples = (double)trace.sampleCount() * iterations;
+        double batches = (double)trace.batchCount() * iterations;
+        printf("  %.1f Msamples/s, %.1f ns/batch (%d iterations, %zu events)\n", samples / ns * 1e3, ns / batches,
+               iterations, eventCount);
+
+        printScore(trace, score);
+        printf("  batch latency: p50 < %u ns, p99 < %u ns, max %u ns\n", gBatchLatency.quantile(0.5f) + 1,
+               gBatchLatency.quantile(0.99f) + 1, gBatchLatency.max());
+
+        if (compare)
+        {
+            DetectionScore other;
+            replayTrace<SplitStepDetector>(trace, other, true, profile);
+            printf("  profile %.1f,%.1f,%.1f,%u:\n", profile.beginThreshold, profile.endThreshold,
+                   profile.splitStepThreshold, profile.goodStepLength);
+            printScore(trace, other);
+        }
+        checkUptime<SplitStepDetector>(trace, "float", events);
+        if (fixed)
+            compareFixed(trace, iterations, ns, events);
+    }
+    return 0;
+}
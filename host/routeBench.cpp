@@ -0,0 +1,168 @@
+// Dispatch cost of a data notification as the subscription count grows: the
+// linear DataSub scan myApp used before against RouteTable. A random
+// subscribe/unsubscribe workload, with shared resources, is checked against a
+// std::map first.
+//
+// usage: routeBench [--notifications N]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "RouteTable.h"
+
+namespace
+{
+struct DataSub
+{
+    uint32_t resource;
+    uint8_t clientReference;
+};
+
+const uint32_t INVALID_RESOURCE = 0xffffffff;
+
+// the scan findDataSub did
+template <size_t N>
+int linearFind(const DataSub (&subs)[N], uint32_t resource)
+{
+    for (size_t i = 0; i < N; i++)
+        if (subs[i].resource == resource)
+            return (int)i;
+    return -1;
+}
+
+uint32_t gRandom = 12345;
+uint32_t nextRandom()
+{
+    gRandom ^= gRandom << 13;
+    gRandom ^= gRandom >> 17;
+    gRandom ^= gRandom << 5;
+    return gRandom;
+}
+
+// resource keys look like a local resource id with the sample rate as instance
+uint32_t resourceKey(uint32_t i)
+{
+    return (300 + i % 40) | ((13u << (i % 5)) << 16);
+}
+
+// random subscribe/unsubscribe, resources shared by several references included
+template <size_t N>
+bool check()
+{
+    RouteTable<N> table;
+    std::map<uint32_t, std::vector<int> > byResource;
+    std::map<uint8_t, int> byReference;
+    for (int step = 0; step < 200000; step++)
+    {
+        uint32_t resource = resourceKey(nextRandom() % (N + 4));
+        uint8_t reference = (uint8_t)(1 + nextRandom() % 250);
+        int slot = table.findReference(reference);
+        if (slot != RouteTable<N>::NONE)
+        {
+            if (byReference[reference] != slot)
+                return false;
+            std::vector<int> &slots = byResource[table.resource(slot)];
+            slots.erase(std::find(slots.begin(), slots.end(), slot));
+            if (slots.empty())
+                byResource.erase(table.resource(slot));
+            byReference.erase(reference);
+            table.remove(slot);
+        }
+        else
+        {
+            slot = table.add(reference);
+            if ((slot == RouteTable<N>::NONE) != (byReference.size() == N))
+                return false;
+            if (slot == RouteTable<N>::NONE)
+                continue;
+            byReference[reference] = slot;
+            table.bind(slot, resource);
+            byResource[resource].push_back(slot);
+        }
+        // every routed resource must still lead to its slots, in bind order
+        for (std::map<uint32_t, std::vector<int> >::const_iterator it = byResource.begin(); it != byResource.end();
+             ++it)
+        {
+            int s = table.findResource(it->first);
+            for (size_t i = 0; i < it->second.size(); i++, s = table.next(s))
+                if (s != it->second[i] || table.shared(s) != (it->second.size() > 1))
+                    return false;
+            if (s != RouteTable<N>::NONE)
+                return false;
+        }
+    }
+    return true;
+}
+
+volatile int gSink;
+
+template <size_t N>
+bool bench(size_t notifications)
+{
+    if (!check<N>())
+    {
+        fprintf(stderr, "RouteTable<%zu> disagrees with std::map\n", N);
+        return false;
+    }
+
+    // N subscriptions to distinct resources, notifications spread over them
+    DataSub subs[N];
+    RouteTable<N> table;
+    std::vector<uint32_t> resources;
+    for (size_t i = 0; i < N; i++)
+    {
+        subs[i].resource = resourceKey((uint32_t)i * 7);
+        subs[i].clientReference = (uint8_t)(i + 1);
+        int slot = table.add(subs[i].clientReference);
+        table.bind(slot, subs[i].resource);
+        resources.push_back(subs[i].resource);
+    }
+    // the last notification of a replaced subscription, like after a rate switch
+    resources.push_back(INVALID_RESOURCE - 1);
+    std::vector<uint32_t> stream(notifications);
+    for (size_t i = 0; i < notifications; i++)
+        stream[i] = resources[nextRandom() % resources.size()];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int sink = 0;
+    for (size_t i = 0; i < notifications; i++)
+        sink += linearFind(subs, stream[i]);
+    double linearNs =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / notifications;
+    gSink = sink;
+
+    start = std::chrono::steady_clock::now();
+    sink = 0;
+    for (size_t i = 0; i < notifications; i++)
+        sink += table.findResource(stream[i]);
+    double tableNs =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / notifications;
+    gSink = sink;
+
+    printf("%-6zu %12.2f %12.2f %8zu\n", N, linearNs, tableNs, sizeof(table));
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t notifications = 5000000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--notifications") == 0 && i + 1 < argc)
+            notifications = (size_t)atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: routeBench [--notifications N]\n");
+            return 2;
+        }
+    }
+
+    printf("%-6s %12s %12s %8s\n", "subs", "linear ns", "table ns", "bytes");
+    bool ok = bench<4>(notifications) && bench<8>(notifications) && bench<16>(notifications) &&
+              bench<32>(notifications) && bench<64>(notifications) && bench<128>(notifications);
+    return ok ? 0 : 1;
+}
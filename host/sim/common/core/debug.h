@@ -0,0 +1,13 @@
+#pragma once
+// Debug output of the app. Quiet unless built with SIM_DEBUGLOG, the event
+// loop would otherwise drown in it.
+#include <assert.h>
+#include <stdio.h>
+
+#ifdef SIM_DEBUGLOG
+#define DEBUGLOG(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#else
+#define DEBUGLOG(...) ((void)0)
+#endif
+
+#define ASSERT(condition) assert(condition)
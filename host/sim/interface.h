@@ -0,0 +1,3 @@
+#pragma once
+// interface.cpp declares everything it uses itself, the device header is empty
+#include "myApp.h"
@@ -0,0 +1,3 @@
+#pragma once
+#include "whiteboard/wb.h"
+#include "wbResources.h"
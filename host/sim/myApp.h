@@ -0,0 +1,79 @@
+#pragma once
+// Declaration of the app module as myApp.cpp and interface.cpp define it. The
+// device build takes the header from the app directory of the Movesense
+// device library; this copy lets the host build compile the same sources.
+#include <whiteboard/LaunchableModule.h>
+#include <whiteboard/ResourceClient.h>
+
+class myApp FINAL : private wb::ResourceClient, public wb::LaunchableModule
+{
+public:
+    /** Name of this class. Used in StartupProvider list. */
+    static const char* const LAUNCHABLE_NAME;
+    myApp();
+    ~myApp();
+
+private:
+    /** @see whiteboard::ILaunchableModule::initModule */
+    virtual bool initModule() OVERRIDE;
+    /** @see whiteboard::ILaunchableModule::deinitModule */
+    virtual void deinitModule() OVERRIDE;
+    /** @see whiteboard::ILaunchableModule::startModule */
+    virtual bool startModule() OVERRIDE;
+    /** @see whiteboard::ILaunchableModule::stopModule */
+    virtual void stopModule() OVERRIDE;
+
+    virtual void onGetResult(wb::RequestId requestId, wb::ResourceId resourceId, wb::Result resultCode,
+                             const wb::Value& rResultData) OVERRIDE;
+    virtual void onPostResult(wb::RequestId requestId, wb::ResourceId resourceId, wb::Result resultCode,
+                              const wb::Value& rResultData) OVERRIDE;
+    virtual void onSubscribeResult(wb::RequestId requestId, wb::ResourceId resourceId, wb::Result resultCode,
+                                   const wb::Value& rResultData) OVERRIDE;
+    virtual void onNotify(wb::ResourceId resourceId, const wb::Value& rValue,
+                          const wb::ParameterList& rParameters) OVERRIDE;
+    virtual void onTimer(wb::TimerId timerId) OVERRIDE;
+
+    void configGattSvc();
+    void handleIncomingCommand(const wb::Array<uint8> &commandData);
+    void handleCommand(uint8_t cmd, const uint8_t values[], size_t len);
+    void processData(wb::ResourceId resourceId, const wb::Value &value);
+    void sendWithNumber(char *message, int number);
+    void sendPacket(const uint8_t data[], size_t len, uint8_t tag=0, uint8_t type=2);
+    bool subscribe(const char path[], size_t pathlen, uint8_t reference);
+    void unsubscribe(uint8_t reference);
+    void unsubscribeAllStreams();
+    size_t serializeData(wb::ResourceId resourceId, const wb::Value &value);
+
+    void ledSet(bool on);
+    void ledSetPattern_n(uint16_t* pattern, size_t length, bool startOn=true);
+    void ledSetPattern(uint16_t* pattern, bool startOn=true);
+    void ledSetPattern(uint16_t onDuration, uint16_t offDuration, size_t repetitions, bool startOn=true);
+
+    wb::ResourceId mCommandCharResource;
+    wb::ResourceId mDataCharResource;
+    bool mNotificationsEnabled;
+    int32_t mSensorSvcHandle;
+    int32_t mCommandCharHandle;
+    int32_t mDataCharHandle;
+
+    struct DataSub
+    {
+        wb::ResourceId resourceId;
+        uint8_t clientReference;
+        bool subStarted;
+        bool subCompleted;
+    };
+    static const size_t MAX_DATASUB_COUNT = 4;
+    DataSub mDataSubs[MAX_DATASUB_COUNT];
+    DataSub* findDataSub(const wb::ResourceId resourceId);
+    DataSub* findDataSubByRef(const uint8_t clientReference);
+
+    uint8_t mSerializedData[200];
+
+    wb::TimerId mLedTimer;
+    bool ledStatus;
+    size_t mLedPatternRemaining;
+    uint16_t* mLedRepeatPtr;
+    uint16_t* mLedInstructionPtr;
+    uint16_t mRepeatingPattern[2];
+};
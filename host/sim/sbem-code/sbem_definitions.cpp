@@ -0,0 +1,29 @@
+#include "sbem_definitions.h"
+
+size_t getSbemLength(wb::LocalResourceId localResourceId, const wb::Value &value)
+{
+    if (localResourceId != WB_RES::LOCAL::MEAS_IMU6_SAMPLERATE::LID)
+        return 0;
+    const WB_RES::IMU6Data &data = value.convertTo<const WB_RES::IMU6Data &>();
+    size_t count = data.arrayAcc.size();
+    return count > 255 ? 0 : 5 + count * 2 * sizeof(wb::FloatVector3D);
+}
+
+size_t writeToSbemBuffer(void *buffer, size_t bufferSize, size_t offset, wb::LocalResourceId localResourceId,
+                         const wb::Value &value)
+{
+    size_t length = getSbemLength(localResourceId, value);
+    if (length == 0 || offset + length > bufferSize)
+        return 0;
+    const WB_RES::IMU6Data &data = value.convertTo<const WB_RES::IMU6Data &>();
+    uint8_t *out = static_cast<uint8_t *>(buffer) + offset;
+    size_t count = data.arrayAcc.size();
+    memcpy(out, &data.timestamp, 4);
+    out[4] = (uint8_t) count;
+    out += 5;
+    for (size_t i = 0; i < count; i++, out += sizeof(wb::FloatVector3D))
+        memcpy(out, &data.arrayAcc[i], sizeof(wb::FloatVector3D));
+    for (size_t i = 0; i < count; i++, out += sizeof(wb::FloatVector3D))
+        memcpy(out, &data.arrayGyro[i], sizeof(wb::FloatVector3D));
+    return length;
+}
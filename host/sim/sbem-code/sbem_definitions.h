@@ -0,0 +1,10 @@
+#pragma once
+// Stand-in for the SBEM serializer. Writes IMU6 data as
+//   [timestamp (4), count (1), acc (count * 12), gyro (count * 12)]
+// in host byte order, not real SBEM chunks, but of about the same size so
+// raw streaming costs the same link time.
+#include "wbResources.h"
+
+size_t getSbemLength(wb::LocalResourceId localResourceId, const wb::Value &value);
+size_t writeToSbemBuffer(void *buffer, size_t bufferSize, size_t offset, wb::LocalResourceId localResourceId,
+                         const wb::Value &value);
@@ -0,0 +1,645 @@
+#include "simRuntime.h"
+#include <stdio.h>
+#include "DetectionParams.h"
+
+namespace
+{
+const uint16_t FIRST_GATT_HANDLE = 32; // below are the services of the device library
+}
+
+SimRuntime &SimRuntime::instance()
+{
+    static SimRuntime runtime;
+    return runtime;
+}
+
+SimRuntime::SimRuntime()
+    : mNow(0), mSequence(0), mNextRequest(1), mNextTimer(wb::ID_INVALID_TIMER), mNextHandle(FIRST_GATT_HANDLE),
+      mImuGeneration(0), mConnected(false), mNotifying(false), mLinkLatency(7500), mImuBatches(0),
+      mHrTrace(nullptr), mHrGeneration(0), mHrNotifications(0), mRefusedNotifications(0)
+{
+    mTrace.name = "";
+    mTrace.sampleRate = 0;
+    mTrace.sampleCount = 0;
+    mTrace.timestamps = nullptr;
+    mTrace.acc = nullptr;
+    mTrace.gyro = nullptr;
+    mTrace.labels = nullptr;
+    mTrace.labelCount = 0;
+}
+
+void SimRuntime::setTime(uint64_t time)
+{
+    mNow = time > mNow ? time : mNow;
+}
+
+void SimRuntime::at(uint64_t time, const std::function<void()> &action)
+{
+    Event event;
+    event.time = time > mNow ? time : mNow;
+    event.sequence = mSequence++;
+    event.action = action;
+    mEvents.push(event);
+}
+
+bool SimRuntime::runOne()
+{
+    if (mEvents.empty())
+        return false;
+    Event event = mEvents.top();
+    mEvents.pop();
+    mNow = event.time;
+    event.action();
+    return true;
+}
+
+void SimRuntime::runUntil(uint64_t time)
+{
+    while (!mEvents.empty() && mEvents.top().time <= time)
+        runOne();
+    setTime(time);
+}
+
+bool SimRuntime::launch(wb::LaunchableModule &module)
+{
+    return module.initModule() && module.startModule();
+}
+
+void SimRuntime::connect()
+{
+    mConnected = true;
+    notifyPeers(WB_RES::PeerState::CONNECTED);
+}
+
+void SimRuntime::disconnect()
+{
+    // the client configuration goes with the link
+    mConnected = false;
+    mNotifying = false;
+    notifyPeers(WB_RES::PeerState::DISCONNECTED);
+}
+
+bool SimRuntime::setNotifications(bool enabled)
+{
+    uint16_t serviceHandle;
+    const GattCharacteristic *c = findCharacteristic(WB_RES::GattProperty::NOTIFY, serviceHandle);
+    if (!c || !mConnected)
+        return false;
+    mNotifying = enabled;
+    WB_RES::Characteristic value;
+    value.notifications = wb::Optional<bool>(enabled);
+    notifyCharacteristic(*c, serviceHandle, value);
+    return true;
+}
+
+bool SimRuntime::writeCommand(const uint8_t data[], size_t len)
+{
+    uint16_t serviceHandle;
+    const GattCharacteristic *c = findCharacteristic(WB_RES::GattProperty::WRITE, serviceHandle);
+    if (!c || !mConnected || len == 0)
+        return false;
+    std::vector<uint8_t> bytes(data, data + len);
+    WB_RES::Characteristic value;
+    value.bytes = wb::MakeArray<uint8_t>(bytes.data(), bytes.size());
+    notifyCharacteristic(*c, serviceHandle, value);
+    return true;
+}
+
+void SimRuntime::attach(wb::ResourceClient *client)
+{
+    mClients.insert(client);
+}
+
+void SimRuntime::detach(wb::ResourceClient *client)
+{
+    mClients.erase(client);
+    for (std::map<uint32_t, std::vector<wb::ResourceClient *> >::iterator it = mSubscribers.begin();
+         it != mSubscribers.end(); ++it)
+    {
+        std::vector<wb::ResourceClient *> &list = it->second;
+        for (size_t i = 0; i < list.size();)
+            if (list[i] == client)
+                list.erase(list.begin() + i);
+            else
+                i++;
+    }
+    for (std::map<wb::TimerId, Timer>::iterator it = mTimers.begin(); it != mTimers.end();)
+        if (it->second.client == client)
+            mTimers.erase(it++);
+        else
+            ++it;
+}
+
+wb::Result SimRuntime::getResource(const char *path, wb::ResourceId &resourceId)
+{
+    unsigned rate;
+    int serviceHandle, charHandle;
+    char tail;
+    if (sscanf(path, "/Meas/IMU6/%u%c", &rate, &tail) == 1)
+    {
+        if (!supportedSampleRate(rate))
+            return wb::HTTP_CODE_NOT_FOUND;
+        resourceId = wb::ResourceId(WB_RES::LOCAL::MEAS_IMU6_SAMPLERATE::LID, (uint16_t) rate);
+        return wb::HTTP_CODE_OK;
+    }
+    if (strcmp(path, "Component/Led") == 0 || strcmp(path, "/Component/Led") == 0)
+    {
+        resourceId = WB_RES::LOCAL::COMPONENT_LED();
+        return wb::HTTP_CODE_OK;
+    }
+    if (strcmp(path, "/Meas/HR") == 0)
+    {
+        resourceId = WB_RES::LOCAL::MEAS_HR();
+        return wb::HTTP_CODE_OK;
+    }
+    if (sscanf(path, "/Comm/Ble/GattSvc/%d/%d%c", &serviceHandle, &charHandle, &tail) == 2)
+    {
+        for (size_t i = 0; i < mServices.size(); i++)
+        {
+            if (mServices[i].handle != serviceHandle)
+                continue;
+            for (size_t j = 0; j < mServices[i].chars.size(); j++)
+                if (mServices[i].chars[j].handle == charHandle)
+                {
+                    resourceId = wb::ResourceId(WB_RES::LOCAL::COMM_BLE_GATTSVC_SVCHANDLE_CHARHANDLE::LID,
+                                                (uint16_t) charHandle);
+                    return wb::HTTP_CODE_OK;
+                }
+        }
+    }
+    return wb::HTTP_CODE_NOT_FOUND;
+}
+
+wb::Result SimRuntime::subscribe(wb::ResourceClient *client, wb::ResourceId resourceId)
+{
+    wb::Result code = wb::HTTP_CODE_OK;
+    switch (resourceId.localResourceId)
+    {
+    case WB_RES::LOCAL::COMM_BLE_PEERS::LID:
+    case WB_RES::LOCAL::COMM_BLE_GATTSVC_SVCHANDLE_CHARHANDLE::LID:
+        break;
+    case WB_RES::LOCAL::MEAS_IMU6_SAMPLERATE::LID:
+        if (!supportedSampleRate(resourceId.instanceId))
+            code = wb::HTTP_CODE_NOT_FOUND;
+        break;
+    case WB_RES::LOCAL::MEAS_HR::LID:
+        break;
+    default:
+        code = wb::HTTP_CODE_NOT_FOUND;
+        break;
+    }
+    if (code == wb::HTTP_CODE_OK && !subscribed(client, resourceId))
+    {
+        std::vector<wb::ResourceClient *> &list = mSubscribers[key(resourceId)];
+        list.push_back(client);
+        if (resourceId.localResourceId == WB_RES::LOCAL::MEAS_IMU6_SAMPLERATE::LID && list.size() == 1)
+            startImu(resourceId);
+        if (resourceId.localResourceId == WB_RES::LOCAL::MEAS_HR::LID && list.size() == 1)
+            startHr();
+    }
+
+    // the result comes after the request returned, as with ForceAsync
+    wb::RequestId requestId = mNextRequest++;
+    after(0, [this, client, requestId, resourceId, code]() {
+        if (!alive(client))
+            return;
+        int empty = 0;
+        client->onSubscribeResult(requestId, resourceId, code, wb::Value(empty));
+    });
+    return wb::HTTP_CODE_ACCEPTED;
+}
+
+wb::Result SimRuntime::unsubscribe(wb::ResourceClient *client, wb::ResourceId resourceId)
+{
+    std::map<uint32_t, std::vector<wb::ResourceClient *> >::iterator it = mSubscribers.find(key(resourceId));
+    if (it == mSubscribers.end())
+        return wb::HTTP_CODE_NOT_FOUND;
+    std::vector<wb::ResourceClient *> &list = it->second;
+    for (size_t i = 0; i < list.size(); i++)
+        if (list[i] == client)
+        {
+            list.erase(list.begin() + i);
+            break;
+        }
+    if (list.empty())
+    {
+        mSubscribers.erase(it);
+        // the batches already scheduled see the stream gone and stop
+        mImuStreams.erase(key(resourceId));
+        if (resourceId.localResourceId == WB_RES::LOCAL::MEAS_HR::LID)
+            mHrGeneration++;
+    }
+    return wb::HTTP_CODE_OK;
+}
+
+wb::Result SimRuntime::put(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value)
+{
+    wb::Result code = wb::HTTP_CODE_NOT_FOUND;
+    uint64_t delay = 0;
+    if (resourceId.localResourceId == WB_RES::LOCAL::COMPONENT_LED::LID)
+    {
+        LedChange change;
+        change.time = mNow;
+        change.on = value.convertTo<bool>();
+        mLedChanges.push_back(change);
+        code = wb::HTTP_CODE_OK;
+    }
+    else if (resourceId.localResourceId == WB_RES::LOCAL::COMM_BLE_GATTSVC_SVCHANDLE_CHARHANDLE::LID)
+    {
+        const WB_RES::Characteristic &c = value.convertTo<const WB_RES::Characteristic &>();
+        if (!mConnected || !mNotifying)
+        {
+            // nobody listens, the stack rejects the notification
+            code = wb::HTTP_CODE_BAD_REQUEST;
+            mRefusedNotifications++;
+        }
+        else
+        {
+            Notification notification;
+            notification.time = mNow;
+            for (size_t i = 0; i < c.bytes.size(); i++)
+                notification.bytes.push_back(c.bytes[i]);
+            mNotifications.push_back(notification);
+            code = wb::HTTP_CODE_OK;
+            // the put completes when the notification went out with the next connection event
+            delay = mLinkLatency;
+        }
+    }
+
+    wb::RequestId requestId = mNextRequest++;
+    after(delay, [this, client, requestId, resourceId, code]() {
+        if (!alive(client))
+            return;
+        int empty = 0;
+        client->onPutResult(requestId, resourceId, code, wb::Value(empty));
+    });
+    return wb::HTTP_CODE_ACCEPTED;
+}
+
+wb::Result SimRuntime::post(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value)
+{
+    if (resourceId.localResourceId != WB_RES::LOCAL::COMM_BLE_GATTSVC::LID)
+        return wb::HTTP_CODE_NOT_FOUND;
+
+    // copies the service and hands out its handles, the characteristics follow the service
+    const WB_RES::GattSvc &svc = value.convertTo<const WB_RES::GattSvc &>();
+    GattService service;
+    for (size_t i = 0; i < svc.uuid.size(); i++)
+        service.uuid.push_back(svc.uuid[i]);
+    service.handle = mNextHandle++;
+    for (size_t i = 0; i < svc.chars.size(); i++)
+    {
+        GattCharacteristic c;
+        for (size_t j = 0; j < svc.chars[i].uuid.size(); j++)
+            c.uuid.push_back(svc.chars[i].uuid[j]);
+        for (size_t j = 0; j < svc.chars[i].props.size(); j++)
+            c.props.push_back(svc.chars[i].props[j]);
+        c.handle = mNextHandle++;
+        service.chars.push_back(c);
+    }
+    mServices.push_back(service);
+
+    wb::RequestId requestId = mNextRequest++;
+    uint16_t handle = service.handle;
+    after(0, [this, client, requestId, resourceId, handle]() {
+        if (!alive(client))
+            return;
+        uint16_t result = handle;
+        client->onPostResult(requestId, resourceId, wb::HTTP_CODE_CREATED, wb::Value(result));
+    });
+    return wb::HTTP_CODE_ACCEPTED;
+}
+
+wb::Result SimRuntime::get(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value)
+{
+    if (resourceId.localResourceId == WB_RES::LOCAL::TIME_DETAILED::LID)
+    {
+        // the sensor clock is the simulated one, read when the request is served
+        wb::RequestId requestId = mNextRequest++;
+        after(0, [this, client, requestId, resourceId]() {
+            if (!alive(client))
+                return;
+            WB_RES::DetailedTime time;
+            time.utcTime = 0;
+            time.relativeTime = nowMs();
+            client->onGetResult(requestId, resourceId, wb::HTTP_CODE_OK, wb::Value(time));
+        });
+        return wb::HTTP_CODE_ACCEPTED;
+    }
+    if (resourceId.localResourceId != WB_RES::LOCAL::COMM_BLE_GATTSVC_SVCHANDLE::LID)
+        return wb::HTTP_CODE_NOT_FOUND;
+
+    int32_t handle = value.convertTo<int32_t>();
+    wb::RequestId requestId = mNextRequest++;
+    after(0, [this, client, requestId, resourceId, handle]() {
+        if (!alive(client))
+            return;
+        const GattService *service = nullptr;
+        for (size_t i = 0; i < mServices.size(); i++)
+            if (mServices[i].handle == handle)
+                service = &mServices[i];
+        int empty = 0;
+        if (!service)
+        {
+            client->onGetResult(requestId, resourceId, wb::HTTP_CODE_NOT_FOUND, wb::Value(empty));
+            return;
+        }
+        std::vector<WB_RES::GattChar> chars(service->chars.size());
+        for (size_t i = 0; i < chars.size(); i++)
+        {
+            const GattCharacteristic &c = service->chars[i];
+            chars[i].props = wb::MakeArray<WB_RES::GattProperty>(c.props.data(), c.props.size());
+            chars[i].uuid = wb::MakeArray<uint8_t>(c.uuid.data(), c.uuid.size());
+            chars[i].handle = wb::Optional<uint16_t>(c.handle);
+        }
+        WB_RES::GattSvc svc;
+        svc.uuid = wb::MakeArray<uint8_t>(service->uuid.data(), service->uuid.size());
+        svc.chars = wb::MakeArray<WB_RES::GattChar>(chars.data(), chars.size());
+        svc.handle = wb::Optional<uint16_t>(service->handle);
+        client->onGetResult(requestId, resourceId, wb::HTTP_CODE_OK, wb::Value(svc));
+    });
+    return wb::HTTP_CODE_ACCEPTED;
+}
+
+wb::TimerId SimRuntime::startTimer(wb::ResourceClient *client, size_t periodMs, bool continuous)
+{
+    wb::TimerId timerId = ++mNextTimer;
+    Timer timer;
+    timer.client = client;
+    timer.period = (uint64_t) periodMs * 1000;
+    timer.continuous = continuous;
+    mTimers[timerId] = timer;
+    after(timer.period, [this, timerId]() { fireTimer(timerId); });
+    return timerId;
+}
+
+bool SimRuntime::stopTimer(wb::TimerId timerId)
+{
+    return mTimers.erase(timerId) != 0;
+}
+
+void SimRuntime::fireTimer(wb::TimerId timerId)
+{
+    std::map<wb::TimerId, Timer>::iterator it = mTimers.find(timerId);
+    if (it == mTimers.end())
+        return;
+    wb::ResourceClient *client = it->second.client;
+    if (it->second.continuous)
+        after(it->second.period, [this, timerId]() { fireTimer(timerId); });
+    else
+        mTimers.erase(it);
+    client->onTimer(timerId);
+}
+
+bool SimRuntime::subscribed(wb::ResourceClient *client, wb::ResourceId resourceId) const
+{
+    std::map<uint32_t, std::vector<wb::ResourceClient *> >::const_iterator it = mSubscribers.find(key(resourceId));
+    if (it == mSubscribers.end())
+        return false;
+    for (size_t i = 0; i < it->second.size(); i++)
+        if (it->second[i] == client)
+            return true;
+    return false;
+}
+
+std::vector<wb::ResourceClient *> SimRuntime::subscribers(wb::ResourceId resourceId) const
+{
+    std::map<uint32_t, std::vector<wb::ResourceClient *> >::const_iterator it = mSubscribers.find(key(resourceId));
+    return it == mSubscribers.end() ? std::vector<wb::ResourceClient *>() : it->second;
+}
+
+const SimRuntime::GattCharacteristic *SimRuntime::findCharacteristic(WB_RES::GattProperty::Type prop,
+                                                                      uint16_t &serviceHandle) const
+{
+    for (size_t i = 0; i < mServices.size(); i++)
+        for (size_t j = 0; j < mServices[i].chars.size(); j++)
+        {
+            const GattCharacteristic &c = mServices[i].chars[j];
+            for (size_t k = 0; k < c.props.size(); k++)
+                if (c.props[k] == prop)
+                {
+                    serviceHandle = mServices[i].handle;
+                    return &c;
+                }
+        }
+    return nullptr;
+}
+
+void SimRuntime::notifyCharacteristic(const GattCharacteristic &c, uint16_t serviceHandle,
+                                      const WB_RES::Characteristic &value)
+{
+    wb::ResourceId resourceId(WB_RES::LOCAL::COMM_BLE_GATTSVC_SVCHANDLE_CHARHANDLE::LID, c.handle);
+    wb::ParameterList parameters = {{serviceHandle, c.handle, 0, 0}};
+    std::vector<wb::ResourceClient *> list = subscribers(resourceId);
+    for (size_t i = 0; i < list.size(); i++)
+        if (alive(list[i]) && subscribed(list[i], resourceId))
+            list[i]->onNotify(resourceId, wb::Value(value), parameters);
+}
+
+void SimRuntime::notifyPeers(WB_RES::PeerState::Type state)
+{
+    wb::ResourceId resourceId = WB_RES::LOCAL::COMM_BLE_PEERS();
+    wb::ParameterList parameters = {{0, 0, 0, 0}};
+    WB_RES::PeerChange change;
+    change.state = state;
+    std::vector<wb::ResourceClient *> list = subscribers(resourceId);
+    for (size_t i = 0; i < list.size(); i++)
+        if (alive(list[i]) && subscribed(list[i], resourceId))
+            list[i]->onNotify(resourceId, wb::Value(change), parameters);
+}
+
+void SimRuntime::startImu(wb::ResourceId resourceId)
+{
+    ImuStream &stream = mImuStreams[key(resourceId)];
+    stream.generation = ++mImuGeneration;
+    stream.start = mNow;
+    stream.produced = 0;
+    stream.cursor = 0;
+    const uint32_t rate = resourceId.instanceId;
+    const uint64_t samples = rate >= 26 ? rate / 13 : 1;
+    // a batch leaves with its last sample
+    const uint32_t generation = stream.generation;
+    at(stream.start + (samples - 1) * 1000000 / rate,
+       [this, resourceId, generation]() { produceImu(resourceId, generation); });
+}
+
+void SimRuntime::produceImu(wb::ResourceId resourceId, uint32_t generation)
+{
+    std::map<uint32_t, ImuStream>::iterator it = mImuStreams.find(key(resourceId));
+    if (it == mImuStreams.end() || it->second.generation != generation)
+        return;
+    ImuStream &stream = it->second;
+    const uint32_t rate = resourceId.instanceId;
+    const size_t samples = rate >= 26 ? rate / 13 : 1;
+    if (mTrace.sampleCount == 0)
+        return;
+
+    // nearest trace sample to every sample time, the trace starts with the simulation
+    std::vector<wb::FloatVector3D> acc(samples), gyro(samples);
+    const uint32_t traceStart = mTrace.timestamps[0];
+    const uint32_t traceEnd = mTrace.timestamps[mTrace.sampleCount - 1];
+    uint32_t firstTime = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        uint64_t time = stream.start + (stream.produced + i) * 1000000 / rate;
+        uint32_t target = traceStart + (uint32_t) (time / 1000);
+        if (target > traceEnd)
+        {
+            // the trace is over, so is the stream
+            mImuStreams.erase(it);
+            return;
+        }
+        size_t &cursor = stream.cursor;
+        while (cursor + 1 < mTrace.sampleCount && mTrace.timestamps[cursor + 1] <= target)
+            cursor++;
+        if (cursor + 1 < mTrace.sampleCount &&
+            mTrace.timestamps[cursor + 1] - target < target - mTrace.timestamps[cursor])
+            cursor++;
+        const Vec3f &a = mTrace.acc[cursor];
+        const Vec3f &g = mTrace.gyro[cursor];
+        acc[i].x = a.x;
+        acc[i].y = a.y;
+        acc[i].z = a.z;
+        gyro[i].x = g.x;
+        gyro[i].y = g.y;
+        gyro[i].z = g.z;
+        if (i == 0)
+            firstTime = (uint32_t) (time / 1000);
+    }
+    stream.produced += samples;
+
+    WB_RES::IMU6Data data;
+    data.timestamp = firstTime;
+    data.arrayAcc = wb::MakeArray<wb::FloatVector3D>(acc.data(), acc.size());
+    data.arrayGyro = wb::MakeArray<wb::FloatVector3D>(gyro.data(), gyro.size());
+    const uint64_t next = stream.start + (stream.produced + samples - 1) * 1000000 / rate;
+    at(next, [this, resourceId, generation]() { produceImu(resourceId, generation); });
+
+    mImuBatches++;
+    wb::ParameterList parameters = {{0, 0, 0, 0}};
+    std::vector<wb::ResourceClient *> list = subscribers(resourceId);
+    for (size_t i = 0; i < list.size(); i++)
+        if (alive(list[i]) && subscribed(list[i], resourceId))
+            list[i]->onNotify(resourceId, wb::Value(data), parameters);
+}
+
+void SimRuntime::startHr()
+{
+    const uint32_t generation = ++mHrGeneration;
+    if (!mHrTrace)
+        return;
+    // the notifications from now on
+    const std::vector<HrNotification> &list = mHrTrace->notifications;
+    size_t index = 0;
+    while (index < list.size() && (uint64_t) list[index].time * 1000 < mNow)
+        index++;
+    if (index < list.size())
+        at((uint64_t) list[index].time * 1000, [this, generation, index]() { produceHr(generation, index); });
+}
+
+void SimRuntime::produceHr(uint32_t generation, size_t index)
+{
+    if (generation != mHrGeneration)
+        return;
+    const HrNotification &n = mHrTrace->notifications[index];
+    if (index + 1 < mHrTrace->notifications.size())
+        at((uint64_t) mHrTrace->notifications[index + 1].time * 1000,
+           [this, generation, index]() { produceHr(generation, index + 1); });
+
+    WB_RES::HRData data;
+    data.average = n.average;
+    data.rrData = wb::MakeArray<uint16>(n.rr.data(), n.rr.size());
+    mHrNotifications++;
+    wb::ResourceId resourceId = WB_RES::LOCAL::MEAS_HR();
+    wb::ParameterList parameters = {{0, 0, 0, 0}};
+    std::vector<wb::ResourceClient *> list = subscribers(resourceId);
+    for (size_t i = 0; i < list.size(); i++)
+        if (alive(list[i]) && subscribed(list[i], resourceId))
+            list[i]->onNotify(resourceId, wb::Value(data), parameters);
+}
+
+// The ResourceClient stand-in, every request goes to the runtime.
+namespace whiteboard
+{
+const ResourceClient::AsyncRequestOptions ResourceClient::AsyncRequestOptions::Empty(nullptr, 0, false);
+const ResourceClient::AsyncRequestOptions ResourceClient::AsyncRequestOptions::ForceAsync(nullptr, 0, true);
+
+ResourceClient::ResourceClient(const char *name, int executionContext) : mName(name)
+{
+    (void) executionContext;
+    SimRuntime::instance().attach(this);
+}
+
+ResourceClient::~ResourceClient()
+{
+    SimRuntime::instance().detach(this);
+}
+
+Result ResourceClient::getResource(const char *path, ResourceId &resourceId)
+{
+    return SimRuntime::instance().getResource(path, resourceId);
+}
+
+Result ResourceClient::releaseResource(ResourceId)
+{
+    return HTTP_CODE_OK;
+}
+
+Result ResourceClient::asyncSubscribe(ResourceId resourceId, const AsyncRequestOptions &)
+{
+    return SimRuntime::instance().subscribe(this, resourceId);
+}
+
+Result ResourceClient::asyncUnsubscribe(ResourceId resourceId, const AsyncRequestOptions &)
+{
+    return SimRuntime::instance().unsubscribe(this, resourceId);
+}
+
+TimerId ResourceClient::startTimer(size_t periodMs, bool isContinuous)
+{
+    return SimRuntime::instance().startTimer(this, periodMs, isContinuous);
+}
+
+bool ResourceClient::stopTimer(TimerId timerId)
+{
+    return SimRuntime::instance().stopTimer(timerId);
+}
+
+Result ResourceClient::asyncGet(ResourceId resourceId, const AsyncRequestOptions &options)
+{
+    int none = 0;
+    return simGet(this, resourceId, options, Value(none));
+}
+
+// every accepted request takes the next ID of the runtime
+static Result withRequestId(const ResourceClient::AsyncRequestOptions &options, RequestId next, Result result)
+{
+    if (options.mRequestId && result == HTTP_CODE_ACCEPTED)
+        *options.mRequestId = next;
+    return result;
+}
+
+Result simPut(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+              const Value &value)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    const RequestId next = sim.nextRequestId();
+    return withRequestId(options, next, sim.put(client, resourceId, value));
+}
+
+Result simPost(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+               const Value &value)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    const RequestId next = sim.nextRequestId();
+    return withRequestId(options, next, sim.post(client, resourceId, value));
+}
+
+Result simGet(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+              const Value &value)
+{
+    SimRuntime &sim = SimRuntime::instance();
+    const RequestId next = sim.nextRequestId();
+    return withRequestId(options, next, sim.get(client, resourceId, value));
+}
+}
@@ -0,0 +1,173 @@
+#pragma once
+// Deterministic event loop behind the Whiteboard stand-in. Time is simulated
+// (microseconds) and only moves from one scheduled event to the next, so a
+// run does not depend on the speed of the workstation and an hour of sensor
+// time replays in seconds.
+//
+// The runtime plays the sensor side (GATT service, BLE peers, LED, IMU6
+// measurements fed from a trace) and the central: a script writes commands,
+// turns notifications on and off and connects or disconnects, and every
+// notification the app sends is recorded with the time it left.
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+#include "hrTrace.h"
+#include "imuTrace.h"
+#include "whiteboard/wb.h"
+#include "wbResources.h"
+
+class SimRuntime
+{
+public:
+    struct Notification
+    {
+        uint64_t time; // us
+        std::vector<uint8_t> bytes;
+    };
+
+    struct LedChange
+    {
+        uint64_t time; // us
+        bool on;
+    };
+
+    static SimRuntime &instance();
+
+    uint64_t now() const { return mNow; }
+    uint32_t nowMs() const { return (uint32_t)(mNow / 1000); }
+    // moves the clock, only forward
+    void setTime(uint64_t time);
+
+    void at(uint64_t time, const std::function<void()> &action);
+    void after(uint64_t delay, const std::function<void()> &action) { at(mNow + delay, action); }
+    // runs the next event, false when there is none
+    bool runOne();
+    // runs every event up to and including time, then sets the clock to it
+    void runUntil(uint64_t time);
+
+    // init and start, as the startup provider does on the sensor
+    bool launch(wb::LaunchableModule &module);
+
+    // central side
+    void connect();
+    void disconnect();
+    bool setNotifications(bool enabled);
+    bool writeCommand(const uint8_t data[], size_t len);
+    // time a notification takes on the link before its put completes
+    void setLinkLatency(uint64_t latency) { mLinkLatency = latency; }
+    const std::vector<Notification> &notifications() const { return mNotifications; }
+    // notification puts the stack refused, no link or notifications off
+    size_t refusedNotifications() const { return mRefusedNotifications; }
+    const std::vector<LedChange> &ledChanges() const { return mLedChanges; }
+
+    // IMU6 subscriptions are fed with the samples of the trace nearest to
+    // their sample times, at whatever rate the app subscribes
+    void setImuSource(const TraceView &trace) { mTrace = trace; }
+    size_t imuBatches() const { return mImuBatches; }
+    // /Meas/HR sends the notifications of the trace, with its times counted
+    // from the start of the simulation like the IMU trace; none without one
+    void setHrSource(const HrTrace *trace) { mHrTrace = trace; }
+    size_t hrNotifications() const { return mHrNotifications; }
+
+    // Whiteboard side, called by the ResourceClient stand-in
+    void attach(wb::ResourceClient *client);
+    void detach(wb::ResourceClient *client);
+    wb::Result getResource(const char *path, wb::ResourceId &resourceId);
+    wb::Result subscribe(wb::ResourceClient *client, wb::ResourceId resourceId);
+    wb::Result unsubscribe(wb::ResourceClient *client, wb::ResourceId resourceId);
+    // the ID the next request gets
+    wb::RequestId nextRequestId() const { return mNextRequest; }
+    wb::Result put(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value);
+    wb::Result post(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value);
+    wb::Result get(wb::ResourceClient *client, wb::ResourceId resourceId, const wb::Value &value);
+    wb::TimerId startTimer(wb::ResourceClient *client, size_t periodMs, bool continuous);
+    bool stopTimer(wb::TimerId timerId);
+
+private:
+    SimRuntime();
+    SimRuntime(const SimRuntime &);
+    SimRuntime &operator=(const SimRuntime &);
+
+    struct Event
+    {
+        uint64_t time;
+        uint64_t sequence; // events of the same time run in the order they were scheduled
+        std::function<void()> action;
+        bool operator<(const Event &other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct GattCharacteristic
+    {
+        std::vector<uint8_t> uuid;
+        std::vector<WB_RES::GattProperty> props;
+        uint16_t handle;
+    };
+
+    struct GattService
+    {
+        std::vector<uint8_t> uuid;
+        std::vector<GattCharacteristic> chars;
+        uint16_t handle;
+    };
+
+    struct ImuStream
+    {
+        uint32_t generation; // batches scheduled for an earlier run of the stream are dropped
+        uint64_t start; // time of the first sample
+        uint64_t produced; // samples sent so far
+        size_t cursor; // trace sample nearest to the last sample time, times only grow
+    };
+
+    struct Timer
+    {
+        wb::ResourceClient *client;
+        uint64_t period;
+        bool continuous;
+    };
+
+    static uint32_t key(wb::ResourceId resourceId) { return resourceId.localResourceId | (uint32_t)resourceId.instanceId << 16; }
+    bool alive(wb::ResourceClient *client) const { return mClients.count(client) != 0; }
+    bool subscribed(wb::ResourceClient *client, wb::ResourceId resourceId) const;
+    // the subscribers at the time of the call, the callbacks may change them
+    std::vector<wb::ResourceClient *> subscribers(wb::ResourceId resourceId) const;
+    const GattCharacteristic *findCharacteristic(WB_RES::GattProperty::Type prop, uint16_t &serviceHandle) const;
+    void notifyCharacteristic(const GattCharacteristic &c, uint16_t serviceHandle, const WB_RES::Characteristic &value);
+    void notifyPeers(WB_RES::PeerState::Type state);
+    void startImu(wb::ResourceId resourceId);
+    void produceImu(wb::ResourceId resourceId, uint32_t generation);
+    void startHr();
+    void produceHr(uint32_t generation, size_t index);
+    void fireTimer(wb::TimerId timerId);
+
+    uint64_t mNow;
+    uint64_t mSequence;
+    std::priority_queue<Event> mEvents;
+    wb::RequestId mNextRequest;
+    wb::TimerId mNextTimer;
+    uint16_t mNextHandle;
+
+    std::set<wb::ResourceClient *> mClients;
+    std::map<uint32_t, std::vector<wb::ResourceClient *> > mSubscribers;
+    std::vector<GattService> mServices;
+    std::map<wb::TimerId, Timer> mTimers;
+    std::map<uint32_t, ImuStream> mImuStreams;
+    uint32_t mImuGeneration;
+
+    bool mConnected;
+    bool mNotifying; // the central enabled notifications of the data characteristic
+    uint64_t mLinkLatency;
+    std::vector<Notification> mNotifications;
+    std::vector<LedChange> mLedChanges;
+    TraceView mTrace;
+    size_t mImuBatches;
+    const HrTrace *mHrTrace;
+    uint32_t mHrGeneration; // as ImuStream::generation, for the one HR stream
+    size_t mHrNotifications;
+    size_t mRefusedNotifications;
+};
@@ -0,0 +1,136 @@
+#pragma once
+// The generated WB_RES types and resource ids the app uses, shared by the
+// resources.h stand-ins. Values are laid out like the generated ones, but only
+// the members the app touches exist.
+#include "whiteboard/wb.h"
+
+namespace WB_RES
+{
+struct ModuleStateValues
+{
+    enum Type
+    {
+        UNINITIALIZED = 0,
+        INITIALIZED = 1,
+        STARTED = 2,
+        STOPPED = 3,
+    };
+};
+
+struct GattProperty
+{
+    enum Type
+    {
+        BROADCAST = 0,
+        READ = 1,
+        WRITENORESP = 2,
+        WRITE = 3,
+        NOTIFY = 4,
+        INDICATE = 5,
+    };
+    GattProperty(Type value = READ) : mValue(value) {}
+    operator Type() const { return mValue; }
+
+private:
+    Type mValue;
+};
+
+struct GattChar
+{
+    wb::Array<GattProperty> props;
+    wb::Array<uint8> uuid;
+    wb::Optional<uint16> handle;
+};
+
+struct GattSvc
+{
+    wb::Array<uint8> uuid;
+    wb::Array<GattChar> chars;
+    wb::Optional<uint16> handle;
+};
+
+struct Characteristic
+{
+    wb::Array<uint8> bytes;
+    wb::Optional<bool> notifications;
+};
+
+struct PeerState
+{
+    enum Type
+    {
+        DISCONNECTED = 0,
+        CONNECTED = 1,
+    };
+    PeerState(Type value = DISCONNECTED) : mValue(value) {}
+    operator Type() const { return mValue; }
+
+private:
+    Type mValue;
+};
+
+struct PeerChange
+{
+    PeerState state;
+};
+
+struct IMU6Data
+{
+    uint32 timestamp;
+    wb::Array<wb::FloatVector3D> arrayAcc;
+    wb::Array<wb::FloatVector3D> arrayGyro;
+};
+
+// what GET /Time/Detailed returns
+struct DetailedTime
+{
+    int64 utcTime; // us since 1970, unset in the sim
+    uint32 relativeTime; // ms, the clock of the IMU6 timestamps
+};
+
+struct HRData
+{
+    float average;
+    wb::Array<uint16> rrData;
+};
+
+namespace LOCAL
+{
+#define SIM_RESOURCE(NAME, ID)                                                                                         \
+    struct NAME                                                                                                        \
+    {                                                                                                                  \
+        static const wb::LocalResourceId LID = ID;                                                                     \
+        operator wb::ResourceId() const { return wb::ResourceId(LID); }                                                \
+    };
+
+SIM_RESOURCE(COMM_BLE_PEERS, 1)
+SIM_RESOURCE(COMM_BLE_GATTSVC, 2)
+SIM_RESOURCE(COMM_BLE_GATTSVC_SVCHANDLE, 3)
+SIM_RESOURCE(COMPONENT_LED, 5)
+SIM_RESOURCE(MEAS_IMU6_SAMPLERATE, 10) // instance: the sample rate
+SIM_RESOURCE(MEAS_HR, 11)
+SIM_RESOURCE(TIME_DETAILED, 12)
+
+#undef SIM_RESOURCE
+
+// instance: the characteristic handle
+struct COMM_BLE_GATTSVC_SVCHANDLE_CHARHANDLE
+{
+    static const wb::LocalResourceId LID = 4;
+
+    struct SUBSCRIBE
+    {
+        class ParameterListRef
+        {
+        public:
+            explicit ParameterListRef(const wb::ParameterList &parameters) : mParameters(parameters) {}
+            int32 getSvcHandle() const { return mParameters.values[0]; }
+            int32 getCharHandle() const { return mParameters.values[1]; }
+
+        private:
+            const wb::ParameterList &mParameters;
+        };
+    };
+};
+}
+}
@@ -0,0 +1,241 @@
+#pragma once
+// Stand-in for the Whiteboard runtime of the Movesense device library, just
+// enough of it to build and run myApp on a workstation. Requests, results,
+// notifications and timers go through SimRuntime (host/sim/simRuntime.h), a
+// deterministic event loop with simulated time; nothing here talks to real
+// hardware.
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <typeinfo>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+
+class SimRuntime;
+
+namespace whiteboard
+{
+typedef uint16 LocalResourceId;
+typedef uint16 Result;
+typedef uint16 RequestId;
+typedef int32 TimerId;
+
+const TimerId ID_INVALID_TIMER = 0;
+
+const Result HTTP_CODE_OK = 200;
+const Result HTTP_CODE_CREATED = 201;
+const Result HTTP_CODE_ACCEPTED = 202;
+const Result HTTP_CODE_BAD_REQUEST = 400;
+const Result HTTP_CODE_NOT_FOUND = 404;
+
+struct ResourceId
+{
+    LocalResourceId localResourceId;
+    uint16 instanceId;
+
+    ResourceId(LocalResourceId local = 0xFFFF, uint16 instance = 0) : localResourceId(local), instanceId(instance) {}
+    bool operator==(const ResourceId &other) const
+    {
+        return localResourceId == other.localResourceId && instanceId == other.instanceId;
+    }
+    bool operator!=(const ResourceId &other) const { return !(*this == other); }
+};
+
+const ResourceId ID_INVALID_RESOURCE;
+
+// view of an array owned by someone else, like the real wb::Array
+template <typename T>
+class Array
+{
+public:
+    Array() : mData(nullptr), mSize(0) {}
+    Array(const T *data, size_t size) : mData(data), mSize(size) {}
+
+    size_t size() const { return mSize; }
+    const T &operator[](size_t i) const
+    {
+        assert(i < mSize);
+        return mData[i];
+    }
+
+private:
+    const T *mData;
+    size_t mSize;
+};
+
+template <typename T>
+Array<T> MakeArray(const T *data, size_t size)
+{
+    return Array<T>(data, size);
+}
+
+template <typename T>
+class Optional
+{
+public:
+    Optional() : mHasValue(false), mValue() {}
+    Optional(const T &value) : mHasValue(true), mValue(value) {}
+
+    bool hasValue() const { return mHasValue; }
+    const T &getValue() const
+    {
+        assert(mHasValue);
+        return mValue;
+    }
+
+private:
+    bool mHasValue;
+    T mValue;
+};
+
+// A value passed to a callback. It refers to data owned by the caller and is
+// only valid during the callback, as on the device; convertTo checks the type.
+class Value
+{
+public:
+    template <typename T>
+    Value(const T &value) : mData(&value), mType(&typeid(T))
+    {
+    }
+
+    template <typename T>
+    T convertTo() const
+    {
+        typedef typename std::remove_cv<typename std::remove_reference<T>::type>::type Type;
+        assert(*mType == typeid(Type));
+        return *static_cast<Type *>(const_cast<void *>(mData));
+    }
+
+private:
+    const void *mData;
+    const std::type_info *mType;
+};
+
+// path parameters of a notification, e.g. the service and characteristic handle
+struct ParameterList
+{
+    int32 values[4];
+};
+
+struct FloatVector3D
+{
+    float x;
+    float y;
+    float z;
+};
+
+class ResourceClient
+{
+public:
+    class AsyncRequestOptions
+    {
+    public:
+        AsyncRequestOptions(RequestId *requestId, uint32 timeout, bool forceAsync)
+            : mRequestId(requestId), mTimeout(timeout), mForceAsync(forceAsync)
+        {
+        }
+        static const AsyncRequestOptions Empty;
+        static const AsyncRequestOptions ForceAsync;
+
+        RequestId *mRequestId;
+        uint32 mTimeout;
+        bool mForceAsync;
+    };
+
+    ResourceClient(const char *name, int executionContext);
+    virtual ~ResourceClient();
+
+protected:
+    Result getResource(const char *path, ResourceId &resourceId);
+    Result releaseResource(ResourceId resourceId);
+    Result asyncSubscribe(ResourceId resourceId, const AsyncRequestOptions &options = AsyncRequestOptions::Empty);
+    Result asyncUnsubscribe(ResourceId resourceId, const AsyncRequestOptions &options = AsyncRequestOptions::Empty);
+    template <typename T>
+    Result asyncPut(ResourceId resourceId, const AsyncRequestOptions &options, const T &value);
+    template <typename T>
+    Result asyncPost(ResourceId resourceId, const AsyncRequestOptions &options, const T &value);
+    template <typename T>
+    Result asyncGet(ResourceId resourceId, const AsyncRequestOptions &options, const T &value);
+    Result asyncGet(ResourceId resourceId, const AsyncRequestOptions &options = AsyncRequestOptions::Empty);
+    TimerId startTimer(size_t periodMs, bool isContinuous = false);
+    bool stopTimer(TimerId timerId);
+
+    virtual void onGetResult(RequestId, ResourceId, Result, const Value &) {}
+    virtual void onPutResult(RequestId, ResourceId, Result, const Value &) {}
+    virtual void onPostResult(RequestId, ResourceId, Result, const Value &) {}
+    virtual void onSubscribeResult(RequestId, ResourceId, Result, const Value &) {}
+    virtual void onNotify(ResourceId, const Value &, const ParameterList &) {}
+    virtual void onTimer(TimerId) {}
+
+private:
+    friend class ::SimRuntime;
+    const char *mName;
+};
+
+class LaunchableModule
+{
+public:
+    LaunchableModule(const char *name, int executionContext) : mName(name), mModuleState(0) { (void)executionContext; }
+    virtual ~LaunchableModule() {}
+
+    virtual bool initModule() = 0;
+    virtual void deinitModule() = 0;
+    virtual bool startModule() = 0;
+    virtual void stopModule() = 0;
+
+    const char *name() const { return mName; }
+    int moduleState() const { return mModuleState; }
+
+protected:
+    const char *mName;
+    int mModuleState;
+};
+}
+
+namespace wb = whiteboard;
+
+const int WB_EXEC_CTX_APPLICATION = 1;
+
+#define WBDEBUG_NAME(name) name
+#define FINAL final
+#define OVERRIDE override
+
+// the requests with a value, handed to SimRuntime type-erased
+namespace whiteboard
+{
+// the ID of an accepted request goes to options.mRequestId, when given
+Result simPut(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+              const Value &value);
+Result simPost(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+               const Value &value);
+Result simGet(ResourceClient *client, ResourceId resourceId, const ResourceClient::AsyncRequestOptions &options,
+              const Value &value);
+
+template <typename T>
+Result ResourceClient::asyncPut(ResourceId resourceId, const AsyncRequestOptions &options, const T &value)
+{
+    return simPut(this, resourceId, options, Value(value));
+}
+
+template <typename T>
+Result ResourceClient::asyncPost(ResourceId resourceId, const AsyncRequestOptions &options, const T &value)
+{
+    return simPost(this, resourceId, options, Value(value));
+}
+
+template <typename T>
+Result ResourceClient::asyncGet(ResourceId resourceId, const AsyncRequestOptions &options, const T &value)
+{
+    return simGet(this, resourceId, options, Value(value));
+}
+}
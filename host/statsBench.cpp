@@ -0,0 +1,154 @@
+// Per-sample update cost of the streaming statistics in StreamingStats.h for
+// window lengths from 10 to 1000 samples, next to recomputing the window on
+// every sample. Every window result is checked against the recomputation.
+//
+// usage: statsBench [--samples N]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "StreamingStats.h"
+#include "imuTrace.h"
+
+namespace
+{
+volatile float gSink;
+
+// what an ad-hoc loop over the last n samples costs
+void naiveWindow(const float *samples, size_t end, size_t n, float &mean, float &variance, float &lo, float &hi)
+{
+    size_t first = end >= n ? end - n : 0;
+    size_t count = end - first;
+    double sum = 0, sumSq = 0;
+    lo = FLT_MAX;
+    hi = -FLT_MAX;
+    for (size_t i = first; i < end; i++)
+    {
+        sum += samples[i];
+        lo = samples[i] < lo ? samples[i] : lo;
+        hi = samples[i] > hi ? samples[i] : hi;
+    }
+    mean = (float)(sum / count);
+    for (size_t i = first; i < end; i++)
+        sumSq += (samples[i] - mean) * (samples[i] - mean);
+    variance = (float)(sumSq / count);
+}
+
+template <typename F>
+double nsPerSample(size_t count, F fn)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+template <size_t N>
+bool benchWindow(const std::vector<float> &samples)
+{
+    const size_t count = samples.size();
+
+    // the incremental results must follow the recomputation
+    WindowStats<N> window;
+    RollingMax<N> rollingMax;
+    RollingMin<N> rollingMin;
+    float worstMean = 0, worstStd = 0;
+    bool extremesAgree = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        window.add(samples[i]);
+        rollingMax.add(samples[i]);
+        rollingMin.add(samples[i]);
+        if (i % 97 != 0)
+            continue;
+        float mean, variance, lo, hi;
+        naiveWindow(&samples[0], i + 1, N, mean, variance, lo, hi);
+        worstMean = fmaxf(worstMean, fabsf(mean - window.mean()));
+        worstStd = fmaxf(worstStd, fabsf(sqrtf(variance) - sqrtf(window.variance())));
+        extremesAgree = extremesAgree && lo == rollingMin.value() && hi == rollingMax.value();
+    }
+    if (worstMean > 1e-2f || worstStd > 1e-2f || !extremesAgree)
+    {
+        fprintf(stderr, "window %zu disagrees: mean %g, std %g, extremes %s\n", N, worstMean, worstStd,
+                extremesAgree ? "ok" : "differ");
+        return false;
+    }
+
+    double windowNs = nsPerSample(count, [&]() {
+        WindowStats<N> w;
+        for (size_t i = 0; i < count; i++)
+            w.add(samples[i]);
+        gSink = w.variance();
+    });
+    double maxNs = nsPerSample(count, [&]() {
+        RollingMax<N> m;
+        for (size_t i = 0; i < count; i++)
+            m.add(samples[i]);
+        gSink = m.value();
+    });
+    double minNs = nsPerSample(count, [&]() {
+        RollingMin<N> m;
+        for (size_t i = 0; i < count; i++)
+            m.add(samples[i]);
+        gSink = m.value();
+    });
+    // the recomputation is slow, time a slice of the samples
+    const size_t naiveCount = count < 20000 ? count : 20000;
+    double naiveNs = nsPerSample(naiveCount, [&]() {
+        for (size_t i = 0; i < naiveCount; i++)
+        {
+            float mean, variance, lo, hi;
+            naiveWindow(&samples[0], i + 1, N, mean, variance, lo, hi);
+            gSink = mean + variance + lo + hi;
+        }
+    });
+    printf("%-8zu %12.1f %12.1f %12.1f %12.1f %10zu\n", N, windowNs, maxNs, minNs, naiveNs,
+           sizeof(WindowStats<N>) + sizeof(RollingMax<N>) + sizeof(RollingMin<N>));
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t sampleCount = 1000000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            sampleCount = (size_t)atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: statsBench [--samples N]\n");
+            return 2;
+        }
+    }
+
+    // |acc| of a synthesized session, repeated up to the sample count
+    ImuTrace trace;
+    synthesizeTrace(trace, 104, 600, 3);
+    std::vector<float> samples(sampleCount);
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        const Vec3f &a = trace.acc[i % trace.sampleCount()];
+        samples[i] = sqrtf(a.x * a.x + a.y * a.y + a.z * a.z);
+    }
+
+    double runningNs = nsPerSample(sampleCount, [&]() {
+        RunningStats s;
+        for (size_t i = 0; i < sampleCount; i++)
+            s.add(samples[i]);
+        gSink = s.variance() + s.max();
+    });
+    double emaNs = nsPerSample(sampleCount, [&]() {
+        Ema e(Ema::alphaFor(1000.0f / 104, 300));
+        for (size_t i = 0; i < sampleCount; i++)
+            e.add(samples[i]);
+        gSink = e.value();
+    });
+    printf("running stats %.1f ns/sample, ema %.1f ns/sample\n\n", runningNs, emaNs);
+
+    printf("%-8s %12s %12s %12s %12s %10s\n", "window", "window ns", "max ns", "min ns", "naive ns", "bytes");
+    bool ok = benchWindow<10>(samples) && benchWindow<30>(samples) && benchWindow<100>(samples) &&
+              benchWindow<300>(samples) && benchWindow<1000>(samples);
+    return ok ? 0 : 1;
+}
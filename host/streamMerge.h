@@ -0,0 +1,179 @@
+#pragma once
+// Joins the time-ordered streams of several sensors into one, in bounded
+// memory. Every stream has a buffer of fixed capacity and a watermark, the
+// time its items have reached (its last item, or advance() from a batch that
+// brought none). An item leaves once no stream can still deliver an earlier
+// one: the streams are kept in an indexed min-heap keyed by their first
+// buffered item, or by the watermark while empty, so the heap top decides and
+// push, advance and pop are O(log N).
+//
+//   StreamMerger<EventRecord> merger(sensors, 64);
+//   merger.push(sensor, clientTime, record);   // per stream, in time order
+//   while (merger.pop(time, record, sensor)) ...
+//
+// A stream that falls silent holds the others back until it advances or is
+// closed; when a buffer is full push() fails and the caller decides.
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+template <typename T>
+class StreamMerger
+{
+public:
+    StreamMerger(size_t streams, size_t capacity)
+        : mStreams(streams), mHeap(streams), mCapacity(capacity), mBuffered(0), mLate(0)
+    {
+        for (size_t i = 0; i < streams; i++)
+        {
+            mStreams[i].items.resize(capacity);
+            mStreams[i].first = 0;
+            mStreams[i].count = 0;
+            mStreams[i].watermark = INT64_MIN;
+            mStreams[i].closed = false;
+            mStreams[i].position = i;
+            mHeap[i] = i;
+        }
+    }
+
+    size_t streamCount() const { return mStreams.size(); }
+    size_t buffered() const { return mBuffered; }
+    // items pushed earlier than their stream's watermark, taken at the watermark
+    size_t late() const { return mLate; }
+
+    // false if the buffer of the stream is full
+    bool push(size_t stream, int64_t time, const T &item)
+    {
+        Stream &s = mStreams[stream];
+        if (s.count == mCapacity)
+            return false;
+        if (time < s.watermark)
+        {
+            time = s.watermark;
+            mLate++;
+        }
+        Entry &e = s.items[(s.first + s.count) % mCapacity];
+        e.time = time;
+        e.item = item;
+        s.count++;
+        s.watermark = time;
+        mBuffered++;
+        if (s.count == 1)
+            update(stream);
+        return true;
+    }
+
+    // the stream has nothing before time
+    void advance(size_t stream, int64_t time)
+    {
+        Stream &s = mStreams[stream];
+        if (time <= s.watermark)
+            return;
+        s.watermark = time;
+        if (s.count == 0)
+            update(stream);
+    }
+
+    // no more items from the stream, the buffered ones still leave
+    void close(size_t stream)
+    {
+        mStreams[stream].closed = true;
+        update(stream);
+    }
+
+    // The next item in time order, false while a stream could still deliver
+    // an earlier one or everything is out.
+    bool pop(int64_t &time, T &item, size_t &stream)
+    {
+        if (mHeap.empty())
+            return false;
+        size_t top = mHeap[0];
+        Stream &s = mStreams[top];
+        if (s.count == 0)
+            return false;
+        const Entry &e = s.items[s.first];
+        time = e.time;
+        item = e.item;
+        stream = top;
+        s.first = (s.first + 1) % mCapacity;
+        s.count--;
+        mBuffered--;
+        update(top);
+        return true;
+    }
+
+private:
+    struct Entry
+    {
+        int64_t time;
+        T item;
+    };
+
+    struct Stream
+    {
+        std::vector<Entry> items; // ring of capacity entries
+        size_t first;
+        size_t count;
+        int64_t watermark;
+        bool closed;
+        size_t position; // in mHeap
+    };
+
+    int64_t key(size_t i) const
+    {
+        const Stream &s = mStreams[i];
+        if (s.count)
+            return s.items[s.first].time;
+        return s.closed ? INT64_MAX : s.watermark;
+    }
+
+    // on equal keys a buffered item goes first, an empty stream can't deliver earlier
+    bool before(size_t a, size_t b) const
+    {
+        int64_t ka = key(a), kb = key(b);
+        if (ka != kb)
+            return ka < kb;
+        bool ea = mStreams[a].count == 0, eb = mStreams[b].count == 0;
+        if (ea != eb)
+            return eb;
+        return a < b;
+    }
+
+    void swap(size_t i, size_t j)
+    {
+        size_t a = mHeap[i], b = mHeap[j];
+        mHeap[i] = b;
+        mHeap[j] = a;
+        mStreams[b].position = i;
+        mStreams[a].position = j;
+    }
+
+    // the key of stream moved, restore the heap around it
+    void update(size_t stream)
+    {
+        size_t i = mStreams[stream].position;
+        while (i > 0 && before(mHeap[i], mHeap[(i - 1) / 2]))
+        {
+            swap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+        while (true)
+        {
+            size_t smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+            if (l < mHeap.size() && before(mHeap[l], mHeap[smallest]))
+                smallest = l;
+            if (r < mHeap.size() && before(mHeap[r], mHeap[smallest]))
+                smallest = r;
+            if (smallest == i)
+                break;
+            swap(i, smallest);
+            i = smallest;
+        }
+    }
+
+    std::vector<Stream> mStreams;
+    std::vector<size_t> mHeap; // stream indices
+    size_t mCapacity;
+    size_t mBuffered;
+    size_t mLate;
+};
@@ -0,0 +1,211 @@
+// Checks the streaming statistics of StreamingStats.h against brute force
+// over the samples kept in a plain vector: RunningStats and Ema after every
+// sample, WindowStats<N> and RollingMax/Min<N> for several window lengths
+// over streams many times longer than the window, so the ring wraps and
+// WindowStats hands over to fresh sums again and again. The stream has a
+// gravity offset, landing spikes and a level shift, as |acc| does, and
+// rounded values for ties in the rolling extremes. Run by ctest.
+//
+// usage: streamingStatsTest [--samples N] [--seed N]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "StreamingStats.h"
+
+namespace
+{
+size_t gFailures = 0;
+
+void fail(const char *what, size_t index, double got, double expected)
+{
+    if (gFailures++ < 20)
+        fprintf(stderr, "%s at sample %zu: %g, expected %g\n", what, index, got, expected);
+}
+
+void checkNear(const char *what, size_t index, double got, double expected, double tolerance)
+{
+    if (!(fabs(got - expected) <= tolerance))
+        fail(what, index, got, expected);
+}
+
+void checkEqual(const char *what, size_t index, double got, double expected)
+{
+    if (got != expected)
+        fail(what, index, got, expected);
+}
+
+// xorshift, the same stream on every host
+struct Rng
+{
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float unit() { return (next() >> 8) / 16777216.0f; }
+};
+
+std::vector<float> makeStream(size_t count, uint32_t seed)
+{
+    Rng rng(seed);
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        float v = 9.81f + 2 * (rng.unit() - 0.5f);
+        if (rng.next() % 50 == 0)
+            v += 30 * rng.unit(); // landing
+        if (i >= count / 2)
+            v += 100; // the level moves, the window has to follow
+        if (i % 3 == 0)
+            v = floorf(v); // ties
+        samples[i] = v;
+    }
+    return samples;
+}
+
+// mean and population variance of samples[first, end) in double
+void bruteForce(const std::vector<float> &samples, size_t first, size_t end, double &mean, double &variance)
+{
+    double sum = 0;
+    for (size_t i = first; i < end; i++)
+        sum += samples[i];
+    mean = sum / (end - first);
+    double m2 = 0;
+    for (size_t i = first; i < end; i++)
+        m2 += (samples[i] - mean) * (samples[i] - mean);
+    variance = m2 / (end - first);
+}
+
+void testRunningStats(const std::vector<float> &samples)
+{
+    RunningStats s;
+    checkEqual("empty RunningStats mean", 0, s.mean(), 0);
+    checkEqual("empty RunningStats max", 0, s.max(), 0);
+    checkEqual("empty RunningStats min", 0, s.min(), 0);
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    // the whole stream every sample would be quadratic, a prefix is enough
+    const size_t count = samples.size() < 5000 ? samples.size() : 5000;
+    for (size_t i = 0; i < count; i++)
+    {
+        s.add(samples[i]);
+        lo = samples[i] < lo ? samples[i] : lo;
+        hi = samples[i] > hi ? samples[i] : hi;
+        double mean, variance;
+        bruteForce(samples, 0, i + 1, mean, variance);
+        checkEqual("RunningStats count", i, s.count(), i + 1);
+        checkNear("RunningStats mean", i, s.mean(), mean, 1e-4 * (1 + fabs(mean)));
+        checkNear("RunningStats std", i, sqrt(s.variance()), sqrt(variance), 1e-3 * (1 + sqrt(variance)));
+        checkEqual("RunningStats min", i, s.min(), lo);
+        checkEqual("RunningStats max", i, s.max(), hi);
+    }
+    s.reset();
+    checkEqual("RunningStats count after reset", 0, s.count(), 0);
+}
+
+template <size_t N>
+void testWindow(const std::vector<float> &samples)
+{
+    WindowStats<N> window;
+    RollingMax<N> rollingMax;
+    RollingMin<N> rollingMin;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        window.add(samples[i]);
+        rollingMax.add(samples[i]);
+        rollingMin.add(samples[i]);
+
+        const size_t first = i + 1 >= N ? i + 1 - N : 0;
+        float lo = samples[first], hi = samples[first];
+        for (size_t j = first; j <= i; j++)
+        {
+            lo = samples[j] < lo ? samples[j] : lo;
+            hi = samples[j] > hi ? samples[j] : hi;
+        }
+        checkEqual("RollingMax", i, rollingMax.value(), hi);
+        checkEqual("RollingMin", i, rollingMin.value(), lo);
+
+        checkEqual("WindowStats count", i, window.count(), i + 1 - first);
+        checkEqual("WindowStats full", i, window.full(), i + 1 >= N);
+        checkEqual("WindowStats oldest", i, window.oldest(), samples[first]);
+        double mean, variance;
+        bruteForce(samples, first, i + 1, mean, variance);
+        checkNear("WindowStats mean", i, window.mean(), mean, 1e-4 * (1 + fabs(mean)));
+        // float rounding leaves a few ulps of mean^2 in the variance, whatever its size
+        checkNear("WindowStats variance", i, window.variance(), variance, 1e-3 * variance + 1e-6 * mean * mean);
+    }
+
+    window.reset();
+    rollingMax.reset();
+    rollingMin.reset();
+    checkEqual("WindowStats count after reset", 0, window.count(), 0);
+    checkEqual("WindowStats mean after reset", 0, window.mean(), 0);
+    checkEqual("WindowStats variance after reset", 0, window.variance(), 0);
+    checkEqual("RollingMax after reset", 0, rollingMax.value(), 0);
+    checkEqual("RollingMin after reset", 0, rollingMin.value(), 0);
+    window.add(3);
+    checkEqual("WindowStats mean of one sample", 0, window.mean(), 3);
+    checkEqual("WindowStats variance of one sample", 0, window.variance(), 0);
+}
+
+void testEma(const std::vector<float> &samples)
+{
+    const float alpha = Ema::alphaFor(1000.0f / 104, 300);
+    checkNear("Ema::alphaFor", 0, alpha, (1000.0 / 104) / (300 + 1000.0 / 104), 1e-6);
+    checkEqual("Ema::alphaFor without a time constant", 0, Ema::alphaFor(10, 0), 1);
+
+    Ema ema(alpha);
+    checkEqual("empty Ema", 0, ema.value(), 0);
+    double expected = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        ema.add(samples[i]);
+        // the first sample starts the average
+        expected = i == 0 ? samples[0] : expected + alpha * (samples[i] - expected);
+        checkNear("Ema", i, ema.value(), expected, 1e-4 * (1 + fabs(expected)));
+    }
+    ema.reset();
+    ema.add(5);
+    checkEqual("Ema after reset", 0, ema.value(), 5);
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t sampleCount = 20000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            sampleCount = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: streamingStatsTest [--samples N] [--seed N]\n");
+            return 2;
+        }
+    }
+
+    const std::vector<float> samples = makeStream(sampleCount, seed);
+    testRunningStats(samples);
+    testEma(samples);
+    testWindow<2>(samples);
+    testWindow<7>(samples);
+    testWindow<10>(samples);
+    testWindow<100>(samples);
+    testWindow<1000>(samples);
+
+    if (gFailures)
+    {
+        fprintf(stderr, "%zu checks failed\n", gFailures);
+        return 1;
+    }
+    printf("streaming statistics agree with brute force over %zu samples\n", sampleCount);
+    return 0;
+}
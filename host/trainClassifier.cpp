@@ -0,0 +1,297 @@
+// Trains the footwork classifier (FootworkClassifier.h) on labeled traces and
+// writes its tables as a header. The detector runs with the gyro threshold
+// rule to find the landings; every landing that overlaps a label is a
+// training sample, a split step unless the label is other footwork.
+//
+// The features are quantized to int8 over their range in the training set,
+// then gradient-boosted trees of TREE_DEPTH levels (logistic loss) are grown
+// on the quantized values, so the thresholds found are the ones the sensor
+// compares. Leaves are scaled to int8 all with the same factor, which keeps
+// the sign of the summed score.
+//
+// Without traces it trains on synthesized sessions with confusers at 52, 104
+// and 208 Hz. Regenerate the shipped model with
+//   trainClassifier --out ../FootworkModel.h
+//
+// usage: trainClassifier [--out FILE] [--trees N] [--rate-of-learning X]
+//                        [--synth SECONDS] [--seeds N] [trace ...]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "FootworkClassifier.h"
+#include "imuTrace.h"
+
+namespace
+{
+const float LAMBDA = 1.0f; // L2 on the leaves
+const float MIN_HESSIAN = 1.0f; // smallest child worth a split
+const int BINS = 256; // one per int8 value
+
+const char *FEATURE_NAMES[LANDING_FEATURE_COUNT] = {"max z gyro", "mean z gyro", "max tilt gyro", "airtime",
+                                                   "landing acc"};
+
+struct Sample
+{
+    int8_t q[LANDING_FEATURE_COUNT];
+    float target; // 1 split step, 0 other
+    float score; // of the trees so far
+};
+
+struct FloatTree
+{
+    uint8_t feature[TREE_NODES];
+    int8_t threshold[TREE_NODES];
+    float leaf[TREE_LEAVES];
+};
+
+float sigmoid(float x)
+{
+    return 1.0f / (1.0f + expf(-x));
+}
+
+// finds the best split of the samples on one node, false if none helps
+bool bestSplit(const std::vector<Sample> &samples, const std::vector<size_t> &index, uint8_t &feature,
+               int8_t &threshold)
+{
+    double g = 0, h = 0;
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        float p = sigmoid(samples[index[i]].score);
+        g += p - samples[index[i]].target;
+        h += p * (1 - p);
+    }
+    const double parent = g * g / (h + LAMBDA);
+    double bestGain = 1e-6;
+    bool found = false;
+    for (size_t f = 0; f < LANDING_FEATURE_COUNT; f++)
+    {
+        double gs[BINS] = {0}, hs[BINS] = {0};
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            const Sample &s = samples[index[i]];
+            float p = sigmoid(s.score);
+            gs[s.q[f] + 128] += p - s.target;
+            hs[s.q[f] + 128] += p * (1 - p);
+        }
+        double gl = 0, hl = 0;
+        for (int b = 0; b < BINS - 1; b++)
+        {
+            gl += gs[b];
+            hl += hs[b];
+            double gr = g - gl, hr = h - hl;
+            if (hl < MIN_HESSIAN || hr < MIN_HESSIAN)
+                continue;
+            double gain = gl * gl / (hl + LAMBDA) + gr * gr / (hr + LAMBDA) - parent;
+            if (gain > bestGain)
+            {
+                bestGain = gain;
+                feature = (uint8_t)f;
+                threshold = (int8_t)(b - 128);
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void growTree(std::vector<Sample> &samples, float learningRate, FloatTree &tree)
+{
+    // level by level, node i holds the samples that reached it
+    std::vector<std::vector<size_t> > nodes(TREE_NODES + TREE_LEAVES);
+    for (size_t i = 0; i < samples.size(); i++)
+        nodes[0].push_back(i);
+    for (size_t n = 0; n < TREE_NODES; n++)
+    {
+        // a node that can't split sends everything left
+        tree.feature[n] = 0;
+        tree.threshold[n] = 127;
+        bestSplit(samples, nodes[n], tree.feature[n], tree.threshold[n]);
+        for (size_t i = 0; i < nodes[n].size(); i++)
+        {
+            size_t s = nodes[n][i];
+            nodes[samples[s].q[tree.feature[n]] <= tree.threshold[n] ? 2 * n + 1 : 2 * n + 2].push_back(s);
+        }
+    }
+    for (size_t l = 0; l < TREE_LEAVES; l++)
+    {
+        const std::vector<size_t> &index = nodes[TREE_NODES + l];
+        double g = 0, h = 0;
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            float p = sigmoid(samples[index[i]].score);
+            g += p - samples[index[i]].target;
+            h += p * (1 - p);
+        }
+        tree.leaf[l] = (float)(-g / (h + LAMBDA)) * learningRate;
+        for (size_t i = 0; i < index.size(); i++)
+            samples[index[i]].score += tree.leaf[l];
+    }
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: trainClassifier [--out FILE] [--trees N] [--rate-of-learning X]\n"
+                    "                       [--synth SECONDS] [--seeds N] [trace ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    const char *outPath = "FootworkModel.h";
+    size_t treeCount = 8;
+    float learningRate = 0.5f;
+    uint32_t synthSeconds = 1200;
+    uint32_t seeds = 3;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            outPath = argv[++i];
+        else if (arg == "--trees" && hasValue)
+            treeCount = (size_t)atoi(argv[++i]);
+        else if (arg == "--rate-of-learning" && hasValue)
+            learningRate = (float)atof(argv[++i]);
+        else if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seeds" && hasValue)
+            seeds = (uint32_t)atoi(argv[++i]);
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+    if (treeCount == 0 || treeCount > 64 || learningRate <= 0)
+        usage();
+
+    std::vector<LabeledLanding> landings;
+    if (paths.empty())
+    {
+        const uint32_t rates[] = {52, 104, 208};
+        for (size_t r = 0; r < 3; r++)
+            for (uint32_t seed = 1; seed <= seeds; seed++)
+            {
+                ImuTrace trace;
+                synthesizeTrace(trace, rates[r], synthSeconds, seed, true);
+                collectLandings(trace, landings);
+            }
+    }
+    else
+    {
+        std::vector<ImuTrace> corpus;
+        if (!loadCorpus(paths, corpus))
+            return 1;
+        for (size_t t = 0; t < corpus.size(); t++)
+            collectLandings(corpus[t], landings);
+    }
+    if (landings.empty())
+    {
+        fprintf(stderr, "no labeled landings to train on\n");
+        return 1;
+    }
+
+    // int8 over the range seen, centered
+    FeatureQuantizer quantizers[LANDING_FEATURE_COUNT];
+    for (size_t f = 0; f < LANDING_FEATURE_COUNT; f++)
+    {
+        float lo = landings[0].features.values[f], hi = lo;
+        for (size_t i = 1; i < landings.size(); i++)
+        {
+            lo = std::min(lo, landings[i].features.values[f]);
+            hi = std::max(hi, landings[i].features.values[f]);
+        }
+        quantizers[f].offset = (lo + hi) / 2;
+        quantizers[f].scale = hi > lo ? 254.0f / (hi - lo) : 1.0f;
+    }
+
+    size_t positives = 0;
+    std::vector<Sample> samples(landings.size());
+    for (size_t i = 0; i < landings.size(); i++)
+    {
+        quantizeLanding(landings[i].features, quantizers, samples[i].q);
+        samples[i].target = landings[i].splitStep ? 1.0f : 0.0f;
+        positives += landings[i].splitStep;
+    }
+    const float prior = (positives + 1.0f) / (landings.size() + 2.0f);
+    const float bias = logf(prior / (1 - prior));
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i].score = bias;
+
+    std::vector<FloatTree> trees(treeCount);
+    for (size_t t = 0; t < treeCount; t++)
+        growTree(samples, learningRate, trees[t]);
+
+    // one scale for every leaf and the bias, the largest leaf becomes 127
+    float largest = 0;
+    for (size_t t = 0; t < treeCount; t++)
+        for (size_t l = 0; l < TREE_LEAVES; l++)
+            largest = std::max(largest, fabsf(trees[t].leaf[l]));
+    const float leafScale = largest > 0 ? 127.0f / largest : 1.0f;
+    std::vector<QuantizedTree> quantized(treeCount);
+    for (size_t t = 0; t < treeCount; t++)
+    {
+        memcpy(quantized[t].feature, trees[t].feature, sizeof(quantized[t].feature));
+        memcpy(quantized[t].threshold, trees[t].threshold, sizeof(quantized[t].threshold));
+        for (size_t l = 0; l < TREE_LEAVES; l++)
+            quantized[t].leaf[l] = (int8_t)lrintf(trees[t].leaf[l] * leafScale);
+    }
+    float scaledBias = bias * leafScale;
+    scaledBias = std::max(-32768.0f, std::min(32767.0f, scaledBias));
+    QuantizedEnsemble model = {quantizers, quantized.data(), treeCount, (int16_t)lrintf(scaledBias)};
+
+    size_t floatCorrect = 0, quantizedCorrect = 0, thresholdCorrect = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const bool splitStep = landings[i].splitStep;
+        floatCorrect += (samples[i].score >= 0) == splitStep;
+        quantizedCorrect += (ensembleScore(model, samples[i].q) >= 0) == splitStep;
+        thresholdCorrect += (landings[i].thresholdKind != OTHER_FOOTWORK) == splitStep;
+    }
+    const double n = (double)samples.size();
+    printf("%zu landings (%zu split steps), %zu trees of depth %zu\n", landings.size(), positives, treeCount,
+           TREE_DEPTH);
+    printf("  training accuracy: threshold rule %.1f%%, trees %.1f%%, int8 trees %.1f%%\n",
+           100 * thresholdCorrect / n, 100 * floatCorrect / n, 100 * quantizedCorrect / n);
+
+    FILE *out = fopen(outPath, "w");
+    if (!out)
+    {
+        fprintf(stderr, "cannot write %s\n", outPath);
+        return 1;
+    }
+    fprintf(out, "#pragma once\n");
+    fprintf(out, "// Generated by host/trainClassifier from %zu labeled landings, do not edit.\n", landings.size());
+    fprintf(out, "// Training accuracy %.1f%% (gyro threshold rule %.1f%%).\n", 100 * quantizedCorrect / n,
+            100 * thresholdCorrect / n);
+    fprintf(out, "#include \"FootworkClassifier.h\"\n\n");
+    fprintf(out, "static const FeatureQuantizer FOOTWORK_QUANTIZERS[LANDING_FEATURE_COUNT] = {\n");
+    for (size_t f = 0; f < LANDING_FEATURE_COUNT; f++)
+        fprintf(out, "    {%.6gf, %.6gf}, // %s\n", quantizers[f].offset, quantizers[f].scale, FEATURE_NAMES[f]);
+    fprintf(out, "};\n\n");
+    fprintf(out, "static const QuantizedTree FOOTWORK_TREES[] = {\n");
+    for (size_t t = 0; t < treeCount; t++)
+    {
+        const QuantizedTree &q = quantized[t];
+        fprintf(out, "    {{");
+        for (size_t i = 0; i < TREE_NODES; i++)
+            fprintf(out, "%s%u", i ? ", " : "", q.feature[i]);
+        fprintf(out, "}, {");
+        for (size_t i = 0; i < TREE_NODES; i++)
+            fprintf(out, "%s%d", i ? ", " : "", q.threshold[i]);
+        fprintf(out, "}, {");
+        for (size_t i = 0; i < TREE_LEAVES; i++)
+            fprintf(out, "%s%d", i ? ", " : "", q.leaf[i]);
+        fprintf(out, "}},\n");
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "static const int16_t FOOTWORK_BIAS = %d;\n", model.bias);
+    fclose(out);
+    printf("  wrote %s\n", outPath);
+    return 0;
+}
@@ -0,0 +1,451 @@
+// Searches the split step thresholds over a corpus of labeled traces. Every
+// parameter set runs SplitStepDetector batch by batch with the batch features
+// computed once per batch, the same way processData does on the sensor:
+// leveled into the gravity-aligned frame by AttitudeFilter as the default
+// DetectionParams ask, or on the sensor axes with --sensor-axes. Each set is
+// scored against the labels:
+//   precision    detected landings that overlap a labeled movement
+//   recall       labeled movements with a detected landing
+//   kind         matched landings classified as labeled (good/high/other)
+//   airtime      mean |airtime - labeled airtime| of the matched landings
+// The parameter sets run on all cores with a work-stealing loop. Binary traces
+// (*.imut, see imuTrace.h) are memory-mapped and shared read-only by the
+// workers, text traces are loaded once; the batch features don't depend on the
+// parameters and are computed once per trace, leveled batches included. The
+// sets use the gyro threshold rule and so does the default row they are ranked
+// against; the shipped defaults with the footwork classifier are shown below it.
+//
+// usage: tune [--grid | --random N] [--begin LO:HI:STEP] [--end LO:HI:STEP]
+//             [--gyro LO:HI:STEP] [--good LO:HI:STEP] [--threads N] [--top N]
+//             [--seed N] [--synth SECONDS] [--rate HZ] [--sensor-axes] [--csv FILE]
+//             [trace ...]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AttitudeFilter.h"
+#include "CaptureRecorder.h"
+#include "DetectionParams.h"
+#include "ImuFeatures.h"
+#include "SplitStepDetector.h"
+#include "imuTrace.h"
+#include "workStealing.h"
+
+namespace
+{
+const size_t GRAIN = 16; // parameter sets per chunk
+
+struct Axis
+{
+    float lo;
+    float hi;
+    float step;
+
+    size_t count() const { return step > 0 && hi >= lo ? (size_t)((hi - lo) / step + 1e-3f) + 1 : 1; }
+    float at(size_t i) const { return lo + step * i; }
+};
+
+enum AxisIndex
+{
+    BEGIN_AXIS,
+    END_AXIS,
+    GYRO_AXIS,
+    GOOD_AXIS,
+    AXIS_COUNT,
+};
+
+// a trace ready for the workers, only read once the search runs
+struct PreparedTrace
+{
+    TraceView view;
+    std::vector<ImuBatch> batches; // the view's, or leveled into the vectors below
+    std::vector<Vec3f> leveledAcc;
+    std::vector<Vec3f> leveledGyro;
+    std::vector<BatchFeatures> features;
+    std::vector<TraceLabel> labels; // sorted by begin time
+};
+
+struct Result
+{
+    SplitStepConfig config;
+    bool valid;
+    uint32_t detected; // landings (good, high and other)
+    uint32_t matched;
+    uint32_t correctKind;
+    uint32_t labels;
+    double airtimeError;
+
+    double precision() const { return detected ? (double)matched / detected : 0; }
+    double recall() const { return labels ? (double)matched / labels : 0; }
+    double f1() const
+    {
+        double p = precision(), r = recall();
+        return p + r > 0 ? 2 * p * r / (p + r) : 0;
+    }
+    double kindAccuracy() const { return matched ? (double)correctKind / matched : 0; }
+    double meanAirtimeError() const { return matched ? airtimeError / matched : 0; }
+};
+
+// best first: F1, then classification, then airtime
+bool better(const Result &a, const Result &b)
+{
+    if (a.valid != b.valid)
+        return a.valid;
+    if (a.f1() != b.f1())
+        return a.f1() > b.f1();
+    if (a.kindAccuracy() != b.kindAccuracy())
+        return a.kindAccuracy() > b.kindAccuracy();
+    return a.meanAirtimeError() < b.meanAirtimeError();
+}
+
+bool labelBefore(const TraceLabel &a, const TraceLabel &b)
+{
+    return a.beginTime < b.beginTime;
+}
+
+// The attitude filter runs through the trace once, as a session's does over
+// its batches; it doesn't depend on the thresholds.
+void prepare(const TraceView &view, bool level, PreparedTrace &prepared)
+{
+    prepared.view = view;
+    prepared.batches.resize(view.batchCount());
+    prepared.features.resize(view.batchCount());
+    AttitudeFilter attitude;
+    attitude.setSampleRate(view.sampleRate);
+    if (level)
+    {
+        prepared.leveledAcc.resize(view.sampleCount);
+        prepared.leveledGyro.resize(view.sampleCount);
+    }
+    size_t offset = 0;
+    for (size_t b = 0; b < view.batchCount(); b++)
+    {
+        ImuBatch batch = view.batch(b);
+        if (level)
+        {
+            const size_t capacity = std::min(LEVEL_MAX_SAMPLES, view.sampleCount - offset);
+            batch = attitude.levelBatch(batch, &prepared.leveledAcc[offset], &prepared.leveledGyro[offset], capacity);
+            offset += batch.accCount;
+        }
+        prepared.batches[b] = batch;
+        computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, prepared.features[b]);
+    }
+    prepared.labels.assign(view.labels, view.labels + view.labelCount);
+    std::sort(prepared.labels.begin(), prepared.labels.end(), labelBefore);
+}
+
+void clearScore(Result &result)
+{
+    result.detected = result.matched = result.correctKind = result.labels = 0;
+    result.airtimeError = 0;
+}
+
+// Landings come in time order, so the labels are walked once per trace and
+// every label counts for at most one landing.
+void evaluate(const std::vector<PreparedTrace> &corpus, Result &result)
+{
+    clearScore(result);
+    SplitStepEvent events[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    for (size_t t = 0; t < corpus.size(); t++)
+    {
+        const PreparedTrace &trace = corpus[t];
+        SplitStepDetector detector(result.config);
+        detector.setSampleRate(trace.view.sampleRate);
+        size_t label = 0;
+        result.labels += (uint32_t)trace.labels.size();
+        for (size_t b = 0; b < trace.features.size(); b++)
+        {
+            size_t n = detector.process(trace.batches[b], trace.features[b], events,
+                                        SplitStepDetector::MAX_EVENTS_PER_BATCH);
+            for (size_t i = 0; i < n; i++)
+            {
+                const SplitStepEvent &e = events[i];
+                if (e.kind == ZERO_G_BEGIN)
+                    continue;
+                result.detected++;
+                while (label < trace.labels.size() && trace.labels[label].endTime < e.beginTime)
+                    label++;
+                if (label == trace.labels.size() || trace.labels[label].beginTime > e.endTime)
+                    continue;
+                const TraceLabel &l = trace.labels[label++];
+                result.matched++;
+                if (l.kind == e.kind)
+                    result.correctKind++;
+                double airtime = (double)e.endTime - e.beginTime;
+                double labeled = (double)l.endTime - l.beginTime;
+                result.airtimeError += fabs(airtime - labeled);
+            }
+        }
+    }
+}
+
+// same rules as SET_PARAMS, so every result can be sent to the sensor
+bool validConfig(const SplitStepConfig &config)
+{
+    DetectionParams params;
+    params.splitStep = config;
+    return validDetectionParams(params, CAPTURE_MAX_RATE);
+}
+
+SplitStepConfig gridConfig(const Axis axes[], size_t index)
+{
+    size_t i[AXIS_COUNT];
+    for (size_t a = 0; a < AXIS_COUNT; a++)
+    {
+        i[a] = index % axes[a].count();
+        index /= axes[a].count();
+    }
+    SplitStepConfig config;
+    config.beginThreshold = axes[BEGIN_AXIS].at(i[BEGIN_AXIS]);
+    config.endThreshold = axes[END_AXIS].at(i[END_AXIS]);
+    config.splitStepThreshold = axes[GYRO_AXIS].at(i[GYRO_AXIS]);
+    config.goodStepLength = (uint32_t)(axes[GOOD_AXIS].at(i[GOOD_AXIS]) + 0.5f);
+    config.classifier = false; // the gyro axis tunes the threshold rule
+    return config;
+}
+
+// uniform in [0, 1), from the index alone so results don't depend on scheduling
+float unitHash(uint64_t seed, uint64_t index, unsigned axis)
+{
+    uint64_t x = seed * 0x9E3779B97F4A7C15ull + index * 0xBF58476D1CE4E5B9ull + axis * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    x *= 0xD6E8FEB86659FD39ull;
+    x ^= x >> 28;
+    return (float)((x >> 40) / 16777216.0);
+}
+
+SplitStepConfig randomConfig(const Axis axes[], uint32_t seed, size_t index)
+{
+    float v[AXIS_COUNT];
+    for (unsigned a = 0; a < AXIS_COUNT; a++)
+        v[a] = axes[a].lo + (axes[a].hi - axes[a].lo) * unitHash(seed, index, a);
+    SplitStepConfig config;
+    config.beginThreshold = v[BEGIN_AXIS];
+    config.endThreshold = v[END_AXIS];
+    config.splitStepThreshold = v[GYRO_AXIS];
+    config.goodStepLength = (uint32_t)(v[GOOD_AXIS] + 0.5f);
+    config.classifier = false;
+    return config;
+}
+
+bool parseAxis(const char *text, Axis &axis)
+{
+    return sscanf(text, "%f:%f:%f", &axis.lo, &axis.hi, &axis.step) == 3 && axis.hi >= axis.lo;
+}
+
+void printResult(const char *title, const Result &r)
+{
+    printf("%-9s %6.2f %6.2f %6.1f %5u   %5.3f %5.3f %5.3f %5.3f %7.1f\n", title, r.config.beginThreshold,
+           r.config.endThreshold, r.config.splitStepThreshold, r.config.goodStepLength, r.precision(), r.recall(),
+           r.f1(), r.kindAccuracy(), r.meanAirtimeError());
+}
+
+bool writeCsv(const char *path, const std::vector<Result> &results)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+    fprintf(f, "begin,end,gyro,good_ms,valid,detected,matched,labels,precision,recall,f1,kind,airtime_ms\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        fprintf(f, "%.3f,%.3f,%.2f,%u,%d,%u,%u,%u,%.4f,%.4f,%.4f,%.4f,%.2f\n", r.config.beginThreshold,
+                r.config.endThreshold, r.config.splitStepThreshold, r.config.goodStepLength, r.valid ? 1 : 0,
+                r.detected, r.matched, r.labels, r.precision(), r.recall(), r.f1(), r.kindAccuracy(),
+                r.meanAirtimeError());
+    }
+    return fclose(f) == 0;
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: tune [--grid | --random N] [--begin LO:HI:STEP] [--end LO:HI:STEP]\n"
+                    "            [--gyro LO:HI:STEP] [--good LO:HI:STEP] [--threads N] [--top N]\n"
+                    "            [--seed N] [--synth SECONDS] [--rate HZ] [--sensor-axes] [--csv FILE]\n"
+                    "            [trace ...]\n");
+    exit(2);
+}
+}
+
+int main(int argc, char **argv)
+{
+    Axis axes[AXIS_COUNT] = {
+        {3.0f, 9.0f, 0.5f}, // begin acc
+        {8.0f, 14.0f, 0.5f}, // end acc
+        {40.0f, 160.0f, 10.0f}, // split step gyro
+        {150.0f, 260.0f, 10.0f}, // good step ms
+    };
+    size_t randomCount = 0;
+    unsigned workers = defaultWorkerCount();
+    size_t top = 10;
+    uint32_t seed = 1;
+    uint32_t synthSeconds = 0;
+    uint32_t rate = 52;
+    bool level = DetectionParams().level; // as processData runs a session with the default params
+    const char *csvPath = nullptr;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--grid")
+            randomCount = 0;
+        else if (arg == "--random" && hasValue)
+            randomCount = (size_t)atol(argv[++i]);
+        else if (arg == "--begin" && hasValue)
+        {
+            if (!parseAxis(argv[++i], axes[BEGIN_AXIS]))
+                usage();
+        }
+        else if (arg == "--end" && hasValue)
+        {
+            if (!parseAxis(argv[++i], axes[END_AXIS]))
+                usage();
+        }
+        else if (arg == "--gyro" && hasValue)
+        {
+            if (!parseAxis(argv[++i], axes[GYRO_AXIS]))
+                usage();
+        }
+        else if (arg == "--good" && hasValue)
+        {
+            if (!parseAxis(argv[++i], axes[GOOD_AXIS]))
+                usage();
+        }
+        else if (arg == "--threads" && hasValue)
+            workers = (unsigned)atoi(argv[++i]);
+        else if (arg == "--top" && hasValue)
+            top = (size_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--sensor-axes")
+            level = false;
+        else if (arg == "--csv" && hasValue)
+            csvPath = argv[++i];
+        else if (arg[0] == '-')
+            usage();
+        else
+            paths.push_back(arg);
+    }
+    if (workers < 1)
+        usage();
+
+    // binary traces stay mapped, text traces and synthesized ones in memory
+    std::vector<std::unique_ptr<MappedTrace> > mapped;
+    std::vector<std::string> textPaths;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!isBinaryTrace(paths[i]))
+        {
+            textPaths.push_back(paths[i]);
+            continue;
+        }
+        mapped.push_back(std::unique_ptr<MappedTrace>(new MappedTrace()));
+        if (!mapped.back()->open(paths[i]))
+            return 1;
+    }
+    std::vector<ImuTrace> loaded;
+    if (synthSeconds)
+    {
+        loaded.resize(1);
+        synthesizeTrace(loaded[0], rate, synthSeconds, seed);
+    }
+    else if ((!textPaths.empty() || mapped.empty()) && !loadCorpus(textPaths, loaded))
+        return 1;
+
+    std::vector<PreparedTrace> corpus(mapped.size() + loaded.size());
+    size_t samples = 0;
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        prepare(i < mapped.size() ? mapped[i]->view() : traceView(loaded[i - mapped.size()]), level, corpus[i]);
+        samples += corpus[i].view.sampleCount;
+        printf("%s: %zu samples at %u Hz, %zu labels\n", corpus[i].view.name, corpus[i].view.sampleCount,
+               corpus[i].view.sampleRate, corpus[i].labels.size());
+    }
+
+    size_t count = 1;
+    for (size_t a = 0; a < AXIS_COUNT; a++)
+        count *= axes[a].count();
+    if (randomCount)
+        count = randomCount;
+    std::vector<Result> results(count);
+    printf("%s search over %zu parameter sets on %u workers, %s\n", randomCount ? "random" : "grid", count, workers,
+           level ? "leveled" : "sensor axes");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    WorkStats stats = parallelFor(count, GRAIN, workers, [&](unsigned, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            Result &r = results[i];
+            r.config = randomCount ? randomConfig(axes, seed, i) : gridConfig(axes, i);
+            r.valid = validConfig(r.config);
+            if (r.valid)
+                evaluate(corpus, r);
+            else
+                clearScore(r);
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%.2f s, %.0f sets/s, %.1f Msamples/s, %zu chunks, %zu stolen\n\n", seconds, count / seconds,
+           (double)samples * count / seconds / 1e6, stats.chunks, stats.steals);
+
+    if (csvPath && !writeCsv(csvPath, results))
+        return 1;
+
+    // the default thresholds with the rule the sets use, and as they ship
+    Result defaults;
+    defaults.config = SplitStepConfig();
+    defaults.config.classifier = false;
+    defaults.valid = true;
+    evaluate(corpus, defaults);
+    Result shipped;
+    shipped.config = SplitStepConfig();
+    shipped.valid = true;
+    evaluate(corpus, shipped);
+
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = i;
+    size_t shown = std::min(top, count);
+    std::partial_sort(order.begin(), order.begin() + shown, order.end(),
+                      [&](size_t a, size_t b) { return better(results[a], results[b]); });
+
+    printf("          begin    end   gyro  good   prec  rec   f1    kind  airtime\n");
+    printResult("default", defaults);
+    printResult("classif.", shipped);
+    for (size_t i = 0; i < shown; i++)
+    {
+        char title[24];
+        snprintf(title, sizeof(title), "#%zu", i + 1);
+        printResult(title, results[order[i]]);
+    }
+
+    // ready to send: SET_PARAMS 0 with this block sets the profile new analyses start from
+    if (shown && results[order[0]].valid)
+    {
+        DetectionParams best;
+        best.splitStep = results[order[0]].config;
+        uint8_t block[PARAMS_BLOCK_SIZE];
+        // the thresholds are the first fields, the rest keeps the sensor's values;
+        // the gyro threshold is only used once the classifier field is set to 0
+        size_t len = encodeDetectionParams(best, block, sizeof(block));
+        printf("\nSET_PARAMS block of #1:");
+        for (size_t i = 0; i < len && i < 9; i++)
+            printf(" %02x", block[i]);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+// Work-stealing parallel loop for the host tools.
+//
+// The index range is cut into chunks and every worker gets a contiguous run of
+// them. A worker takes its own chunks from the front; once it runs dry it
+// steals from the back of another worker's run, so a few slow chunks (long
+// traces, configurations that detect a lot) don't leave cores idle while the
+// common case never touches another worker's queue.
+#include <stddef.h>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkStats
+{
+    size_t chunks; // chunks run
+    size_t steals; // chunks taken from other workers
+};
+
+namespace workStealing
+{
+struct Chunk
+{
+    size_t begin;
+    size_t end;
+};
+
+struct Queue
+{
+    std::mutex lock;
+    std::deque<Chunk> chunks;
+
+    bool popFront(Chunk &chunk)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (chunks.empty())
+            return false;
+        chunk = chunks.front();
+        chunks.pop_front();
+        return true;
+    }
+
+    bool popBack(Chunk &chunk)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (chunks.empty())
+            return false;
+        chunk = chunks.back();
+        chunks.pop_back();
+        return true;
+    }
+};
+}
+
+inline unsigned defaultWorkerCount()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Calls body(worker, begin, end) for chunks of at most grain indices covering
+// [0, count), on workers threads. No chunk is added once the loop runs, so a
+// worker that finds every queue empty is done.
+template <typename Body>
+WorkStats parallelFor(size_t count, size_t grain, unsigned workers, Body body)
+{
+    WorkStats total = {0, 0};
+    if (count == 0)
+        return total;
+    if (grain == 0)
+        grain = 1;
+    size_t chunkCount = (count + grain - 1) / grain;
+    if (workers == 0)
+        workers = 1;
+    if (workers > chunkCount)
+        workers = (unsigned)chunkCount;
+
+    std::vector<workStealing::Queue> queues(workers);
+    for (size_t c = 0; c < chunkCount; c++)
+    {
+        workStealing::Chunk chunk = {c * grain, std::min(count, (c + 1) * grain)};
+        queues[c * workers / chunkCount].chunks.push_back(chunk);
+    }
+
+    std::vector<WorkStats> stats(workers, total);
+    auto run = [&](unsigned w) {
+        workStealing::Chunk chunk;
+        while (true)
+        {
+            if (queues[w].popFront(chunk))
+            {
+                body(w, chunk.begin, chunk.end);
+                stats[w].chunks++;
+                continue;
+            }
+            bool stolen = false;
+            for (unsigned i = 1; i < workers && !stolen; i++)
+                stolen = queues[(w + i) % workers].popBack(chunk);
+            if (!stolen)
+                return;
+            body(w, chunk.begin, chunk.end);
+            stats[w].chunks++;
+            stats[w].steals++;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; w++)
+        threads.push_back(std::thread(run, w));
+    run(0);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    for (unsigned w = 0; w < workers; w++)
+    {
+        total.chunks += stats[w].chunks;
+        total.steals += stats[w].steals;
+    }
+    return total;
+}
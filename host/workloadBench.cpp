@@ -0,0 +1,248 @@
+// Feeds the workload fusion (WorkloadFusion.h) with the two streams of a
+// session the way they reach the application thread: the IMU6 batches of a
+// trace through the split step detector, and the /Meas/HR notifications of a
+// heart rate trace (synthesized from the IMU trace's labels without --hr),
+// merged in arrival order, the HR notifications held back by up to
+// --hr-delay-ms each. The session runs as fast as the host allows, once with
+// heart rate and once without. Reports the speed against real time, the
+// cost per notification, the queue high water, the items taken early or
+// late, and the score and heart rate every minute.
+//
+// usage: workloadBench [--hr FILE] [--synth SECONDS] [--rate HZ] [--seed N]
+//                      [--hr-delay-ms MS] [trace.csv]
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SplitStepDetector.h"
+#include "WorkloadFusion.h"
+#include "hrTrace.h"
+#include "imuTrace.h"
+
+namespace
+{
+const uint32_t TIMELINE_MS = 60000;
+
+// xorshift, the same delays on every host
+struct Rng
+{
+    uint32_t state;
+    explicit Rng(uint32_t seed) : state(seed ? seed : 1) {}
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+// one notification of either stream, in the order the app gets them
+struct Arrival
+{
+    uint32_t time; // device ms
+    bool hr;
+    size_t index; // batch or HR notification
+};
+
+bool operator<(const Arrival &a, const Arrival &b)
+{
+    return a.time < b.time;
+}
+
+struct TimelinePoint
+{
+    uint32_t minute;
+    uint8_t score;
+    uint8_t heartRate;
+    uint16_t load;
+};
+
+struct Run
+{
+    double wallMs;
+    std::vector<double> ns; // per notification
+    std::vector<TimelinePoint> timeline;
+    uint8_t score;
+    uint16_t load;
+    uint32_t forced;
+    uint32_t late;
+    size_t highWater;
+};
+
+double percentile(std::vector<double> v, double q)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+Run runSession(const ImuTrace &trace, const std::vector<std::vector<SplitStepEvent> > &events,
+               const HrTrace &hr, const std::vector<Arrival> &arrivals, bool withHr)
+{
+    Run run;
+    run.ns.reserve(arrivals.size());
+    static WorkloadFusion fusion; // as on the sensor, not on the stack
+    fusion.reset();
+    const uint32_t start = trace.timestamps[0];
+    uint32_t nextPoint = start + TIMELINE_MS;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t a = 0; a < arrivals.size(); a++)
+    {
+        const Arrival &arrival = arrivals[a];
+        if (arrival.hr && !withHr)
+            continue;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        if (arrival.hr)
+        {
+            const HrNotification &n = hr.notifications[arrival.index];
+            fusion.addHeartRate(n.average, n.rr.empty() ? nullptr : &n.rr[0], n.rr.size());
+        }
+        else
+        {
+            const std::vector<SplitStepEvent> &batchEvents = events[arrival.index];
+            for (size_t i = 0; i < batchEvents.size(); i++)
+                fusion.addEvent(batchEvents[i]);
+            fusion.addBatch(arrival.time);
+        }
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        run.ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+
+        if (arrival.time >= nextPoint)
+        {
+            TimelinePoint point;
+            point.minute = (nextPoint - start) / TIMELINE_MS;
+            point.score = fusion.score();
+            point.heartRate = fusion.heartRate();
+            point.load = fusion.load();
+            run.timeline.push_back(point);
+            nextPoint += TIMELINE_MS;
+        }
+    }
+    run.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    run.score = fusion.score();
+    run.load = fusion.load();
+    run.forced = fusion.forced();
+    run.late = fusion.late();
+    run.highWater = fusion.highWater();
+    return run;
+}
+
+void printRun(const char *name, const Run &run, double sessionMs)
+{
+    printf("  %s: %zu notifications in %.2f ms (%.0fx real time), %.0f ns p50, %.0f ns max\n", name, run.ns.size(),
+           run.wallMs, sessionMs / run.wallMs, percentile(run.ns, 0.5), percentile(run.ns, 1));
+    printf("    queues up to %zu items of %zu, %u taken early, %u late; score %u, load %u score-min\n", run.highWater,
+           2 * WorkloadFusion::QUEUE_SIZE, run.forced, run.late, run.score, run.load);
+}
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t synthSeconds = 600;
+    uint32_t rate = 104;
+    uint32_t seed = 1;
+    uint32_t hrDelayMs = 0;
+    const char *hrPath = nullptr;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--hr" && hasValue)
+            hrPath = argv[++i];
+        else if (arg == "--synth" && hasValue)
+            synthSeconds = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (arg == "--hr-delay-ms" && hasValue)
+            hrDelayMs = (uint32_t)atoi(argv[++i]);
+        else if (arg[0] == '-')
+        {
+            fprintf(stderr, "usage: workloadBench [--hr FILE] [--synth SECONDS] [--rate HZ] [--seed N]\n"
+                            "                     [--hr-delay-ms MS] [trace.csv]\n");
+            return 2;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    ImuTrace trace;
+    if (!paths.empty())
+    {
+        if (!loadTrace(paths[0], trace))
+            return 1;
+    }
+    else
+        synthesizeTrace(trace, rate, synthSeconds, seed);
+    if (trace.sampleCount() == 0)
+    {
+        fprintf(stderr, "%s: no samples\n", trace.name.c_str());
+        return 1;
+    }
+    HrTrace hr;
+    if (hrPath)
+    {
+        if (!loadHrTrace(hrPath, hr))
+            return 1;
+    }
+    else
+        synthesizeHrTrace(trace, seed, hr);
+
+    // the detector runs ahead, only the fusion is timed
+    SplitStepDetector detector((SplitStepConfig()));
+    detector.setSampleRate(trace.sampleRate);
+    SplitStepEvent found[SplitStepDetector::MAX_EVENTS_PER_BATCH];
+    std::vector<std::vector<SplitStepEvent> > events(trace.batchCount());
+    std::vector<Arrival> arrivals;
+    size_t eventCount = 0;
+    for (size_t b = 0; b < trace.batchCount(); b++)
+    {
+        ImuBatch batch = trace.batch(b);
+        size_t n = detector.process(batch, found, SplitStepDetector::MAX_EVENTS_PER_BATCH);
+        events[b].assign(found, found + n);
+        eventCount += n;
+        Arrival arrival;
+        arrival.time = batch.timestamp + (uint32_t)((batch.accCount - 1) * 1000 / trace.sampleRate);
+        arrival.hr = false;
+        arrival.index = b;
+        arrivals.push_back(arrival);
+    }
+    // a subscription delivers in order, a late notification holds back the next ones
+    Rng rng(seed);
+    const uint32_t start = trace.timestamps[0];
+    uint32_t previous = 0;
+    for (size_t i = 0; i < hr.notifications.size(); i++)
+    {
+        Arrival arrival;
+        arrival.time = start + hr.notifications[i].time + (hrDelayMs ? rng.next() % (hrDelayMs + 1) : 0);
+        arrival.time = std::max(arrival.time, previous);
+        previous = arrival.time;
+        arrival.hr = true;
+        arrival.index = i;
+        arrivals.push_back(arrival);
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end());
+
+    const double sessionMs = trace.timestamps.back() - start;
+    printf("%s: %.0f s at %u Hz, %zu batches, %zu events; %zu HR notifications, up to %u ms late\n",
+           trace.name.c_str(), sessionMs / 1000, trace.sampleRate, trace.batchCount(), eventCount,
+           hr.notifications.size(), hrDelayMs);
+    Run withHr = runSession(trace, events, hr, arrivals, true);
+    Run without = runSession(trace, events, hr, arrivals, false);
+    printRun("with heart rate", withHr, sessionMs);
+    printRun("footwork only", without, sessionMs);
+
+    printf("  minute  score  HR bpm  load | footwork only score  load\n");
+    for (size_t i = 0; i < withHr.timeline.size() && i < without.timeline.size(); i++)
+        printf("  %6u  %5u  %6u  %4u | %25u  %4u\n", withHr.timeline[i].minute, withHr.timeline[i].score,
+               withHr.timeline[i].heartRate, withHr.timeline[i].load, without.timeline[i].score,
+               without.timeline[i].load);
+    return 0;
+}
@@ -5,7 +5,29 @@
 #include "meas_gyro/resources.h"
 #include "meas_magn/resources.h"
 #include "meas_imu/resources.h"
+#include "movesense_time/resources.h"
+#include "meas_hr/resources.h"
 #include <ui_ind/resources.h>
+#include "AttitudeFilter.h"
+#include "BleTransmitter.h"
+#include "CaptureRecorder.h"
+#include "CommandFrames.h"
+#include "DataRoutes.h"
+#include "DetectionParams.h"
+#include "DetectorPipeline.h"
+#include "EventCodec.h"
+#include "FixedPoint.h"
+#include "FootworkDetectors.h"
+#include "ImuCodec.h"
+#include "ImuFeatures.h"
+#include "Instrumentation.h"
+#include "Logbook.h"
+#include "RateScheduler.h"
+#include "SessionSummary.h"
+#include "SplitStepDetector.h"
+#include "TimeSync.h"
+#include "TxQueue.h"
+#include "WorkloadFusion.h"
 
 // This code is modified by Yifan Lan (Andrew ID: yifanlan)
 
@@ -16,6 +38,27 @@ enum Commands
     BEGIN_SUB=1,
     END_SUB=2,
     BLINK=3,
+    SET_FORMAT=4, // [format (0 text, 1 binary), batch window ms (2 bytes, optional)]
+    BEGIN_RAW=5, // [format (0 SBEM, 1 compressed)], streams raw IMU6 batches
+    END_RAW=6,
+    CAPTURE=7, // [] captures the samples around now, [auto (0/1)] captures around every detection
+    SET_PARAMS=8, // [reference (0 for new analyses), parameter block], see DetectionParams.h
+    GET_PARAMS=9, // [reference (0 for new analyses)]
+    STATS=10, // replies with STATS_DATA records, see Instrumentation.h. The counters end with
+              // the TxQueue drops, TxQueue oversize messages and failed puts
+    RESET_STATS=11,
+    FEEDBACK=12, // [enabled (0/1)] LED feedback and LANDING responses on split step landings
+    SUMMARY=13, // [] replies with a SUMMARY_DATA of the session now, [interval s (2), per-event messages (0/1)]
+                // sends one every interval (0 for none), see SessionSummary.h
+    RESET_SUMMARY=14, // starts a new session for the summaries
+    TIME_SYNC=15, // [client time (4)] replies with TIME_DATA, one request at a time
+    LOG=16, // [mode (LogMode bits)] logs the default analysis to the logbook, replies with LOG_INFO
+    LOG_READ=17, // [offset (4)] streams the logbook from offset as LOG_DATA, ends with LOG_INFO
+    LOG_ERASE=18,
+    SET_MTU=19, // [ATT MTU (2)] sizes the notifications to the link, replies with [payload size (2)]
+    WORKLOAD=20, // [enabled (0/1), rest HR, max HR (bpm, optional)] subscribes to the heart rate for the
+                 // workload score of the summaries, see WorkloadFusion.h. Replies with [enabled, rest HR, max HR];
+                 // with every subscription slot taken a 507 tagged HR_REF comes first and enabled is 0
 };
 //Responses formated as byte array with [Response, tag, data?...] (data optional)
 enum Responses 
@@ -23,25 +66,410 @@ enum Responses
     COMMAND_RESULT = 1,
     DATA = 2,
     ERROR = 3,
+    PACKED = TX_PACKED_TYPE, // several responses in one notification, see TxQueue.h
+    EVENTS = 5, // binary detection events, see EventCodec.h
+    RAW = 6, // fragment of a raw IMU6 batch, see ImuCodec.h
+    CAPTURE_DATA = 7, // chunk of the samples around a trigger, see CaptureRecorder.h
+    STATS_DATA = 8, // counters or one latency histogram, see Instrumentation.h
+    LANDING = 9, // [kind, timestamp ms (4), airtime ms (2)] of a split step, sent ahead of all queued traffic
+    SUMMARY_DATA = 10, // statistics of the session so far, see SessionSummary.h
+    TIME_DATA = 11, // [client time (4), device time ms (4)], see TimeSync.h
+    LOG_DATA = 12, // [offset (4), logbook bytes...], see Logbook.h
+    LOG_INFO = 13, // [oldest record offset (4), end offset (4), mode, downloading (0/1)]
+    STATUS = STATUS_TYPE, // [command, HTTP status (2)] of a v2 command, tagged with its request ID, see CommandFrames.h
+};
+// what the logbook keeps of the default analysis
+enum LogMode
+{
+    LOG_EVENTS = 1, // every detection, as an EventRecord
+    LOG_RAW_BATCHES = 2, // every IMU6 batch, compressed
+};
+// how detection results are reported
+enum OutputFormat
+{
+    TEXT_FORMAT = 0,
+    BINARY_FORMAT = 1,
+};
+// what processData does with the notifications of a subscription, bound in the routing table
+enum StreamHandler
+{
+    FOOTWORK_STREAM = 1, // split step and footwork detection
+    RAW_STREAM = 2, // raw IMU6 batches forwarded to the client
+    HR_STREAM = 3, // heart rate for the workload score
+};
+// first byte of the SET_PARAMS/GET_PARAMS result, the parameter block follows
+enum ParamsStatus
+{
+    PARAMS_OK = 0,
+    PARAMS_INVALID = 1, // unknown version or values the detectors can't work with, nothing changed
+    PARAMS_NO_SESSION = 2, // no analysis runs with that reference
+};
+// how raw IMU batches are serialized
+enum RawFormat
+{
+    RAW_SBEM = 0,
+    RAW_COMPRESSED = 1,
 };
           
-const char IMUPath[]="/Meas/IMU6/52"; // path to IMU data, using 52 frequency
+const char IMUPathFormat[]="/Meas/IMU6/%u"; // path to IMU data, the frequency is picked by rateScheduler
 const char GYROPath[]="/Meas/Gyro/52"; // path to gyroscope data, using 52 frequency
 const uint8_t DEFAULT_REFERENCE=99; //appears as 63 in hex
 const uint8_t IMU_REF=20;
-const int8_t BEGIN_THRESHOLD=6; // acceleration threshold for split step beginning
-const int8_t END_THRESHOLD=10; // acceleration threshold for split step ending
-const int8_t SPLIT_STEP_THRESHOLD=80; // the threshold to differentiate between split steps and other footworks
-const uint32 GOOD_STEP_LENGTH=200; // the maximum time (ms) for performing a good split step
+const char RAWPath[]="/Meas/IMU6/104"; // raw streaming always runs at 104
+const char HRPath[]="/Meas/HR";
+const uint8_t HR_REF=22; // takes a subscription slot, as raw streaming does
 const uint8_t IMU_TAG = 5; // tag for gyroscope data
 const bool TEST = false; // whether enable test mode
+const size_t MAX_PENDING_EVENTS = 16; // binary events held back for batching
+const size_t CAPTURE_CHUNKS_PER_BATCH = 2; // capture upload pace, in chunks per IMU batch
+// The logbook pages stay in RAM until the sensor's flash driver is put behind
+// FlashStore: 8 kB, enough for hours of events, survive a disconnect but not a reset.
+const size_t LOG_FLASH_PAGES = 32;
+const size_t LOG_SECTOR_PAGES = 4;
+
+
+// detectors run on the IMU subscription, all fed from one feature pass per batch,
+// in float or fixed point as FIXED_POINT_DETECTION picks (FixedPoint.h)
+typedef BasicSplitStepDetector<DetectionMath> SessionSplitStepDetector;
+typedef DetectorPipeline<SessionSplitStepDetector, BasicLateralShuffleDetector<DetectionMath>,
+                         BasicCrossoverDetector<DetectionMath>, BasicLungeDetector<DetectionMath> > FootworkPipeline;
+
+// One analysis of the IMU data, per client reference. Every session has its
+// own detector state and thresholds; sessions at the same rate share one
+// subscription and decode its batches once.
+struct AnalysisSession
+{
+    uint8_t reference; // client reference of its subscription
+    uint8_t tag; // tag of its results
+    DetectionParams params; // in use by the detectors
+    DetectionParams pendingParams; // set by SET_PARAMS, taken over at the next batch
+    bool paramsPending;
+    FootworkPipeline footwork;
+    BasicRateScheduler<DetectionMath> rateScheduler; // picks the IMU sample rate from the motion in the batches
+    AttitudeFilter attitude; // levels the batches when params.level is set
+};
+// the sessions, raw streaming and the heart rate share the subscription slots,
+// whatever comes last when they are all taken gets a 507
+const size_t MAX_SESSIONS = DATA_ROUTE_SLOTS - 1;
+AnalysisSession sessions[MAX_SESSIONS];
+DetectionParams defaultParams; // what a BEGIN_SUB starts from, changed with SET_PARAMS 0
+
+OutputFormat outputFormat = TEXT_FORMAT; // negotiated with SET_FORMAT
+uint16_t eventWindow = 0; // time (ms) binary events wait for others to share a notification
+uint16_t eventSequence = 0; // sequence number of the next binary event
+EventRecord pendingEvents[MAX_PENDING_EVENTS]; // binary events not sent yet
+size_t pendingEventCount = 0;
+uint32 pendingSince = 0; // timestamp of the batch of the oldest pending event
+uint8_t pendingTag = IMU_TAG; // tag of the session the pending events belong to
+
+RawFormat rawFormat = RAW_COMPRESSED; // chosen with BEGIN_RAW
+RawFragmenter rawFragmenter; // numbers the raw fragments so the client can spot gaps
+uint8_t rawBuffer[RAW_MAX_ENCODED]; // compressed batch, kept off the stack
+
+Vec3f leveledAcc[LEVEL_MAX_SAMPLES]; // the batch of one session in its gravity-aligned frame
+Vec3f leveledGyro[LEVEL_MAX_SAMPLES];
+
+CaptureRecorder captureRecorder; // recent samples of the IMU subscription, for auditing detections
+bool autoCapture = false; // whether every detection triggers a capture
+
+bool feedbackMode = false; // set with FEEDBACK, follows the default analysis
+const uint16_t FEEDBACK_BLINK_MS = 120; // one blink for a good split step, two for a high one
+
+bool timeSyncPending = false; // a TIME_SYNC waits for the device clock
+uint32 syncClientTime = 0; // its client time, echoed in the reply
+
+MemoryFlash<LOG_FLASH_PAGES, LOG_SECTOR_PAGES> logFlash;
+uint8_t logMode = 0; // LogMode bits, set with LOG
+bool logSessionPending = false; // the next batch of the default analysis starts a LOG_SESSION
+uint16_t logSequence = 0; // sequence number of the next logged event
+bool logDownloading = false; // a LOG_READ is being streamed
+uint32 logDownloadOffset = 0; // where it goes on
+
+WorkloadFusion workload; // footwork of the default analysis, and its heart rate while WORKLOAD is on
+
+bool eventMessages = true; // whether the default analysis reports every event, cleared with SUMMARY to get summaries only
+static_assert(ACTIVE_SAMPLE_RATE <= CAPTURE_MAX_RATE, "capture window too small for the active sample rate");
+
+static_assert(sizeof(wb::FloatVector3D) == sizeof(Vec3f), "Vec3f must match wb::FloatVector3D");
+
+// thin adapter from the Whiteboard IMU6 notification to the detector input
+static ImuBatch toImuBatch(const WB_RES::IMU6Data &data){
+    ImuBatch batch;
+    batch.timestamp = data.timestamp;
+    batch.accCount = data.arrayAcc.size();
+    batch.acc = batch.accCount ? reinterpret_cast<const Vec3f*>(&data.arrayAcc[0]) : nullptr;
+    batch.gyroCount = data.arrayGyro.size();
+    batch.gyro = batch.gyroCount ? reinterpret_cast<const Vec3f*>(&data.arrayGyro[0]) : nullptr;
+    return batch;
+}
+
+// sends the pending binary events, as many per notification as the payload allows
+static void flushEvents(){
+    uint8_t payload[TxQueue::MAX_PAYLOAD];
+    // the notification also carries the response type and tag
+    const size_t payloadSize = bleTransmitter().queue().payloadSize() - 2;
+    EventPacker packer(payload, payloadSize);
+    for (size_t i=0; i<pendingEventCount; i++) {
+        if (!packer.add(pendingEvents[i])) {
+            bleTransmitter().send(Responses::EVENTS, pendingTag, packer.data(), packer.length());
+            packer.clear();
+            packer.add(pendingEvents[i]);
+        }
+    }
+    if (!packer.empty())
+        bleTransmitter().send(Responses::EVENTS, pendingTag, packer.data(), packer.length());
+    pendingEventCount = 0;
+}
+
+// the verdict in as few bytes as possible, queued ahead of everything else
+static void sendLanding(const SplitStepEvent &e, uint8_t tag){
+    uint32 airtime = e.endTime - e.beginTime;
+    uint8_t msg[7];
+    msg[0] = (uint8_t) e.kind;
+    msg[1] = (uint8_t) e.endTime;
+    msg[2] = (uint8_t) (e.endTime >> 8);
+    msg[3] = (uint8_t) (e.endTime >> 16);
+    msg[4] = (uint8_t) (e.endTime >> 24);
+    msg[5] = (uint8_t) (airtime > 0xFFFF ? 0xFFFF : airtime);
+    msg[6] = (uint8_t) ((airtime > 0xFFFF ? 0xFFFF : airtime) >> 8);
+    bleTransmitter().send(Responses::LANDING, tag, msg, sizeof(msg), TX_PRIORITY_HIGH);
+}
+
+static void queueEvent(const SplitStepEvent &e, uint32 batchTimestamp, uint8_t tag){
+    // a notification carries the events of one session
+    if (pendingEventCount == MAX_PENDING_EVENTS || (pendingEventCount > 0 && tag != pendingTag))
+        flushEvents();
+    pendingTag = tag;
+    EventRecord &r = pendingEvents[pendingEventCount++];
+    r.kind = (uint8_t) e.kind;
+    r.sequence = eventSequence++;
+    r.timestamp = e.endTime;
+    uint32 airtime = e.endTime - e.beginTime;
+    r.airtime = airtime > 0xFFFF ? 0xFFFF : (uint16_t) airtime;
+    r.maxGyro = e.maxZGyro > 0xFFFF ? 0xFFFF : (uint16_t) (e.maxZGyro + 0.5f);
+    if (pendingEventCount == 1)
+        pendingSince = batchTimestamp;
+}
+
+static void sendSummary(SummaryReason reason){
+    SessionSummary summary;
+    sessionAggregator().summarize(reason, summary);
+    summary.heartRate = workload.heartRate();
+    summary.workload = workload.score();
+    summary.load = workload.load();
+    uint8_t msg[SUMMARY_SIZE];
+    size_t len = encodeSessionSummary(summary, msg, sizeof(msg));
+    bleTransmitter().send(Responses::SUMMARY_DATA, IMU_TAG, msg, len);
+}
+
+// the echo goes ahead of queued traffic, a reply held in the queue would
+// make the round trip look asymmetric
+void sendTimeSync(bool valid, uint32_t deviceTime){
+    if (!timeSyncPending)
+        return;
+    timeSyncPending = false;
+    if (!valid) {
+        // 500: HTTP_CODE_INTERNAL_SERVER_ERROR
+        replyError(500, IMU_TAG);
+        return;
+    }
+    uint8_t msg[TIME_DATA_SIZE];
+    for (size_t i=0; i<4; i++) {
+        msg[i] = (uint8_t) (syncClientTime >> (8 * i));
+        msg[4 + i] = (uint8_t) (deviceTime >> (8 * i));
+    }
+    bleTransmitter().send(Responses::TIME_DATA, IMU_TAG, msg, sizeof(msg), TX_PRIORITY_HIGH);
+}
+
+void cancelTimeSync(){
+    timeSyncPending = false;
+}
+
+Logbook &logbook(){
+    static Logbook book(logFlash);
+    static bool mounted = false;
+    if (!mounted) {
+        book.mount();
+        mounted = true;
+    }
+    return book;
+}
 
+bool logbookLogging(){
+    return logMode != 0;
+}
+
+void stopLogDownload(){
+    logDownloading = false;
+}
+
+static void sendLogInfo(){
+    Logbook &book = logbook();
+    uint32 begin = book.begin();
+    uint32 end = book.end();
+    uint8_t msg[10];
+    for (size_t i=0; i<4; i++) {
+        msg[i] = (uint8_t) (begin >> (8 * i));
+        msg[4 + i] = (uint8_t) (end >> (8 * i));
+    }
+    msg[8] = logMode;
+    msg[9] = (uint8_t) logDownloading;
+    bleTransmitter().send(Responses::LOG_INFO, IMU_TAG, msg, sizeof(msg));
+}
+
+static void logEvent(const SplitStepEvent &e){
+    EventRecord r;
+    r.kind = (uint8_t) e.kind;
+    r.sequence = logSequence++;
+    r.timestamp = e.endTime;
+    uint32 airtime = e.endTime - e.beginTime;
+    r.airtime = airtime > 0xFFFF ? 0xFFFF : (uint16_t) airtime;
+    r.maxGyro = e.maxZGyro > 0xFFFF ? 0xFFFF : (uint16_t) (e.maxZGyro + 0.5f);
+    uint8_t record[EVENT_RECORD_SIZE];
+    encodeEventRecord(r, record);
+    logbook().append(LOG_EVENT, record, sizeof(record));
+}
+
+// Streams the logbook while the queue takes it, called again whenever a
+// notification went out, so a download runs at the pace of the link. Low
+// priority, live results still get through.
+static void pumpLogDownload(){
+    if (!logDownloading)
+        return;
+    Logbook &book = logbook();
+    uint8_t msg[TxQueue::MAX_PAYLOAD];
+    const size_t chunkSize = bleTransmitter().queue().payloadSize() - 2 - 4;
+    while (true) {
+        logDownloadOffset = book.seek(logDownloadOffset);
+        if (logDownloadOffset >= book.end()) {
+            logDownloading = false;
+            sendLogInfo();
+            return;
+        }
+        // a chunk can span pages, not a gap
+        size_t len = 0;
+        size_t n;
+        while (len < chunkSize && (n = book.read(logDownloadOffset + len, msg + 4 + len, chunkSize - len)) > 0)
+            len += n;
+        for (size_t i=0; i<4; i++)
+            msg[i] = (uint8_t) (logDownloadOffset >> (8 * i));
+        if (!bleTransmitter().send(Responses::LOG_DATA, IMU_TAG, msg, 4 + len, TX_PRIORITY_LOW))
+            return;
+        logDownloadOffset += len;
+    }
+}
+
+// cuts one serialized raw batch into notifications. Raw data is bulk traffic
+// and goes out at low priority so it never holds back results.
+static void sendRaw(const uint8_t data[], size_t len){
+    uint8_t fragment[TxQueue::MAX_PAYLOAD];
+    const size_t fragmentSize = bleTransmitter().queue().payloadSize() - 2;
+    size_t offset = 0;
+    size_t fragmentLen;
+    while ((fragmentLen = rawFragmenter.next(data, len, offset, fragment, fragmentSize)) > 0) {
+        bleTransmitter().send(Responses::RAW, RAW_REF, fragment, fragmentLen, TX_PRIORITY_LOW);
+    }
+}
+
+// sends a few chunks of a frozen capture. Low priority, so when the queue is
+// busy with live feedback the chunk is kept and retried with the next batch.
+static void uploadCapture(){
+    uint8_t payload[TxQueue::MAX_PAYLOAD];
+    const size_t payloadSize = bleTransmitter().queue().payloadSize() - 2;
+    for (size_t i=0; i<CAPTURE_CHUNKS_PER_BATCH; i++) {
+        size_t len = captureRecorder.chunk(payload, payloadSize);
+        if (len == 0 || !bleTransmitter().send(Responses::CAPTURE_DATA, IMU_TAG, payload, len, TX_PRIORITY_LOW))
+            return;
+        captureRecorder.advance(payloadSize);
+    }
+}
+
+// binds the subscription of reference to its handler, if subscribe() took it
+static void bindStream(uint8_t reference, StreamHandler handler, uint8_t binding = 0){
+    int slot = dataRoutes().findReference(reference);
+    if (slot != DataRoutes::NONE)
+        dataRoutes().setHandler(slot, handler, binding);
+}
+
+// the session running for reference, if any
+static AnalysisSession *activeSession(uint8_t reference){
+    if (dataRoutes().findReference(reference) == DataRoutes::NONE)
+        return nullptr;
+    for (size_t i=0; i<MAX_SESSIONS; i++) {
+        if (sessions[i].reference == reference)
+            return &sessions[i];
+    }
+    return nullptr;
+}
 
-bool begin = false; // whether the split step process has begun
-uint32 beginTime; // the starting timestamp of split step
-float maxZGyro = 0; // the maximum gyroscope magnitude detected during split step
-float beginZAcc; // beginning z-axis acc
-float endZAcc; // ending z-axis acc
+// the session of reference, or a session nobody is subscribed with anymore
+static AnalysisSession *sessionFor(uint8_t reference){
+    AnalysisSession *unused = nullptr;
+    for (size_t i=0; i<MAX_SESSIONS; i++) {
+        if (sessions[i].reference == reference)
+            return &sessions[i];
+        if (!unused && dataRoutes().findReference(sessions[i].reference) == DataRoutes::NONE)
+            unused = &sessions[i];
+    }
+    return unused;
+}
+
+// Parameters of a BEGIN_SUB, defaultParams for what is left out:
+// [reference, rate (2 bytes, 0 adaptive), begin acc, end acc, split step gyro, good step ms (2 bytes)]
+static DetectionParams parseProfile(const uint8_t values[], size_t len){
+    DetectionParams params = defaultParams;
+    if (len >= 3)
+        params.fixedRate = values[1] | (values[2] << 8);
+    SplitStepConfig &config = params.splitStep;
+    if (len >= 4 && values[3])
+        config.beginThreshold = values[3];
+    if (len >= 5 && values[4])
+        config.endThreshold = values[4];
+    if (len >= 6 && values[5])
+        config.splitStepThreshold = values[5];
+    if (len >= 8 && (values[6] | values[7]))
+        config.goodStepLength = values[6] | (values[7] << 8);
+    return params;
+}
+
+// the sample rate the subscription of the session runs at
+static uint32 sessionRate(const AnalysisSession &session){
+    return session.params.adaptive() ? session.rateScheduler.rate() : session.params.fixedRate;
+}
+
+// Takes over the parameters of a SET_PARAMS, between two batches so a batch
+// never sees half of them. Returns true when the subscription has to follow a
+// new sample rate.
+static bool applyPendingParams(AnalysisSession &session){
+    const bool wasAdaptive = session.params.adaptive();
+    const bool wasLevel = session.params.level;
+    session.params = session.pendingParams;
+    session.paramsPending = false;
+    session.footwork.get<SessionSplitStepDetector>().setConfig(session.params.splitStep);
+    session.rateScheduler.setConfig(session.params.rate);
+    if (session.params.adaptive() && !wasAdaptive)
+        session.rateScheduler.reset();
+    if (session.params.level && !wasLevel)
+        session.attitude.reset();
+    return sessionRate(session) != session.footwork.get<SessionSplitStepDetector>().sampleRate();
+}
+
+// replies to SET_PARAMS/GET_PARAMS with [status, parameter block]
+static void sendParams(ParamsStatus status, const DetectionParams &params, uint8_t tag){
+    uint8_t msg[1 + PARAMS_BLOCK_SIZE];
+    msg[0] = (uint8_t) status;
+    size_t len = encodeDetectionParams(params, &msg[1], PARAMS_BLOCK_SIZE);
+    bleTransmitter().send(Responses::COMMAND_RESULT, tag, msg, 1 + len);
+    // 400: HTTP_CODE_BAD_REQUEST, 404: HTTP_CODE_NOT_FOUND
+    if (status != PARAMS_OK)
+        setFramedStatus(status == PARAMS_INVALID ? 400 : 404);
+}
+
+// writes the IMU path for the given rate, returns its size including the terminator
+static size_t imuPath(char path[], size_t size, uint32 rate){
+    int len = snprintf(path, size, IMUPathFormat, (unsigned) rate);
+    return len > 0 && (size_t) len < size ? len + 1 : 0;
+}
 
 void myApp::handleCommand(uint8_t cmd, const uint8_t values[], size_t len){
     switch (cmd)
@@ -56,24 +484,60 @@ void myApp::handleCommand(uint8_t cmd, const uint8_t values[], size_t len){
             sendPacket(helloMsg, sizeof(helloMsg), tag, Responses::COMMAND_RESULT);
         }
         break;
-        // This case handles the split step analysis
+        // This case handles the split step analysis. Without data it (re)starts
+        // the default analysis on IMU_REF; a client reference and a threshold
+        // profile start another one next to it, see parseProfile.
         case Commands::BEGIN_SUB:
         {
+            uint8_t reference = len >= 1 && values[0] ? values[0] : IMU_REF;
+            uint8_t tag = reference == IMU_REF ? IMU_TAG : reference;
+            DetectionParams params = parseProfile(values, len);
+            // raw streaming and the heart rate keep their references
+            if (reference == RAW_REF || reference == HR_REF || !validDetectionParams(params, CAPTURE_MAX_RATE)) {
+                // 400: HTTP_CODE_BAD_REQUEST
+                replyError(400, reference);
+                break;
+            }
             //unsubscribes to prevent duplicate subscriptions
-            unsubscribe(DEFAULT_REFERENCE);
+            unsubscribe(reference);
+            AnalysisSession *session = sessionFor(reference);
+            if (!session) {
+                // 507: HTTP_CODE_INSUFFICIENT_STORAGE
+                replyError(507, reference);
+                break;
+            }
             uint8_t msg[] = "subscribe";
-            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
-            //subscribes to the IMU data
-
-            subscribe(IMUPath, sizeof(IMUPath), IMU_REF);
+            sendPacket(msg, sizeof(msg), tag, Responses::COMMAND_RESULT);
+            //subscribes to the IMU data, starting at the idle rate unless the rate is fixed
+            session->reference = reference;
+            session->tag = tag;
+            session->params = params;
+            session->paramsPending = false;
+            session->rateScheduler.setConfig(params.rate);
+            session->rateScheduler.reset();
+            uint32 rate = sessionRate(*session);
+            session->footwork.reset();
+            session->footwork.get<SessionSplitStepDetector>().setConfig(params.splitStep);
+            session->footwork.setSampleRate(rate);
+            session->attitude.reset();
+            session->attitude.setSampleRate(rate);
+            if (reference == IMU_REF) {
+                captureRecorder.reset();
+                logSessionPending = logMode != 0;
+            }
+            char path[20];
+            subscribe(path, imuPath(path, sizeof(path), rate), reference);
+            bindStream(reference, FOOTWORK_STREAM, (uint8_t) (session - sessions));
         }
         break;
         case Commands::END_SUB:
         {
-            //unsubscribes
+            //unsubscribes, [reference] ends another analysis than the default one
+            uint8_t reference = len >= 1 && values[0] ? values[0] : IMU_REF;
             uint8_t msg[] = "unsubscribe";
-            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
-            unsubscribe(IMU_REF);
+            sendPacket(msg, sizeof(msg), reference == IMU_REF ? IMU_TAG : reference, Responses::COMMAND_RESULT);
+            unsubscribe(reference);
+            flushEvents();
         }
         break;
         case Commands::BLINK:
@@ -83,107 +547,494 @@ void myApp::handleCommand(uint8_t cmd, const uint8_t values[], size_t len){
             ledSetPattern(1000, 2000, 3);
         }
         break;
+        case Commands::BEGIN_RAW:
+        {
+            unsubscribe(RAW_REF);
+            rawFormat = len >= 1 && values[0] == RAW_SBEM ? RAW_SBEM : RAW_COMPRESSED;
+            rawFragmenter.reset();
+            uint8_t msg[] = "raw subscribe";
+            sendPacket(msg, sizeof(msg), RAW_REF, Responses::COMMAND_RESULT);
+            subscribe(RAWPath, sizeof(RAWPath), RAW_REF);
+            bindStream(RAW_REF, RAW_STREAM);
+        }
+        break;
+        case Commands::END_RAW:
+        {
+            uint8_t msg[] = "raw unsubscribe";
+            sendPacket(msg, sizeof(msg), RAW_REF, Responses::COMMAND_RESULT);
+            unsubscribe(RAW_REF);
+        }
+        break;
+        case Commands::CAPTURE:
+        {
+            // replies with [capture started, auto capture, recorder memory (2 bytes)]
+            bool started = false;
+            if (len >= 1)
+                autoCapture = values[0] != 0;
+            else
+                started = captureRecorder.trigger(captureRecorder.latestTime());
+            uint8_t msg[] = {(uint8_t) started, (uint8_t) autoCapture,
+                             (uint8_t) CAPTURE_MEMORY, (uint8_t) (CAPTURE_MEMORY >> 8)};
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        // Tunes a running analysis, or the parameters later BEGIN_SUBs start
+        // from. The detectors take them over with the next batch.
+        case Commands::SET_PARAMS:
+        {
+            uint8_t reference = len >= 1 ? values[0] : 0;
+            uint8_t tag = reference == 0 || reference == IMU_REF ? IMU_TAG : reference;
+            AnalysisSession *session = reference ? activeSession(reference) : nullptr;
+            if (reference && !session) {
+                sendParams(PARAMS_NO_SESSION, defaultParams, tag);
+                break;
+            }
+            DetectionParams &target = !session ? defaultParams :
+                                      session->paramsPending ? session->pendingParams : session->params;
+            DetectionParams params = target;
+            if (len < 2 || !decodeDetectionParams(values + 1, len - 1, params) || !validDetectionParams(params, CAPTURE_MAX_RATE)) {
+                sendParams(PARAMS_INVALID, target, tag);
+                break;
+            }
+            if (session) {
+                session->pendingParams = params;
+                session->paramsPending = true;
+            } else {
+                defaultParams = params;
+            }
+            sendParams(PARAMS_OK, params, tag);
+        }
+        break;
+        case Commands::GET_PARAMS:
+        {
+            uint8_t reference = len >= 1 ? values[0] : 0;
+            uint8_t tag = reference == 0 || reference == IMU_REF ? IMU_TAG : reference;
+            AnalysisSession *session = reference ? activeSession(reference) : nullptr;
+            if (reference && !session)
+                sendParams(PARAMS_NO_SESSION, defaultParams, tag);
+            else if (!session)
+                sendParams(PARAMS_OK, defaultParams, tag);
+            else
+                sendParams(PARAMS_OK, session->paramsPending ? session->pendingParams : session->params, tag);
+        }
+        break;
+        case Commands::STATS:
+        {
+#if PERF_STATS
+            // the transmitter's own drop counters come along with ours
+            uint8_t msg[TxQueue::MAX_PAYLOAD];
+            const size_t payloadSize = bleTransmitter().queue().payloadSize() - 2;
+            const TxStats &tx = bleTransmitter().stats();
+            uint32_t counters[PERF_COUNTER_COUNT + 3];
+            for (size_t i=0; i<PERF_COUNTER_COUNT; i++)
+                counters[i] = perfStats().counters[i];
+            counters[PERF_COUNTER_COUNT] = tx.dropped;
+            counters[PERF_COUNTER_COUNT + 1] = tx.oversize;
+            counters[PERF_COUNTER_COUNT + 2] = bleTransmitter().failedCount();
+            size_t len = encodePerfCounters(counters, PERF_COUNTER_COUNT + 3, msg, payloadSize);
+            bleTransmitter().send(Responses::STATS_DATA, IMU_TAG, msg, len);
+            for (size_t i=0; i<PERF_PATH_COUNT; i++) {
+                len = encodePerfHistogram((uint8_t) i, perfStats().paths[i], msg, payloadSize);
+                bleTransmitter().send(Responses::STATS_DATA, IMU_TAG, msg, len);
+            }
+#else
+            // 501: HTTP_CODE_NOT_IMPLEMENTED, built without instrumentation
+            replyError(501, IMU_TAG);
+#endif
+        }
+        break;
+        case Commands::RESET_STATS:
+        {
+#if PERF_STATS
+            perfStats().reset();
+#endif
+            bleTransmitter().queue().resetStats();
+            uint8_t msg[] = "stats reset";
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        case Commands::SET_FORMAT:
+        {
+            // switches between text results and binary EVENTS responses,
+            // replies with the format in use and the binary protocol version
+            if (len >= 1 && values[0] <= BINARY_FORMAT) {
+                flushEvents();
+                outputFormat = (OutputFormat) values[0];
+                eventWindow = len >= 3 ? (uint16_t) (values[1] | (values[2] << 8)) : 0;
+            }
+            uint8_t msg[] = {(uint8_t) outputFormat, EVENT_PROTOCOL_VERSION};
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        case Commands::FEEDBACK:
+        {
+            // low-latency feedback on the landings of the default analysis,
+            // replies with the mode in use
+            if (len >= 1 && values[0] <= 1)
+                feedbackMode = values[0] == 1;
+            uint8_t msg[] = {(uint8_t) feedbackMode};
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        case Commands::SUMMARY:
+        {
+            // the totals are kept across disconnects, so a client that comes
+            // back asks for them instead of restarting the analysis
+            if (len >= 2) {
+                sessionAggregator().setInterval((uint16_t) (values[0] | (values[1] << 8)));
+                eventMessages = len < 3 || values[2] != 0;
+            }
+            sendSummary(SUMMARY_REQUESTED);
+        }
+        break;
+        case Commands::TIME_SYNC:
+        {
+            // the device clock is read asynchronously, see sendTimeSync
+            if (len < 4) {
+                // 400: HTTP_CODE_BAD_REQUEST
+                replyError(400, IMU_TAG);
+                break;
+            }
+            if (timeSyncPending) {
+                // 409: HTTP_CODE_CONFLICT
+                replyError(409, IMU_TAG);
+                break;
+            }
+            syncClientTime = values[0] | (values[1] << 8) | (values[2] << 16) | ((uint32) values[3] << 24);
+            if (asyncGet(WB_RES::LOCAL::TIME_DETAILED(), AsyncRequestOptions::Empty) >= 400) {
+                // 500: HTTP_CODE_INTERNAL_SERVER_ERROR
+                replyError(500, IMU_TAG);
+                break;
+            }
+            timeSyncPending = true;
+        }
+        break;
+        case Commands::LOG:
+        {
+            if (len >= 1) {
+                if (values[0] && !logMode)
+                    logSessionPending = true;
+                logMode = values[0] & (LOG_EVENTS | LOG_RAW_BATCHES);
+            }
+            sendLogInfo();
+        }
+        break;
+        case Commands::LOG_READ:
+        {
+            if (len < 4) {
+                // 400: HTTP_CODE_BAD_REQUEST
+                replyError(400, IMU_TAG);
+                break;
+            }
+            // offsets that are gone start at the oldest record
+            logDownloadOffset = values[0] | (values[1] << 8) | (values[2] << 16) | ((uint32) values[3] << 24);
+            logDownloading = true;
+            bleTransmitter().addRefillHandler(pumpLogDownload);
+            pumpLogDownload();
+        }
+        break;
+        case Commands::LOG_ERASE:
+        {
+            logDownloading = false;
+            logbook().clear();
+            logSessionPending = logMode != 0;
+            sendLogInfo();
+        }
+        break;
+        case Commands::RESET_SUMMARY:
+        {
+            sessionAggregator().reset();
+            workload.reset();
+            uint8_t msg[] = "summary reset";
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        case Commands::SET_MTU:
+        {
+            // the client tells the MTU it negotiated, a notification is the MTU
+            // minus the 3 byte ATT header. A new link starts at the default again.
+            if (len < 2) {
+                // 400: HTTP_CODE_BAD_REQUEST
+                replyError(400, IMU_TAG);
+                break;
+            }
+            const size_t mtu = values[0] | (values[1] << 8);
+            bleTransmitter().queue().setPayloadSize(mtu > 3 ? mtu - 3 : 0);
+            const size_t payloadSize = bleTransmitter().queue().payloadSize();
+            uint8_t msg[] = {(uint8_t) payloadSize, (uint8_t) (payloadSize >> 8)};
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        case Commands::WORKLOAD:
+        {
+            if (len >= 1) {
+                WorkloadConfig config = workload.config();
+                if (len >= 3 && values[2] > values[1]) {
+                    config.restHr = values[1];
+                    config.maxHr = values[2];
+                }
+                workload.setConfig(config);
+                unsubscribe(HR_REF);
+                if (values[0]) {
+                    subscribe(HRPath, sizeof(HRPath), HR_REF);
+                    bindStream(HR_REF, HR_STREAM);
+                }
+            }
+            const bool enabled = dataRoutes().findReference(HR_REF) != DataRoutes::NONE;
+            uint8_t msg[] = {(uint8_t) enabled, workload.config().restHr, workload.config().maxHr};
+            sendPacket(msg, sizeof(msg), IMU_TAG, Responses::COMMAND_RESULT);
+        }
+        break;
+        default:
+        {
+            // 501: HTTP_CODE_NOT_IMPLEMENTED
+            replyError(501, IMU_TAG);
+        }
+        break;
     }
 }
 
 void myApp::processData(wb::ResourceId resourceId, const wb::Value &value){
-    // only process data from IMU subscription
-    if(findDataSub(resourceId)->clientReference != IMU_REF)
+    // Batches of a subscription that was just replaced by a rate switch can
+    // still arrive and are dropped here.
+    int slot = dataRoutes().findResource(routeKey(resourceId));
+    if (slot == DataRoutes::NONE)
         return;
-    const WB_RES::IMU6Data &data = value.convertTo<WB_RES::IMU6Data&>();
-    const wb::Array<wb::FloatVector3D> &accData = data.arrayAcc;
-    const wb::Array<wb::FloatVector3D> &gyroData = data.arrayGyro;
-    // average gyroscope data
-    float averageZGyro=0;
-    for (size_t i=0; i<gyroData.size();i++) {
-        wb::FloatVector3D a = gyroData[i];
-        // float gyro = sqrt(a.x*a.x + a.y*a.y + a.z*a.z);
-        // to only get the magnitude and ignore the direction
-        averageZGyro += sqrt(a.z*a.z);
-    }
-    averageZGyro /= gyroData.size();
-
-    // average acceleration data
-    float averageAccMagnitude=0;
-    float averageZAcc=0;
-    for (size_t i=0; i<accData.size();i++) {
-        wb::FloatVector3D a = accData[i];
-        float acc = sqrt(a.x*a.x + a.y*a.y + a.z*a.z);
-        averageZAcc += a.z;
-        averageAccMagnitude += acc;
-    }
-    averageAccMagnitude /= accData.size();
-    averageZAcc /= accData.size();
-
-    // this marks the beginning of the zero-acceleration period
-    if (averageAccMagnitude < BEGIN_THRESHOLD) {
-        if (!begin) {
-            // reset all the value. Record the initial timestamp to calculate the height of jump
-            begin = true;
-            maxZGyro = 0;
-            beginZAcc = averageZAcc;
-            beginTime = data.timestamp;
-            // for debugging
-            if (TEST) {
-                char newMsg[] = "zero-g begins, acc is ";
-                sendWithNumber(newMsg, (int) averageAccMagnitude);
-            }
-        } else {
-            endZAcc = averageZAcc;
-        }
-        // calculate the maximum of gyroscope data during the zero-acceleration period
-        maxZGyro = fmax(maxZGyro, averageZGyro);
+    PERF_SCOPE(PERF_PROCESS_DATA);
+    if (dataRoutes().handler(slot) == HR_STREAM) {
+        // timed with the IMU batches, see WorkloadFusion.h
+        const WB_RES::HRData &hr = value.convertTo<WB_RES::HRData&>();
+        workload.addHeartRate(hr.average, hr.rrData.size() ? &hr.rrData[0] : nullptr, hr.rrData.size());
         return;
     }
+    const WB_RES::IMU6Data &data = value.convertTo<WB_RES::IMU6Data&>();
+    const ImuBatch batch = toImuBatch(data);
+    PERF_COUNT(PERF_BATCHES, 1);
+    PERF_COUNT(PERF_SAMPLES, batch.accCount);
+    BasicBatchFeatures<DetectionMath> features;
+    BasicBatchFeatures<DetectionMath> leveledFeatures;
+    bool haveFeatures = false;
+    uint32 rateSwitches = 0; // sessions whose subscription has to follow a new rate
+    bool summaryDue = false;
 
-    // this markes the end of the zero-acceleration period
-    if (begin && averageAccMagnitude > END_THRESHOLD) {
-        begin = false;
-
-        // if the gyroscope data falls in the range of split step
-        if (maxZGyro < SPLIT_STEP_THRESHOLD) {
-            // calculate the total duration to get the height of jump
-            uint32 endTime = data.timestamp;
-            uint32 duration = endTime - beginTime;
+    // the batch is decoded once and handed to every reference subscribed to it
+    for (; slot != DataRoutes::NONE; slot = dataRoutes().next(slot)) {
+        const uint8_t handler = dataRoutes().handler(slot);
 
-            // good split step.
-            if (duration <= GOOD_STEP_LENGTH) {
-                uint8_t splitMsg[] = "You perform an excellent split step";
-                sendPacket(splitMsg, sizeof(splitMsg), IMU_TAG, Responses::COMMAND_RESULT);
-            // bad split step only consider the case where the user jump too high due to the limitation of the sensor
+        // raw streaming, the batch is only serialized and sent
+        if (handler == RAW_STREAM) {
+            if (rawFormat == RAW_SBEM) {
+                size_t len = serializeData(resourceId, value);
+                if (len > 0)
+                    sendRaw(mSerializedData, len);
             } else {
-                uint8_t splitMsg[] = "You jumped too high for your split step";
-                sendPacket(splitMsg, sizeof(splitMsg), IMU_TAG, Responses::COMMAND_RESULT);
+                size_t len = encodeImuBatch(batch, rawBuffer, sizeof(rawBuffer));
+                if (len > 0)
+                    sendRaw(rawBuffer, len);
             }
-            // debug purpose
-            if (TEST) {
-                char splitMsg[] = "split step detected. maxZGyro = ";
-                sendWithNumber(splitMsg, (int) maxZGyro);
+            continue;
+        }
+        // only analyze data from IMU subscription
+        if (handler != FOOTWORK_STREAM)
+            continue;
+        const size_t index = dataRoutes().binding(slot);
+        AnalysisSession &session = sessions[index];
+        const uint8_t tag = session.tag;
+        if (session.paramsPending && applyPendingParams(session))
+            rateSwitches |= 1u << index;
+        // a leveled session has a batch of its own, the others share the features of the sensor axes
+        ImuBatch input = batch;
+        const BasicBatchFeatures<DetectionMath> *inputFeatures = &features;
+        if (session.params.level) {
+            input = session.attitude.levelBatch(batch, leveledAcc, leveledGyro, LEVEL_MAX_SAMPLES);
+            computeBatchFeatures(input.acc, input.accCount, input.gyro, input.gyroCount, leveledFeatures);
+            inputFeatures = &leveledFeatures;
+        } else if (!haveFeatures) {
+            computeBatchFeatures(batch.acc, batch.accCount, batch.gyro, batch.gyroCount, features);
+            haveFeatures = true;
+        }
+
+        // captures follow the default analysis
+        const bool primary = session.reference == IMU_REF;
+        const float samplePeriod = 1000.0f / session.footwork.get<SessionSplitStepDetector>().sampleRate();
+        // time of the last sample, the feedback latency and the workload run up to it.
+        // A notification without samples has no end, it is left out of both.
+        const bool haveSamples = batch.accCount > 0;
+        const uint32 batchEnd = haveSamples ? batch.timestamp + (uint32) ((batch.accCount - 1) * samplePeriod + 0.5f) : batch.timestamp;
+        if (primary) {
+            captureRecorder.record(batch, samplePeriod);
+            if (logSessionPending) {
+                uint8_t start[4];
+                for (size_t i=0; i<4; i++)
+                    start[i] = (uint8_t) (data.timestamp >> (8 * i));
+                logbook().append(LOG_SESSION, start, sizeof(start));
+                logSessionPending = false;
+            }
+            if (logMode & LOG_RAW_BATCHES) {
+                size_t len = encodeImuBatch(batch, rawBuffer, sizeof(rawBuffer));
+                if (len > 0)
+                    logbook().append(LOG_RAW, rawBuffer, len);
             }
+        }
+
+        SplitStepEvent events[FootworkPipeline::MAX_EVENTS_PER_BATCH];
+        size_t eventCount = session.footwork.process(input, *inputFeatures, events, FootworkPipeline::MAX_EVENTS_PER_BATCH);
+
+        // feedback before anything else of the batch: the LED first, then a
+        // LANDING response that overtakes the queued messages. The landing
+        // sample waited for the rest of its batch, that counts too.
+        if (primary && feedbackMode && haveSamples) {
+            for (size_t i=0; i<eventCount; i++) {
+                const SplitStepEvent &e = events[i];
+                if (e.kind != GOOD_STEP && e.kind != HIGH_STEP)
+                    continue;
+                ledSetPattern(FEEDBACK_BLINK_MS, FEEDBACK_BLINK_MS, e.kind == GOOD_STEP ? 1 : 2);
+                // in integers up to the difference, the timestamps are too large for a float after a few hours
+                PERF_ADD(PERF_FEEDBACK, perfMsToTicks((float) (int32_t) (batchEnd - e.endTime)) + PERF_ELAPSED());
+                sendLanding(e, tag);
+            }
+        }
 
-        } else {
+        // the summaries follow the default analysis, which can report them
+        // instead of every event
+        if (primary)
+            summaryDue = sessionAggregator().update(data.timestamp);
+        for (size_t i=0; i<eventCount; i++) {
+            const SplitStepEvent &e = events[i];
+            if (e.kind != ZERO_G_BEGIN)
+                PERF_COUNT(PERF_EVENTS, 1);
+            if (primary && autoCapture && e.kind != ZERO_G_BEGIN)
+                captureRecorder.trigger(e.endTime);
+            if (primary) {
+                sessionAggregator().add(e);
+                workload.addEvent(e);
+                if ((logMode & LOG_EVENTS) && e.kind != ZERO_G_BEGIN)
+                    logEvent(e);
+                if (!eventMessages)
+                    continue;
+            }
+            if (outputFormat == BINARY_FORMAT && e.kind != ZERO_G_BEGIN) {
+                queueEvent(e, data.timestamp, tag);
+                continue;
+            }
+            switch (e.kind)
+            {
+                case ZERO_G_BEGIN:
+                {
+                    // for debugging
+                    if (TEST) {
+                        char newMsg[] = "zero-g begins, acc is ";
+                        sendWithNumber(newMsg, (int) e.accMagnitude);
+                    }
+                }
+                break;
+                // good split step.
+                case GOOD_STEP:
+                {
+                    uint8_t splitMsg[] = "You perform an excellent split step";
+                    sendPacket(splitMsg, sizeof(splitMsg), tag, Responses::COMMAND_RESULT);
+                }
+                break;
+                // bad split step only consider the case where the user jump too high due to the limitation of the sensor
+                case HIGH_STEP:
+                {
+                    uint8_t splitMsg[] = "You jumped too high for your split step";
+                    sendPacket(splitMsg, sizeof(splitMsg), tag, Responses::COMMAND_RESULT);
+                }
+                break;
+                case OTHER_FOOTWORK:
+                {
+                    // debug purpose
+                    if (TEST) {
+                        char splitMsg[] = "this is not split, maxZGyro = ";
+                        sendWithNumber(splitMsg, (int) e.maxZGyro);
+                    }
+                }
+                break;
+                case LATERAL_SHUFFLE:
+                {
+                    uint8_t msg[] = "Lateral shuffle";
+                    sendPacket(msg, sizeof(msg), tag, Responses::COMMAND_RESULT);
+                }
+                break;
+                case CROSSOVER:
+                {
+                    uint8_t msg[] = "Crossover step";
+                    sendPacket(msg, sizeof(msg), tag, Responses::COMMAND_RESULT);
+                }
+                break;
+                case LUNGE:
+                {
+                    uint8_t msg[] = "Lunge";
+                    sendPacket(msg, sizeof(msg), tag, Responses::COMMAND_RESULT);
+                }
+                break;
+                default:
+                break;
+            }
             // debug purpose
-            if (TEST) {
-                char splitMsg[] = "this is not split, maxZGyro = ";
-                sendWithNumber(splitMsg, (int) maxZGyro);
+            if (TEST && (e.kind == GOOD_STEP || e.kind == HIGH_STEP)) {
+                char splitMsg[] = "split step detected. maxZGyro = ";
+                sendWithNumber(splitMsg, (int) e.maxZGyro);
             }
         }
+
+        // the heart rate waits for the footwork up to the end of the batch,
+        // without WORKLOAD the score is made of the footwork alone
+        if (primary && haveSamples)
+            workload.addBatch(batchEnd);
+
+        // follow the motion with the sample rate. Thresholds are physical units,
+        // so only the per-sample timing of the detector has to change.
+        if (session.params.adaptive() && session.rateScheduler.update(*inputFeatures, data.timestamp))
+            rateSwitches |= 1u << index;
+    }
+
+    // events of this batch share a notification, older ones are sent once the window is over
+    if (pendingEventCount > 0 && data.timestamp - pendingSince >= eventWindow)
+        flushEvents();
+
+    // after the events, so the summary counts them already
+    if (summaryDue)
+        sendSummary(SUMMARY_PERIODIC);
+
+    uploadCapture();
+    pumpLogDownload();
+
+    // resubscribing changes the routes, so it waits until the fan-out is done
+    for (size_t i=0; i<MAX_SESSIONS; i++) {
+        if (!(rateSwitches & (1u << i)))
+            continue;
+        AnalysisSession &session = sessions[i];
+        uint32 rate = sessionRate(session);
+        char path[20];
+        unsubscribe(session.reference);
+        subscribe(path, imuPath(path, sizeof(path), rate), session.reference);
+        bindStream(session.reference, FOOTWORK_STREAM, (uint8_t) i);
+        session.footwork.setSampleRate(rate);
+        session.attitude.setSampleRate(rate);
+        // debug purpose
+        if (TEST) {
+            char rateMsg[] = "sample rate is now ";
+            sendWithNumber(rateMsg, (int) rate);
+        }
     }
 }
 
 // the purpose of the function is to send an int to the console
 // this will help me to debug and fine tune the parameters
 void myApp::sendWithNumber(char *message, int number){
-    int nDigits = floor(log10(number)) + 1;
     char numStr[12];
-    sprintf(numStr, "%d", number);
-    int len = strlen(message);
+    size_t nDigits = formatDecimal(number, numStr);
+    size_t len = strlen(message);
     uint8_t output[50];
-    for (int i = 0; i < len; i++) {
+    if (len + nDigits > sizeof(output))
+        len = sizeof(output) - nDigits;
+    for (size_t i = 0; i < len; i++) {
         output[i] = uint8_t(message[i]);
     }
-    for (int i = len; i < 12 + len; i++) {
-        output[i] = uint8_t(numStr[i - len]);
+    for (size_t i = 0; i < nDigits; i++) {
+        output[len + i] = uint8_t(numStr[i]);
     }
     sendPacket(output, len + nDigits, IMU_TAG, Responses::COMMAND_RESULT);
 
@@ -1,6 +1,13 @@
 #include "movesense.h"
 
 #include "myApp.h"
+#include "BleTransmitter.h"
+#include "CommandFrames.h"
+#include "DataRoutes.h"
+#include "Instrumentation.h"
+#include "Logbook.h"
+#include "SessionSummary.h"
+#include "TimeSync.h"
 #include "common/core/debug.h"
 #include "oswrapper/thread.h"
 
@@ -34,7 +41,9 @@ myApp::myApp():
     mNotificationsEnabled(false),
     mSensorSvcHandle(0),
     mCommandCharHandle(0),
-    mDataCharHandle(0)
+    mDataCharHandle(0),
+    mLedTimer(wb::ID_INVALID_TIMER),
+    ledStatus(false)
 {
 }
 
@@ -58,6 +67,7 @@ bool myApp::startModule()
     mModuleState = WB_RES::ModuleStateValues::STARTED;
 
     // Clear subscription table
+    static_assert(DATA_ROUTE_SLOTS == MAX_DATASUB_COUNT, "every DataSub needs a route slot");
     for (size_t i=0; i<MAX_DATASUB_COUNT; i++)
     {
         mDataSubs[i].clientReference = 0;
@@ -65,6 +75,8 @@ bool myApp::startModule()
         mDataSubs[i].subStarted = false;
         mDataSubs[i].subCompleted = false;
     }
+    dataRoutes().clear();
+    PERF_INIT();
 
     // Follow BLE connection status
     asyncSubscribe(WB_RES::LOCAL::COMM_BLE_PEERS());
@@ -82,6 +94,8 @@ void myApp::stopModule()
     stopTimer(mLedTimer);
 
     // Clean up GATT stuff
+    bleTransmitter().reset();
+    bleTransmitter().setDataCharResource(wb::ID_INVALID_RESOURCE);
     asyncUnsubscribe(mCommandCharResource);
     asyncUnsubscribe(mDataCharResource);
     
@@ -129,52 +143,116 @@ void myApp::configGattSvc()
 // - client reference [1 byte]
 // - data: (2 byte "HTTP result" for commands, sbem formatted binary for subscriptions)
 
+// Subscriptions are looked up through dataRoutes(), whose slots are the
+// indices of mDataSubs.
+DataRoutes &dataRoutes()
+{
+    static DataRoutes routes;
+    return routes;
+}
+
 myApp::DataSub* myApp::findDataSub(const wb::ResourceId resourceId)
 {
-    for (size_t i=0; i<MAX_DATASUB_COUNT; i++)
-    {
-        const DataSub &ds= mDataSubs[i];
-        if (ds.resourceId == resourceId)
-            return &(mDataSubs[i]);
-    }
-    return nullptr;
+    int slot = dataRoutes().findResource(routeKey(resourceId));
+    return slot == DataRoutes::NONE ? nullptr : &(mDataSubs[slot]);
 }
 myApp::DataSub*  myApp::findDataSubByRef(const uint8_t clientReference)
 {
-    for (size_t i=0; i<MAX_DATASUB_COUNT; i++)
-    {
-        const DataSub &ds= mDataSubs[i];
-        if (ds.clientReference == clientReference)
-            return &(mDataSubs[i]);
+    int slot = dataRoutes().findReference(clientReference);
+    return slot == DataRoutes::NONE ? nullptr : &(mDataSubs[slot]);
+}
+
+void myApp::sendPacket(const uint8_t data[], size_t len, uint8_t tag /*=0*/, uint8_t type /*=2*/){
+    // queued and sent by the transmitter, several packets in one tick don't overwrite each other
+    if (!bleTransmitter().send(type, tag, data, len)) {
+        DEBUGLOG("sendPacket: dropped, notifications %d", mNotificationsEnabled);
     }
-    return nullptr;
 }
 
-myApp::DataSub* myApp::getFreeDataSubSlot()
-{
-    for (size_t i=0; i<MAX_DATASUB_COUNT; i++)
-    {
-        const DataSub &ds= mDataSubs[i];
-        if (ds.clientReference == 0 && ds.resourceId == wb::ID_INVALID_RESOURCE)
-            return &(mDataSubs[i]);
+// status of the v2 command being handled, replyError puts its error there
+static bool inFramedCommand = false;
+static uint16_t framedStatus = STATUS_OK;
+// frames of v2 writes that wait for room in the transmit queue, after PROTOCOL_V2
+static uint8_t pendingFrames[1 + 2 * TxQueue::MAX_PAYLOAD] = {PROTOCOL_V2};
+static size_t pendingLen = 1;
+// handleCommand is private, the refill handler gets it from handleIncomingCommand
+static myApp *framedApp = nullptr;
+static void (myApp::*framedHandler)(uint8_t, const uint8_t[], size_t) = nullptr;
+const size_t FRAME_SLOTS = 2; // a reply and the status
+
+void setFramedStatus(uint16_t status){
+    // the first error counts
+    if (inFramedCommand && framedStatus == STATUS_OK)
+        framedStatus = status;
+}
+
+void replyError(uint16_t status, uint8_t tag){
+    if (inFramedCommand) {
+        setFramedStatus(status);
+        return;
     }
-    return nullptr;
+    uint8_t errorMsg[] = {(uint8_t) (status >> 8), (uint8_t) status};
+    bleTransmitter().send(1, tag, errorMsg, sizeof(errorMsg)); // COMMAND_RESULT
 }
 
-void myApp::sendPacket(const uint8_t data[], size_t len, uint8_t tag /*=0*/, uint8_t type /*=2*/){
-    len = len<64? len:64; 
-    mDataMsgBuffer[0]=type;
-    mDataMsgBuffer[1]=tag;
-    for(size_t i=0; i<len; i++) {
-        mDataMsgBuffer[i+2]=data[i];
+static void sendStatus(uint8_t requestId, uint8_t command, uint16_t status){
+    uint8_t msg[STATUS_SIZE];
+    encodeStatus(command, status, msg);
+    bleTransmitter().send(STATUS_TYPE, requestId, msg, sizeof(msg));
+}
+
+// Handles the pending frames while the queue has room for their replies,
+// called again whenever a notification went out.
+static void handlePendingFrames(){
+    if (!framedApp)
+        return;
+    FrameReader reader(pendingFrames, pendingLen);
+    CommandFrame frame;
+    size_t handled = 1;
+    while (bleTransmitter().queue().size() + FRAME_SLOTS <= TxQueue::POOL_SIZE && reader.next(frame)) {
+        inFramedCommand = true;
+        framedStatus = STATUS_OK;
+        (framedApp->*framedHandler)(frame.command, frame.data, frame.len);
+        inFramedCommand = false;
+        sendStatus(frame.requestId, frame.command, framedStatus);
+        handled = reader.position();
     }
-    WB_RES::Characteristic dataCharValue;
-    dataCharValue.bytes=wb::MakeArray<uint8_t>(mDataMsgBuffer, len+2);
-    asyncPut(mDataCharResource, AsyncRequestOptions(NULL, 0, true), dataCharValue);
+    memmove(&pendingFrames[1], &pendingFrames[handled], pendingLen - handled);
+    pendingLen -= handled - 1;
+}
+
+// a dropped link takes the unanswered frames with it
+static void dropPendingFrames(){
+    pendingLen = 1;
 }
 
 void myApp::handleIncomingCommand(const wb::Array<uint8> &commandData)
 {
+    PERF_SCOPE(PERF_HANDLE_COMMAND);
+    if (isFramedWrite(&(commandData[0]), commandData.size())) {
+        // v2: the frames go after those still waiting, checked whole first
+        FrameReader reader(&(commandData[0]), commandData.size());
+        CommandFrame frame;
+        while (reader.next(frame))
+            ;
+        if (reader.malformed()) {
+            // 400: HTTP_CODE_BAD_REQUEST
+            sendStatus(0, PROTOCOL_V2, 400);
+            return;
+        }
+        if (pendingLen + commandData.size() - 1 > sizeof(pendingFrames)) {
+            // 503: HTTP_CODE_SERVICE_UNAVAILABLE, too many writes ahead of it
+            sendStatus(0, PROTOCOL_V2, 503);
+            return;
+        }
+        memcpy(&pendingFrames[pendingLen], &(commandData[1]), commandData.size() - 1);
+        pendingLen += commandData.size() - 1;
+        framedApp = this;
+        framedHandler = &myApp::handleCommand;
+        bleTransmitter().addRefillHandler(handlePendingFrames);
+        handlePendingFrames();
+        return;
+    }
     uint8_t cmd = commandData[0];
     const uint8_t *pData = commandData.size()>1 ? &(commandData[1]) : nullptr;
     uint16_t dataLen = commandData.size() - 1;
@@ -187,38 +265,64 @@ bool myApp::subscribe(const char path[], size_t pathlen, uint8_t reference){
         return false;
     }
 
-    DataSub *pDataSub = getFreeDataSubSlot();
-    if (!pDataSub)
+    if (dataRoutes().findReference(reference) != DataRoutes::NONE)
+    {
+        DEBUGLOG("Reference already subscribed: %u", reference);
+        // 409: HTTP_CODE_CONFLICT
+        replyError(409, reference);
+        return false;
+    }
+    int slot = dataRoutes().add(reference);
+    if (slot == DataRoutes::NONE)
     {
         DEBUGLOG("No free datasub slot");
         // 507: HTTP_CODE_INSUFFICIENT_STORAGE
-        uint8_t errorMsg[] = {0x01,0xFB};
-        sendPacket(errorMsg, sizeof(errorMsg), reference, 1);
+        replyError(507, reference);
         return false;
     }
     // Store client reference to array and trigger subsribe
-    DataSub &dataSub = *pDataSub;
+    DataSub &dataSub = mDataSubs[slot];
 
     dataSub.subStarted = true;
     dataSub.subCompleted = false;
     dataSub.clientReference = reference;
     wb::Result res = getResource(path, dataSub.resourceId);
     if(res<200 || res>210){
+        dataSub.clientReference = 0;
+        dataSub.resourceId = wb::ID_INVALID_RESOURCE;
+        dataSub.subStarted = false;
+        dataRoutes().remove(slot);
         return false;
     }
+    dataRoutes().bind(slot, routeKey(dataSub.resourceId));
+    if (dataRoutes().shared(slot))
+    {
+        // already streamed for another reference, the notifications are fanned out to this one too
+        const DataSub &feed = mDataSubs[dataRoutes().findResource(routeKey(dataSub.resourceId))];
+        dataSub.subCompleted = feed.subCompleted;
+        return true;
+    }
     asyncSubscribe(dataSub.resourceId, AsyncRequestOptions::ForceAsync);
+    PERF_COUNT(PERF_SUBSCRIBES, 1);
     return true;
 }
 
 void myApp::unsubscribe(uint8_t reference){
-    DataSub *pDataSub = findDataSubByRef(reference);
-    if (pDataSub != nullptr)
+    int slot = dataRoutes().findReference(reference);
+    if (slot != DataRoutes::NONE)
     {
-        asyncUnsubscribe(pDataSub->resourceId);
+        DataSub *pDataSub = &(mDataSubs[slot]);
+        // a shared resource keeps streaming for the other references
+        if (!dataRoutes().shared(slot))
+        {
+            asyncUnsubscribe(pDataSub->resourceId);
+            PERF_COUNT(PERF_UNSUBSCRIBES, 1);
+        }
         pDataSub->resourceId = wb::ID_INVALID_RESOURCE;
         pDataSub->clientReference = 0;
         pDataSub->subStarted = false;
         pDataSub->subCompleted = false;
+        dataRoutes().remove(slot);
     }
 }
 
@@ -306,6 +410,7 @@ void myApp::onGetResult(wb::RequestId requestId,
             getResource(pathBuffer, mCommandCharResource);
             snprintf(pathBuffer, sizeof(pathBuffer), "/Comm/Ble/GattSvc/%d/%d", mSensorSvcHandle, mDataCharHandle);
             getResource(pathBuffer, mDataCharResource);
+            bleTransmitter().setDataCharResource(mDataCharResource);
 
             // Forse subscriptions asynchronously to save stack (will have stack overflow if not) 
             // Subscribe to listen to intervalChar notifications (someone writes new value to intervalChar) 
@@ -314,6 +419,13 @@ void myApp::onGetResult(wb::RequestId requestId,
             asyncSubscribe(mDataCharResource,  AsyncRequestOptions(NULL, 0, true));
             break;
         }
+        case WB_RES::LOCAL::TIME_DETAILED::LID:
+        {
+            // the sensor clock for a TIME_SYNC
+            const bool valid = resultCode == wb::HTTP_CODE_OK;
+            sendTimeSync(valid, valid ? rResultData.convertTo<const WB_RES::DetailedTime &>().relativeTime : 0);
+            break;
+        }
     }
 }
 
@@ -342,29 +454,37 @@ void  myApp::onSubscribeResult(wb::RequestId requestId,
         default:
         {
             // All other notifications. These must be the client subscribed data streams
-            myApp::DataSub *ds = findDataSub(resourceId);
-            if (ds == nullptr)
+            int slot = dataRoutes().findResource(routeKey(resourceId));
+            if (slot == DataRoutes::NONE)
             {
                 DEBUGLOG("DataSub not found for resource: %u", resourceId);
                 return;
             }
-            ASSERT(ds->subStarted);
-            if (ds->subCompleted)
+            ASSERT(mDataSubs[slot].subStarted);
+            if (mDataSubs[slot].subCompleted)
             {
                 DEBUGLOG("subCompleted already: %u", resourceId);
                 return;
             }
 
-            if (resultCode >= 400)
+            // the result holds for every reference sharing the resource
+            while (slot != DataRoutes::NONE)
             {
-                ds->clientReference = 0;
-                ds->resourceId = wb::ID_INVALID_RESOURCE;
-                ds->subStarted=false;
-                ds->subCompleted=false;
-            }
-            else
-            {
-                ds->subCompleted=true;
+                int next = dataRoutes().next(slot);
+                DataSub *ds = &(mDataSubs[slot]);
+                if (resultCode >= 400)
+                {
+                    dataRoutes().remove(slot);
+                    ds->clientReference = 0;
+                    ds->resourceId = wb::ID_INVALID_RESOURCE;
+                    ds->subStarted=false;
+                    ds->subCompleted=false;
+                }
+                else
+                {
+                    ds->subCompleted=true;
+                }
+                slot = next;
             }
         }
         break;
@@ -377,13 +497,20 @@ void myApp::unsubscribeAllStreams()
     {
         if (mDataSubs[i].resourceId != wb::ID_INVALID_RESOURCE)
         {
-            asyncUnsubscribe(mDataSubs[i].resourceId);
+            // the last reference of a shared resource unsubscribes it
+            if (!dataRoutes().shared(i))
+            {
+                asyncUnsubscribe(mDataSubs[i].resourceId);
+                PERF_COUNT(PERF_UNSUBSCRIBES, 1);
+            }
+            dataRoutes().remove(i);
             mDataSubs[i].clientReference = 0;
             mDataSubs[i].resourceId = wb::ID_INVALID_RESOURCE;
             mDataSubs[i].subStarted = false;
             mDataSubs[i].subCompleted = false;
         }
     }
+    dataRoutes().clear();
 }
 
 void myApp::onNotify(wb::ResourceId resourceId,
@@ -395,10 +522,19 @@ void myApp::onNotify(wb::ResourceId resourceId,
         case WB_RES::LOCAL::COMM_BLE_PEERS::LID:
             {
                 WB_RES::PeerChange peerChange = value.convertTo<WB_RES::PeerChange>();
-                if (peerChange.state = peerChange.state.DISCONNECTED)
+                if (peerChange.state == peerChange.state.DISCONNECTED)
                 {
-                    // if connection is dropped, unsubscribe all data streams so that sensor does not stay on for no reason
-                    unsubscribeAllStreams();
+                    // if connection is dropped, unsubscribe all data streams so that sensor does not stay on for no reason.
+                    // With periodic summaries or the logbook the analyses keep running, the client gets the
+                    // totals or downloads the log when it is back.
+                    if (sessionAggregator().interval() || logbookLogging())
+                        unsubscribe(RAW_REF);
+                    else
+                        unsubscribeAllStreams();
+                    stopLogDownload();
+                    cancelTimeSync();
+                    dropPendingFrames();
+                    bleTransmitter().reset();
                 }
             }
 
@@ -420,6 +556,7 @@ void myApp::onNotify(wb::ResourceId resourceId,
                 const WB_RES::Characteristic &charValue = value.convertTo<const WB_RES::Characteristic &>();
                 // Update the notification state so we know if to forward data to datapipe
                 mNotificationsEnabled = charValue.notifications.hasValue() ? charValue.notifications.getValue() : false;
+                bleTransmitter().setNotificationsEnabled(mNotificationsEnabled);
                 DEBUGLOG("onNotify: mDataCharHandle. mNotificationsEnabled: %d", mNotificationsEnabled);
             }
             break;